@@ -170,14 +170,17 @@ HEADERS += \
 	src/gl/gltools.h \
 	src/gl/icontrollable.h \
 	src/gl/renderer.h \
+	src/gl/vertexstream.h \
 	src/io/material.h \
 	src/io/MeshFile.h \
 	src/io/nifstream.h \
 	src/lib/importex/3ds.h \
 	src/lib/nvtristripwrapper.h \
+	src/lib/parallel.h \
 	src/lib/qhull.h \
 	src/model/basemodel.h \
 	src/model/kfmmodel.h \
+	src/model/nifindex.h \
 	src/model/nifmodel.h \
 	src/model/nifproxymodel.h \
 	src/model/undocommands.h \
@@ -261,6 +264,7 @@ SOURCES += \
 	src/model/basemodel.cpp \
 	src/model/kfmmodel.cpp \
 	src/model/nifdelegate.cpp \
+	src/model/nifindex.cpp \
 	src/model/nifmodel.cpp \
 	src/model/nifextfiles.cpp \
 	src/model/nifproxymodel.cpp \
@@ -33,8 +33,137 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "nifitem.h"
 #include "model/basemodel.h"
 
+#include <QDataStream>
+#include <QHash>
+#include <QReadWriteLock>
+
+#include <cstdint>
+#include <cstring>
 #include <new>
 
+
+/*
+ *  NifNameAtom
+ */
+
+namespace
+{
+	//! The name table of NifNameAtom, atom 0 is the empty name
+	struct NameAtomTable
+	{
+		QReadWriteLock	lock;
+		QList<QByteArray>	names;
+		QHash<QByteArray, int>	atoms;
+
+		NameAtomTable()
+		{
+			names.append( QByteArray( "" ) );
+			atoms.insert( names.first(), 0 );
+		}
+	};
+
+	NameAtomTable & nameAtomTable()
+	{
+		static NameAtomTable	table;
+		return table;
+	}
+
+	int findNameAtom( const QByteArray & name, const char ** nameData = nullptr )
+	{
+		NameAtomTable &	t = nameAtomTable();
+		QReadLocker	lock( &t.lock );
+		int	n = t.atoms.value( name, -1 );
+		if ( nameData && n >= 0 )
+			*nameData = t.names.at( n ).constData();
+		return n;
+	}
+}
+
+NifNameAtom NifNameAtom::intern( const QString & name )
+{
+	if ( name.isEmpty() )
+		return NifNameAtom( 0 );
+
+	QByteArray	utf8 = name.toUtf8();
+	int	n = findNameAtom( utf8 );
+	if ( n < 0 ) {
+		NameAtomTable &	t = nameAtomTable();
+		QWriteLocker	lock( &t.lock );
+		n = t.atoms.value( utf8, -1 );
+		if ( n < 0 ) {
+			n = int( t.names.size() );
+			t.names.append( utf8 );
+			t.atoms.insert( utf8, n );
+		}
+	}
+	return NifNameAtom( n );
+}
+
+NifNameAtom NifNameAtom::find( std::string_view name )
+{
+	for ( char c : name ) {
+		// not ASCII: the names are stored in UTF-8, the string view is Latin-1
+		if ( (unsigned char) c >= 0x80 )
+			return find( QString::fromLatin1( name.data(), qsizetype( name.size() ) ) );
+	}
+	return NifNameAtom( findNameAtom( QByteArray::fromRawData( name.data(), qsizetype( name.size() ) ) ) );
+}
+
+NifNameAtom NifNameAtom::find( const QString & name )
+{
+	return NifNameAtom( findNameAtom( name.toUtf8() ) );
+}
+
+NifNameAtom NifNameAtom::fromLiteral( const char * name )
+{
+	struct CacheEntry
+	{
+		const char *	literal = nullptr;
+		//! The name in the atom table, which is never modified or freed
+		const char *	atomName = nullptr;
+		int	atom = -1;
+	};
+	static thread_local CacheEntry	cache[256];
+
+	if ( !name )
+		return NifNameAtom();
+
+	std::uintptr_t	h = std::uintptr_t( name );
+	CacheEntry &	e = cache[( h ^ ( h >> 8 ) ) & 255];
+	// The address may be reused by a different string if it is not a literal, so the contents are compared as well
+	if ( e.literal == name && std::strcmp( name, e.atomName ) == 0 )
+		return NifNameAtom( e.atom );
+
+	if ( std::strchr( name, '\\' ) )
+		return NifNameAtom();
+
+	size_t	len = std::strlen( name );
+	for ( size_t i = 0; i < len; i++ ) {
+		if ( (unsigned char) name[i] >= 0x80 )
+			return find( std::string_view( name, len ) );
+	}
+
+	const char *	atomName = nullptr;
+	int	n = findNameAtom( QByteArray::fromRawData( name, qsizetype( len ) ), &atomName );
+	if ( n >= 0 ) {
+		e.literal = name;
+		e.atomName = atomName;
+		e.atom = n;
+	}
+	return NifNameAtom( n );
+}
+
+QString NifNameAtom::name() const
+{
+	if ( id < 0 )
+		return QString();
+
+	NameAtomTable &	t = nameAtomTable();
+	QReadLocker	lock( &t.lock );
+	return QString::fromUtf8( t.names.at( id ) );
+}
+
+
 bool NifData::compareStrings( const QChar * s, const char * t, size_t l )
 {
 	for ( size_t i = 0; i < l; i++ ) {
@@ -44,6 +173,29 @@ bool NifData::compareStrings( const QChar * s, const char * t, size_t l )
 	return true;
 }
 
+void NifData::saveSchema( QDataStream & out ) const
+{
+	out << d->name << d->type << d->templ << d->arg << d->arr1 << d->arr2 << d->cond << d->vercond << d->text;
+	out << d->ver1 << d->ver2 << quint32( d->flags.toInt() );
+	d->argexpr.save( out );
+	d->condexpr.save( out );
+	d->arr1expr.save( out );
+	d->verexpr.save( out );
+}
+
+bool NifData::loadSchema( QDataStream & in )
+{
+	quint32	f;
+	in >> d->name >> d->type >> d->templ >> d->arg >> d->arr1 >> d->arr2 >> d->cond >> d->vercond >> d->text;
+	in >> d->ver1 >> d->ver2 >> f;
+	d->nameAtom = NifNameAtom::intern( d->name );
+	d->flags = NifSharedData::DataFlags::fromInt( f );
+	if ( in.status() != QDataStream::Ok )
+		return false;
+
+	return ( d->argexpr.load( in ) && d->condexpr.load( in ) && d->arr1expr.load( in ) && d->verexpr.load( in ) );
+}
+
 bool NifItem::isDescendantOf( const NifItem * testAncestor ) const
 {
 	if ( testAncestor ) {
@@ -184,6 +336,23 @@ void NifItem::insertLinkRow( int n )
 	linkRowsSize++;
 }
 
+void NifItem::registerAllChildLinkRows()
+{
+	if ( childItemsSize >= 65535 )
+		throw std::bad_alloc();
+
+	// One spare element, so that insertLinkRow() never reallocates the array for a registered row
+	size_t	linkRowsCapacity = size_t( childItemsSize ) + 1;
+	int *	tmp = new int[linkRowsCapacity + 1];
+	tmp[0] = int( linkRowsCapacity );
+	for ( int n = 0; n < childItemsSize; n++ )
+		tmp[n + 1] = n;
+	if ( linkRows )
+		delete[] ( linkRows - 1 );
+	linkRows = tmp + 1;
+	linkRowsSize = (unsigned short) childItemsSize;
+}
+
 void NifItem::registerInParentLinkCache()
 {
 	NifItem * c = this;
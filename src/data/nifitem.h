@@ -43,7 +43,45 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QMap>
 
 
-//! @file nifitem.h NifItem, NifBlock, NifData, NifSharedData
+//! @file nifitem.h NifItem, NifBlock, NifData, NifSharedData, NifNameAtom
+
+//! A field name interned as an integer, for looking up items by name without comparing strings
+/*!
+ * All names of NifData are interned when they are created or renamed, so an item has a name
+ * if and only if its atom is equal to the atom of the name. Atoms are never removed.
+ */
+class NifNameAtom
+{
+public:
+	NifNameAtom() = default;
+
+	//! Returns the atom of a name, adding the name if it has no atom yet
+	static NifNameAtom intern( const QString & name );
+	//! Returns the atom of a name, or an invalid atom if no field has this name
+	static NifNameAtom find( std::string_view name );
+	//! Returns the atom of a name, or an invalid atom if no field has this name
+	static NifNameAtom find( const QString & name );
+	//! Returns the atom of a name that is usually a string literal, or an invalid atom if no field has this name
+	/*!
+	 * The atom is cached per thread by the address of the string, so repeated lookups of the same literal
+	 * cost one string comparison regardless of the number of fields searched. Names containing a backslash
+	 * (item paths) always return an invalid atom.
+	 */
+	static NifNameAtom fromLiteral( const char * name );
+
+	//! Returns the name of the atom
+	QString name() const;
+
+	inline bool isValid() const { return id >= 0; }
+	inline bool operator==( const NifNameAtom & other ) const { return id == other.id; }
+	inline bool operator!=( const NifNameAtom & other ) const { return id != other.id; }
+
+private:
+	explicit NifNameAtom( int n ) : id( n ) {}
+
+	int	id = -1;
+};
+
 
 /*! Shared data for NifData.
  *
@@ -74,22 +112,24 @@ private:
 
 	NifSharedData( const QString & n, const QString & t, const QString & tt, const QString & a, const QString & a1,
 				   const QString & a2, const QString & c, quint32 v1, quint32 v2, NifSharedData::DataFlags f )
-		: QSharedData(), name( n ), type( t ), templ( tt ), arg( a ), argexpr( a ), arr1( a1 ), arr2( a2 ),
-		cond( c ), ver1( v1 ), ver2( v2 ), condexpr( c ), arr1expr( a1 ), flags( f )
+		: QSharedData(), name( n ), nameAtom( NifNameAtom::intern( n ) ), type( t ), templ( tt ), arg( a ), argexpr( a ),
+		arr1( a1 ), arr2( a2 ), cond( c ), ver1( v1 ), ver2( v2 ), condexpr( c ), arr1expr( a1 ), flags( f )
 	{
 	}
 
 	NifSharedData( const QString & n, const QString & t )
-		: QSharedData(), name( n ), type( t ) {}
+		: QSharedData(), name( n ), nameAtom( NifNameAtom::intern( n ) ), type( t ) {}
 
 	NifSharedData( const QString & n, const QString & t, const QString & txt )
-		: QSharedData(), name( n ), type( t ), text( txt ) {}
+		: QSharedData(), name( n ), nameAtom( NifNameAtom::intern( n ) ), type( t ), text( txt ) {}
 
 	NifSharedData()
-		: QSharedData() {}
+		: QSharedData(), nameAtom( NifNameAtom::intern( QString() ) ) {}
 
 	//! Name.
 	QString name;
+	//! Name as an atom.
+	NifNameAtom nameAtom;
 	//! Type.
 	QString type;
 	//! Template type.
@@ -142,6 +182,8 @@ public:
 
 	//! Get the name of the data.
 	inline const QString & name() const { return d->name; }
+	//! Get the name of the data as an atom.
+	inline NifNameAtom nameAtom() const { return d->nameAtom; }
 	//! Get the type of the data.
 	inline const QString & type() const { return d->type; }
 	//! Get the template type of the data.
@@ -204,7 +246,11 @@ public:
 	}
 
 	//! Sets the name of the data.
-	void setName( const QString & name ) { d->name = name; }
+	void setName( const QString & name )
+	{
+		d->name = name;
+		d->nameAtom = NifNameAtom::intern( name );
+	}
 	//! Sets the type of the data.
 	void setStrType( const QString & type ) { d->type = type; }
 	//! Sets the template type of the data.
@@ -268,6 +314,11 @@ public:
 	//! Gets the data's value type (NifValue::Type).
 	inline NifValue::Type valueType() const { return NifValue::type(); }
 
+	//! Writes the XML attributes and the parsed expressions of the data (but not its value) to a binary schema cache.
+	void saveSchema( QDataStream & out ) const;
+	//! Reads the attributes written by saveSchema(), returns false on invalid data.
+	bool loadSchema( QDataStream & in );
+
 protected:
 	//! The internal shared data.
 	QSharedDataPointer<NifSharedData> d;
@@ -546,6 +597,13 @@ private:
 public:
 	//! Does the item have any children of link type?
 	bool hasChildLinks() const { return bool( linkRowsSize ); }
+	//! Registers all the children in the link cache, so that it is not modified when links are loaded into them on multiple threads
+	/*!
+	 * The cache must be rebuilt by updateChildLinkRows() afterwards.
+	 */
+	void registerAllChildLinkRows();
+	//! Rebuilds the link cache from the children
+	void updateChildLinkRows() { updateLinkRows( 0 ); }
 
 	//! Return the value of the item data (const version)
 	inline const NifValue & value() const { return itemData; }
@@ -554,6 +612,8 @@ public:
 
 	//! Return the name of the data
 	inline const QString & name() const { return itemData.name(); }
+	//! Return the name of the data as an atom
+	inline NifNameAtom nameAtom() const { return itemData.nameAtom(); }
 	//! Return the type of the data (the "type" attribute in the XML file).
 	inline const QString & strType() const { return itemData.type(); }
 	//! Return the template type of the data
@@ -607,6 +667,8 @@ public:
 	// item->hasName("Foo") is much faster than item->name() == "Foo"
 	inline bool hasName( std::string_view testName ) const { return itemData.hasName( testName ); }
 	inline bool hasName( const char * testName ) const { return itemData.hasName( std::string_view(testName) ); }
+	//! Does the item's name match the atom?
+	inline bool hasName( NifNameAtom testName ) const { return itemData.nameAtom() == testName; }
 
 	//! Does the item's string type match testType?
 	inline bool hasStrType( const QString & testType ) const { return itemData.type() == testType; }
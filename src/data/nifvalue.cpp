@@ -34,6 +34,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "model/nifmodel.h"
 
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QRegularExpression>
 #include <QSettings>
 
@@ -133,6 +135,7 @@ void NifValue::initialize()
 	typeMap.insert( "ByteColor4BGRA", NifValue::tByteColor4BGRA );
 	//typeMap.insert( "BSVertexDesc", NifValue::tBSVertexDesc );
 
+	aliasMap.clear();
 	enumMap.clear();
 }
 
@@ -234,6 +237,70 @@ bool NifValue::registerEnumType( const QString & eid, EnumType eTyp )
 	return true;
 }
 
+void NifValue::saveTypeRegistry( QDataStream & out )
+{
+	out << quint32( typeMap.size() );
+	for ( auto i = typeMap.cbegin(); i != typeMap.cend(); i++ )
+		out << i.key() << quint32( i.value() );
+
+	out << aliasMap << typeTxt;
+
+	out << quint32( enumMap.size() );
+	for ( auto i = enumMap.cbegin(); i != enumMap.cend(); i++ )
+		out << i.key() << quint32( i->t ) << i->o;
+}
+
+bool NifValue::loadTypeRegistry( QDataStream & in )
+{
+	typeMap.clear();
+	typeTxt.clear();
+	aliasMap.clear();
+	enumMap.clear();
+
+	quint32	n = 0;
+	in >> n;
+	for ( ; n && in.status() == QDataStream::Ok; n-- ) {
+		QString	id;
+		quint32	t;
+		in >> id >> t;
+		typeMap.insert( id, Type( t ) );
+	}
+
+	in >> aliasMap >> typeTxt;
+
+	in >> n;
+	for ( ; n && in.status() == QDataStream::Ok; n-- ) {
+		QString	id;
+		quint32	t;
+		EnumOptions	e;
+		in >> id >> t >> e.o;
+		e.t = EnumType( t );
+		enumMap.insert( id, e );
+	}
+
+	return ( in.status() == QDataStream::Ok );
+}
+
+QByteArray NifValue::typeLayoutHash()
+{
+	if ( typeMap.isEmpty() )
+		initialize();
+
+	QStringList	names = typeMap.keys();
+	names.sort();
+
+	QCryptographicHash	h( QCryptographicHash::Md5 );
+	for ( const QString & name : names ) {
+		const quint32	t = quint32( typeMap.value( name ) );
+		h.addData( name.toUtf8() );
+		h.addData( QByteArrayView( reinterpret_cast< const char * >( &t ), sizeof( t ) ) );
+	}
+	const quint32	layout[2] = { quint32( tNone ), quint32( sizeof( NifValue ) ) };
+	h.addData( QByteArrayView( reinterpret_cast< const char * >( layout ), sizeof( layout ) ) );
+
+	return h.result();
+}
+
 NifValue::EnumType NifValue::enumType( const QString & eid )
 {
 	return (enumMap.contains( eid )) ? enumMap[eid].t : EnumType::eNone;
@@ -371,7 +438,8 @@ void NifValue::clear()
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		delete static_cast<QString *>( val.data );
+		if ( isLongString() )
+			delete static_cast<QString *>( val.data );
 		break;
 	case tMatrix:
 		delete static_cast<Matrix *>( val.data );
@@ -397,6 +465,61 @@ void NifValue::clear()
 	val.clear();
 }
 
+QByteArray NifValue::getStringLatin1() const
+{
+	if ( isLongString() )
+		return static_cast<const QString *>( val.data )->toLatin1();
+
+	return QByteArray( val.str, qsizetype( val.str[15] ) );
+}
+
+void NifValue::setString( const QString & s )
+{
+	qsizetype	len = s.size();
+	if ( len <= maxShortStringLength ) {
+		const QChar *	p = s.constData();
+		bool	isASCII = true;
+		for ( qsizetype i = 0; i < len; i++ )
+			isASCII = isASCII && ( p[i].unicode() < 0x80 );
+		if ( isASCII ) {
+			if ( isLongString() )
+				delete static_cast<QString *>( val.data );
+			val.clear();
+			for ( qsizetype i = 0; i < len; i++ )
+				val.str[i] = char( p[i].unicode() );
+			val.str[15] = char( len );
+			return;
+		}
+	}
+
+	if ( isLongString() ) {
+		*static_cast<QString *>( val.data ) = s;
+	} else {
+		val.clear();
+		val.data = new QString( s );
+		val.str[15] = longStringTag;
+	}
+}
+
+void NifValue::setString( const char * s, qsizetype len, bool isUtf8 )
+{
+	if ( len <= maxShortStringLength ) {
+		bool	isASCII = true;
+		for ( qsizetype i = 0; i < len; i++ )
+			isASCII = isASCII && ( (unsigned char) s[i] < 0x80 );
+		if ( isASCII ) {
+			if ( isLongString() )
+				delete static_cast<QString *>( val.data );
+			val.clear();
+			std::memcpy( val.str, s, size_t( len ) );
+			val.str[15] = char( len );
+			return;
+		}
+	}
+
+	setString( isUtf8 ? QString::fromUtf8( s, len ) : QString::fromLatin1( s, len ) );
+}
+
 void NifValue::changeType( Type t )
 {
 	if ( typ == t )
@@ -444,7 +567,8 @@ void NifValue::changeType( Type t )
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		val.data = new QString();
+		// empty short string
+		val.clear();
 		return;
 	case tColor3:
 	case tColor4:
@@ -488,7 +612,13 @@ void NifValue::operator=( const NifValue & other )
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		*static_cast<QString *>( val.data ) = *static_cast<QString *>( other.val.data );
+		if ( other.isLongString() ) {
+			setString( *static_cast<const QString *>( other.val.data ) );
+		} else {
+			if ( isLongString() )
+				delete static_cast<QString *>( val.data );
+			std::memcpy( &val, &( other.val ), sizeof( val ) );
+		}
 		return;
 	case tMatrix:
 		*static_cast<Matrix *>( val.data ) = *static_cast<Matrix *>( other.val.data );
@@ -591,13 +721,10 @@ bool NifValue::operator==( const NifValue & other ) const
 	case tLineString:
 	case tChar8String:
 	{
-		QString * s1 = static_cast<QString *>(val.data);
-		QString * s2 = static_cast<QString *>(other.val.data);
+		if ( !isLongString() && !other.isLongString() )
+			return std::memcmp( val.str, other.val.str, sizeof( val.str ) ) == 0;
 
-		if ( !s1 || !s2 )
-			return false;
-
-		return *s1 == *s2;
+		return getString() == other.getString();
 	}
 
 	case tMatrix:
@@ -733,7 +860,7 @@ bool NifValue::setFromString( const QString & s, const BaseModel * model, const
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		*static_cast<QString *>( val.data ) = s;
+		setString( s );
 		ok = true;
 		break;
 	case tColor3:
@@ -837,7 +964,7 @@ QString NifValue::toString() const
 	case tHeaderString:
 	case tLineString:
 	case tChar8String:
-		return *static_cast<QString *>( val.data );
+		return getString();
 	case tColor3:
 		{
 			FloatVector4	c = FloatVector4( 0.0f ).blendValues( val.f32v4, 0x07 );
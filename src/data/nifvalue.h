@@ -184,7 +184,7 @@ public:
 
 	/*! Initialize the class data
 	 *
-	 * Sets typeMap. Clears typeTxt and enumMap (which will be filled later during xml parsing).
+	 * Sets typeMap. Clears typeTxt, aliasMap and enumMap (which will be filled later during xml parsing).
 	 */
 	static void initialize();
 
@@ -247,6 +247,16 @@ public:
 	//! Get list of all options that have been registered for the given enum type.
 	static const EnumOptions & enumOptionData( const QString & eid );
 
+	//! Write the type, alias, enum and type description tables to a binary schema cache.
+	static void saveTypeRegistry( QDataStream & out );
+	//! Replace the type tables with the ones written by saveTypeRegistry(), returns false on invalid data.
+	static bool loadTypeRegistry( QDataStream & in );
+	//! Hash of the built-in type names, their Type values and the size of NifValue, identifies the layout of the types in caches.
+	/*!
+	 * Must be called after initialize() and before any types are registered from the xml.
+	 */
+	static QByteArray typeLayoutHash();
+
 
 	//! Check if the type is not tNone.
 	static bool isValid( Type t ) { return t != tNone; }
@@ -299,7 +309,7 @@ public:
 	bool isFileVersion() const { return typ == tFileVersion; }
 	//! Check if the type of the data is a byte matrix.
 	bool isByteMatrix() const { return typ == tByteMatrix; }
-	//! Check if the type uses allocated data (val.data is valid).
+	//! Check if the type uses allocated data (val.data is valid, or val.str for short strings).
 	bool isAllocated() const { return typ >= tSizedString && typ < tNone; }
 
 	//! Return the value of the data as a QColor, if applicable.
@@ -372,6 +382,8 @@ protected:
 		float f32;
 		FloatVector4 f32v4;
 		Triangle t;
+		// strings of up to 15 ASCII characters, the last byte is the length, or longStringTag if data is a QString
+		char str[16];
 		// for types that are not trivially copyable or require more space than 4 floats
 		void * data;
 		// should not be used on types with allocated data
@@ -387,6 +399,22 @@ protected:
 	//! The type of this data.
 	Type typ = tNone;
 
+	//! Maximum length of strings stored in val.str without allocating a QString
+	static constexpr qsizetype maxShortStringLength = 15;
+	//! Value of val.str[15] if val.data points to a QString
+	static constexpr char longStringTag = char( 0xFF );
+
+	//! Check if a string type value is stored in an allocated QString.
+	inline bool isLongString() const { return val.str[15] == longStringTag; }
+	//! Get the value of a string type.
+	inline QString getString() const;
+	//! Get the value of a string type, encoded as Latin-1.
+	QByteArray getStringLatin1() const;
+	//! Set the value of a string type.
+	void setString( const QString & s );
+	//! Set the value of a string type from 8-bit text, decoded as UTF-8 if isUtf8 is true, and as Latin-1 otherwise.
+	void setString( const char * s, qsizetype len, bool isUtf8 );
+
 	//! Check the value type, and if it is not compatible with 't', report the error and return false.
 	inline bool checkGetType( Type t, const BaseModel * model, const NifItem * item ) const;
 	inline bool checkSetType( Type t, const BaseModel * model, const NifItem * item ) const;
@@ -704,10 +732,18 @@ template <> inline Triangle NifValue::get( const BaseModel * model, const NifIte
 {
 	return getType<Triangle>( tTriangle, model, item );
 }
+inline QString NifValue::getString() const
+{
+	if ( isLongString() )
+		return *static_cast<const QString *>( val.data );
+
+	return QString::fromLatin1( val.str, qsizetype( val.str[15] ) );
+}
+
 template <> inline QString NifValue::get( const BaseModel * model, const NifItem * item ) const
 {
 	if ( isString() )
-		return *static_cast<QString *>( val.data );
+		return getString();
 
 	if ( model )
 		reportConvertToError( model, item, "a string" );
@@ -883,11 +919,7 @@ template <> inline bool NifValue::set( const Triangle & x, const BaseModel * mod
 template <> inline bool NifValue::set( const QString & x, const BaseModel * model, const NifItem * item )
 {
 	if ( isString() ) {
-		if ( !val.data ) {
-			val.data = new QString;
-		}
-
-		*static_cast<QString *>( val.data ) = x;
+		setString( x );
 		return true;
 	}
 
@@ -28,14 +28,15 @@ void BSMesh::transformShapes()
 	updateBoneTransforms();
 }
 
-void BSMesh::drawShapes( NodeList * secondPass )
+void BSMesh::drawShapes( DrawQueue * queue )
 {
 	if ( isHidden() || ( !scene->hasOption(Scene::ShowMarkers) && name.contains(QLatin1StringView("EditorMarker")) ) )
 		return;
 
-	// Draw translucent meshes in second pass
-	if ( secondPass && drawInSecondPass ) {
-		secondPass->add(this);
+	// Queue for sorted drawing, translucent meshes are drawn in second pass
+	if ( queue ) {
+		if ( !queue->cull( this ) )
+			queue->add( this, drawInSecondPass, drawSortKey() );
 		return;
 	}
 
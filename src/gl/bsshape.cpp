@@ -3,6 +3,7 @@
 #include "gl/glnode.h"
 #include "gl/glscene.h"
 #include "gl/renderer.h"
+#include "gl/vertexstream.h"
 #include "io/material.h"
 #include "model/nifmodel.h"
 #include "glview.h"
@@ -77,51 +78,45 @@ void BSShape::updateData( const NifModel * nif )
 			numVerts = nDynVerts;
 	}
 
-	static const char *	attrNames[8] = {
-		"Vertex", "Bitangent X", "Bitangent Y", "Bitangent Z", "UV", "Normal", "Tangent", "Vertex Colors"
+	// The fields are read through typed views, which look up the row of each field once in the first vertex.
+	// The fields that are not in the vertex description are disabled by their conditions and are not found.
+	const NifItem *	vertexArray = nif->getItem( iData );
+	QModelIndex	iFirstVertex = nif->getIndex( iData, 0 );
+	auto	fieldRow = [&]( const char * name ) {
+		QModelIndex	j = nif->getIndex( iFirstVertex, name );
+		return ( j.isValid() ? j.row() : -1 );
 	};
-	int	attrRows[8];
-	for ( int i = 0; i < 8; i++ ) {
-		QModelIndex	j = nif->getIndex( nif->getIndex( iData, 0 ), attrNames[i] );
-		attrRows[i] = ( j.isValid() ? j.row() : -1 );
-	}
+	VertexFieldView<Vector3>	vertexView( vertexArray, fieldRow( "Vertex" ), !isDynamic );
+	VertexFieldView<float>	bitangentXView( vertexArray, fieldRow( "Bitangent X" ), !isDynamic );
+	VertexFieldView<float>	bitangentYView( vertexArray, fieldRow( "Bitangent Y" ) );
+	VertexFieldView<float>	bitangentZView( vertexArray, fieldRow( "Bitangent Z" ) );
+	VertexFieldView<HalfVector2>	uvView( vertexArray, fieldRow( "UV" ) );
+	VertexFieldView<ByteVector3>	normalView( vertexArray, fieldRow( "Normal" ) );
+	VertexFieldView<ByteVector3>	tangentView( vertexArray, fieldRow( "Tangent" ) );
+	VertexFieldView<ByteColor4>	colorView( vertexArray, fieldRow( "Vertex Colors" ), hasVertexColors );
+
 	auto	vertsData = verts.fill( Vector3(), numVerts ).data();
 	auto	normsData = norms.fill( Vector3(), numVerts ).data();
 	auto	colorsData = colors.fill( Color4( 0.0f, 0.0f, 0.0f, 1.0f ), numVerts ).data();
 	auto	tangentsData = tangents.fill( Vector3(), numVerts ).data();
 	auto	bitangentsData = bitangents.fill( Vector3(), numVerts ).data();
 	auto	coordsetData = coordset.fill( Vector2(), numVerts ).data();
-	for ( int i = 0; i < numVerts; i++ ) {
-		auto idx = nif->getIndex( iData, i );
-		if ( !idx.isValid() )
-			continue;
-		auto item = nif->getItem( idx );
-		if ( !item )
-			continue;
-
-		float bitX;
 
+	vertexView.copyTo( vertsData, numVerts );
+	uvView.copyTo( coordsetData, numVerts );
+	normalView.copyTo( normsData, numVerts );
+	tangentView.copyTo( tangentsData, numVerts );
+	colorView.copyTo( colorsData, numVerts );
+	for ( int i = 0; i < numVerts; i++ ) {
+		float	bitX;
 		if ( isDynamic ) {
-			auto& dynv = dynVerts.at(i);
+			const Vector4 &	dynv = dynVerts.at( i );
 			vertsData[i] = Vector3( dynv );
 			bitX = dynv[3];
 		} else {
-			vertsData[i] = nif->get<Vector3>( item->child( attrRows[0] ) );	// "Vertex"
-			bitX = nif->get<float>( item->child( attrRows[1] ) );	// "Bitangent X"
+			bitX = bitangentXView[i];
 		}
-
-		// Bitangent Y/Z
-		auto bitY = nif->get<float>( item->child( attrRows[2] ) );	// "Bitangent Y"
-		auto bitZ = nif->get<float>( item->child( attrRows[3] ) );	// "Bitangent Z"
-
-		coordsetData[i] = nif->get<HalfVector2>( item->child( attrRows[4] ) );	// "UV"
-		normsData[i] = nif->get<ByteVector3>( item->child( attrRows[5] ) );	// "Normal"
-		tangentsData[i] = nif->get<ByteVector3>( item->child( attrRows[6] ) );	// "Tangent"
-		bitangentsData[i] = Vector3( bitX, bitY, bitZ );
-
-		auto vcItem = item->child( attrRows[7] );	// "Vertex Colors"
-		if ( vcItem )
-			colorsData[i] = nif->get<ByteColor4>( vcItem );
+		bitangentsData[i] = Vector3( bitX, bitangentYView[i], bitangentZView[i] );
 	}
 
 	// Add coords as the first set of QList
@@ -251,7 +246,7 @@ void BSShape::transformShapes()
 	updateBoneTransforms();
 }
 
-void BSShape::drawShapes( NodeList * secondPass )
+void BSShape::drawShapes( DrawQueue * queue )
 {
 	if ( isHidden() )
 		return;
@@ -260,9 +255,10 @@ void BSShape::drawShapes( NodeList * secondPass )
 	if ( !scene->hasOption(Scene::ShowMarkers) && name.contains( QLatin1StringView("EditorMarker") ) )
 		return;
 
-	// Draw translucent meshes in second pass
-	if ( secondPass && drawInSecondPass ) {
-		secondPass->add( this );
+	// Queue for sorted drawing, translucent meshes are drawn in second pass
+	if ( queue ) {
+		if ( !queue->cull( this ) )
+			queue->add( this, drawInSecondPass, drawSortKey() );
 		return;
 	}
 
@@ -17,7 +17,7 @@ public:
 
 	void transformShapes() override;
 
-	void drawShapes( NodeList * secondPass = nullptr ) override;
+	void drawShapes( DrawQueue * queue = nullptr ) override;
 	void drawSelection() const override;
 
 	BoundSphere bounds() const override;
@@ -977,8 +977,7 @@ NifSkopeOpenGLContext::Program * NifSkopeOpenGLContext::useProgram( const std::s
 		if ( h != prvH )
 			std::swap( shadersAndPrograms[prvH], shadersAndPrograms[h] );
 		Program *	prog = static_cast< Program * >( s );
-		fn->glUseProgram( prog->id );
-		currentProgram = prog;
+		setCurrentProgram( prog );
 		return prog;
 	}
 	stopProgram();
@@ -1031,6 +1030,7 @@ void NifSkopeOpenGLContext::setGlobalUniforms()
 void NifSkopeOpenGLContext::setDefaultVertexAttribs( std::uint64_t attrMask, const float * const * attrData )
 {
 	fn->glBindVertexArray( 0 );
+	currentVertexArray = 0;
 	for ( size_t i = 0; attrMask; i++, attrMask = attrMask >> 4 ) {
 		size_t	n = attrMask & 15;
 		if ( !n )
@@ -1089,13 +1089,19 @@ void NifSkopeOpenGLContext::bindShape(
 				d->next->prev = d;
 			}
 			cacheLastItem = d;
-			f.glBindVertexArray( d->vao );
+			if ( d->vao != currentVertexArray ) {
+				f.glBindVertexArray( d->vao );
+				currentVertexArray = d->vao;
+				drawStats.vaoSwitches++;
+			}
 			return;
 		}
 		j = i;
 	}
 
 	ShapeData *	d = new ShapeData( *this, h, attrData, elementData );
+	currentVertexArray = d->vao;
+	drawStats.vaoSwitches++;
 	if ( !cacheLastItem ) {
 		d->prev = d;
 		d->next = d;
@@ -1144,6 +1150,7 @@ void NifSkopeOpenGLContext::shrinkCache( bool deleteAll )
 			d->next->prev = d->prev;
 		}
 		delete d;
+		currentVertexArray = 0;
 	}
 
 	if ( rehashNeeded )
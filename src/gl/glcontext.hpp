@@ -337,6 +337,26 @@ public:
 	{
 		return currentProgram;
 	}
+	//! Make a linked program current, the GL call is skipped if it is already in use
+	inline void setCurrentProgram( Program * prog )
+	{
+		if ( prog != currentProgram ) {
+			fn->glUseProgram( prog->id );
+			currentProgram = prog;
+			drawStats.programSwitches++;
+		}
+	}
+
+	//! Number of state changes since the last call to resetDrawStats()
+	struct DrawStats {
+		std::uint32_t	programSwitches = 0;
+		std::uint32_t	vaoSwitches = 0;
+	};
+	DrawStats	drawStats;
+	inline void resetDrawStats()
+	{
+		drawStats = DrawStats();
+	}
 
 	void setViewTransform( const Transform & t, int upAxis, float envMapRotation );
 	inline void setProjectionMatrix( const Matrix4 & m )
@@ -394,6 +414,7 @@ protected:
 
 	std::vector< ShapeData * >	geometryCache;
 	ShapeData *	cacheLastItem = nullptr;
+	unsigned int	currentVertexArray = 0;
 	size_t	cacheShapeCnt = 0;
 	size_t	cacheBytesUsed = 0;
 	size_t	cacheMaxBytes = 0x08000000;
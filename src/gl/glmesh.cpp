@@ -36,12 +36,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gl/controllers.h"
 #include "gl/glscene.h"
 #include "gl/renderer.h"
+#include "gl/vertexstream.h"
 #include "io/material.h"
-#include "io/nifstream.h"
 #include "model/nifmodel.h"
 #include "glview.h"
 
-#include <QBuffer>
 #include <QDebug>
 #include <QSettings>
 
@@ -324,98 +323,78 @@ void Mesh::updateData_NiMesh( const NifModel * nif )
 
 		Q_ASSERT( compSemanticIndexMaps[i].size() == qsizetype(numStreamComponents) );
 
-		auto tempMdl = std::make_unique<NifModel>( this );
-
+		// The components are decoded directly from the stream data through typed views,
+		// the elements of the stream are the components packed without padding
 		QByteArray streamData = nif->get<QByteArray>( nif->getIndex( nif->getIndex( iDataStream, "Data" ), 0 ) );
-		QBuffer streamBuffer( &streamData );
-		streamBuffer.open( QIODevice::ReadOnly );
 
-		NifIStream tempInput( tempMdl.get(), &streamBuffer );
-		NifValue tempValue;
+		QVector<VertexStreamView> componentViews;
+		qsizetype elementSize = 0;
+		for ( auto format : datastreamFormats )
+			elementSize += VertexStreamView::componentSize( format );
+		qsizetype componentOffset = 0;
+		for ( auto format : datastreamFormats ) {
+			qsizetype componentSize = VertexStreamView::componentSize( format );
+			switch ( format ) {
+			case NiMesh::F_FLOAT32_3:
+			case NiMesh::F_FLOAT16_3:
+			case NiMesh::F_UINT16_1:
+			case NiMesh::F_FLOAT32_2:
+			case NiMesh::F_FLOAT16_2:
+			case NiMesh::F_UINT8_4:
+			case NiMesh::F_NORMUINT8_4:
+			case NiMesh::F_NORMUINT8_4_BGRA:
+				componentViews.append( VertexStreamView( streamData, elementSize, componentOffset, componentSize ) );
+				break;
+			default:
+				// Unsupported components are skipped
+				Message::append( tr( NIMESH_ABORT ), tr( "[%1] Unsupported Component: %2" ).arg( stream )
+									.arg( NifValue::enumOptionName( "ComponentFormat", format ) ),
+									QMessageBox::Warning );
+				componentViews.append( VertexStreamView() );
+				break;
+			}
+			componentOffset += componentSize;
+		}
 
-		bool abort = false;
-		for ( const auto & r : regions ) for ( uint j = 0; j < r.second; j++ ) {
+		// The elements are read in order, and stored at the Start Index of each region
+		qsizetype e = 0;
+		for ( const auto & r : regions ) for ( uint j = 0; j < r.second; j++, e++ ) {
 			auto off = r.first;
 			Q_ASSERT( totalIndices >= off + j );
 			for ( uint k = 0; k < numStreamComponents; k++ ) {
-				auto typeK = datastreamFormats[k];
-				int typeLength = ( (typeK & 0x000F0000) >> 0x10 );
-
-				switch ( (typeK & 0x00000FF0) >> 0x04 ) {
-				case 0x10:
-					tempValue.changeType( NifValue::tByte );
-					break;
-				case 0x11:
-					if ( typeK == NiMesh::F_NORMUINT8_4 )
-						tempValue.changeType( NifValue::tByteColor4 );
-					typeLength = 1;
-					break;
-				case 0x13:
-					if ( typeK == NiMesh::F_NORMUINT8_4_BGRA )
-						tempValue.changeType( NifValue::tByteColor4 );
-					typeLength = 1;
-					break;
-				case 0x21:
-					tempValue.changeType( NifValue::tShort );
-					break;
-				case 0x23:
-					if ( typeLength == 3 )
-						tempValue.changeType( NifValue::tHalfVector3 );
-					else if ( typeLength == 2 )
-						tempValue.changeType( NifValue::tHalfVector2 );
-					else if ( typeLength == 1 )
-						tempValue.changeType( NifValue::tHfloat );
-
-					typeLength = 1;
-
-					break;
-				case 0x42:
-					tempValue.changeType( NifValue::tInt );
-					break;
-				case 0x43:
-					if ( typeLength == 3 )
-						tempValue.changeType( NifValue::tVector3 );
-					else if ( typeLength == 2 )
-						tempValue.changeType( NifValue::tVector2 );
-					else if ( typeLength == 4 )
-						tempValue.changeType( NifValue::tVector4 );
-					else if ( typeLength == 1 )
-						tempValue.changeType( NifValue::tFloat );
-
-					typeLength = 1;
-
-					break;
-				}
-
-				for ( int l = 0; l < typeLength; l++ ) {
-					tempInput.read( tempValue );
-				}
+				const VertexStreamView & view = componentViews.at( k );
+				if ( e >= view.size() )
+					continue;
 
+				auto typeK = datastreamFormats[k];
 				auto compType = compSemanticIndexMaps[i].value( k ).first;
 				switch ( typeK )
 				{
 				case NiMesh::F_FLOAT32_3:
 				case NiMesh::F_FLOAT16_3:
 					Q_ASSERT( usage == NiMesh::USAGE_VERTEX );
-					switch ( compType ) {
-					case NiMesh::E_POSITION:
-					case NiMesh::E_POSITION_BP:
-						verts[j + off] = tempValue.get<Vector3>( nif, nullptr );
-						break;
-					case NiMesh::E_NORMAL:
-					case NiMesh::E_NORMAL_BP:
-						norms[j + off] = tempValue.get<Vector3>( nif, nullptr );
-						break;
-					case NiMesh::E_TANGENT:
-					case NiMesh::E_TANGENT_BP:
-						tangents[j + off] = tempValue.get<Vector3>( nif, nullptr );
-						break;
-					case NiMesh::E_BINORMAL:
-					case NiMesh::E_BINORMAL_BP:
-						bitangents[j + off] = tempValue.get<Vector3>( nif, nullptr );
-						break;
-					default:
-						break;
+					{
+						Vector3 v( typeK == NiMesh::F_FLOAT32_3 ? view.float32( e, 3 ) : view.float16( e, 3 ) );
+						switch ( compType ) {
+						case NiMesh::E_POSITION:
+						case NiMesh::E_POSITION_BP:
+							verts[j + off] = v;
+							break;
+						case NiMesh::E_NORMAL:
+						case NiMesh::E_NORMAL_BP:
+							norms[j + off] = v;
+							break;
+						case NiMesh::E_TANGENT:
+						case NiMesh::E_TANGENT_BP:
+							tangents[j + off] = v;
+							break;
+						case NiMesh::E_BINORMAL:
+						case NiMesh::E_BINORMAL_BP:
+							bitangents[j + off] = v;
+							break;
+						default:
+							break;
+						}
 					}
 					break;
 				case NiMesh::F_UINT16_1:
@@ -424,7 +403,7 @@ void Mesh::updateData_NiMesh( const NifModel * nif )
 						// TODO: The total index value across all submeshes
 						// is likely allowed to exceed USHRT_MAX.
 						// For now limit the index.
-						quint32 ind = tempValue.get<quint16>( nif, nullptr ) + off;
+						quint32 ind = view.uint16( e ) + off;
 						if ( ind > 0xFFFF )
 							qDebug() << QString( "[%1] %2" ).arg( stream ).arg( ind );
 
@@ -443,7 +422,8 @@ void Mesh::updateData_NiMesh( const NifModel * nif )
 					if ( compType == NiMesh::E_TEXCOORD ) {
 						quint32 coordSet = compSemanticIndexMaps[i].value( k ).second;
 						Q_ASSERT( coords.size() > qsizetype(coordSet) );
-						coords[coordSet][j + off] = tempValue.get<Vector2>( nif, nullptr );
+						FloatVector4 uv( typeK == NiMesh::F_FLOAT32_2 ? view.float32( e, 2 ) : view.float16( e, 2 ) );
+						coords[coordSet][j + off] = Vector2( uv[0], uv[1] );
 					}
 					break;
 				case NiMesh::F_UINT8_4:
@@ -452,32 +432,21 @@ void Mesh::updateData_NiMesh( const NifModel * nif )
 				case NiMesh::F_NORMUINT8_4:
 					Q_ASSERT( usage == NiMesh::USAGE_VERTEX );
 					if ( compType == NiMesh::E_COLOR )
-						colors[j + off] = tempValue.get<ByteColor4>( nif, nullptr );
+						colors[j + off] = Color4( view.unorm8x4( e ) );
 					break;
 				case NiMesh::F_NORMUINT8_4_BGRA:
 					Q_ASSERT( usage == NiMesh::USAGE_VERTEX );
 					if ( compType == NiMesh::E_COLOR ) {
 						// Swizzle BGRA -> RGBA
-						auto c = tempValue.get<ByteColor4>( nif, nullptr );
-						colors[j + off] = {c[2], c[1], c[0], c[3]};
+						colors[j + off] = Color4( view.unorm8x4( e ).shuffleValues( 0xC6 ) );
 					}
 					break;
 				default:
-					Message::append( tr( NIMESH_ABORT ), tr( "[%1] Unsupported Component: %2" ).arg( stream )
-										.arg( NifValue::enumOptionName( "ComponentFormat", typeK ) ),
-										QMessageBox::Warning );
-					abort = true;
 					break;
 				}
-
-				if ( abort == true )
-					break;
 			}
 		}
 
-		// Clear is extremely expensive. Must be outside of loop
-		tempMdl->clear();
-
 		compIdx++;
 	}
 
@@ -690,7 +659,7 @@ BoundSphere Mesh::bounds() const
 	return worldTrans() * boundSphere;
 }
 
-void Mesh::drawShapes( NodeList * secondPass )
+void Mesh::drawShapes( DrawQueue * queue )
 {
 	if ( isHidden() )
 		return;
@@ -699,9 +668,10 @@ void Mesh::drawShapes( NodeList * secondPass )
 	if ( !scene->hasOption(Scene::ShowMarkers) && name.startsWith( "EditorMarker" ) )
 		return;
 
-	// Draw translucent meshes in second pass
-	if ( secondPass && drawInSecondPass ) {
-		secondPass->add( this );
+	// Queue for sorted drawing, translucent meshes are drawn in second pass
+	if ( queue ) {
+		if ( !queue->cull( this ) )
+			queue->add( this, drawInSecondPass, drawSortKey() );
 		return;
 	}
 
@@ -131,43 +131,123 @@ static bool compareNodes( const Node * node1, const Node * node2 )
 	return node1->id() < node2->id();
 }
 
-static bool compareNodesAlpha( const Node * node1, const Node * node2 )
+void NodeList::orderedNodeSort()
 {
-	// Presorted meshes override other sorting
-	// Alpha enabled meshes on top (sorted from rear to front)
+	for ( Node * node : nodes )
+		node->presorted = true;
+	std::stable_sort( nodes.begin(), nodes.end(), compareNodes );
+}
 
-	bool p1 = node1->isPresorted();
-	bool p2 = node2->isPresorted();
+/*
+ *  Draw queue
+ */
 
-	// Presort meshes
-	if ( p1 && p2 ) {
-		return node1->id() < node2->id();
+void DrawQueue::add( Node * n, bool secondPass, std::uint64_t sortKey )
+{
+	if ( secondPass && useSecondPass ) {
+		translucent.push_back( { sortKey, n->viewDepth(), bool( n->findProperty<AlphaProperty>() ), n->isPresorted(), n } );
+		return;
 	}
 
-	bool a1 = node1->findProperty<AlphaProperty>();
-	bool a2 = node2->findProperty<AlphaProperty>();
+	// second pass shapes are drawn last if blending is disabled
+	if ( secondPass )
+		sortKey = ~std::uint64_t( 0 );
+	opaque.push_back( { sortKey, 0.0f, false, n->isPresorted(), n } );
+}
 
-	float d1 = node1->viewDepth();
-	float d2 = node2->viewDepth();
+void DrawQueue::clear()
+{
+	opaque.clear();
+	translucent.clear();
+	planeMask = 0;
+	culledShapes = 0;
+}
 
-	// Alpha sort meshes
-	if ( a1 == a2 ) {
-		return (d1 < d2);
+void DrawQueue::setupCulling( const Transform & view, const Matrix4 & projection, float viewportHeight, float minPixels )
+{
+	viewTransform = view;
+
+	// rows of the column-major projection matrix
+	const float *	p = projection.data();
+	FloatVector4	r0( p[0], p[4], p[8], p[12] );
+	FloatVector4	r1( p[1], p[5], p[9], p[13] );
+	FloatVector4	r2( p[2], p[6], p[10], p[14] );
+	projectionW = FloatVector4( p[3], p[7], p[11], p[15] );
+
+	frustumPlanes[0] = projectionW + r0;
+	frustumPlanes[1] = projectionW - r0;
+	frustumPlanes[2] = projectionW + r1;
+	frustumPlanes[3] = projectionW - r1;
+	frustumPlanes[4] = projectionW + r2;
+	for ( FloatVector4 & plane : frustumPlanes ) {
+		float	l = plane.dotProduct3( plane );
+		if ( l > 0.0f )
+			plane /= float( std::sqrt( l ) );
 	}
 
-	return a2;
+	pixelScale = std::fabs( p[5] ) * viewportHeight * 0.5f;
+	this->minPixels = minPixels;
+	planeMask = 0x1F;
 }
 
-void NodeList::orderedNodeSort()
+bool DrawQueue::cull( const Node * n )
 {
-	for ( Node * node : nodes )
-		node->presorted = true;
-	std::stable_sort( nodes.begin(), nodes.end(), compareNodes );
+	if ( !planeMask && !( minPixels > 0.0f ) )
+		return false;
+
+	std::uint32_t	shapeCount = 0;
+	const BoundSphere &	bs = n->cullBounds( shapeCount );
+	if ( !( bs.radius > 0.0f ) )
+		return false;
+
+	FloatVector4	c( viewTransform * bs.center );
+	c[3] = 1.0f;
+	float	r = bs.radius * viewTransform.scale;
+
+	for ( std::uint32_t i = 0, m = planeMask; m; i++, m = m >> 1 ) {
+		if ( !( m & 1 ) )
+			continue;
+		float	d = frustumPlanes[i].dotProduct( c );
+		if ( d < -r ) {
+			culledShapes += shapeCount;
+			return true;
+		}
+		// children of a node that is entirely inside the plane do not need to be tested against it
+		if ( d >= r )
+			planeMask &= ~( 1U << i );
+	}
+
+	if ( minPixels > 0.0f ) {
+		float	w = projectionW.dotProduct( c );
+		if ( w > 0.0f && ( r * pixelScale ) < ( minPixels * w ) ) {
+			culledShapes += shapeCount;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void DrawQueue::stateSort()
+{
+	std::stable_sort( opaque.begin(), opaque.end(),
+		[]( const Item & a, const Item & b ) {
+			return ( a.sortKey < b.sortKey );
+		} );
 }
 
-void NodeList::alphaSort()
+void DrawQueue::alphaSort()
 {
-	std::stable_sort( nodes.begin(), nodes.end(), compareNodesAlpha );
+	// Presorted meshes override other sorting
+	// Alpha enabled meshes on top (sorted from rear to front)
+	std::stable_sort( translucent.begin(), translucent.end(),
+		[]( const Item & a, const Item & b ) {
+			if ( a.presorted && b.presorted )
+				return ( a.node->id() < b.node->id() );
+			if ( a.hasAlpha == b.hasAlpha )
+				return ( a.depth < b.depth );
+			return b.hasAlpha;
+		} );
 }
 
 /*
@@ -830,18 +910,14 @@ void Node::drawHvkShape( const NifModel * nif, const QModelIndex & iShape, HvkSh
 #endif
 
 	} else if ( name == "bhkPackedNiTriStripsShape" || name == "hkPackedNiTriStripsData" ) {
-		QModelIndex iData = nif->getBlockIndex( nif->getLink( iShape, "Data" ) );
-		QModelIndex iVerts, iTriangles;
+		const Scene::CollisionMesh &	mesh = scene->getCollisionMesh( nif, iShape );
 
-		if ( iData.isValid()
-			&& ( iVerts = nif->getIndex( iData, "Vertices" ) ).isValid() && nif->rowCount( iVerts ) >= 2
-			&& ( iTriangles = nif->getIndex( iData, "Triangles" ) ).isValid() && nif->rowCount( iTriangles ) >= 1 ) {
+		if ( !mesh.parts.empty() ) {
+			QModelIndex	iData = nif->getBlockIndex( nif->getLink( iShape, "Data" ) );
+			const QVector<Vector3> &	verts = mesh.parts.front().verts;
+			const QVector<Triangle> &	triangles = mesh.parts.front().triangles;
 
-			QVector<Vector3>	verts = nif->getArray<Vector3>( iVerts );
-			QVector<Triangle>	triangles = nif->getArray<Triangle>( iTriangles );
-
-			scene->drawTriangles( verts.constData(), size_t( verts.size() ), nullptr, false, GL_TRIANGLES,
-									size_t( triangles.size() ) * 3, GL_UNSIGNED_SHORT, triangles.constData() );
+			scene->drawCollisionMesh( mesh );
 
 			// Handle Selection of hkPackedNiTriStripsData
 			if ( scene->currentBlock == iData && !scene->selecting ) {
@@ -1660,7 +1736,7 @@ void Node::drawFurn()
 	}
 }
 
-void Node::drawShapes( NodeList * secondPass )
+void Node::drawShapes( DrawQueue * queue )
 {
 	if ( isHidden() )
 		return;
@@ -1668,8 +1744,38 @@ void Node::drawShapes( NodeList * secondPass )
 	if ( presorted )
 		children.orderedNodeSort();
 
-	for ( Node * node : children.list() )
-		node->drawShapes( secondPass );
+	if ( !queue ) {
+		for ( Node * node : children.list() )
+			node->drawShapes();
+		return;
+	}
+
+	if ( queue->cull( this ) )
+		return;
+
+	std::uint32_t	planeMask = queue->planeMask;
+	for ( Node * node : children.list() ) {
+		node->drawShapes( queue );
+		queue->planeMask = planeMask;
+	}
+}
+
+const BoundSphere & Node::cullBounds( std::uint32_t & shapeCount ) const
+{
+	if ( cullFrame != scene->transformCount ) {
+		cullFrame = scene->transformCount;
+		cullSphere = drawBounds();
+		cullShapeCount = ( cullSphere.radius >= 0.0f ? 1 : 0 );
+
+		for ( Node * child : children.list() ) {
+			std::uint32_t	n = 0;
+			cullSphere |= child->cullBounds( n );
+			cullShapeCount += n;
+		}
+	}
+
+	shapeCount = cullShapeCount;
+	return cullSphere;
 }
 
 #define Farg( X ) arg( X, 0, 'f', 5 )
@@ -1824,3 +1930,18 @@ const Transform & BillboardNode::viewTrans() const
 	scene->viewTrans.insert( nodeId, t );
 	return scene->viewTrans[ nodeId ];
 }
+
+const BoundSphere & BillboardNode::cullBounds( std::uint32_t & shapeCount ) const
+{
+	bool	needUpdate = ( cullFrame != scene->transformCount );
+
+	Node::cullBounds( shapeCount );
+
+	if ( needUpdate && cullSphere.radius >= 0.0f ) {
+		// the children can be rotated in any direction around the origin of the node
+		Vector3	c = worldTrans().translation;
+		cullSphere = BoundSphere( c, ( cullSphere.center - c ).length() + cullSphere.radius );
+	}
+
+	return cullSphere;
+}
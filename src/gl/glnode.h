@@ -35,11 +35,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "gl/icontrollable.h" // Inherited
 #include "gl/glproperty.h"
+#include "gl/gltools.h"
 
 #include <QList>
 #include <QPersistentModelIndex>
 #include <QPointer>
 
+#include <vector>
+
 
 //! @file glnode.h Node, NodeList
 
@@ -67,12 +70,70 @@ public:
 	const QVector<Node *> & list() const { return nodes; }
 
 	void orderedNodeSort();
-	void alphaSort();
 
 protected:
 	QVector<Node *> nodes;
 };
 
+//! Render queue of shapes collected by Node::drawShapes() for submission by Scene::drawShapes()
+class DrawQueue final
+{
+public:
+	struct Item
+	{
+		//! Render state key (program, material, geometry), ~0 keeps the scene graph order
+		std::uint64_t	sortKey;
+		//! View space depth, only set for second pass items
+		float	depth;
+		bool	hasAlpha;
+		bool	presorted;
+		Node *	node;
+	};
+
+	//! If false, second pass shapes are drawn in the first pass after all other shapes
+	bool useSecondPass = true;
+
+	void add( Node * n, bool secondPass, std::uint64_t sortKey = ~std::uint64_t( 0 ) );
+	void clear();
+
+	/*! Set up culling for the current view
+	 *
+	 * @param view			The view transform of the scene
+	 * @param projection	The projection matrix, the frustum planes are extracted from it
+	 * @param viewportHeight	Height of the viewport in pixels
+	 * @param minPixels		Shapes with a projected radius smaller than this are culled, 0 to disable
+	 */
+	void setupCulling( const Transform & view, const Matrix4 & projection, float viewportHeight, float minPixels );
+	//! Returns true if the bounds of the node and its children are off screen or too small to draw
+	bool cull( const Node * n );
+
+	//! Frustum planes not yet known to contain the bounds of the current node
+	std::uint32_t	planeMask = 0;
+	//! Number of shapes culled since the last call to clear()
+	std::uint32_t	culledShapes = 0;
+
+	//! Sort the first pass by render state to minimize program, texture and VAO changes
+	void stateSort();
+	//! Sort the second pass from back to front
+	void alphaSort();
+
+	const std::vector<Item> & firstPass() const { return opaque; }
+	const std::vector<Item> & secondPass() const { return translucent; }
+
+protected:
+	std::vector<Item> opaque;
+	std::vector<Item> translucent;
+
+	Transform	viewTransform;
+	//! Left, right, bottom, top and near planes in view space
+	FloatVector4	frustumPlanes[5];
+	//! Fourth row of the projection matrix
+	FloatVector4	projectionW;
+	//! Projected radius in pixels = radius * pixelScale / w
+	float	pixelScale = 0.0f;
+	float	minPixels = 0.0f;
+};
+
 class Node : public IControllable
 {
 	friend class ControllerManager;
@@ -108,13 +169,18 @@ public:
 	virtual void transformShapes();
 
 	virtual void draw();
-	virtual void drawShapes( NodeList * secondPass = nullptr );
+	//! Draw shapes, or add them to the queue if it is not nullptr
+	virtual void drawShapes( DrawQueue * queue = nullptr );
 	virtual void drawHavok();
 	virtual void drawFurn();
 	virtual void drawSelection() const;
 
 	virtual float viewDepth() const;
 	virtual class BoundSphere bounds() const;
+	//! Bounds of the geometry drawn by this node in world space, not including children
+	virtual BoundSphere drawBounds() const { return BoundSphere(); }
+	//! Bounds and number of the shapes in the subtree used for culling, cached until the next Scene::transform()
+	virtual const BoundSphere & cullBounds( std::uint32_t & shapeCount ) const;
 	virtual const Vector3 center() const;
 	virtual const Transform & viewTrans() const;
 	virtual const Transform & worldTrans() const;
@@ -177,6 +243,10 @@ protected:
 
 	int nodeId;
 	int ref;
+
+	mutable BoundSphere cullSphere;
+	mutable std::uint32_t cullShapeCount = 0;
+	mutable std::uint32_t cullFrame = 0;
 };
 
 template <typename T> inline T * Node::findProperty() const
@@ -221,6 +291,7 @@ public:
 	BillboardNode( Scene * scene, const QModelIndex & block );
 
 	const Transform & viewTrans() const override;
+	const BoundSphere & cullBounds( std::uint32_t & shapeCount ) const override;
 };
 
 
@@ -119,7 +119,14 @@ BoundSphere Particles::bounds() const
 	return worldTrans() * sphere | Node::bounds();
 }
 
-void Particles::drawShapes( NodeList * secondPass )
+BoundSphere Particles::drawBounds() const
+{
+	BoundSphere sphere( verts );
+	sphere.radius += size;
+	return worldTrans() * sphere;
+}
+
+void Particles::drawShapes( DrawQueue * queue )
 {
 	if ( isHidden() || scene->selecting > (unsigned char) Scene::SelObject || !scene->renderer || !scene->nifModel
 		|| verts.isEmpty() || active < 1 ) {
@@ -128,8 +135,9 @@ void Particles::drawShapes( NodeList * secondPass )
 
 	AlphaProperty * aprop = findProperty<AlphaProperty>();
 
-	if ( aprop && aprop->hasAlphaBlend() && secondPass ) {
-		secondPass->add( this );
+	if ( queue ) {
+		if ( !queue->cull( this ) )
+			queue->add( this, ( aprop && aprop->hasAlphaBlend() ) );
 		return;
 	}
 
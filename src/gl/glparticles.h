@@ -53,9 +53,10 @@ public:
 
 	void transformShapes() override;
 
-	void drawShapes( NodeList * secondPass = nullptr ) override;
+	void drawShapes( DrawQueue * queue = nullptr ) override;
 
 	BoundSphere bounds() const override;
+	BoundSphere drawBounds() const override;
 
 protected:
 	void setController( const NifModel * nif, const QModelIndex & controller ) override;
@@ -49,6 +49,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QOpenGLFunctions>
 #include <QSettings>
 
+#include <algorithm>
+
 
 //! \file glscene.cpp %Scene management
 
@@ -141,6 +143,9 @@ void Scene::clear( [[maybe_unused]] bool flushTextures )
 	properties.clear();
 	roots.clear();
 	shapes.clear();
+	drawQueue.clear();
+	collisionMeshes.clear();
+	blockLinkParents.clear();
 
 	animGroups.clear();
 	animTags.clear();
@@ -163,16 +168,12 @@ void Scene::update( const NifModel * nif, const QModelIndex & index )
 	nifModel = nif;
 
 	if ( index.isValid() ) {
-		QModelIndex block = nif->getBlockIndex( index );
-		if ( !block.isValid() )
-			return;
-
-		for ( Property * prop : properties )
-			prop->update( nif, block );
-
-		for ( Node * node : nodes.list() )
-			node->update( nif, block );
+		int	blockNum = nif->getBlockNumber( index );
+		if ( blockNum >= 0 )
+			update( nif, QList<int>{ blockNum } );
 	} else {
+		collisionMeshes.clear();
+		blockLinkParents.clear();
 		properties.validate();
 		nodes.validate();
 
@@ -198,6 +199,105 @@ void Scene::update( const NifModel * nif, const QModelIndex & index )
 	timeBoundsValid = false;
 }
 
+void Scene::update( const NifModel * nif, const QList<int> & blocks )
+{
+	if ( !nif )
+		return;
+
+	nifModel = nif;
+
+	// Changes to the links rebuild the scene, so the reverse links are kept until then
+	int	numBlocks = nif->getBlockCount();
+	if ( blockLinkParents.size() != numBlocks ) {
+		blockLinkParents.clear();
+		blockLinkParents.resize( numBlocks );
+		for ( int b = 0; b < numBlocks; b++ ) {
+			for ( int c : nif->getChildLinks( b ) ) {
+				if ( c >= 0 && c < numBlocks )
+					blockLinkParents[c].append( b );
+			}
+			// a block with a pointer to another block (skin bones, controller targets, etc.) also depends on it
+			for ( int p : nif->getParentLinks( b ) ) {
+				if ( p >= 0 && p < numBlocks )
+					blockLinkParents[p].append( b );
+			}
+		}
+	}
+
+	// The scene objects by block number, nodes are stored with their position in the node list,
+	// objects without a valid block are updated on any change
+	std::vector<QList<Property *>>	blockProperties( size_t( numBlocks ) );
+	std::vector<QList<std::pair<qsizetype, Node *>>>	blockNodes( size_t( numBlocks ) );
+	QList<Property *>	otherProperties;
+	QList<std::pair<qsizetype, Node *>>	otherNodes;
+	for ( Property * prop : properties ) {
+		int	b = nif->getBlockNumber( prop->index() );
+		if ( b >= 0 && b < numBlocks )
+			blockProperties[b].append( prop );
+		else
+			otherProperties.append( prop );
+	}
+	for ( qsizetype i = 0; i < nodes.list().size(); i++ ) {
+		Node *	node = nodes.list().at( i );
+		int	b = nif->getBlockNumber( node->index() );
+		if ( b >= 0 && b < numBlocks )
+			blockNodes[b].append( { i, node } );
+		else
+			otherNodes.append( { i, node } );
+	}
+
+	// A scene object only depends on its own block and the blocks linked from it (data, skin, properties,
+	// controllers, etc.), so changing a block only needs to update the objects of the block and its ancestors
+	std::vector<int>	visited( size_t( numBlocks ), -1 );
+	int	pass = 0;
+	QList<int>	affected;
+	QList<Property *>	updateProperties;
+	QList<std::pair<qsizetype, Node *>>	updateNodes;
+	for ( int blockNum : blocks ) {
+		if ( blockNum < 0 || blockNum >= numBlocks )
+			continue;
+
+		for ( auto i = collisionMeshes.begin(); i != collisionMeshes.end(); ) {
+			const auto &	sourceBlocks = i.value().sourceBlocks;
+			if ( std::find( sourceBlocks.begin(), sourceBlocks.end(), blockNum ) != sourceBlocks.end() )
+				i = collisionMeshes.erase( i );
+			else
+				i++;
+		}
+
+		// the blocks visited are marked with the number of the pass, so that the markers need no reset
+		pass++;
+		affected.clear();
+		affected.append( blockNum );
+		visited[blockNum] = pass;
+		for ( qsizetype i = 0; i < affected.size(); i++ ) {
+			for ( int p : blockLinkParents.at( affected.at( i ) ) ) {
+				if ( visited[p] != pass ) {
+					visited[p] = pass;
+					affected.append( p );
+				}
+			}
+		}
+
+		updateProperties = otherProperties;
+		updateNodes = otherNodes;
+		for ( int b : affected ) {
+			updateProperties.append( blockProperties[b] );
+			updateNodes.append( blockNodes[b] );
+		}
+		// nodes are updated in the order of the node list as before, nodes created by the updates are up to date
+		std::sort( updateNodes.begin(), updateNodes.end() );
+
+		QModelIndex	block = nif->getBlockIndex( blockNum );
+		for ( Property * prop : updateProperties )
+			prop->update( nif, block );
+		for ( const auto & n : updateNodes )
+			n.second->update( nif, block );
+	}
+
+	timeBoundsValid = false;
+}
+
 void Scene::updateSceneOptions( bool checked )
 {
 	Q_UNUSED( checked );
@@ -341,6 +441,7 @@ void Scene::transform( const Transform & trans, float time )
 {
 	view = trans;
 	this->time = time;
+	transformCount++;
 
 	worldTrans.clear();
 	viewTrans.clear();
@@ -380,31 +481,48 @@ void Scene::draw()
 
 void Scene::drawShapes()
 {
-	if ( hasOption(DoBlending) ) {
-		NodeList secondPass;
+	drawQueue.clear();
+	drawQueue.useSecondPass = hasOption(DoBlending);
+	drawQueue.setupCulling( view, Matrix4( &( renderer->globalUniforms->projectionMatrix[0][0] ) ),
+							renderer->getViewport()[3], cullMinPixels );
 
-		for ( Node * node : roots.list() ) {
-			node->drawShapes( &secondPass );
-		}
+	std::uint32_t	planeMask = drawQueue.planeMask;
+	for ( Node * node : roots.list() ) {
+		node->drawShapes( &drawQueue );
+		drawQueue.planeMask = planeMask;
+	}
 
-		renderer->drawSkyBox( this );
-		drawGrid();
+	if ( !selecting ) {
+		renderer->resetDrawStats();
+		textures->textureBinds = 0;
+	}
 
-		if ( secondPass.list().count() > 0 )
-			drawSelection(); // for transparency pass
+	drawQueue.stateSort();
 
-		secondPass.alphaSort();
+	for ( const DrawQueue::Item & i : drawQueue.firstPass() ) {
+		i.node->drawShapes();
+	}
 
-		for ( Node * node : secondPass.list() ) {
-			node->drawShapes();
-		}
-	} else {
-		for ( Node * node : roots.list() ) {
-			node->drawShapes();
+	renderer->drawSkyBox( this );
+	drawGrid();
+
+	if ( !drawQueue.secondPass().empty() ) {
+		drawSelection(); // for transparency pass
+
+		drawQueue.alphaSort();
+
+		for ( const DrawQueue::Item & i : drawQueue.secondPass() ) {
+			i.node->drawShapes();
 		}
+	}
 
-		renderer->drawSkyBox( this );
-		drawGrid();
+	if ( !selecting ) {
+		drawStats.shapes = std::uint32_t( drawQueue.firstPass().size() + drawQueue.secondPass().size() );
+		drawStats.secondPassShapes = std::uint32_t( drawQueue.secondPass().size() );
+		drawStats.culledShapes = drawQueue.culledShapes;
+		drawStats.programSwitches = renderer->drawStats.programSwitches;
+		drawStats.textureBinds = textures->textureBinds;
+		drawStats.vaoSwitches = renderer->drawStats.vaoSwitches;
 	}
 }
 
@@ -547,11 +665,20 @@ float Scene::timeMax() const
 
 QString Scene::textStats()
 {
+	QString	stats;
 	for ( Node * node : nodes.list() ) {
 		if ( node->index() == currentBlock ) {
-			return node->textStats();
+			stats = node->textStats() + QChar( '\n' );
+			break;
 		}
 	}
-	return QString();
+
+	stats += QString( "shapes drawn %1 (%2 in second pass)\n" ).arg( drawStats.shapes ).arg( drawStats.secondPassShapes );
+	stats += QString( "shapes culled %1\n" ).arg( drawStats.culledShapes );
+	stats += QString( "program switches %1\n" ).arg( drawStats.programSwitches );
+	stats += QString( "texture binds %1\n" ).arg( drawStats.textureBinds );
+	stats += QString( "VAO switches %1\n" ).arg( drawStats.vaoSwitches );
+
+	return stats;
 }
 
@@ -75,6 +75,8 @@ public:
 	void make( NifModel * nif, bool flushTextures = false );
 
 	void update( const NifModel * nif, const QModelIndex & index );
+	//! Updates the scene objects affected by changes to a list of blocks, that is, the objects of the blocks and their ancestors
+	void update( const NifModel * nif, const QList<int> & blocks );
 
 	void transform( const Transform & trans, float time = 0.0 );
 
@@ -206,6 +208,10 @@ public:
 	bool animate;
 
 	float time;
+	//! Incremented on each call to transform(), invalidates Node::cullBounds()
+	std::uint32_t transformCount = 0;
+	//! Shapes with a projected bounding sphere radius smaller than this (in pixels) are not drawn, 0 to disable
+	float cullMinPixels = 0.0f;
 
 	QString animGroup;
 	QStringList animGroups;
@@ -218,6 +224,32 @@ public:
 
 	QVector<Shape *> shapes;
 
+	//! Shapes queued for sorted drawing by drawShapes()
+	DrawQueue drawQueue;
+
+	//! Statistics of the last drawShapes() call that was not selecting, see textStats()
+	struct DrawStats {
+		std::uint32_t	shapes = 0;
+		std::uint32_t	secondPassShapes = 0;
+		std::uint32_t	culledShapes = 0;
+		std::uint32_t	programSwitches = 0;
+		std::uint32_t	textureBinds = 0;
+		std::uint32_t	vaoSwitches = 0;
+	} drawStats;
+
+	//! Collision geometry decoded once by getCollisionMesh() and drawn by drawCollisionMesh()
+	struct CollisionMesh {
+		struct Part {
+			QVector<Vector3>	verts;
+			QVector<Triangle>	triangles;
+			NifSkopeOpenGLContext::ShapeDataHash	dataHash;
+		};
+		//! Parts have at most 65536 vertices each
+		std::vector<Part>	parts;
+		//! Block numbers the geometry was decoded from, see update()
+		std::vector<int>	sourceBlocks;
+	};
+
 	FloatVector4 currentGLColor;
 	float currentGLLineWidth;
 	float currentGLPointSize;
@@ -248,6 +280,12 @@ protected:
 	Matrix4 modelViewMatrixStack[4];
 
 	Vector3 * allocateVertexAttr( size_t numVerts, FloatVector4 ** colors = nullptr );
+	NifSkopeOpenGLContext::Program * setupTriangleProgram( bool solid );
+
+	//! Collision meshes by bhk shape block number
+	QHash<int, CollisionMesh> collisionMeshes;
+	//! Blocks that have a child link or a pointer to each block, built on demand by update() and cleared by clear()
+	QList<QList<int>> blockLinkParents;
 
 public:
 	//! Color settings
@@ -304,6 +342,11 @@ public:
 	void drawConvexHull( const NifModel * nif, const QModelIndex & iShape, float scale, bool solid = false );
 	void drawNiTSS( const NifModel * nif, const QModelIndex & iShape, bool solid = false );
 	void drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid = false );
+	// returns the cached geometry of bhkNiTriStripsShape, bhkConvexVerticesShape, bhkPackedNiTriStripsShape
+	// or bhkCompressedMeshShape, decoding it on first use
+	const CollisionMesh & getCollisionMesh( const NifModel * nif, const QModelIndex & iShape );
+	// the data of the last part remains bound after drawing (for drawVertexSelection() etc.)
+	void drawCollisionMesh( const CollisionMesh & mesh, bool solid = false );
 	void drawSpring( const Vector3 & a, const Vector3 & b, float stiffness, int sd = 16, bool solid = false );
 	void drawRail( const Vector3 & a, const Vector3 & b );
 	void renderText( const Vector3 & c, const QString & str );
@@ -538,6 +538,24 @@ void Shape::setUniforms( NifSkopeOpenGLContext::Program * prog ) const
 	prog->uni4m( "modelViewMatrix", v.toMatrix4() );
 }
 
+std::uint64_t Shape::drawSortKey() const
+{
+	// presorted shapes are drawn last, in the order of the scene graph
+	if ( presorted ) [[unlikely]]
+		return ~std::uint64_t( 0 );
+
+	// the program is the one used in the previous frame, textures are grouped by the shader property
+	const void *	material = bssp;
+	if ( !material )
+		material = findProperty<TexturingProperty>();
+
+	std::uint64_t	programKey = ( shader ? shader->id : 0U ) & 0xFFFFU;
+	std::uint64_t	materialKey = std::uint64_t( reinterpret_cast< std::uintptr_t >( material ) >> 4 ) & 0xFFFFFFU;
+	std::uint64_t	geometryKey = dataHash.h[0] & 0xFFFFFFU;
+
+	return ( programKey << 48 ) | ( materialKey << 24 ) | geometryKey;
+}
+
 bool Shape::bindShape() const
 {
 	NifSkopeOpenGLContext *	context = scene->renderer;
@@ -75,6 +75,9 @@ public:
 	void drawBoundingBox( const Vector3 & boundsCenter, const Vector3 & boundsDims, FloatVector4 color ) const;
 	void setUniforms( NifSkopeOpenGLContext::Program * prog ) const;
 	bool bindShape() const;
+	//! Sort key for DrawQueue::stateSort(), grouping shapes by program, material and geometry
+	std::uint64_t drawSortKey() const;
+	BoundSphere drawBounds() const override { return bounds(); }
 
 	virtual QModelIndex vertexAt( int ) const { return QModelIndex(); }
 	virtual QModelIndex triangleAt( int ) const { return QModelIndex(); }
@@ -159,6 +159,8 @@ TexCache::TexCache( QObject * parent ) : QObject( parent )
 
 TexCache::~TexCache()
 {
+	// the cube maps being prefiltered must not notify the object after it is destroyed
+	cancelCubeMapJobs();
 #if 0
 	flush();
 #endif
@@ -345,6 +347,7 @@ int TexCache::bind( const QStringView & fname, const NifModel * nif )
 	if ( !tx->target ) [[unlikely]]
 		tx->target = GL_TEXTURE_2D;
 	glBindTexture( tx->target, tx->id[0] );
+	textureBinds++;
 
 	return tx->mipmaps;
 }
@@ -367,6 +370,7 @@ bool TexCache::bindCube( const QString & fname, const NifModel * nif, bool useSe
 	}
 
 	glBindTexture( tx->target, tx->id[size_t(useSecondTexture)] );
+	textureBinds++;
 
 	if ( !tx->mipmaps ) [[unlikely]]
 		return false;
@@ -409,6 +413,17 @@ std::uint16_t TexCache::loadTex( Tex & tx, const NifModel * nif )
 		i->status = e;
 	}
 
+	if ( !pendingCubeMapKey.isEmpty() ) [[unlikely]] {
+		// the texture is loaded by reloadPrefilteredCubeMap() when prefiltering has finished
+		glDeleteTextures( 1, tx.id );
+		tx.id[0] = GLuint( -1 );
+		tx.target = 0;
+		tx.mipmaps = 0;
+		i->prefilterKey = pendingCubeMapKey;
+		i->status = "prefiltering cube map";
+		pendingCubeMapKey.clear();
+	}
+
 	return tx.mipmaps;
 }
 
@@ -438,6 +453,7 @@ int TexCache::bind( const QModelIndex & iSource )
 					}
 				} else {
 					glBindTexture( GL_TEXTURE_2D, tx.id[0] );
+					textureBinds++;
 				}
 
 				return tx.mipmaps;
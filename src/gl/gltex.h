@@ -106,6 +106,8 @@ public:
 			TexFmt format;
 			//! Status messages
 			QString status;
+			//! Cache key of the cube map being prefiltered on a worker thread, empty if the texture is not waiting for one
+			QByteArray prefilterKey;
 
 			//! Save the texture as pixel data
 			bool savePixelData( TexCache & t, NifModel * nif, QModelIndex & iData ) const;
@@ -156,6 +158,8 @@ public:
 	bool bindCube( const QString & fname, const NifModel * nif, bool useSecondTexture );
 	//! Bind a texture from pixel data
 	int bind( const QModelIndex & iSource );
+	//! Number of textures bound since the counter was last reset by Scene::drawShapes()
+	std::uint32_t textureBinds = 0;
 
 	//! Debug function for getting info about a texture
 	QString info( const QModelIndex & iSource );
@@ -206,6 +210,13 @@ protected:
 	//! Load the texture
 	std::uint16_t loadTex( Tex & tx, const NifModel * nif );
 
+	//! Set by texLoadPBRCubeMap() to the cache key if the cube map has been queued for prefiltering instead of loaded
+	QByteArray pendingCubeMapKey;
+	//! Reloads the textures waiting for a cube map that has finished prefiltering
+	void reloadPrefilteredCubeMap( const QByteArray & key );
+	//! Stops waiting for the cube maps being prefiltered
+	void cancelCubeMapJobs();
+
 public:
 	void setOpenGLContext( NifSkopeOpenGLContext * context );
 
@@ -213,6 +224,7 @@ public:
 
 	// returns true if the settings have changed
 	static bool loadSettings( QSettings & settings );
+	//! Clears the prefiltered PBR cube maps in memory and on disk
 	static void clearCubeCache();
 	static void set_max_anisotropy();
 	static float get_max_anisotropy();
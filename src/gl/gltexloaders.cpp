@@ -43,14 +43,25 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QBuffer>
 #include <QByteArray>
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QModelIndex>
+#include <QMutex>
 #include <QOpenGLContext>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QString>
 #include <QtEndian>
 
+#include <bit>
+#include <future>
+#include <system_error>
+
 #include "dds.h"
 
 /*! @file gltexloaders.cpp
@@ -903,11 +914,167 @@ GLuint TexCache::texLoadDDS( const QString & filepath, GLenum & target, QByteArr
 	return mipmaps;
 }
 
-static SFCubeMapCache	sfCubeMapCache;
+//! Prefiltered specular and diffuse cube maps in DDS format
+struct PBRCubeMap
+{
+	QByteArray	specular;
+	QByteArray	diffuse;
+};
+
+//! A cube map being prefiltered on a worker thread
+struct PBRCubeMapJob
+{
+	std::shared_future< void >	future;
+	//! Texture caches to notify when the job has finished
+	QList< TexCache * >	waiting;
+	//! Set when the job has finished, the result is kept until it is loaded, even if it is not in the memory cache
+	bool	finished = false;
+	PBRCubeMap	result;
+};
+
+static QMutex	pbrCubeMapLock;
+//! Most recently used prefiltered cube maps in memory by cache key, the cost is the size in bytes
+static QCache< QByteArray, PBRCubeMap >	pbrCubeMaps( 0x10000000 );
+//! Cube maps that are being prefiltered on a worker thread
+static QHash< QByteArray, PBRCubeMapJob >	pbrCubeMapJobs;
+
+//! Adds a copy of a cube map to the memory cache, pbrCubeMapLock must be locked
+static void insertPBRCubeMap( const QByteArray & key, const PBRCubeMap & cubeMap )
+{
+	pbrCubeMaps.insert( key, new PBRCubeMap( cubeMap ), cubeMap.specular.size() + cubeMap.diffuse.size() );
+}
+
+static const quint32	pbrCubeMapCacheMagic = 0x4D43534E;	// "NSCM"
+static const quint32	pbrCubeMapCacheVersion = 1;
+
+static QString pbrCubeMapCacheDir()
+{
+	QString path = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+	if ( path.isEmpty() )
+		path = QDir::tempPath() + "/NifSkope";
+
+	return path + "/cubemaps";
+}
+
+static QString pbrCubeMapCacheFileName( const QByteArray & key )
+{
+	return pbrCubeMapCacheDir() + '/' + QString::fromLatin1( key.toHex() ) + ".cache";
+}
+
+static bool loadPBRCubeMapCache( const QByteArray & key, PBRCubeMap & cubeMap )
+{
+	QFile f( pbrCubeMapCacheFileName( key ) );
+	if ( !f.open( QIODevice::ReadOnly ) )
+		return false;
+
+	QDataStream in( &f );
+	in.setVersion( QDataStream::Qt_6_0 );
+	quint32	magic = 0, version = 0;
+	QByteArray	k;
+	in >> magic >> version;
+	if ( magic != pbrCubeMapCacheMagic || version != pbrCubeMapCacheVersion )
+		return false;
+	in >> k >> cubeMap.specular >> cubeMap.diffuse;
+
+	return ( in.status() == QDataStream::Ok && k == key && !cubeMap.specular.isEmpty() );
+}
+
+static void savePBRCubeMapCache( const QByteArray & key, const PBRCubeMap & cubeMap )
+{
+	QDir().mkpath( pbrCubeMapCacheDir() );
+
+	QSaveFile f( pbrCubeMapCacheFileName( key ) );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return;
+
+	QDataStream out( &f );
+	out.setVersion( QDataStream::Qt_6_0 );
+	out << pbrCubeMapCacheMagic << pbrCubeMapCacheVersion << key << cubeMap.specular << cubeMap.diffuse;
+
+	if ( out.status() == QDataStream::Ok )
+		f.commit();
+	else
+		f.cancelWriting();
+}
+
+//! Prefilters the specular and diffuse cube maps from a DDS or Radiance HDR image, this is thread safe
+static PBRCubeMap prefilterPBRCubeMap( QByteArray data, int width, int importanceSamples, int toneMapLevel,
+										float normalizeLevel, bool filterDisabled )
+{
+	PBRCubeMap	cubeMap;
+	const QByteArray	source( data );
+	try {
+		SFCubeMapCache	cubeMapFilter;
+		if ( !filterDisabled ) {
+			cubeMapFilter.setOutputWidth( std::uint32_t( width ) );
+			cubeMapFilter.setRoughnessTable( nullptr, 7 );
+			cubeMapFilter.setNormalizeLevel( normalizeLevel );
+			cubeMapFilter.setImportanceSamplingQuality( importanceSamples );
+			size_t	dataSize = size_t( data.size() );
+			size_t	spaceRequired = size_t( width ) * size_t( width ) * 8 * 4 + 148;
+			if ( data.size() < qsizetype(spaceRequired) )
+				data.resize( spaceRequired );
+			size_t	newSize = cubeMapFilter.convertImage( reinterpret_cast< unsigned char * >(data.data()), dataSize,
+															true, spaceRequired, toneMapLevel );
+			data.resize( newSize );
+		}
+		cubeMap.specular = data;
+
+		// generate second cube map for diffuse lighting
+		std::uint32_t	diffuseWidth = 32;
+		size_t	dataSize = size_t( data.size() );
+		size_t	spaceRequired = diffuseWidth * diffuseWidth * 8 * 4 + 148;
+		if ( data.size() < qsizetype(spaceRequired) )
+			data.resize( spaceRequired );
+		static const float  roughnessDiffuse = 1.0f;
+		cubeMapFilter.setOutputWidth( diffuseWidth );
+		cubeMapFilter.setRoughnessTable( &roughnessDiffuse, 1 );
+		cubeMapFilter.setImportanceSamplingQuality( -1 );
+		size_t	newSize = cubeMapFilter.convertImage( reinterpret_cast< unsigned char * >(data.data()), dataSize,
+														true, spaceRequired );
+		data.resize( newSize );
+		cubeMap.diffuse = data;
+	} catch ( std::exception & e ) {
+		qWarning() << "Prefiltering cube map failed:" << e.what();
+		// the source image is loaded without the diffuse cube map
+		cubeMap.specular = source;
+		cubeMap.diffuse.clear();
+	}
+
+	return cubeMap;
+}
 
 void TexCache::clearCubeCache()
 {
-	sfCubeMapCache.clear();
+	{
+		QMutexLocker	lock( &pbrCubeMapLock );
+		pbrCubeMaps.clear();
+	}
+	QDir( pbrCubeMapCacheDir() ).removeRecursively();
+}
+
+void TexCache::reloadPrefilteredCubeMap( const QByteArray & key )
+{
+	bool	reloaded = false;
+	for ( size_t i = 0; i <= textureHashMask; i++ ) {
+		Tex &	tx = textures[i];
+		if ( tx.imageInfo && tx.imageInfo->prefilterKey == key ) {
+			tx.imageInfo->prefilterKey.clear();
+			tx.imageInfo->status.clear();
+			tx.id[0] = 0;
+			reloaded = true;
+		}
+	}
+
+	if ( reloaded )
+		emit sigRefresh();
+}
+
+void TexCache::cancelCubeMapJobs()
+{
+	QMutexLocker	lock( &pbrCubeMapLock );
+	for ( auto & j : pbrCubeMapJobs )
+		j.waiting.removeAll( this );
 }
 
 GLuint TexCache::texLoadPBRCubeMap(
@@ -948,39 +1115,101 @@ GLuint TexCache::texLoadPBRCubeMap(
 		return 0;
 	} while ( false );
 
-	if ( !filterDisabled ) {
-		std::uint32_t	width = std::uint32_t( pbrCubeMapResolution );
-		sfCubeMapCache.setOutputWidth( width );
-		sfCubeMapCache.setRoughnessTable( nullptr, 7 );
-		sfCubeMapCache.setNormalizeLevel( normalizeLevel );
-		sfCubeMapCache.setImportanceSamplingQuality( pbrImportanceSamples );
-		size_t	dataSize = size_t( data.size() );
-		size_t	spaceRequired = width * width * 8 * 4 + 148;
-		if ( data.size() < qsizetype(spaceRequired) )
-			data.resize( spaceRequired );
-		size_t	newSize = sfCubeMapCache.convertImage( reinterpret_cast< unsigned char * >(data.data()), dataSize,
-														true, spaceRequired, hdrToneMapLevel );
-		data.resize( newSize );
+	// The cache key is the hash of the source image and of all settings that affect prefiltering
+	int	width = pbrCubeMapResolution;
+	int	importanceSamples = pbrImportanceSamples;
+	int	toneMapLevel = hdrToneMapLevel;
+	QByteArray	key;
+	{
+		QCryptographicHash	h( QCryptographicHash::Md5 );
+		h.addData( data );
+		const qint32	params[5] = { width, importanceSamples, toneMapLevel, qint32( filterDisabled ),
+										qint32( std::bit_cast< std::uint32_t >( normalizeLevel ) ) };
+		h.addData( QByteArrayView( reinterpret_cast< const char * >( params ), sizeof( params ) ) );
+		key = h.result();
 	}
 
+	PBRCubeMap	cubeMap;
+	bool	queued = false;
 	{
-		// generate and load second cube map for diffuse lighting
-		std::uint32_t	width = 32;
-		QByteArray	tmpData( data );
-		size_t	dataSize = size_t( tmpData.size() );
-		size_t	spaceRequired = width * width * 8 * 4 + 148;
-		if ( tmpData.size() < qsizetype(spaceRequired) )
-			tmpData.resize( spaceRequired );
-		static const float  roughnessDiffuse = 1.0f;
-		sfCubeMapCache.setOutputWidth( width );
-		sfCubeMapCache.setRoughnessTable( &roughnessDiffuse, 1 );
-		sfCubeMapCache.setImportanceSamplingQuality( -1 );
-		size_t	newSize = sfCubeMapCache.convertImage( reinterpret_cast< unsigned char * >(tmpData.data()), dataSize,
-														true, spaceRequired );
-		tmpData.resize( newSize );
+		QMutexLocker	lock( &pbrCubeMapLock );
+		auto	j = pbrCubeMapJobs.find( key );
+		if ( j != pbrCubeMapJobs.end() && j->finished ) {
+			cubeMap = j->result;
+			// the job is removed here, because the last copy of an std::async() future waits for the thread to exit
+			pbrCubeMapJobs.erase( j );
+		} else if ( j != pbrCubeMapJobs.end() ) {
+			if ( !j->waiting.contains( this ) )
+				j->waiting.append( this );
+			queued = true;
+		} else if ( const PBRCubeMap * c = pbrCubeMaps.object( key ); c ) {
+			cubeMap = *c;
+		}
+	}
+	if ( queued ) {
+		pendingCubeMapKey = key;
+		return 0;
+	}
+	if ( cubeMap.specular.isEmpty() && loadPBRCubeMapCache( key, cubeMap ) ) {
+		QMutexLocker	lock( &pbrCubeMapLock );
+		insertPBRCubeMap( key, cubeMap );
+	}
+
+	if ( cubeMap.specular.isEmpty() ) {
+		auto	prefilter = [key, data, width, importanceSamples, toneMapLevel, normalizeLevel, filterDisabled]() {
+			PBRCubeMap	c = prefilterPBRCubeMap( data, width, importanceSamples, toneMapLevel, normalizeLevel, filterDisabled );
+			if ( !c.diffuse.isEmpty() )
+				savePBRCubeMapCache( key, c );
+			return c;
+		};
+
+		// Solid color cube maps are used as fallbacks, and are prefiltered on the render thread
+		if ( filepath.startsWith( QChar('#') ) ) {
+			cubeMap = prefilter();
+			QMutexLocker	lock( &pbrCubeMapLock );
+			insertPBRCubeMap( key, cubeMap );
+		} else {
+			// Other cube maps are prefiltered on a worker thread, which notifies the waiting texture caches
+			// when it has finished, these then reload the textures that use the cube map
+			QMutexLocker	lock( &pbrCubeMapLock );
+			PBRCubeMapJob &	job = pbrCubeMapJobs[key];
+			if ( !job.waiting.contains( this ) )
+				job.waiting.append( this );
+			if ( !job.future.valid() ) {
+				try {
+					job.future = std::async( std::launch::async, [key, prefilter]() {
+						PBRCubeMap	c = prefilter();
+						QMutexLocker	lock( &pbrCubeMapLock );
+						insertPBRCubeMap( key, c );
+						PBRCubeMapJob &	j = pbrCubeMapJobs[key];
+						j.finished = true;
+						j.result = c;
+						for ( TexCache * t : j.waiting )
+							QMetaObject::invokeMethod( t, [t, key]() { t->reloadPrefilteredCubeMap( key ); }, Qt::QueuedConnection );
+						j.waiting.clear();
+					} ).share();
+				} catch ( std::system_error & ) {
+					// threads cannot be created
+					pbrCubeMapJobs.remove( key );
+					lock.unlock();
+					cubeMap = prefilter();
+					lock.relock();
+					insertPBRCubeMap( key, cubeMap );
+				}
+			}
+			if ( cubeMap.specular.isEmpty() ) {
+				pendingCubeMapKey = key;
+				return 0;
+			}
+		}
+	}
+
+	if ( !cubeMap.diffuse.isEmpty() ) {
+		QByteArray	tmpData( cubeMap.diffuse );
 		(void) texLoadDDS( filepath, target, tmpData, id + 1 );
 	}
 
+	data = cubeMap.specular;
 	return texLoadDDS( filepath, target, data, id );
 }
 
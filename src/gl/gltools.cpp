@@ -543,14 +543,11 @@ void Scene::drawLineStrip( const Vector3 * positions, size_t numVerts, const Flo
 	drawLines( positions, numVerts, colors, GL_LINE_STRIP );
 }
 
-void Scene::drawTriangles( const Vector3 * positions, size_t numVerts, const FloatVector4 * colors, bool solid,
-							unsigned int elementMode, size_t numElements, unsigned int elementType,
-							const void * elementData )
+NifSkopeOpenGLContext::Program * Scene::setupTriangleProgram( bool solid )
 {
 	auto	prog = useProgram( !solid ? "wireframe.prog" : "selection.prog" );
 	if ( !prog )
-		return;
-	NifSkopeOpenGLContext *	context = renderer;
+		return nullptr;
 	if ( !solid ) {
 		prog->uni3m( "normalMatrix", Matrix() );
 		prog->uni1f( "lineWidth", currentGLLineWidth );
@@ -564,9 +561,21 @@ void Scene::drawTriangles( const Vector3 * positions, size_t numVerts, const Flo
 		glDisable( GL_BLEND );
 	} else {
 		glEnable( GL_BLEND );
-		context->fn->glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+		renderer->fn->glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
 	}
 
+	return prog;
+}
+
+void Scene::drawTriangles( const Vector3 * positions, size_t numVerts, const FloatVector4 * colors, bool solid,
+							unsigned int elementMode, size_t numElements, unsigned int elementType,
+							const void * elementData )
+{
+	auto	prog = setupTriangleProgram( solid );
+	if ( !prog )
+		return;
+	NifSkopeOpenGLContext *	context = renderer;
+
 	size_t	elementDataSize = 0;
 	if ( numElements > 0 ) {
 		elementDataSize = ( elementType == GL_UNSIGNED_SHORT ? 2 : ( elementType == GL_UNSIGNED_INT ? 4 : 1 ) );
@@ -1394,92 +1403,101 @@ static QVector<Vector3> generateTris( const NifModel * nif, const QModelIndex &
 	return tris;
 }
 
-void Scene::drawConvexHull( const NifModel * nif, const QModelIndex & iShape, float scale, bool solid )
+//! Append a triangle strip to a triangle list, skipping degenerate triangles and invalid indices
+static void addTriangleStrip( QVector<Triangle> & triangles, const quint16 * strip, qsizetype numIndices,
+								quint32 firstVertex, quint32 numVerts )
 {
-	static QMap<QModelIndex, QVector<Vector3>> shapes;
-	QVector<Vector3> shape;
-
-	shape = shapes[iShape];
-
-	if ( shape.empty() ) {
-		shape = generateTris( nif, iShape, scale );
-		shapes[iShape] = shape;
+	for ( qsizetype i = 2; i < numIndices; i++ ) {
+		quint32	a = strip[i - 2];
+		quint32	b = strip[i - 1];
+		quint32	c = strip[i];
+		if ( a == b || a == c || b == c || std::max( a, std::max( b, c ) ) >= numVerts )
+			continue;
+		if ( i & 1 )
+			std::swap( b, c );
+		triangles.append( Triangle( quint16( a + firstVertex ), quint16( b + firstVertex ), quint16( c + firstVertex ) ) );
 	}
+}
 
-	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-	glDisable( GL_CULL_FACE );
-
-	drawTriangles( shape.constData(), size_t( shape.size() ), nullptr, solid );
-
-	glEnable( GL_CULL_FACE );
+//! Append a triangle list to a triangle list, skipping invalid indices
+static void addTriangleList( QVector<Triangle> & triangles, const quint16 * indices, qsizetype numIndices,
+								quint32 firstVertex, quint32 numVerts )
+{
+	for ( qsizetype i = 2; i < numIndices; i = i + 3 ) {
+		quint32	a = indices[i - 2];
+		quint32	b = indices[i - 1];
+		quint32	c = indices[i];
+		if ( std::max( a, std::max( b, c ) ) >= numVerts )
+			continue;
+		triangles.append( Triangle( quint16( a + firstVertex ), quint16( b + firstVertex ), quint16( c + firstVertex ) ) );
+	}
 }
 
-void Scene::drawNiTSS( const NifModel * nif, const QModelIndex & iShape, bool solid )
+//! Returns a collision mesh part that has room for numVerts more vertices
+static Scene::CollisionMesh::Part & allocCollisionMeshPart( Scene::CollisionMesh & mesh, qsizetype numVerts )
 {
-	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-	glDisable( GL_CULL_FACE );
+	if ( mesh.parts.empty() || ( mesh.parts.back().verts.size() + numVerts ) > 65536 )
+		mesh.parts.emplace_back();
+	return mesh.parts.back();
+}
 
+static void decodeNiTSS( Scene::CollisionMesh & mesh, const NifModel * nif, const QModelIndex & iShape )
+{
 	QModelIndex iStrips = nif->getIndex( iShape, "Strips Data" );
 	for ( int r = 0; r < nif->rowCount( iStrips ); r++ ) {
 		QModelIndex iStripData = nif->getBlockIndex( nif->getLink( nif->getIndex( iStrips, r ) ), "NiTriStripsData" );
 		if ( !iStripData.isValid() )
 			continue;
+		mesh.sourceBlocks.push_back( nif->getBlockNumber( iStripData ) );
 
 		QVector<Vector3> verts = nif->getArray<Vector3>( iStripData, "Vertices" );
+		if ( verts.size() > 65536 )
+			verts.resize( 65536 );
+		if ( verts.size() < 2 )
+			continue;
+
+		auto &	part = allocCollisionMeshPart( mesh, verts.size() );
+		quint32	firstVertex = quint32( part.verts.size() );
+		part.verts.append( verts );
 
+		// the strips are converted to triangles like they appear in the tescs
+		// (use the unstich strips spell to avoid the spider web effect)
 		QModelIndex iPoints = nif->getIndex( iStripData, "Points" );
-		for ( int r = 0; r < nif->rowCount( iPoints ); r++ ) {	// draw the strips like they appear in the tescs
-			// (use the unstich strips spell to avoid the spider web effect)
-			QVector<quint16> strip = nif->getArray<quint16>( nif->getIndex( iPoints, r ) );
-			// TODO: check for invalid indices
-			if ( verts.size() >= 2 && strip.size() >= 3 ) {
-				drawTriangles( verts.constData(), size_t( verts.size() ), nullptr, solid,
-								GL_TRIANGLE_STRIP, size_t( strip.size() ), GL_UNSIGNED_SHORT, strip.constData() );
-			}
+		for ( int s = 0; s < nif->rowCount( iPoints ); s++ ) {
+			QVector<quint16> strip = nif->getArray<quint16>( nif->getIndex( iPoints, s ) );
+			addTriangleStrip( part.triangles, strip.constData(), strip.size(), firstVertex, quint32( verts.size() ) );
 		}
 	}
-
-	glEnable( GL_CULL_FACE );
 }
 
-void Scene::drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid )
+static void decodeCMS( Scene::CollisionMesh & mesh, const NifModel * nif, const QModelIndex & iShape )
 {
 	QModelIndex iData = nif->getBlockIndex( nif->getLink( iShape, "Data" ) );
 	if ( !iData.isValid() )
 		return;
-
-	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-	glDisable( GL_CULL_FACE );
+	mesh.sourceBlocks.push_back( nif->getBlockNumber( iData ) );
 
 	QModelIndex iBigVerts = nif->getIndex( iData, "Big Verts" );
 	QModelIndex iBigTris = nif->getIndex( iData, "Big Tris" );
 	QModelIndex iChunkTrans = nif->getIndex( iData, "Chunk Transforms" );
 
-	qsizetype	numVerts = 0;
-	Vector3 *	positions = nullptr;
-	if ( nif->rowCount( iBigVerts ) > 0 ) {
-		QVector<Vector4> verts = nif->getArray<Vector4>( iBigVerts );
-		numVerts = std::min< qsizetype >( verts.size(), 65536 );
-		positions = allocateVertexAttr( size_t( numVerts ) );
-		if ( positions ) {
-			for ( qsizetype i = 0; i < numVerts; i++ )
-				FloatVector4( verts.at( i ) ).convertToVector3( &( positions[i][0] ) );
-		}
-	}
 	int numTriangles = nif->rowCount( iBigTris );
-	if ( numVerts >= 2 && numTriangles > 0 && positions ) {
-		QVector<Triangle> triangles( numTriangles );
+	if ( nif->rowCount( iBigVerts ) >= 2 && numTriangles > 0 ) {
+		QVector<Vector4> verts = nif->getArray<Vector4>( iBigVerts );
+		qsizetype	numVerts = std::min< qsizetype >( verts.size(), 65536 );
+
+		auto &	part = allocCollisionMeshPart( mesh, numVerts );
+		part.verts.resize( numVerts );
+		for ( qsizetype i = 0; i < numVerts; i++ )
+			part.verts[i] = Vector3( verts.at( i ) );
+
+		part.triangles.reserve( numTriangles );
 		for ( int i = 0; i < numTriangles; i++ ) {
-#if 0
-			triangles[i] = nif->get<Triangle>( nif->getIndex( iBigTris, i ), "Triangle" );
-#else
 			// assume that "Triangle" is in the first row of bhkCMSBigTri
-			triangles[i] = nif->get<Triangle>( nif->getIndex( nif->getIndex( iBigTris, i ), 0 ) );
-#endif
+			Triangle	t = nif->get<Triangle>( nif->getIndex( nif->getIndex( iBigTris, i ), 0 ) );
+			if ( std::max( t.v1(), std::max( t.v2(), t.v3() ) ) < numVerts )
+				part.triangles.append( t );
 		}
-
-		drawTriangles( positions, size_t( numVerts ), nullptr, solid,
-						GL_TRIANGLES, size_t( numTriangles ) * 3, GL_UNSIGNED_SHORT, triangles.constData() );
 	}
 
 	QModelIndex iChunkArr = nif->getIndex( iData, "Chunks" );
@@ -1492,52 +1510,147 @@ void Scene::drawCMS( const NifModel * nif, const QModelIndex & iShape, bool soli
 		Vector4 chunkTranslation = nif->get<Vector4>( nif->getIndex( chunkTransform, 0 ) ) + chunkOrigin;
 		Quat chunkRotation = nif->get<Quat>( nif->getIndex( chunkTransform, 1 ) );
 
-#if 0
-		quint32 numOffsets = nif->get<quint32>( iChunk, "Num Vertices" ) / 3;
-		quint32 numIndices = nif->get<quint32>( iChunk, "Num Indices" );
-		quint32 numStrips = nif->get<quint32>( iChunk, "Num Strips" );
-#endif
 		QVector<Vector3> vertices = nif->getArray<Vector3>( iChunk, "Vertices" );
 		QVector<quint16> indices = nif->getArray<quint16>( iChunk, "Indices" );
 		QVector<quint16> strips = nif->getArray<quint16>( iChunk, "Strips" );
 
+		if ( vertices.size() > 65536 )
+			vertices.resize( 65536 );
 		if ( vertices.size() < 2 || indices.size() < 3 )
 			continue;
 
+		// the chunk transform is applied to the vertices, so that the whole shape can be drawn at once
 		Transform trans;
 		trans.rotation.fromQuat( chunkRotation );
+		Matrix4	m = trans.toMatrix4() * Transform( Vector3( chunkTranslation ), 0.001f );
 
-		pushAndMultModelViewMatrix( trans.toMatrix4() * Transform( Vector3( chunkTranslation ), 0.001f ) );
-		// load data without rendering the mesh
-		drawTriangles( vertices.constData(), size_t( vertices.size() ), nullptr, solid,
-						0, size_t( indices.size() ), GL_UNSIGNED_SHORT, indices.constData() );
+		auto &	part = allocCollisionMeshPart( mesh, vertices.size() );
+		quint32	firstVertex = quint32( part.verts.size() );
+		quint32	numVerts = quint32( vertices.size() );
+		part.verts.reserve( part.verts.size() + vertices.size() );
+		for ( const auto & v : vertices )
+			part.verts.append( m * v );
 
 		// Stripped tris
 		qsizetype	offset = 0;
-		for ( qsizetype s = 0; s < strips.size(); s++ ) {
-
-			qsizetype	numIndices = strips[s];
-			if ( ( offset + numIndices ) > indices.size() )
-				numIndices = indices.size() - offset;
-			if ( numIndices < 3 )
-				continue;
-
-			renderer->fn->glDrawElements( GL_TRIANGLE_STRIP, GLsizei( numIndices ),
-											GL_UNSIGNED_SHORT, (void *) ( offset * 2 ) );
-
+		for ( qsizetype s = 0; s < strips.size() && offset < indices.size(); s++ ) {
+			qsizetype	numIndices = std::min< qsizetype >( strips[s], indices.size() - offset );
+			addTriangleStrip( part.triangles, indices.constData() + offset, numIndices, firstVertex, numVerts );
 			offset += numIndices;
 		}
 
 		// Non-stripped tris
-		if ( ( offset + 3 ) <= indices.size() ) {
-			qsizetype	numTriangles = ( indices.size() - offset ) / 3;
+		addTriangleList( part.triangles, indices.constData() + offset, indices.size() - offset, firstVertex, numVerts );
+	}
+}
 
-			renderer->fn->glDrawElements( GL_TRIANGLES, GLsizei( numTriangles * 3 ),
-											GL_UNSIGNED_SHORT, (void *) ( offset * 2 ) );
-		}
+static void decodePackedNiTSS( Scene::CollisionMesh & mesh, const NifModel * nif, const QModelIndex & iShape )
+{
+	QModelIndex iData = nif->getBlockIndex( nif->getLink( iShape, "Data" ) );
+	if ( !iData.isValid() )
+		return;
+	mesh.sourceBlocks.push_back( nif->getBlockNumber( iData ) );
 
-		popModelViewMatrix();
+	QModelIndex iVerts = nif->getIndex( iData, "Vertices" );
+	QModelIndex iTriangles = nif->getIndex( iData, "Triangles" );
+	if ( !( iVerts.isValid() && nif->rowCount( iVerts ) >= 2
+			&& iTriangles.isValid() && nif->rowCount( iTriangles ) >= 1 ) ) {
+		return;
+	}
+
+	// the triangles are stored unmodified, they are also used for drawing the selection
+	auto &	part = mesh.parts.emplace_back();
+	part.verts = nif->getArray<Vector3>( iVerts );
+	part.triangles = nif->getArray<Triangle>( iTriangles );
+}
+
+const Scene::CollisionMesh & Scene::getCollisionMesh( const NifModel * nif, const QModelIndex & iShape )
+{
+	int	blockNum = nif->getBlockNumber( iShape );
+	auto	i = collisionMeshes.constFind( blockNum );
+	if ( i != collisionMeshes.constEnd() ) [[likely]]
+		return i.value();
+
+	CollisionMesh &	mesh = collisionMeshes[blockNum];
+	mesh.sourceBlocks.push_back( blockNum );
+
+	const QString &	name = nif->itemName( iShape );
+	if ( name == "bhkNiTriStripsShape" ) {
+		decodeNiTSS( mesh, nif, iShape );
+	} else if ( name == "bhkConvexVerticesShape" ) {
+		auto &	part = mesh.parts.emplace_back();
+		part.verts = generateTris( nif, iShape, 1.0f );
+		if ( part.verts.size() > 65535 )
+			part.verts.resize( 65535 );
+		for ( qsizetype j = 2; j < part.verts.size(); j = j + 3 )
+			part.triangles.append( Triangle( quint16( j - 2 ), quint16( j - 1 ), quint16( j ) ) );
+	} else if ( name == "bhkPackedNiTriStripsShape" || name == "hkPackedNiTriStripsData" ) {
+		decodePackedNiTSS( mesh, nif, iShape );
+	} else if ( name == "bhkCompressedMeshShape" ) {
+		decodeCMS( mesh, nif, iShape );
+	}
+
+	// remove empty parts, and hash the geometry only once instead of on every bindShape() call
+	std::erase_if( mesh.parts, []( const CollisionMesh::Part & p ) {
+		return ( p.verts.size() < 2 || p.triangles.isEmpty() );
+	} );
+	for ( auto & p : mesh.parts ) {
+		const float *	attrData[1] = { &( p.verts.constFirst()[0] ) };
+		p.dataHash = NifSkopeOpenGLContext::ShapeDataHash( std::uint32_t( p.verts.size() ), 0x03,
+															size_t( p.triangles.size() ) * sizeof( Triangle ),
+															attrData, p.triangles.constData() );
+	}
+
+	return mesh;
+}
+
+void Scene::drawCollisionMesh( const CollisionMesh & mesh, bool solid )
+{
+	if ( mesh.parts.empty() )
+		return;
+	auto	prog = setupTriangleProgram( solid );
+	if ( !prog )
+		return;
+	prog->uni4f( "vertexColorOverride", FloatVector4( 1.0e-15f ).maxValues( currentGLColor ) );
+
+	NifSkopeOpenGLContext *	context = renderer;
+	for ( const auto & p : mesh.parts ) {
+		const float *	attrData[1] = { &( p.verts.constFirst()[0] ) };
+		context->bindShape( p.dataHash, attrData, p.triangles.constData() );
+		context->fn->glDrawElements( GL_TRIANGLES, GLsizei( p.triangles.size() * 3 ), GL_UNSIGNED_SHORT, (void *) 0 );
 	}
+}
+
+void Scene::drawConvexHull( const NifModel * nif, const QModelIndex & iShape, float scale, bool solid )
+{
+	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+	glDisable( GL_CULL_FACE );
+
+	if ( scale != 1.0f )
+		pushAndMultModelViewMatrix( Transform( Vector3(), scale ) );
+	drawCollisionMesh( getCollisionMesh( nif, iShape ), solid );
+	if ( scale != 1.0f )
+		popModelViewMatrix();
+
+	glEnable( GL_CULL_FACE );
+}
+
+void Scene::drawNiTSS( const NifModel * nif, const QModelIndex & iShape, bool solid )
+{
+	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+	glDisable( GL_CULL_FACE );
+
+	drawCollisionMesh( getCollisionMesh( nif, iShape ), solid );
+
+	glEnable( GL_CULL_FACE );
+}
+
+void Scene::drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid )
+{
+	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+	glDisable( GL_CULL_FACE );
+
+	drawCollisionMesh( getCollisionMesh( nif, iShape ), solid );
 
 	glEnable( GL_CULL_FACE );
 }
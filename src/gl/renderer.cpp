@@ -112,8 +112,7 @@ NifSkopeOpenGLContext::Program * Renderer::setupProgram( Shape * mesh, Program *
 
 	if ( hint && hint->status ) [[likely]] {
 		Program * program = hint;
-		fn->glUseProgram( program->id );
-		currentProgram = program;
+		setCurrentProgram( program );
 		bool	setupStatus;
 		if ( nif->getBSVersion() >= 170 )
 			setupStatus = setupProgramCE2( nif, program, mesh );
@@ -140,8 +139,7 @@ NifSkopeOpenGLContext::Program * Renderer::setupProgram( Shape * mesh, Program *
 
 	for ( Program * program = programsLinked; program; program = program->nextProgram ) {
 		if ( !program->conditions.isEmpty() && program->conditions.eval( nif, iBlocks ) ) {
-			fn->glUseProgram( program->id );
-			currentProgram = program;
+			setCurrentProgram( program );
 			bool	setupStatus;
 			if ( nif->getBSVersion() >= 170 )
 				setupStatus = setupProgramCE2( nif, program, mesh );
@@ -0,0 +1,126 @@
+#ifndef VERTEXSTREAM_H
+#define VERTEXSTREAM_H
+
+#include "data/nifitem.h"
+#include "data/niftypes.h"
+
+#include <QByteArray>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+
+//! @file vertexstream.h VertexFieldView, VertexStreamView
+
+//! Typed view of one field of the vertex structures in an array item, e.g. "Normal" in BSTriShape "Vertex Data"
+/*!
+ * The row of the field is looked up once in the first structure, the vertices are then read without
+ * model indices or name lookups. An invalid view (field not found or disabled by the vertex description)
+ * leaves the output unchanged.
+ */
+template <typename T> class VertexFieldView final
+{
+public:
+	VertexFieldView( const NifItem * vertexArray, int fieldRow, bool enabled = true )
+		: array( vertexArray ), row( enabled ? fieldRow : -1 )
+	{
+		if ( !array )
+			row = -1;
+	}
+
+	bool isValid() const { return row >= 0; }
+
+	//! Reads the field of vertex i, or returns T() if it does not exist
+	T operator[]( int i ) const
+	{
+		if ( !isValid() )
+			return T();
+		const NifItem * v = array->child( i );
+		const NifItem * f = ( v ? v->child( row ) : nullptr );
+		return ( f ? f->get<T>() : T() );
+	}
+
+	//! Converts the field of the first n vertices to U and stores them at dst
+	template <typename U> void copyTo( U * dst, int n ) const
+	{
+		if ( !isValid() )
+			return;
+		n = std::min( n, array->childCount() );
+		for ( int i = 0; i < n; i++ )
+			dst[i] = U( (*this)[i] );
+	}
+
+private:
+	const NifItem * array;
+	int row;
+};
+
+//! Typed view of one component of the elements in a packed vertex stream, e.g. an NiDataStream region
+/*!
+ * Element i of the component starts at offset + i * stride bytes in the stream. The read functions
+ * return the values as floats, 16-bit floats are converted with F16C instructions where available.
+ */
+class VertexStreamView final
+{
+public:
+	VertexStreamView() {}
+	VertexStreamView( const QByteArray & data, qsizetype stride, qsizetype offset, qsizetype componentSize )
+	{
+		if ( stride > 0 && offset >= 0 && componentSize > 0 && ( offset + componentSize ) <= data.size() ) {
+			buf = reinterpret_cast< const unsigned char * >( data.constData() ) + offset;
+			elementStride = stride;
+			elementCount = ( data.size() - ( offset + componentSize ) ) / stride + 1;
+		}
+	}
+
+	//! Number of complete elements in the stream
+	qsizetype size() const { return elementCount; }
+
+	//! Reads n (1 to 4) 32-bit floats
+	FloatVector4 float32( qsizetype i, int n ) const
+	{
+		float	v[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		std::memcpy( v, element( i ), size_t( n ) * sizeof( float ) );
+		return FloatVector4( v );
+	}
+
+	//! Reads n (1 to 4) 16-bit floats
+	FloatVector4 float16( qsizetype i, int n ) const
+	{
+		std::uint64_t	v = 0;
+		std::memcpy( &v, element( i ), size_t( n ) * sizeof( std::uint16_t ) );
+		return FloatVector4::convertFloat16( v );
+	}
+
+	//! Reads 4 unsigned bytes normalized to the range 0.0 to 1.0
+	FloatVector4 unorm8x4( qsizetype i ) const
+	{
+		std::uint32_t	v;
+		std::memcpy( &v, element( i ), sizeof( v ) );
+		return FloatVector4( v ) / 255.0f;
+	}
+
+	//! Reads an unsigned 16-bit integer
+	std::uint16_t uint16( qsizetype i ) const
+	{
+		std::uint16_t	v;
+		std::memcpy( &v, element( i ), sizeof( v ) );
+		return v;
+	}
+
+	//! Size in bytes of a component of a NiMesh data stream format (NiMesh::DataStreamFormat)
+	static qsizetype componentSize( std::uint32_t format )
+	{
+		return qsizetype( ( format >> 8 ) & 0x0F ) * qsizetype( ( format >> 16 ) & 0x0F );
+	}
+
+private:
+	const unsigned char * element( qsizetype i ) const { return buf + i * elementStride; }
+
+	const unsigned char * buf = nullptr;
+	qsizetype elementStride = 0;
+	qsizetype elementCount = 0;
+};
+
+#endif
@@ -221,11 +221,14 @@ void GLView::updateSettings()
 	cfg.startupDirection = startupDirections[std::clamp< int >( z, 0, 5 )];
 	z = settings.value( "General/Camera/Mwheel Zoom Speed", 8 ).toInt();
 	z = std::clamp< int >( z, 0, 16 );
+	float	cullMinPixels = std::clamp< float >( settings.value( "General/Small Shape Cull Size", 0.0f ).toFloat(), 0.0f, 64.0f );
 
 	settings.endGroup();
 
-	if ( scene )
+	if ( scene ) {
 		scene->updateColors( settings );
+		scene->cullMinPixels = cullMinPixels;
+	}
 
 	// TODO: make these configurable via the UI
 	double	p = devicePixelRatioF();
@@ -309,6 +312,15 @@ Scene * GLView::getScene()
 	return scene;
 }
 
+void GLView::flushSceneUpdates()
+{
+	if ( pendingBlockUpdates.isEmpty() || doCompile )
+		return;
+
+	scene->update( model, pendingBlockUpdates.values() );
+	pendingBlockUpdates.clear();
+}
+
 void GLView::updateScene()
 {
 	scene->update( model, QModelIndex() );
@@ -458,8 +470,11 @@ void GLView::paintGL()
 		emit sceneTimeChanged( time, scene->timeMin(), scene->timeMax() );
 		isDisabled = false;
 		doCompile = false;
+		pendingBlockUpdates.clear();
 	}
 
+	flushSceneUpdates();
+
 	// Center the model
 	if ( doCenter ) {
 		setCenter();
@@ -911,6 +926,7 @@ QModelIndex GLView::indexAt( const QPointF & pos, bool shiftModifier )
 	df << &Scene::drawShapes;
 
 	auto	prvContext = pushGLContext();
+	flushSceneUpdates();
 
 	double	p = devicePixelRatioF();
 	int	wp = pixelWidth;
@@ -1158,6 +1174,7 @@ void GLView::setNif( NifModel * nif )
 	}
 
 	model = nif;
+	pendingBlockUpdates.clear();
 
 	if ( model ) {
 		connect( model, &NifModel::dataChanged, this, &GLView::dataChanged );
@@ -1216,7 +1233,11 @@ void GLView::dataChanged( const QModelIndex & idx, const QModelIndex & xdi )
 	}
 
 	if ( ix.isValid() ) {
-		scene->update( model, idx );
+		// Edits are collected and applied once per frame, so that a series of changes (typing in an editor,
+		// dragging a slider, or a spell setting many values) does not update the scene for each one of them
+		int	blockNum = model->getBlockNumber( ix );
+		if ( blockNum >= 0 )
+			pendingBlockUpdates.insert( blockNum );
 		update();
 	} else {
 		modelChanged();
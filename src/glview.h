@@ -39,6 +39,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QOpenGLWindow> // Inherited
 #include <QDateTime>
 #include <QPersistentModelIndex>
+#include <QSet>
 
 
 //! @file glview.h GLView
@@ -186,6 +187,8 @@ protected:
 	//! Renders the OpenGL scene.
 	void paintGL() override final;
 	void glProjection( int x = -1, int y = -1 );
+	//! Applies the changes of pendingBlockUpdates to the scene
+	void flushSceneUpdates();
 
 	// QWidget Event Handlers
 
@@ -245,6 +248,8 @@ private:
 	bool doCompile = false;
 	bool doCenter = false;
 	unsigned char updatePending = 0;
+	//! Blocks changed since the last frame, the scene is updated once per frame by flushSceneUpdates()
+	QSet<int> pendingBlockUpdates;
 
 	QTimer * lightVisTimer;
 	int lightVisTimeout;
@@ -317,7 +317,16 @@ bool NifIStream::read( NifValue & val )
 			}
 
 			if ( len > maxLength || len < 0 ) {
-				*static_cast<QString *>(val.val.data) = tr( "<string too long (0x%1)>" ).arg( len, 0, 16 ); return false;
+				val.setString( tr( "<string too long (0x%1)>" ).arg( len, 0, 16 ) ); return false;
+			}
+
+			if ( len <= NifValue::maxShortStringLength ) {
+				// short strings are stored in the value without allocation
+				char	buf[16];
+				if ( device->read( buf, len ) != len )
+					return false;
+				val.setString( buf, len, true );
+				return true;
 			}
 
 			QByteArray string = device->read( len );
@@ -327,13 +336,20 @@ bool NifIStream::read( NifValue & val )
 
 			//string.replace( "\r", "\\r" );
 			//string.replace( "\n", "\\n" );
-			*static_cast<QString *>(val.val.data) = QString( string );
+			val.setString( string.constData(), string.size(), true );
 		}
 		return true;
 	case NifValue::tShortString:
 		{
 			unsigned char len;
 			device->read( (char *)&len, 1 );
+			if ( len <= NifValue::maxShortStringLength ) {
+				char	buf[16];
+				if ( device->read( buf, len ) != len )
+					return false;
+				val.setString( buf, len, false );
+				return true;
+			}
 			QByteArray string = device->read( len );
 
 			if ( string.size() != len )
@@ -341,7 +357,7 @@ bool NifIStream::read( NifValue & val )
 
 			//string.replace( "\r", "\\r" );
 			//string.replace( "\n", "\\n" );
-			*static_cast<QString *>(val.val.data) = QString::fromLatin1( string );
+			val.setString( string.constData(), string.size(), false );
 		}
 		return true;
 	case NifValue::tText:
@@ -350,7 +366,7 @@ bool NifIStream::read( NifValue & val )
 			device->read( (char *)&len, 4 );
 
 			if ( len > maxLength || len < 0 ) {
-				*static_cast<QString *>(val.val.data) = tr( "<string too long>" ); return false;
+				val.setString( tr( "<string too long>" ) ); return false;
 			}
 
 			QByteArray string = device->read( len );
@@ -358,7 +374,7 @@ bool NifIStream::read( NifValue & val )
 			if ( string.size() != len )
 				return false;
 
-			*static_cast<QString *>(val.val.data) = QString( string );
+			val.setString( string.constData(), string.size(), true );
 		}
 		return true;
 	case NifValue::tByteArray:
@@ -424,7 +440,7 @@ bool NifIStream::read( NifValue & val )
 				version = 0;
 			//}
 
-			*static_cast<QString *>(val.val.data) = QString( string );
+			val.setString( string.constData(), string.size(), true );
 			bool x = model->setHeaderString( QString( string ), version );
 
 			init();
@@ -442,7 +458,7 @@ bool NifIStream::read( NifValue & val )
 			if ( c >= 255 )
 				return false;
 
-			*static_cast<QString *>(val.val.data) = QString( string );
+			val.setString( string.constData(), string.size(), true );
 			return true;
 		}
 	case NifValue::tChar8String:
@@ -457,7 +473,7 @@ bool NifIStream::read( NifValue & val )
 			if ( c > 9 )
 				return false;
 
-			*static_cast<QString *>(val.val.data) = QString( string );
+			val.setString( string.constData(), string.size(), true );
 			return true;
 		}
 	case NifValue::tFileVersion:
@@ -706,7 +722,7 @@ bool NifOStream::write( const NifValue & val )
 	case NifValue::tSizedString:
 	case NifValue::tSizedString16:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.getStringLatin1();
 			//string.replace( "\\r", "\r" );
 			//string.replace( "\\n", "\n" );
 			char	len[4];
@@ -720,7 +736,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tShortString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.getStringLatin1();
 			//string.replace( "\\r", "\r" );
 			//string.replace( "\\n", "\n" );
 
@@ -738,7 +754,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tText:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.getStringLatin1();
 			std::int32_t len = std::int32_t( string.size() );
 
 			if ( device->write( (char *)&len, 4 ) != 4 )
@@ -749,7 +765,7 @@ bool NifOStream::write( const NifValue & val )
 	case NifValue::tHeaderString:
 	case NifValue::tLineString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.getStringLatin1();
 
 			if ( device->write( string.constData(), string.length() ) != string.length() )
 				return false;
@@ -758,7 +774,7 @@ bool NifOStream::write( const NifValue & val )
 		}
 	case NifValue::tChar8String:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.getStringLatin1();
 			quint32 n = std::min<quint32>( 8, string.length() );
 
 			if ( device->write( string.constData(), n ) != n )
@@ -916,14 +932,14 @@ int NifSStream::size( const NifValue & val )
 	case NifValue::tSizedString:
 	case NifValue::tSizedString16:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.getStringLatin1();
 			//string.replace( "\\r", "\r" );
 			//string.replace( "\\n", "\n" );
 			return string.size() + ( val.type() == NifValue::tSizedString16 ? 2 : 4 );
 		}
 	case NifValue::tShortString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.getStringLatin1();
 
 			//string.replace( "\\r", "\r" );
 			//string.replace( "\\n", "\n" );
@@ -932,13 +948,13 @@ int NifSStream::size( const NifValue & val )
 		}
 	case NifValue::tText:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.getStringLatin1();
 			return 4 + string.size();
 		}
 	case NifValue::tHeaderString:
 	case NifValue::tLineString:
 		{
-			QByteArray string = static_cast<QString *>(val.val.data)->toLatin1();
+			QByteArray string = val.getStringLatin1();
 			return string.length() + 1;
 		}
 	case NifValue::tChar8String:
@@ -11,6 +11,7 @@
 #include "libfo76utils/src/material.hpp"
 #include "spells/mesh.h"
 #include "spells/tangentspace.h"
+#include "lib/parallel.h"
 
 #define TINYGLTF_IMPLEMENTATION
 #define TINYGLTF_NO_STB_IMAGE	1
@@ -18,17 +19,26 @@
 #include <tiny_gltf.h>
 
 #include <cctype>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 
 #include <QApplication>
 #include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QVector>
 #include <QDir>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QIODevice>
 #include <QImage>
+#include <QSaveFile>
 #include <QSettings>
+#include <QStandardPaths>
 #include <QMessageBox>
+#include <QtEndian>
 
 #define tr( x ) QApplication::tr( x )
 
@@ -591,13 +601,45 @@ bool exportCreateMeshes(const NifModel* nif, const Scene* scene, tinygltf::Model
 
 class ExportGltfMaterials {
 protected:
+	//! A texture or pair of textures converted to a glTF compatible PNG image
+	struct BakedTexture {
+		std::string	txtPath1;
+		std::string	txtPath2;
+		int	n;
+		unsigned char	texCoordMode;
+		// DDS data of the source textures, only kept until the image is baked
+		QByteArray	srcData[2];
+		QByteArray	cacheKey;
+		QByteArray	imageBuf;
+		int	width = 1;
+		int	height = 1;
+		int	channels = 0;
+		int	textureID = -1;
+	};
+	//! Texture slot of a material that is set after baking
+	struct TextureRef {
+		tinygltf::Material *	mat;
+		int	n;
+		unsigned char	texCoordChannel;
+		size_t	texture;
+	};
 	tinygltf::Model &	model;
 	NifModel *	nif;
 	CE2MaterialDB *	materials;
 	int	mipLevel;
 	std::set< std::string >	materialSet;
-	std::map< std::string, int >	textureMap;
-	DDSTexture16 * loadTexture( const std::string_view & txtPath );
+	std::map< std::string, size_t >	textureMap;
+	std::vector< BakedTexture >	textures;
+	std::vector< TextureRef >	textureRefs;
+	static DDSTexture16 * loadTexture( const std::string & txtPath, const QByteArray & srcData, int mipLevel );
+	void loadSourceData( BakedTexture & t );
+	//! Converts the source textures to PNG format, this is thread safe
+	static void bakeTexture( BakedTexture & t, int mipLevel );
+	static QString bakedTextureCacheDir();
+	static bool loadCachedTexture( BakedTexture & t );
+	static void saveCachedTexture( const BakedTexture & t );
+	//! Removes the least recently used cache files while the cache is larger than bakedTextureCacheMaxSize
+	static void trimTextureCache();
 	// n = 0: albedo
 	// n = 1: normal
 	// n = 2: PBR
@@ -612,9 +654,15 @@ public:
 	{
 	}
 	void exportMaterial( tinygltf::Material & mat, const std::string & matPath );
+	//! Bakes the textures of the exported materials, and adds them as images stored at binSize in buffer 0
+	/*!
+	 * The images are baked on worker threads, or loaded from the cache of previously baked images.
+	 * The PNG data is appended to imageData, and binSize is incremented by its size padded to 4 bytes.
+	 */
+	void bakeTextures( std::vector< QByteArray > & imageData, size_t & binSize );
 };
 
-DDSTexture16 * ExportGltfMaterials::loadTexture( const std::string_view & txtPath )
+DDSTexture16 * ExportGltfMaterials::loadTexture( const std::string & txtPath, const QByteArray & srcData, int mipLevel )
 {
 	if ( txtPath.length() == 9 && txtPath[0] == '#' ) {
 		std::uint32_t	c = 0;
@@ -627,13 +675,12 @@ DDSTexture16 * ExportGltfMaterials::loadTexture( const std::string_view & txtPat
 		return new DDSTexture16( FloatVector4( c ) / 255.0f );
 	}
 
+	if ( mipLevel < 0 || txtPath.empty() || srcData.isEmpty() )
+		return nullptr;
 	DDSTexture16 *	t = nullptr;
 	try {
-		QByteArray	buf;
-		if ( mipLevel < 0 || !nif->getResourceFile( buf, txtPath ) )
-			return nullptr;
 		t = new DDSTexture16(
-				reinterpret_cast< const unsigned char * >( buf.constData() ), size_t( buf.size() ), mipLevel, true );
+				reinterpret_cast< const unsigned char * >( srcData.constData() ), size_t( srcData.size() ), mipLevel, true );
 	} catch ( NifSkopeError & ) {
 		delete t;
 		t = nullptr;
@@ -641,6 +688,191 @@ DDSTexture16 * ExportGltfMaterials::loadTexture( const std::string_view & txtPat
 	return t;
 }
 
+void ExportGltfMaterials::loadSourceData( BakedTexture & t )
+{
+	QCryptographicHash	h( QCryptographicHash::Sha1 );
+	std::string	keyPrefix;
+	printToString( keyPrefix, "%s\n%s\n%d\n%d\n", t.txtPath1.c_str(), t.txtPath2.c_str(), t.n, mipLevel );
+	h.addData( QByteArrayView( keyPrefix.c_str(), qsizetype( keyPrefix.length() ) ) );
+
+	for ( int i = 0; i < 2; i++ ) {
+		const std::string &	txtPath = ( !i ? t.txtPath1 : t.txtPath2 );
+		if ( txtPath.empty() || txtPath[0] == '#' || mipLevel < 0 )
+			continue;
+		// the resource archives are not thread safe, the data is loaded on the calling thread
+		if ( !nif->getResourceFile( t.srcData[i], txtPath ) )
+			t.srcData[i].clear();
+		h.addData( QCryptographicHash::hash( t.srcData[i], QCryptographicHash::Sha1 ) );
+	}
+	t.cacheKey = h.result();
+}
+
+void ExportGltfMaterials::bakeTexture( BakedTexture & t, int mipLevel )
+{
+	int	n = t.n;
+	int	width = 1;
+	int	height = 1;
+	int	channels = 0;
+	DDSTexture16 *	t1 = nullptr;
+	DDSTexture16 *	t2 = nullptr;
+	try {
+		if ( !t.txtPath1.empty() && ( t1 = loadTexture( t.txtPath1, t.srcData[0], mipLevel ) ) != nullptr ) {
+			width = t1->getWidth();
+			height = t1->getHeight();
+		}
+		if ( !t.txtPath2.empty() && ( t2 = loadTexture( t.txtPath2, t.srcData[1], mipLevel ) ) != nullptr ) {
+			width = std::max< int >( width, t2->getWidth() );
+			height = std::max< int >( height, t2->getHeight() );
+		}
+		if ( t1 || t2 )
+			channels = ( n == 0 ? ( !t2 ? 3 : 4 ) : ( n == 3 ? 1 : 3 ) );
+		QImage::Format	fmt =
+			( channels <= 1 ? QImage::Format_Grayscale8
+								: ( channels == 3 ? QImage::Format_RGB888 : QImage::Format_RGBA8888 ) );
+		QImage	img( width, height, fmt );
+		size_t	lineBytes = size_t( img.bytesPerLine() );
+		float	xScale = 1.0f / float( width );
+		float	xOffset = xScale * 0.5f;
+		float	yScale = 1.0f / float( height );
+		float	yOffset = yScale * 0.5f;
+		bool	f1 = ( t1 && ( t1->getWidth() != width || t1->getHeight() != height ) );
+		bool	f2 = ( t2 && ( t2->getWidth() != width || t2->getHeight() != height ) );
+		for ( int y = 0; channels > 0 && y < height; y++ ) {
+			unsigned char *	imgPtr = reinterpret_cast< unsigned char * >( img.bits() ) + ( size_t(y) * lineBytes );
+			for ( int x = 0; x < width; x++, imgPtr = imgPtr + channels ) {
+				FloatVector4	a( 0.0f, 0.0f, 0.0f, 1.0f );
+				FloatVector4	b( 0.0f, 0.0f, 0.0f, 1.0f );
+				float	xf = float( x ) * xScale + xOffset;
+				float	yf = float( y ) * yScale + yOffset;
+				if ( t1 )
+					a = ( !f1 ? FloatVector4::convertFloat16( t1->getPixelN(x, y, 0) ) : t1->getPixelB(xf, yf, 0) );
+				if ( t2 )
+					b = ( !f2 ? FloatVector4::convertFloat16( t2->getPixelN(x, y, 0) ) : t2->getPixelB(xf, yf, 0) );
+				switch ( n ) {
+				case 0:
+					// albedo: add alpha channel from opacity texture
+					a[3] = b[0];
+					break;
+				case 1:
+					// normal map: calculate Z (blue) channel and convert to unsigned format
+					a[2] = float( std::sqrt( std::max( 1.0f - a.dotProduct2(a), 0.0f ) ) );
+					a = a * FloatVector4( 0.5f, -0.5f, 0.5f, 0.5f ) + 0.5f;	// invert green channel
+					break;
+				case 2:
+					// PBR map: G = roughness, B = metalness
+					a = FloatVector4( 0.0f, a[0], b[0], 0.0f );
+					break;
+				}
+				std::uint32_t	c = std::uint32_t( a * 255.0f );
+				if ( channels == 3 ) {
+					FileBuffer::writeUInt16Fast( imgPtr, std::uint16_t( c ) );
+					imgPtr[2] = std::uint8_t( c >> 16 );
+				} else if ( channels == 4 ) {
+					FileBuffer::writeUInt32Fast( imgPtr, c );
+				} else {
+					*imgPtr = std::uint8_t( c );
+				}
+			}
+		}
+		delete t1;
+		t1 = nullptr;
+		delete t2;
+		t2 = nullptr;
+
+		if ( channels ) {
+			QBuffer	tmpBuf( &t.imageBuf );
+			tmpBuf.open( QIODevice::WriteOnly );
+			img.save( &tmpBuf, "PNG", 89 );
+		}
+	} catch ( ... ) {
+		delete t1;
+		delete t2;
+		t.imageBuf.clear();
+		channels = 0;
+	}
+
+	t.width = width;
+	t.height = height;
+	t.channels = channels;
+	t.srcData[0] = QByteArray();
+	t.srcData[1] = QByteArray();
+}
+
+//! Identifies a baked glTF texture cache file
+static constexpr quint32 bakedTextureCacheMagic = 0x5447534E;	// "NSGT"
+//! Version of the baked texture cache format, must be incremented when the conversion changes
+static constexpr quint32 bakedTextureCacheVersion = 1;
+//! Maximum total size of the baked texture cache files in bytes
+static constexpr qint64 bakedTextureCacheMaxSize = qint64( 1 ) << 30;
+
+QString ExportGltfMaterials::bakedTextureCacheDir()
+{
+	QString path = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+	if ( path.isEmpty() )
+		path = QDir::tempPath() + "/NifSkope";
+
+	return path + "/gltf_textures";
+}
+
+bool ExportGltfMaterials::loadCachedTexture( BakedTexture & t )
+{
+	QFile f( bakedTextureCacheDir() + '/' + QString::fromLatin1( t.cacheKey.toHex() ) + ".cache" );
+	if ( !f.open( QIODevice::ReadOnly ) )
+		return false;
+
+	QDataStream in( &f );
+	in.setVersion( QDataStream::Qt_6_0 );
+	quint32	magic = 0, version = 0;
+	QByteArray	k;
+	qint32	width = 0, height = 0, channels = 0;
+	in >> magic >> version;
+	if ( magic != bakedTextureCacheMagic || version != bakedTextureCacheVersion )
+		return false;
+	in >> k >> width >> height >> channels >> t.imageBuf;
+	if ( !( in.status() == QDataStream::Ok && k == t.cacheKey && channels > 0 && !t.imageBuf.isEmpty() ) ) {
+		t.imageBuf.clear();
+		return false;
+	}
+
+	t.width = width;
+	t.height = height;
+	t.channels = channels;
+	t.srcData[0] = QByteArray();
+	t.srcData[1] = QByteArray();
+	// the modification time is the last use of the file for trimTextureCache()
+	f.setFileTime( QDateTime::currentDateTime(), QFileDevice::FileModificationTime );
+	return true;
+}
+
+void ExportGltfMaterials::saveCachedTexture( const BakedTexture & t )
+{
+	QSaveFile f( bakedTextureCacheDir() + '/' + QString::fromLatin1( t.cacheKey.toHex() ) + ".cache" );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return;
+
+	QDataStream out( &f );
+	out.setVersion( QDataStream::Qt_6_0 );
+	out << bakedTextureCacheMagic << bakedTextureCacheVersion << t.cacheKey
+		<< qint32( t.width ) << qint32( t.height ) << qint32( t.channels ) << t.imageBuf;
+
+	if ( out.status() == QDataStream::Ok )
+		f.commit();
+	else
+		f.cancelWriting();
+}
+
+void ExportGltfMaterials::trimTextureCache()
+{
+	QDir	d( bakedTextureCacheDir() );
+	qint64	totalSize = 0;
+	// sorted by modification time, the most recently used files first
+	for ( const QFileInfo & i : d.entryInfoList( { "*.cache" }, QDir::Files, QDir::Time ) ) {
+		totalSize += i.size();
+		if ( totalSize > bakedTextureCacheMaxSize )
+			QFile::remove( i.filePath() );
+	}
+}
+
 void ExportGltfMaterials::getTexture(
 	tinygltf::Material & mat, int n, const std::string & txtPath1, const std::string & txtPath2,
 	const CE2Material::UVStream * uvStream )
@@ -660,155 +892,110 @@ void ExportGltfMaterials::getTexture(
 
 	auto	i = textureMap.find( textureMapKey );
 	if ( i == textureMap.end() ) {
-		// load texture(s) and convert to glTF compatible PNG format
-		QByteArray	imageBuf;
-		int	width = 1;
-		int	height = 1;
-		int	channels = 0;
-		DDSTexture16 *	t1 = nullptr;
-		DDSTexture16 *	t2 = nullptr;
-		try {
-			if ( !txtPath1.empty() && ( t1 = loadTexture( txtPath1 ) ) != nullptr ) {
-				width = t1->getWidth();
-				height = t1->getHeight();
-			}
-			if ( !txtPath2.empty() && ( t2 = loadTexture( txtPath2 ) ) != nullptr ) {
-				width = std::max< int >( width, t2->getWidth() );
-				height = std::max< int >( height, t2->getHeight() );
-			}
-			if ( t1 || t2 )
-				channels = ( n == 0 ? ( !t2 ? 3 : 4 ) : ( n == 3 ? 1 : 3 ) );
-			QImage::Format	fmt =
-				( channels <= 1 ? QImage::Format_Grayscale8
-									: ( channels == 3 ? QImage::Format_RGB888 : QImage::Format_RGBA8888 ) );
-			QImage	img( width, height, fmt );
-			size_t	lineBytes = size_t( img.bytesPerLine() );
-			float	xScale = 1.0f / float( width );
-			float	xOffset = xScale * 0.5f;
-			float	yScale = 1.0f / float( height );
-			float	yOffset = yScale * 0.5f;
-			bool	f1 = ( t1 && ( t1->getWidth() != width || t1->getHeight() != height ) );
-			bool	f2 = ( t2 && ( t2->getWidth() != width || t2->getHeight() != height ) );
-			for ( int y = 0; channels > 0 && y < height; y++ ) {
-				unsigned char *	imgPtr = reinterpret_cast< unsigned char * >( img.bits() ) + ( size_t(y) * lineBytes );
-				for ( int x = 0; x < width; x++, imgPtr = imgPtr + channels ) {
-					FloatVector4	a( 0.0f, 0.0f, 0.0f, 1.0f );
-					FloatVector4	b( 0.0f, 0.0f, 0.0f, 1.0f );
-					float	xf = float( x ) * xScale + xOffset;
-					float	yf = float( y ) * yScale + yOffset;
-					if ( t1 )
-						a = ( !f1 ? FloatVector4::convertFloat16( t1->getPixelN(x, y, 0) ) : t1->getPixelB(xf, yf, 0) );
-					if ( t2 )
-						b = ( !f2 ? FloatVector4::convertFloat16( t2->getPixelN(x, y, 0) ) : t2->getPixelB(xf, yf, 0) );
-					switch ( n ) {
-					case 0:
-						// albedo: add alpha channel from opacity texture
-						a[3] = b[0];
-						break;
-					case 1:
-						// normal map: calculate Z (blue) channel and convert to unsigned format
-						a[2] = float( std::sqrt( std::max( 1.0f - a.dotProduct2(a), 0.0f ) ) );
-						a = a * FloatVector4( 0.5f, -0.5f, 0.5f, 0.5f ) + 0.5f;	// invert green channel
-						break;
-					case 2:
-						// PBR map: G = roughness, B = metalness
-						a = FloatVector4( 0.0f, a[0], b[0], 0.0f );
-						break;
-					}
-					std::uint32_t	c = std::uint32_t( a * 255.0f );
-					if ( channels == 3 ) {
-						FileBuffer::writeUInt16Fast( imgPtr, std::uint16_t( c ) );
-						imgPtr[2] = std::uint8_t( c >> 16 );
-					} else if ( channels == 4 ) {
-						FileBuffer::writeUInt32Fast( imgPtr, c );
-					} else {
-						*imgPtr = std::uint8_t( c );
-					}
-				}
-			}
-			delete t1;
-			t1 = nullptr;
-			delete t2;
-			t2 = nullptr;
-
-			if ( channels ) {
-				QBuffer	tmpBuf( &imageBuf );
-				tmpBuf.open( QIODevice::WriteOnly );
-				img.save( &tmpBuf, "PNG", 89 );
-			}
-		} catch ( ... ) {
-			delete t1;
-			delete t2;
-			throw;
-		}
+		BakedTexture &	t = textures.emplace_back();
+		t.txtPath1 = txtPath1;
+		t.txtPath2 = txtPath2;
+		t.n = n;
+		t.texCoordMode = texCoordMode;
+		i = textureMap.emplace( textureMapKey, textures.size() - 1 ).first;
+	}
+
+	textureRefs.push_back( TextureRef{ &mat, n, texCoordChannel, i->second } );
+}
 
-		// if a valid image has been created, add it as a glTF buffer view
-		int	bufView = -1;
-		if ( !imageBuf.isEmpty() && !model.buffers.empty() ) {
-			bufView = int( model.bufferViews.size() );
-			tinygltf::BufferView &	v = model.bufferViews.emplace_back();
-			v.buffer = int( model.buffers.size() - 1 );
-			std::vector< unsigned char > &	buf = model.buffers.back().data;
-			v.byteOffset = buf.size();
-			v.byteLength = size_t( imageBuf.size() );
-			buf.resize( v.byteOffset + v.byteLength );
-			std::memcpy( buf.data() + v.byteOffset, imageBuf.data(), v.byteLength );
+void ExportGltfMaterials::bakeTextures( std::vector< QByteArray > & imageData, size_t & binSize )
+{
+	if ( textures.empty() )
+		return;
+	QDir().mkpath( bakedTextureCacheDir() );
+
+	// the source textures are loaded in batches to limit memory usage
+	size_t	batchSize = std::max< size_t >( std::thread::hardware_concurrency(), 1 ) * 4;
+	std::vector< BakedTexture * >	jobs;
+	for ( size_t i0 = 0; i0 < textures.size(); i0 += batchSize ) {
+		size_t	i1 = std::min( i0 + batchSize, textures.size() );
+		jobs.clear();
+		for ( size_t i = i0; i < i1; i++ ) {
+			loadSourceData( textures[i] );
+			if ( !loadCachedTexture( textures[i] ) )
+				jobs.push_back( &( textures[i] ) );
 		}
 
-		int	textureID = -1;
-		if ( bufView >= 0 ) {
-			tinygltf::Image &	img = model.images.emplace_back();
-			img.width = width;
-			img.height = height;
-			img.component = channels;
-			img.bits = 8;
-			img.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
-			img.bufferView = bufView;
-			img.mimeType = "image/png";
-			textureID = int( model.textures.size() );
-			model.textures.emplace_back().source = int( model.images.size() - 1 );
-			if ( texCoordMode ) {
-				int	wrapMode = TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE;
-				if ( !( texCoordMode & 1 ) )
-					wrapMode = TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT;
-				for ( const auto & j : model.samplers ) {
-					if ( j.wrapS == wrapMode ) {
-						model.textures.back().sampler = int( &j - model.samplers.data() );
-						break;
-					}
-				}
-				if ( model.textures.back().sampler < 0 ) {
-					model.samplers.emplace_back().wrapS = wrapMode;
-					model.samplers.back().wrapT = wrapMode;
-					model.textures.back().sampler = int( model.samplers.size() - 1 );
+		int	textureMipLevel = mipLevel;
+		parallelFor( jobs.size(), [&jobs, textureMipLevel]( size_t i ) {
+			bakeTexture( *(jobs[i]), textureMipLevel );
+			if ( !jobs[i]->imageBuf.isEmpty() )
+				saveCachedTexture( *(jobs[i]) );
+		} );
+	}
+	trimTextureCache();
+
+	// add the valid images as glTF buffer views
+	for ( BakedTexture & t : textures ) {
+		if ( t.imageBuf.isEmpty() )
+			continue;
+
+		int	bufView = int( model.bufferViews.size() );
+		tinygltf::BufferView &	v = model.bufferViews.emplace_back();
+		v.buffer = 0;
+		v.byteOffset = binSize;
+		v.byteLength = size_t( t.imageBuf.size() );
+		binSize = ( binSize + v.byteLength + 3 ) & ~( size_t(3) );
+		imageData.push_back( std::move( t.imageBuf ) );
+
+		tinygltf::Image &	img = model.images.emplace_back();
+		img.width = t.width;
+		img.height = t.height;
+		img.component = t.channels;
+		img.bits = 8;
+		img.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		img.bufferView = bufView;
+		img.mimeType = "image/png";
+		t.textureID = int( model.textures.size() );
+		model.textures.emplace_back().source = int( model.images.size() - 1 );
+		if ( t.texCoordMode ) {
+			int	wrapMode = TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE;
+			if ( !( t.texCoordMode & 1 ) )
+				wrapMode = TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT;
+			for ( const auto & j : model.samplers ) {
+				if ( j.wrapS == wrapMode ) {
+					model.textures.back().sampler = int( &j - model.samplers.data() );
+					break;
 				}
 			}
+			if ( model.textures.back().sampler < 0 ) {
+				model.samplers.emplace_back().wrapS = wrapMode;
+				model.samplers.back().wrapT = wrapMode;
+				model.textures.back().sampler = int( model.samplers.size() - 1 );
+			}
 		}
-
-		i = textureMap.emplace( textureMapKey, textureID ).first;
 	}
 
-	switch ( n ) {
-	case 0:
-		mat.pbrMetallicRoughness.baseColorTexture.index = i->second;
-		mat.pbrMetallicRoughness.baseColorTexture.texCoord = texCoordChannel;
-		break;
-	case 1:
-		mat.normalTexture.index = i->second;
-		mat.normalTexture.texCoord = texCoordChannel;
-		break;
-	case 2:
-		mat.pbrMetallicRoughness.metallicRoughnessTexture.index = i->second;
-		mat.pbrMetallicRoughness.metallicRoughnessTexture.texCoord = texCoordChannel;
-		break;
-	case 3:
-		mat.occlusionTexture.index = i->second;
-		mat.occlusionTexture.texCoord = texCoordChannel;
-		break;
-	case 4:
-		mat.emissiveTexture.index = i->second;
-		mat.emissiveTexture.texCoord = texCoordChannel;
-		break;
+	for ( const TextureRef & r : textureRefs ) {
+		int	textureID = textures[r.texture].textureID;
+		tinygltf::Material &	mat = *( r.mat );
+		switch ( r.n ) {
+		case 0:
+			mat.pbrMetallicRoughness.baseColorTexture.index = textureID;
+			mat.pbrMetallicRoughness.baseColorTexture.texCoord = r.texCoordChannel;
+			break;
+		case 1:
+			mat.normalTexture.index = textureID;
+			mat.normalTexture.texCoord = r.texCoordChannel;
+			break;
+		case 2:
+			mat.pbrMetallicRoughness.metallicRoughnessTexture.index = textureID;
+			mat.pbrMetallicRoughness.metallicRoughnessTexture.texCoord = r.texCoordChannel;
+			break;
+		case 3:
+			mat.occlusionTexture.index = textureID;
+			mat.occlusionTexture.texCoord = r.texCoordChannel;
+			break;
+		case 4:
+			mat.emissiveTexture.index = textureID;
+			mat.emissiveTexture.texCoord = r.texCoordChannel;
+			break;
+		}
 	}
 }
 
@@ -887,9 +1074,103 @@ static QString getGltfFolder( const NifModel * nif )
 	return settings.value( "Spells//Extract File/Last File Path", QString() ).toString();
 }
 
+//! Writes the buffer data padded to 4 bytes, without copying it into a single array
+static bool writeGltfBuffer( QIODevice & f, const QByteArray & geometry, const std::vector< QByteArray > & imageData )
+{
+	static const char	padding[4] = { 0, 0, 0, 0 };
+	bool	ok = true;
+	auto	writeData = [&]( const QByteArray & d ) {
+		qsizetype	n = ( -d.size() ) & 3;
+		ok = ok && f.write( d ) == d.size();
+		ok = ok && ( !n || f.write( padding, n ) == n );
+	};
+	writeData( geometry );
+	for ( const auto & d : imageData )
+		writeData( d );
+	return ok;
+}
+
+//! Writes the model to a .gltf file with a separate .bin buffer, or to a binary .glb file
+/*!
+ * Buffer 0 consists of the geometry data followed by the images. It is streamed to the file, and it is
+ * not stored in the tinygltf model.
+ */
+static bool writeGltf( const tinygltf::Model & model, const QString & fileName, bool binary,
+						const QByteArray & geometry, const std::vector< QByteArray > & imageData, size_t binSize )
+{
+	QString	binName = fileName.left( fileName.lastIndexOf( QChar('.') ) ) + ".bin";
+	std::string	binFileName( binName.mid( QDir::fromNativeSeparators( binName ).lastIndexOf( QChar('/') ) + 1 ).toStdString() );
+
+	std::string	json;
+	{
+		// serialize all properties except buffers and images, which are added here
+		tinygltf::detail::JsonDocument	output;
+		tinygltf::SerializeGltfModel( &model, output );
+		if ( binSize ) {
+			tinygltf::detail::json	buffers;
+			tinygltf::detail::JsonReserveArray( buffers, 1 );
+			tinygltf::detail::json	buffer;
+			tinygltf::SerializeNumberProperty( "byteLength", binSize, buffer );
+			if ( !binary )
+				tinygltf::SerializeStringProperty( "uri", binFileName, buffer );
+			tinygltf::SerializeStringProperty( "name", binFileName, buffer );
+			tinygltf::detail::JsonPushBack( buffers, std::move( buffer ) );
+			tinygltf::detail::JsonAddMember( output, "buffers", std::move( buffers ) );
+		}
+		if ( !model.images.empty() ) {
+			tinygltf::detail::json	images;
+			tinygltf::detail::JsonReserveArray( images, model.images.size() );
+			for ( const auto & img : model.images ) {
+				tinygltf::detail::json	image;
+				tinygltf::SerializeGltfImage( img, std::string(), image );
+				tinygltf::detail::JsonPushBack( images, std::move( image ) );
+			}
+			tinygltf::detail::JsonAddMember( output, "images", std::move( images ) );
+		}
+		json = tinygltf::detail::JsonToString( output, ( binary ? -1 : 2 ) );
+	}
+
+	QSaveFile	f( fileName );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return false;
+	bool	ok = true;
+	if ( binary ) {
+		// JSON chunk padded with spaces, followed by the binary chunk
+		while ( json.length() & 3 )
+			json += ' ';
+		size_t	totalSize = 12 + 8 + json.length() + ( binSize ? 8 + binSize : 0 );
+		quint32	header[5] = {
+			0x46546C67, 2, quint32( totalSize ),	// "glTF", version 2
+			quint32( json.length() ), 0x4E4F534A	// "JSON"
+		};
+		for ( auto & v : header )
+			v = qToLittleEndian( v );
+		ok = ( f.write( reinterpret_cast< const char * >( header ), sizeof( header ) ) == qint64( sizeof( header ) ) );
+		ok = ok && f.write( json.c_str(), qint64( json.length() ) ) == qint64( json.length() );
+		if ( binSize ) {
+			quint32	binHeader[2] = { qToLittleEndian( quint32( binSize ) ), qToLittleEndian( quint32( 0x004E4942 ) ) };	// "BIN"
+			ok = ok && f.write( reinterpret_cast< const char * >( binHeader ), sizeof( binHeader ) ) == qint64( sizeof( binHeader ) );
+			ok = ok && writeGltfBuffer( f, geometry, imageData );
+		}
+	} else {
+		ok = ( f.write( json.c_str(), qint64( json.length() ) ) == qint64( json.length() ) );
+		if ( ok && binSize ) {
+			QSaveFile	binFile( binName );
+			ok = binFile.open( QIODevice::WriteOnly ) && writeGltfBuffer( binFile, geometry, imageData ) && binFile.commit();
+		}
+	}
+	if ( !ok ) {
+		f.cancelWriting();
+		return false;
+	}
+	return f.commit();
+}
+
 void exportGltf( const NifModel* nif, const Scene* scene, [[maybe_unused]] const QModelIndex& index )
 {
-	QString filename = QFileDialog::getSaveFileName(qApp->activeWindow(), tr("Choose a .glTF file for export"), getGltfFolder(nif), "glTF (*.gltf)");
+	QString	selectedFilter;
+	QString filename = QFileDialog::getSaveFileName(qApp->activeWindow(), tr("Choose a .glTF file for export"), getGltfFolder(nif),
+													"glTF (*.gltf);;glTF Binary (*.glb)", &selectedFilter);
 	bool	useFullMatPaths;
 	int	textureMipLevel;
 	if ( filename.isEmpty() ) {
@@ -901,12 +1182,12 @@ void exportGltf( const NifModel* nif, const Scene* scene, [[maybe_unused]] const
 		textureMipLevel = settings.value( "Settings/Nif/Gl TF Export Mip Level", 1 ).toInt();
 		textureMipLevel = std::min< int >( std::max< int >( textureMipLevel, -1 ), 15 );
 	}
-	if ( !filename.endsWith( ".gltf", Qt::CaseInsensitive ) )
-		filename.append( ".gltf" );
-
-	QString buffName = filename.left( filename.length() - 5 ) + ".bin";
+	bool	binary = filename.endsWith( ".glb", Qt::CaseInsensitive );
+	if ( !binary && !filename.endsWith( ".gltf", Qt::CaseInsensitive ) ) {
+		binary = selectedFilter.contains( "*.glb" );
+		filename.append( binary ? ".glb" : ".gltf" );
+	}
 
-	tinygltf::TinyGLTF writer;
 	tinygltf::Model model;
 	model.asset.generator = "NifSkope glTF 2.0 Exporter v1.2";
 
@@ -917,10 +1198,8 @@ void exportGltf( const NifModel* nif, const Scene* scene, [[maybe_unused]] const
 	if ( success )
 		success = exportCreateMeshes(nif, scene, model, buffer, gltf);
 	if ( success ) {
-		auto buff = tinygltf::Buffer();
-		buff.name = buffName.mid( QDir::fromNativeSeparators( buffName ).lastIndexOf( QChar('/') ) + 1 ).toStdString();
-		buff.data = std::vector<unsigned char>(buffer.cbegin(), buffer.cend());
-		model.buffers.push_back(buff);
+		size_t	binSize = ( size_t( buffer.size() ) + 3 ) & ~( size_t(3) );
+		std::vector< QByteArray >	imageData;
 
 		ExportGltfMaterials	matExporter( const_cast< NifModel * >(nif), model, textureMipLevel );
 		model.materials.resize( gltf.materials.size() );
@@ -947,8 +1226,10 @@ void exportGltf( const NifModel* nif, const Scene* scene, [[maybe_unused]] const
 
 			matExporter.exportMaterial( mat, name );
 		}
+		matExporter.bakeTextures( imageData, binSize );
 
-		writer.WriteGltfSceneToFile(&model, filename.toStdString(), false, false, true, false);
+		if ( !writeGltf( model, filename, binary, buffer, imageData, binSize ) )
+			gltf.errors << tr("ERROR: Could not write %1").arg( filename );
 	}
 
 	if ( gltf.errors.size() == 1 ) {
@@ -975,18 +1256,50 @@ protected:
 			}
 		}
 	};
+	//! Triangles and vertex attributes of a primitive, converted to the formats used in BSGeometry mesh data
+	struct MeshData {
+		bool	haveTriangles = false;
+		quint32	indicesSize = 0;
+		QVector< Triangle >	triangles;
+		float	scale = 1.0f / 64.0f;
+		QVector< ShortVector3 >	vertices;
+		QVector< HalfVector2 >	uvs[2];
+		QVector< UDecVector4 >	normals;
+		QVector< UDecVector4 >	tangents;
+		QVector< ByteColor4BGRA >	colors;
+		std::vector< BoneWeights >	boneWeights;
+		size_t	weightsPerVertex = 0;
+	};
 	const tinygltf::Model &	model;
 	NifModel *	nif;
 	bool	lodEnabled;
 	bool	scaleWarningFlag;
 	std::vector< int >	nodeStack;
+	//! Decoded primitives that are still used by nodes not loaded yet
+	std::unordered_map< const tinygltf::Primitive *, MeshData >	meshData;
+	//! Number of nodes not loaded yet that use each primitive
+	std::unordered_map< const tinygltf::Primitive *, size_t >	primitiveUses;
+	//! Primitives in the order of their first use, and the next one to be decoded
+	std::vector< const tinygltf::Primitive * >	primitiveOrder;
+	size_t	nextPrimitive = 0;
 	bool nodeHasMeshes( const tinygltf::Node & node, int d = 0 ) const;
 	static void normalizeFloats( float * p, size_t n, int dataType );
-	template< typename T > bool loadBuffer( std::vector< T > & outBuf, int accessor, int typeRequired );
+	template< typename T, typename S >
+	static void convertComponents( T * dst, const unsigned char * src, size_t blockCnt, size_t blockSize, int componentCnt );
+	template< typename T > bool loadBuffer( std::vector< T > & outBuf, int accessor, int typeRequired ) const;
+	//! Converts the accessors of a primitive to mesh data, this is thread safe
+	void decodePrimitive( MeshData & d, const tinygltf::Primitive & p ) const;
+	bool isTrianglePrimitive( const tinygltf::Primitive & p ) const;
+	//! Counts the uses of the triangle primitives by a node and its children, in the order loadNode() loads them
+	void findPrimitives( int nodeNum );
+	//! Returns the decoded data of a primitive, the next primitives in the order of use are decoded in parallel if needed
+	const MeshData * getMeshData( const tinygltf::Primitive & p );
+	//! Frees the data of a primitive after it has been loaded by its last node
+	void releaseMeshData( const tinygltf::Primitive & p );
 	void applyXYZScale( Transform & t, const Vector3 & scale );
 	void loadSkin( const QPersistentModelIndex & index, const tinygltf::Skin & skin );
-	int loadTriangles( const QModelIndex & index, const tinygltf::Primitive & p );
-	void loadSkinnedLODMesh( const QPersistentModelIndex & index, const tinygltf::Primitive & p, int lod );
+	int loadTriangles( const QModelIndex & index, const MeshData & d );
+	void loadSkinnedLODMesh( const QPersistentModelIndex & index, const MeshData & d, int lod );
 	// Returns true if tangent space needs to be calculated
 	bool loadMesh(
 		const QPersistentModelIndex & index, std::string & materialPath, const tinygltf::Primitive & p,
@@ -1044,7 +1357,26 @@ void ImportGltf::normalizeFloats( float * p, size_t n, int dataType )
 		*p = *p / scale;
 }
 
-template< typename T > bool ImportGltf::loadBuffer( std::vector< T > & outBuf, int accessor, int typeRequired )
+template< typename T, typename S > void ImportGltf::convertComponents(
+	T * dst, const unsigned char * src, size_t blockCnt, size_t blockSize, int componentCnt )
+{
+	if constexpr ( std::is_same_v< T, S > ) {
+		if ( blockSize == sizeof( S ) * size_t( componentCnt ) ) {
+			// tightly packed data of the same type
+			std::memcpy( dst, src, blockCnt * blockSize );
+			return;
+		}
+	}
+	for ( size_t i = 0; i < blockCnt; i++, src = src + blockSize ) {
+		for ( int j = 0; j < componentCnt; j++ ) {
+			S	tmp;
+			std::memcpy( &tmp, src + ( size_t(j) * sizeof( S ) ), sizeof( S ) );
+			*( dst++ ) = static_cast< T >( tmp );
+		}
+	}
+}
+
+template< typename T > bool ImportGltf::loadBuffer( std::vector< T > & outBuf, int accessor, int typeRequired ) const
 {
 	if ( accessor < 0 || size_t(accessor) >= model.accessors.size() )
 		return false;
@@ -1060,63 +1392,269 @@ template< typename T > bool ImportGltf::loadBuffer( std::vector< T > & outBuf, i
 	int	componentCnt = tinygltf::GetNumComponentsInType( std::uint32_t(a.type) );
 	if ( a.type != typeRequired || componentSize < 1 || componentCnt < 1 )
 		return false;
-	int	blockSize = std::max< int >( componentSize * componentCnt, v.byteStride );
+	size_t	elementSize = size_t( componentSize ) * size_t( componentCnt );
+	size_t	blockSize = std::max< size_t >( elementSize, size_t( v.byteStride ) );
 
 	size_t	offset = a.byteOffset + v.byteOffset;
-	if ( std::max( std::max( a.byteOffset, v.byteOffset ), std::max( offset, offset + v.byteLength ) ) > b.data.size() )
+	if ( std::max( std::max( a.byteOffset, v.byteOffset ), std::max( offset, v.byteOffset + v.byteLength ) ) > b.data.size() )
 		return false;
-	size_t	blockCnt = v.byteLength / size_t( blockSize );
-	if ( blockCnt < 1 )
-		return ( v.byteLength < 1 );
+	// number of elements, limited to those that fit in the buffer view
+	size_t	blockCnt = a.count;
+	if ( a.byteOffset > v.byteLength || ( v.byteLength - a.byteOffset ) < elementSize )
+		blockCnt = 0;
+	else
+		blockCnt = std::min( blockCnt, ( v.byteLength - a.byteOffset - elementSize ) / blockSize + 1 );
+	if ( blockCnt < 1 ) {
+		outBuf.clear();
+		return ( a.count < 1 );
+	}
 
-	FileBuffer	inBuf( b.data.data() + offset, v.byteLength );
 	outBuf.resize( blockCnt * size_t( componentCnt ) );
+	T *	dst = outBuf.data();
+	const unsigned char *	src = b.data.data() + offset;
+	switch ( a.componentType ) {
+	case TINYGLTF_COMPONENT_TYPE_BYTE:
+		convertComponents< T, std::int8_t >( dst, src, blockCnt, blockSize, componentCnt );
+		break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+		convertComponents< T, std::uint8_t >( dst, src, blockCnt, blockSize, componentCnt );
+		break;
+	case TINYGLTF_COMPONENT_TYPE_SHORT:
+		convertComponents< T, std::int16_t >( dst, src, blockCnt, blockSize, componentCnt );
+		break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		convertComponents< T, std::uint16_t >( dst, src, blockCnt, blockSize, componentCnt );
+		break;
+	case TINYGLTF_COMPONENT_TYPE_INT:
+		convertComponents< T, std::int32_t >( dst, src, blockCnt, blockSize, componentCnt );
+		break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+		convertComponents< T, std::uint32_t >( dst, src, blockCnt, blockSize, componentCnt );
+		break;
+	case TINYGLTF_COMPONENT_TYPE_FLOAT:
+		convertComponents< T, float >( dst, src, blockCnt, blockSize, componentCnt );
+		break;
+	case TINYGLTF_COMPONENT_TYPE_DOUBLE:
+		convertComponents< T, double >( dst, src, blockCnt, blockSize, componentCnt );
+		break;
+	default:
+		std::fill( outBuf.begin(), outBuf.end(), static_cast< T >( 0 ) );
+		break;
+	}
+	if ( sizeof(T) == sizeof(float) && T(0.1f) != T(0.0f) )
+		normalizeFloats( reinterpret_cast< float * >(outBuf.data()), outBuf.size(), a.componentType );
 
-	size_t	k = 0;
-	int	t = a.componentType;
-	for ( size_t i = 0; i < blockCnt; i++ ) {
-		inBuf.setPosition( i * size_t( blockSize ) );
-		const unsigned char *	readPtr = inBuf.getReadPtr();
-		for ( int j = 0; j < componentCnt; j++, k++, readPtr = readPtr + componentSize ) {
-			switch ( t ) {
-			case TINYGLTF_COMPONENT_TYPE_BYTE:
-				outBuf[k] = static_cast< T >( *( reinterpret_cast< const signed char * >(readPtr) ) );
-				break;
-			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-				outBuf[k] = static_cast< T >( *readPtr );
-				break;
-			case TINYGLTF_COMPONENT_TYPE_SHORT:
-				outBuf[k] = static_cast< T >( std::int16_t( FileBuffer::readUInt16Fast(readPtr) ) );
-				break;
-			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-				outBuf[k] = static_cast< T >( FileBuffer::readUInt16Fast(readPtr) );
-				break;
-			case TINYGLTF_COMPONENT_TYPE_INT:
-				outBuf[k] = static_cast< T >( std::int32_t( FileBuffer::readUInt32Fast(readPtr) ) );
-				break;
-			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-				outBuf[k] = static_cast< T >( FileBuffer::readUInt32Fast(readPtr) );
-				break;
-			case TINYGLTF_COMPONENT_TYPE_FLOAT:
-#if defined(__i386__) || defined(__x86_64__) || defined(__x86_64)
-				outBuf[k] = static_cast< T >( std::bit_cast< float >( FileBuffer::readUInt32Fast(readPtr) ) );
-#else
-				outBuf[k] = static_cast< T >( inBuf.readFloat() );
-#endif
-				break;
-			case TINYGLTF_COMPONENT_TYPE_DOUBLE:
-				outBuf[k] = static_cast< T >( std::bit_cast< double >( FileBuffer::readUInt64Fast(readPtr) ) );
-				break;
-			default:
-				outBuf[k] = static_cast< T >( 0 );
+	return true;
+}
+
+void ImportGltf::decodePrimitive( MeshData & d, const tinygltf::Primitive & p ) const
+{
+	{
+		std::vector< std::uint16_t >	indices;
+		if ( !loadBuffer< std::uint16_t >( indices, p.indices, TINYGLTF_TYPE_SCALAR ) )
+			return;
+		d.haveTriangles = true;
+		d.indicesSize = quint32( indices.size() );
+		qsizetype	numTriangles = qsizetype( indices.size() / 3 );
+		d.triangles.resize( numTriangles );
+		for ( qsizetype i = 0; i < numTriangles; i++ )
+			d.triangles[i] = Triangle( indices[i * 3], indices[i * 3 + 1], indices[i * 3 + 2] );
+	}
+
+	std::vector< float >	buf;
+	for ( const auto & i : p.attributes ) {
+		if ( i.first == "POSITION" ) {
+			if ( !loadBuffer< float >( buf, i.second, TINYGLTF_TYPE_VEC3 ) )
+				continue;
+			qsizetype	numVerts = qsizetype( buf.size() / 3 );
+			if ( !numVerts )
+				continue;
+			float	maxPos = 0.0f;
+			for ( float x : buf )
+				maxPos = std::max( maxPos, float( std::fabs(x) ) );
+			float	scale = 1.0f / 64.0f;
+			while ( maxPos > scale && scale < 16777216.0f )
+				scale = scale + scale;
+			float	invScale = 1.0f / scale;
+			d.scale = scale;
+			d.vertices.resize( numVerts );
+			for ( qsizetype j = 0; j < numVerts; j++ ) {
+				d.vertices[j][0] = buf[j * 3] * invScale;
+				d.vertices[j][1] = buf[j * 3 + 1] * invScale;
+				d.vertices[j][2] = buf[j * 3 + 2] * invScale;
+			}
+		} else if ( i.first == "TEXCOORD_0" || i.first == "TEXCOORD_1" ) {
+			if ( !loadBuffer< float >( buf, i.second, TINYGLTF_TYPE_VEC2 ) )
+				continue;
+			qsizetype	numUVs = qsizetype( buf.size() >> 1 );
+			QVector< HalfVector2 > &	uvs = d.uvs[ ( i.first.c_str()[9] != '0' ? 1 : 0 ) ];
+			uvs.resize( numUVs );
+			for ( qsizetype j = 0; j < numUVs; j++ ) {
+				uvs[j][0] = buf[j * 2];
+				uvs[j][1] = buf[j * 2 + 1];
+			}
+		} else if ( i.first == "NORMAL" ) {
+			if ( !loadBuffer< float >( buf, i.second, TINYGLTF_TYPE_VEC3 ) )
+				continue;
+			qsizetype	numNormals = qsizetype( buf.size() / 3 );
+			d.normals.resize( numNormals );
+			for ( qsizetype j = 0; j < numNormals; j++ ) {
+				auto	normal = FloatVector4::convertVector3( buf.data() + (j * 3) );
+				float	r = normal.dotProduct3( normal );
+				if ( r > 0.0f ) [[likely]] {
+					normal /= float( std::sqrt( r ) );
+					normal[3] = -1.0f / 3.0f;
+				} else {
+					normal = FloatVector4( 0.0f, 0.0f, 1.0f, -1.0f / 3.0f );
+				}
+				normal.convertToFloats( &(d.normals[j][0]) );
+			}
+		} else if ( i.first == "TANGENT" ) {
+			if ( !loadBuffer< float >( buf, i.second, TINYGLTF_TYPE_VEC4 ) )
+				continue;
+			qsizetype	numTangents = qsizetype( buf.size() >> 2 );
+			d.tangents.resize( numTangents );
+			for ( qsizetype j = 0; j < numTangents; j++ ) {
+				FloatVector4	tangent( buf.data() + (j * 4) );
+				float	r = tangent.dotProduct3( tangent );
+				if ( r > 0.0f ) [[likely]] {
+					tangent /= float( std::sqrt( r ) );
+					tangent[3] = ( tangent[3] < 0.0f ? 1.0f : -1.0f );
+				} else {
+					tangent = FloatVector4( 1.0f, 0.0f, 0.0f, -1.0f );
+				}
+				tangent.convertToFloats( &(d.tangents[j][0]) );
+			}
+		} else if ( i.first == "COLOR_0" ) {
+			bool	haveAlpha = loadBuffer< float >( buf, i.second, TINYGLTF_TYPE_VEC4 );
+			if ( !haveAlpha && !loadBuffer< float >( buf, i.second, TINYGLTF_TYPE_VEC3 ) )
+				continue;
+			size_t	componentCnt = ( !haveAlpha ? 3 : 4 );
+			qsizetype	numColors = qsizetype( buf.size() / componentCnt );
+			d.colors.resize( numColors );
+			const float *	q = buf.data();
+			for ( qsizetype j = 0; j < numColors; j++, q = q + componentCnt ) {
+				FloatVector4	color;
+				if ( !haveAlpha )
+					color = FloatVector4::convertVector3( q ).blendValues( FloatVector4(1.0f), 0x08 );
+				else
+					color = FloatVector4( q );
+				color.maxValues( FloatVector4(0.0f) ).minValues( FloatVector4(1.0f) );
+				color.convertToFloats( &(d.colors[j][0]) );
+			}
+		} else if ( i.first == "WEIGHTS_0" || i.first == "WEIGHTS_1" ) {
+			if ( !loadBuffer< float >( buf, i.second, TINYGLTF_TYPE_VEC4 ) )
+				continue;
+			size_t	numWeights = buf.size() >> 2;
+			if ( numWeights > d.boneWeights.size() )
+				d.boneWeights.resize( numWeights );
+			size_t	offs = ( i.first.c_str()[8] == '0' ? 0 : 4 );
+			for ( size_t j = 0; j < numWeights; j++ ) {
+				FloatVector4	w( buf.data() + (j * 4) );
+				w.maxValues( FloatVector4(0.0f) ).minValues( FloatVector4(1.0f) );
+				w *= 65535.0f;
+				w.roundValues();
+				d.boneWeights[j].weights[offs] = std::uint16_t( w[0] );
+				d.boneWeights[j].weights[offs + 1] = std::uint16_t( w[1] );
+				d.boneWeights[j].weights[offs + 2] = std::uint16_t( w[2] );
+				d.boneWeights[j].weights[offs + 3] = std::uint16_t( w[3] );
+			}
+		} else if ( i.first == "JOINTS_0" || i.first == "JOINTS_1" ) {
+			std::vector< std::uint16_t >	joints;
+			if ( !loadBuffer< std::uint16_t >( joints, i.second, TINYGLTF_TYPE_VEC4 ) )
+				continue;
+			size_t	numJoints = joints.size() >> 2;
+			if ( numJoints > d.boneWeights.size() )
+				d.boneWeights.resize( numJoints );
+			size_t	offs = ( i.first.c_str()[7] == '0' ? 0 : 4 );
+			for ( size_t j = 0; j < numJoints; j++ ) {
+				for ( size_t k = 0; k < 4; k++ )
+					d.boneWeights[j].joints[offs + k] = joints[j * 4 + k];
+			}
+		}
+	}
+
+	for ( const auto & bw : d.boneWeights ) {
+		for ( size_t i = 8; i > d.weightsPerVertex; i-- ) {
+			if ( bw.weights[i - 1] != 0 ) {
+				d.weightsPerVertex = i;
 				break;
 			}
 		}
 	}
-	if ( sizeof(T) == sizeof(float) && T(0.1f) != T(0.0f) )
-		normalizeFloats( reinterpret_cast< float * >(outBuf.data()), outBuf.size(), a.componentType );
+}
 
-	return true;
+bool ImportGltf::isTrianglePrimitive( const tinygltf::Primitive & p ) const
+{
+	if ( p.mode != TINYGLTF_MODE_TRIANGLES || p.attributes.empty() )
+		return false;
+	return ( p.indices >= 0 && size_t(p.indices) < model.accessors.size() );
+}
+
+void ImportGltf::findPrimitives( int nodeNum )
+{
+	if ( nodeNum < 0 || size_t(nodeNum) >= model.nodes.size() || !nodeHasMeshes( model.nodes[nodeNum] ) )
+		return;
+	const tinygltf::Node &	node = model.nodes[nodeNum];
+
+	for ( int i : nodeStack ) {
+		if ( i == nodeNum )
+			return;
+	}
+
+	if ( node.mesh >= 0 && size_t(node.mesh) < model.meshes.size() ) {
+		for ( const auto & p : model.meshes[node.mesh].primitives ) {
+			if ( isTrianglePrimitive( p ) && primitiveUses[&p]++ == 0 )
+				primitiveOrder.push_back( &p );
+		}
+		return;
+	}
+
+	nodeStack.push_back( nodeNum );
+	for ( int i : node.children )
+		findPrimitives( i );
+	nodeStack.pop_back();
+}
+
+const ImportGltf::MeshData * ImportGltf::getMeshData( const tinygltf::Primitive & p )
+{
+	if ( auto i = meshData.find( &p ); i != meshData.end() )
+		return &( i->second );
+	if ( !primitiveUses.contains( &p ) )
+		return nullptr;
+
+	// decode a batch of the primitives used next, this limits the memory usage to the batch and
+	// the primitives still needed by nodes that are not loaded yet
+	size_t	batchSize = std::max< size_t >( std::thread::hardware_concurrency(), 1 ) * 2;
+	std::vector< const tinygltf::Primitive * >	batch;
+	bool	found = false;
+	for ( ; nextPrimitive < primitiveOrder.size() && batch.size() < batchSize; nextPrimitive++ ) {
+		const tinygltf::Primitive *	q = primitiveOrder[nextPrimitive];
+		if ( !meshData.contains( q ) ) {
+			batch.push_back( q );
+			found = found || ( q == &p );
+		}
+	}
+	if ( !found )
+		batch.push_back( &p );
+
+	std::vector< MeshData >	decodedData( batch.size() );
+	parallelFor( batch.size(), [&]( size_t i ) {
+		decodePrimitive( decodedData[i], *( batch[i] ) );
+	} );
+	for ( size_t i = 0; i < batch.size(); i++ )
+		meshData.emplace( batch[i], std::move( decodedData[i] ) );
+
+	return &( meshData.at( &p ) );
+}
+
+void ImportGltf::releaseMeshData( const tinygltf::Primitive & p )
+{
+	auto	i = primitiveUses.find( &p );
+	if ( i == primitiveUses.end() || --( i->second ) > 0 )
+		return;
+	primitiveUses.erase( i );
+	meshData.erase( &p );
 }
 
 void ImportGltf::applyXYZScale( Transform & t, const Vector3 & scale )
@@ -1230,31 +1768,22 @@ void ImportGltf::loadSkin( const QPersistentModelIndex & index, const tinygltf::
 	}
 }
 
-int ImportGltf::loadTriangles( const QModelIndex & index, const tinygltf::Primitive & p )
+int ImportGltf::loadTriangles( const QModelIndex & index, const MeshData & d )
 {
-	std::vector< std::uint16_t >	indices;
-	if ( !loadBuffer< std::uint16_t >( indices, p.indices, TINYGLTF_TYPE_SCALAR ) )
+	if ( !d.haveTriangles )
 		return -1;
 
-	int	numTriangles = int( indices.size() / 3 );
-	nif->set<quint32>( index, "Indices Size", quint32(indices.size()) );
+	nif->set<quint32>( index, "Indices Size", d.indicesSize );
 	auto	iTriangles = nif->getIndex( index, "Triangles" );
 	if ( iTriangles.isValid() ) {
 		nif->updateArraySize( iTriangles );
-		QVector< Triangle >	triangles;
-		triangles.resize( numTriangles );
-		for ( qsizetype i = 0; i < numTriangles; i++ ) {
-			triangles[i][0] = indices[i * 3];
-			triangles[i][1] = indices[i * 3 + 1];
-			triangles[i][2] = indices[i * 3 + 2];
-		}
-		nif->setArray<Triangle>( iTriangles, triangles );
+		nif->setArray<Triangle>( iTriangles, d.triangles );
 	}
 
-	return numTriangles;
+	return int( d.triangles.size() );
 }
 
-void ImportGltf::loadSkinnedLODMesh( const QPersistentModelIndex & index, const tinygltf::Primitive & p, int lod )
+void ImportGltf::loadSkinnedLODMesh( const QPersistentModelIndex & index, const MeshData & d, int lod )
 {
 	auto	iMeshes = nif->getIndex( index, "Meshes" );
 	if ( !iMeshes.isValid() )
@@ -1268,34 +1797,13 @@ void ImportGltf::loadSkinnedLODMesh( const QPersistentModelIndex & index, const
 	if ( !iMeshData.isValid() )
 		return;
 
-	std::uint32_t	numVerts = nif->get<quint32>( iMeshData, "Num Verts" );
-	bool	invalidAttrSize = false;
-	for ( const auto & i : p.attributes ) {
-		std::vector< float >	attrBuf;
-		if ( i.first == "POSITION" || i.first == "NORMAL" ) {
-			if ( !loadBuffer< float >( attrBuf, i.second, TINYGLTF_TYPE_VEC3 ) )
-				continue;
-			if ( !attrBuf.empty() && attrBuf.size() != ( size_t(numVerts) * 3 ) ) {
-				invalidAttrSize = true;
-				break;
-			}
-		} else if ( i.first == "TEXCOORD_0" || i.first == "TEXCOORD_1" ) {
-			if ( !loadBuffer< float >( attrBuf, i.second, TINYGLTF_TYPE_VEC2 ) )
-				continue;
-			if ( !attrBuf.empty() && attrBuf.size() != ( size_t(numVerts) << 1 ) ) {
-				invalidAttrSize = true;
-				break;
-			}
-		} else if ( i.first == "TANGENT" || i.first == "COLOR_0" ) {
-			if ( !loadBuffer< float >( attrBuf, i.second, TINYGLTF_TYPE_VEC4 ) )
-				continue;
-			if ( !attrBuf.empty() && attrBuf.size() != ( size_t(numVerts) << 2 ) ) {
-				invalidAttrSize = true;
-				break;
-			}
-		}
-	}
-	if ( invalidAttrSize ) {
+	qsizetype	numVerts = qsizetype( nif->get<quint32>( iMeshData, "Num Verts" ) );
+	auto	invalidAttrSize = [numVerts]( qsizetype n ) {
+		return ( n != 0 && n != numVerts );
+	};
+	if ( invalidAttrSize( d.vertices.size() ) || invalidAttrSize( d.normals.size() )
+		|| invalidAttrSize( d.uvs[0].size() ) || invalidAttrSize( d.uvs[1].size() )
+		|| invalidAttrSize( d.tangents.size() ) || invalidAttrSize( d.colors.size() ) ) {
 		QMessageBox::warning( nullptr, "NifSkope warning", QString("LOD%1 mesh has inconsistent vertex count with LOD0").arg(lod) );
 		return;
 	}
@@ -1311,14 +1819,19 @@ void ImportGltf::loadSkinnedLODMesh( const QPersistentModelIndex & index, const
 	nif->updateArraySize( iLODMesh );
 	iLODMesh = nif->getIndex( iLODMesh, lod - 1 );
 	if ( iLODMesh.isValid() )
-		(void) loadTriangles( iLODMesh, p );
+		(void) loadTriangles( iLODMesh, d );
 }
 
 bool ImportGltf::loadMesh(
 	const QPersistentModelIndex & index, std::string & materialPath, const tinygltf::Primitive & p, int lod, int skin )
 {
+	const MeshData *	dataPtr = getMeshData( p );
+	if ( !dataPtr )
+		return false;
+	const MeshData &	d = *dataPtr;
+
 	if ( lod > 0 && skin >= 0 && size_t(skin) < model.skins.size() ) {
-		loadSkinnedLODMesh( index, p, lod );
+		loadSkinnedLODMesh( index, d, lod );
 		return false;
 	}
 
@@ -1353,7 +1866,7 @@ bool ImportGltf::loadMesh(
 	nif->set<quint32>( iMesh, "Flags", 64 );
 	nif->set<quint32>( iMeshData, "Version", 2 );
 
-	int	numTriangles = loadTriangles( iMeshData, p );
+	int	numTriangles = loadTriangles( iMeshData, d );
 	if ( numTriangles < 0 )
 		return false;
 	nif->set<quint32>( iMesh, "Indices Size", quint32(numTriangles) * 3U );
@@ -1361,195 +1874,72 @@ bool ImportGltf::loadMesh(
 	if ( skin >= 0 && size_t(skin) < model.skins.size() )
 		loadSkin( index, model.skins[skin] );
 
-	std::vector< BoneWeights >	boneWeights;
+	if ( !d.vertices.isEmpty() ) {
+		quint32	numVerts = quint32( d.vertices.size() );
+		nif->set<float>( iMeshData, "Scale", d.scale );
+		nif->set<quint32>( iMeshData, "Num Verts", numVerts );
+		nif->set<quint32>( iMesh, "Num Verts", numVerts );
+		auto	iVertices = nif->getIndex( iMeshData, "Vertices" );
+		if ( iVertices.isValid() ) {
+			nif->updateArraySize( iVertices );
+			nif->setArray<ShortVector3>( iVertices, d.vertices );
+		}
+	}
 
-	for ( const auto & i : p.attributes ) {
-		if ( i.first == "POSITION" ) {
-			std::vector< float >	positions;
-			if ( !loadBuffer< float >( positions, i.second, TINYGLTF_TYPE_VEC3 ) )
-				continue;
-			std::uint32_t	numVerts = std::uint32_t( positions.size() / 3 );
-			if ( !numVerts )
-				continue;
-			float	maxPos = 0.0f;
-			for ( float x : positions )
-				maxPos = std::max( maxPos, float( std::fabs(x) ) );
-			float	scale = 1.0f / 64.0f;
-			while ( maxPos > scale && scale < 16777216.0f )
-				scale = scale + scale;
-			float	invScale = 1.0f / scale;
-			nif->set<float>( iMeshData, "Scale", scale );
-			nif->set<quint32>( iMeshData, "Num Verts", numVerts );
-			nif->set<quint32>( iMesh, "Num Verts", numVerts );
-			auto	iVertices = nif->getIndex( iMeshData, "Vertices" );
-			if ( iVertices.isValid() ) {
-				nif->updateArraySize( iVertices );
-				QVector< ShortVector3 >	vertices;
-				vertices.resize( qsizetype(numVerts) );
-				for ( qsizetype j = 0; j < qsizetype(numVerts); j++ ) {
-					vertices[j][0] = positions[j * 3] * invScale;
-					vertices[j][1] = positions[j * 3 + 1] * invScale;
-					vertices[j][2] = positions[j * 3 + 2] * invScale;
-				}
-				nif->setArray<ShortVector3>( iVertices, vertices );
-			}
-		} else if ( i.first == "TEXCOORD_0" || i.first == "TEXCOORD_1" ) {
-			std::vector< float >	uvs;
-			if ( !loadBuffer< float >( uvs, i.second, TINYGLTF_TYPE_VEC2 ) )
-				continue;
-			std::uint32_t	numUVs = std::uint32_t( uvs.size() >> 1 );
-			if ( !numUVs )
-				continue;
-			bool	isUV2 = ( i.first.c_str()[9] != '0' );
-			nif->set<quint32>( iMeshData, ( !isUV2 ? "Num UVs" : "Num UVs 2" ), numUVs );
-			auto	iUVs = nif->getIndex( iMeshData, ( !isUV2 ? "UVs" : "UVs 2" ) );
-			if ( iUVs.isValid() ) {
-				nif->updateArraySize( iUVs );
-				QVector< HalfVector2 >	uvsVec2;
-				uvsVec2.resize( qsizetype(numUVs) );
-				for ( qsizetype j = 0; j < qsizetype(numUVs); j++ ) {
-					uvsVec2[j][0] = uvs[j * 2];
-					uvsVec2[j][1] = uvs[j * 2 + 1];
-				}
-				nif->setArray<HalfVector2>( iUVs, uvsVec2 );
-			}
-		} else if ( i.first == "NORMAL" ) {
-			std::vector< float >	normals;
-			if ( !loadBuffer< float >( normals, i.second, TINYGLTF_TYPE_VEC3 ) )
-				continue;
-			std::uint32_t	numNormals = std::uint32_t( normals.size() / 3 );
-			if ( !numNormals )
-				continue;
-			nif->set<quint32>( iMeshData, "Num Normals", numNormals );
-			auto	iNormals = nif->getIndex( iMeshData, "Normals" );
-			if ( iNormals.isValid() ) {
-				nif->updateArraySize( iNormals );
-				QVector< UDecVector4 >	normalsVec4;
-				normalsVec4.resize( qsizetype(numNormals) );
-				for ( qsizetype j = 0; j < qsizetype(numNormals); j++ ) {
-					auto	normal = FloatVector4::convertVector3( normals.data() + (j * 3) );
-					float	r = normal.dotProduct3( normal );
-					if ( r > 0.0f ) [[likely]] {
-						normal /= float( std::sqrt( r ) );
-						normal[3] = -1.0f / 3.0f;
-					} else {
-						normal = FloatVector4( 0.0f, 0.0f, 1.0f, -1.0f / 3.0f );
-					}
-					normal.convertToFloats( &(normalsVec4[j][0]) );
-				}
-				nif->setArray<UDecVector4>( iNormals, normalsVec4 );
-			}
-		} else if ( i.first == "TANGENT" ) {
-			std::vector< float >	tangents;
-			if ( !loadBuffer< float >( tangents, i.second, TINYGLTF_TYPE_VEC4 ) )
-				continue;
-			std::uint32_t	numTangents = std::uint32_t( tangents.size() >> 2 );
-			if ( !numTangents )
-				continue;
-			nif->set<quint32>( iMeshData, "Num Tangents", numTangents );
-			auto	iTangents = nif->getIndex( iMeshData, "Tangents" );
-			if ( iTangents.isValid() ) {
-				nif->updateArraySize( iTangents );
-				QVector< UDecVector4 >	tangentsVec4;
-				tangentsVec4.resize( qsizetype(numTangents) );
-				for ( qsizetype j = 0; j < qsizetype(numTangents); j++ ) {
-					FloatVector4	tangent( tangents.data() + (j * 4) );
-					float	r = tangent.dotProduct3( tangent );
-					if ( r > 0.0f ) [[likely]] {
-						tangent /= float( std::sqrt( r ) );
-						tangent[3] = ( tangent[3] < 0.0f ? 1.0f : -1.0f );
-					} else {
-						tangent = FloatVector4( 1.0f, 0.0f, 0.0f, -1.0f );
-					}
-					tangent.convertToFloats( &(tangentsVec4[j][0]) );
-				}
-				nif->setArray<UDecVector4>( iTangents, tangentsVec4 );
-			}
-		} else if ( i.first == "COLOR_0" ) {
-			std::vector< float >	colors;
-			bool	haveAlpha = loadBuffer< float >( colors, i.second, TINYGLTF_TYPE_VEC4 );
-			if ( !haveAlpha && !loadBuffer< float >( colors, i.second, TINYGLTF_TYPE_VEC3 ) )
-				continue;
-			size_t	componentCnt = ( !haveAlpha ? 3 : 4 );
-			std::uint32_t	numColors = std::uint32_t( colors.size() / componentCnt );
-			if ( !numColors )
-				continue;
-			nif->set<quint32>( iMeshData, "Num Vertex Colors", numColors );
-			auto	iColors = nif->getIndex( iMeshData, "Vertex Colors" );
-			if ( iColors.isValid() ) {
-				nif->updateArraySize( iColors );
-				QVector< ByteColor4BGRA >	colorsVec4;
-				colorsVec4.resize( qsizetype(numColors) );
-				const float *	q = colors.data();
-				for ( size_t j = 0; j < numColors; j++, q = q + componentCnt ) {
-					FloatVector4	color;
-					if ( !haveAlpha )
-						color = FloatVector4::convertVector3( q ).blendValues( FloatVector4(1.0f), 0x08 );
-					else
-						color = FloatVector4( q );
-					color.maxValues( FloatVector4(0.0f) ).minValues( FloatVector4(1.0f) );
-					color.convertToFloats( &(colorsVec4[qsizetype(j)][0]) );
-				}
-				nif->setArray<ByteColor4BGRA>( iColors, colorsVec4 );
-			}
-		} else if ( i.first == "WEIGHTS_0" || i.first == "WEIGHTS_1" ) {
-			std::vector< float >	weights;
-			if ( !loadBuffer< float >( weights, i.second, TINYGLTF_TYPE_VEC4 ) )
-				continue;
-			size_t	numWeights = weights.size() >> 2;
-			if ( numWeights > boneWeights.size() )
-				boneWeights.resize( numWeights );
-			size_t	offs = ( i.first.c_str()[8] == '0' ? 0 : 4 );
-			for ( size_t j = 0; j < numWeights; j++ ) {
-				FloatVector4	w( weights.data() + (j * 4) );
-				w.maxValues( FloatVector4(0.0f) ).minValues( FloatVector4(1.0f) );
-				w *= 65535.0f;
-				w.roundValues();
-				boneWeights[j].weights[offs] = std::uint16_t( w[0] );
-				boneWeights[j].weights[offs + 1] = std::uint16_t( w[1] );
-				boneWeights[j].weights[offs + 2] = std::uint16_t( w[2] );
-				boneWeights[j].weights[offs + 3] = std::uint16_t( w[3] );
-			}
-		} else if ( i.first == "JOINTS_0" || i.first == "JOINTS_1" ) {
-			std::vector< std::uint16_t >	joints;
-			if ( !loadBuffer< std::uint16_t >( joints, i.second, TINYGLTF_TYPE_VEC4 ) )
-				continue;
-			size_t	numJoints = joints.size() >> 2;
-			if ( numJoints > boneWeights.size() )
-				boneWeights.resize( numJoints );
-			size_t	offs = ( i.first.c_str()[7] == '0' ? 0 : 4 );
-			for ( size_t j = 0; j < numJoints; j++ ) {
-				for ( size_t k = 0; k < 4; k++ )
-					boneWeights[j].joints[offs + k] = joints[j * 4 + k];
-			}
+	for ( int j = 0; j < 2; j++ ) {
+		if ( d.uvs[j].isEmpty() )
+			continue;
+		nif->set<quint32>( iMeshData, ( !j ? "Num UVs" : "Num UVs 2" ), quint32( d.uvs[j].size() ) );
+		auto	iUVs = nif->getIndex( iMeshData, ( !j ? "UVs" : "UVs 2" ) );
+		if ( iUVs.isValid() ) {
+			nif->updateArraySize( iUVs );
+			nif->setArray<HalfVector2>( iUVs, d.uvs[j] );
 		}
 	}
 
-	if ( !boneWeights.empty() ) {
-		size_t	weightsPerVertex = 0;
-		for ( const auto & bw : boneWeights ) {
-			for ( size_t i = 8; i > 0; i-- ) {
-				if ( bw.weights[i - 1] != 0 ) {
-					weightsPerVertex = std::max( weightsPerVertex, i );
-					break;
-				}
-			}
+	if ( !d.normals.isEmpty() ) {
+		nif->set<quint32>( iMeshData, "Num Normals", quint32( d.normals.size() ) );
+		auto	iNormals = nif->getIndex( iMeshData, "Normals" );
+		if ( iNormals.isValid() ) {
+			nif->updateArraySize( iNormals );
+			nif->setArray<UDecVector4>( iNormals, d.normals );
 		}
-		if ( weightsPerVertex > 0 ) {
-			size_t	numWeights = boneWeights.size() * weightsPerVertex;
-			nif->set<quint32>( iMeshData, "Weights Per Vertex", quint32(weightsPerVertex) );
-			nif->set<quint32>( iMeshData, "Num Weights", quint32(numWeights) );
-			auto	iWeights = nif->getIndex( iMeshData, "Weights" );
-			if ( iWeights.isValid() ) {
-				nif->updateArraySize( iWeights );
-				NifItem *	weightsItem = nif->getItem( iWeights );
-				for ( size_t i = 0; weightsItem && i < boneWeights.size(); i++ ) {
-					for ( size_t j = 0; j < weightsPerVertex; j++ ) {
-						auto	weightItem = weightsItem->child( int(i * weightsPerVertex + j) );
-						if ( weightItem ) {
-							nif->set<quint16>( weightItem->child( 0 ), boneWeights[i].joints[j] );
-							nif->set<quint16>( weightItem->child( 1 ), boneWeights[i].weights[j] );
-						}
+	}
+
+	if ( !d.tangents.isEmpty() ) {
+		nif->set<quint32>( iMeshData, "Num Tangents", quint32( d.tangents.size() ) );
+		auto	iTangents = nif->getIndex( iMeshData, "Tangents" );
+		if ( iTangents.isValid() ) {
+			nif->updateArraySize( iTangents );
+			nif->setArray<UDecVector4>( iTangents, d.tangents );
+		}
+	}
+
+	if ( !d.colors.isEmpty() ) {
+		nif->set<quint32>( iMeshData, "Num Vertex Colors", quint32( d.colors.size() ) );
+		auto	iColors = nif->getIndex( iMeshData, "Vertex Colors" );
+		if ( iColors.isValid() ) {
+			nif->updateArraySize( iColors );
+			nif->setArray<ByteColor4BGRA>( iColors, d.colors );
+		}
+	}
+
+	if ( d.weightsPerVertex > 0 ) {
+		size_t	weightsPerVertex = d.weightsPerVertex;
+		size_t	numWeights = d.boneWeights.size() * weightsPerVertex;
+		nif->set<quint32>( iMeshData, "Weights Per Vertex", quint32(weightsPerVertex) );
+		nif->set<quint32>( iMeshData, "Num Weights", quint32(numWeights) );
+		auto	iWeights = nif->getIndex( iMeshData, "Weights" );
+		if ( iWeights.isValid() ) {
+			nif->updateArraySize( iWeights );
+			// the values are set without change notifications, the block is updated by the bounds calculation
+			NifItem *	weightsItem = nif->getItem( iWeights );
+			for ( size_t i = 0; weightsItem && i < d.boneWeights.size(); i++ ) {
+				for ( size_t j = 0; j < weightsPerVertex; j++ ) {
+					auto	weightItem = weightsItem->child( int(i * weightsPerVertex + j) );
+					if ( weightItem ) {
+						NifItem::set<quint16>( weightItem->child( 0 ), d.boneWeights[i].joints[j] );
+						NifItem::set<quint16>( weightItem->child( 1 ), d.boneWeights[i].weights[j] );
 					}
 				}
 			}
@@ -1592,9 +1982,7 @@ void ImportGltf::loadNode( const QPersistentModelIndex & index, int nodeNum, boo
 			if ( !primCnt )
 				break;
 			meshPrim = model.meshes[node.mesh].primitives.data() + p;
-			if ( meshPrim->mode != TINYGLTF_MODE_TRIANGLES || meshPrim->attributes.empty() )
-				continue;
-			if ( meshPrim->indices < 0 || size_t(meshPrim->indices) >= model.accessors.size() )
+			if ( !isTrianglePrimitive( *meshPrim ) )
 				continue;
 		}
 
@@ -1678,6 +2066,7 @@ void ImportGltf::loadNode( const QPersistentModelIndex & index, int nodeNum, boo
 						tangentsNeeded |= loadMesh( iBlock, materialPath, *meshPrim, l + 1, node.skin );
 				}
 			}
+			releaseMeshData( *meshPrim );
 
 			QPersistentModelIndex	iShaderProperty = nif->insertNiBlock( "BSLightingShaderProperty" );
 			nif->setLink( iBlock, "Shader Property", qint32( nif->getBlockNumber(iShaderProperty) ) );
@@ -1706,6 +2095,15 @@ void ImportGltf::loadNode( const QPersistentModelIndex & index, int nodeNum, boo
 
 void ImportGltf::importModel( const QPersistentModelIndex & iBlock )
 {
+	if ( model.scenes.empty() ) {
+		findPrimitives( 0 );
+	} else {
+		for ( const auto & i : model.scenes ) {
+			for ( int j : i.nodes )
+				findPrimitives( j );
+		}
+	}
+
 	nif->setState( BaseModel::Processing );
 	if ( model.scenes.empty() ) {
 		loadNode( iBlock, 0, true );
@@ -1717,6 +2115,11 @@ void ImportGltf::importModel( const QPersistentModelIndex & iBlock )
 	}
 	nif->updateHeader();
 	nif->restoreState();
+
+	meshData.clear();
+	primitiveUses.clear();
+	primitiveOrder.clear();
+	nextPrimitive = 0;
 }
 
 static bool dummyImageLoadFunction(
@@ -45,12 +45,24 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QRegularExpression>
+#include <QHash>
 #include <QSettings>
-#include <QTextStream>
+
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
 
 #define tr( x ) QApplication::tr( x )
 
 
+// std::to_chars and std::from_chars for floating point types are not available in all C++ libraries
+#if defined( __cpp_lib_to_chars ) && __cpp_lib_to_chars >= 201611L
+#define OBJ_FLOAT_CHARCONV	1
+#else
+#define OBJ_FLOAT_CHARCONV	0
+#endif
+
 // "globals"
 bool objCulling;
 QRegularExpression objCullRegExp;
@@ -61,7 +73,71 @@ QStringList expSknMeshWarnings; // Used when notifying user of skinned meshes th
  *  .OBJ EXPORT
  */
 
-static void writeData( const NifModel * nif, const QModelIndex & iData, QTextStream & obj, int ofs[1], Transform t )
+//! Buffered text output for OBJ and MTL files
+/*!
+ * Numbers are formatted in the C locale, floats with the shortest representation that reads back
+ * to the same value. The buffer is written to the device when it is full and on destruction.
+ */
+class ObjWriter final
+{
+public:
+	ObjWriter( QIODevice * device ) : dev( device ) { buf.reserve( bufferSize + 64 ); }
+	~ObjWriter() { flush(); }
+
+	void flush()
+	{
+		if ( !buf.empty() ) {
+			dev->write( buf.data(), qint64( buf.size() ) );
+			buf.clear();
+		}
+	}
+
+	ObjWriter & operator<<( const char * s )
+	{
+		buf.append( s );
+		return checkSize();
+	}
+
+	ObjWriter & operator<<( const QString & s )
+	{
+		QByteArray	tmp = s.toUtf8();
+		buf.append( tmp.constData(), size_t( tmp.size() ) );
+		return checkSize();
+	}
+
+	ObjWriter & operator<<( int n )
+	{
+		char	tmp[16];
+		buf.append( tmp, std::to_chars( tmp, tmp + sizeof( tmp ), n ).ptr );
+		return checkSize();
+	}
+
+	ObjWriter & operator<<( float x )
+	{
+#if OBJ_FLOAT_CHARCONV
+		char	tmp[32];
+		buf.append( tmp, std::to_chars( tmp, tmp + sizeof( tmp ), x ).ptr );
+#else
+		buf.append( QByteArray::number( double( x ), 'g', 9 ).constData() );
+#endif
+		return checkSize();
+	}
+
+private:
+	static constexpr size_t	bufferSize = 0x10000;
+
+	ObjWriter & checkSize()
+	{
+		if ( buf.size() >= bufferSize ) [[unlikely]]
+			flush();
+		return *this;
+	}
+
+	QIODevice *	dev;
+	std::string	buf;
+};
+
+static void writeData( const NifModel * nif, const QModelIndex & iData, ObjWriter & obj, int ofs[1], Transform t )
 {
 	if ( nif->getBSVersion() < 100 ) {
 		// Copy vertices
@@ -70,7 +146,7 @@ static void writeData( const NifModel * nif, const QModelIndex & iData, QTextStr
 		foreach( Vector3 v, verts )
 		{
 			v = t * v;
-			obj << "v " << qSetRealNumberPrecision( 17 ) << v[0] << " " << v[1] << " " << v[2] << "\r\n";
+			obj << "v " << v[0] << " " << v[1] << " " << v[2] << "\r\n";
 		}
 
 		// Copy texcoords
@@ -79,7 +155,7 @@ static void writeData( const NifModel * nif, const QModelIndex & iData, QTextStr
 		QVector<Vector2> texco = nif->getArray<Vector2>( nif->getIndex( iUV, 0, 0 ) );
 		foreach( Vector2 t, texco )
 		{
-			obj << "vt " << t[0] << " " << 1.0 - t[1] << "\r\n";
+			obj << "vt " << t[0] << " " << 1.0f - t[1] << "\r\n";
 		}
 
 		// Copy normals
@@ -156,11 +232,11 @@ static void writeData( const NifModel * nif, const QModelIndex & iData, QTextStr
 
 		for ( Vector3 & v : verts ) {
 			v = t * v;
-			obj << "v " << qSetRealNumberPrecision( 17 ) << v[0] << " " << v[1] << " " << v[2] << "\r\n";
+			obj << "v " << v[0] << " " << v[1] << " " << v[2] << "\r\n";
 		}
 
 		for ( Vector2 & c : coords ) {
-			obj << "vt " << c[0] << " " << 1.0 - c[1] << "\r\n";
+			obj << "vt " << c[0] << " " << 1.0f - c[1] << "\r\n";
 		}
 
 		for ( Vector3 & n : norms ) {
@@ -224,17 +300,17 @@ static void writeData( const NifModel * nif, const QModelIndex & iData, QTextStr
 
 		for ( Vector3 & v : verts ) {
 			v = t * v;
-			obj << "v " << qSetRealNumberPrecision( 17 ) << v[0] << " " << v[1] << " " << v[2];
+			obj << "v " << v[0] << " " << v[1] << " " << v[2];
 			qsizetype	i = qsizetype( &v - verts.constData() );
 			if ( i < colors.size() ) {
 				ByteColor4	c = colors.at( i );
-				obj << qSetRealNumberPrecision( 5 ) << " " << c[0] << " " << c[1] << " " << c[2];
+				obj << " " << c[0] << " " << c[1] << " " << c[2];
 			}
 			obj << "\r\n";
 		}
 
 		for ( Vector2 & c : coords ) {
-			obj << "vt " << c[0] << " " << 1.0 - c[1] << "\r\n";
+			obj << "vt " << c[0] << " " << 1.0f - c[1] << "\r\n";
 		}
 
 		for ( Vector3 & n : norms ) {
@@ -271,7 +347,7 @@ static void writeData( const NifModel * nif, const QModelIndex & iData, QTextStr
 
 }
 
-static void writeShape( const NifModel * nif, const QModelIndex & iShape, QTextStream & obj, QTextStream & mtl, int ofs[], Transform t )
+static void writeShape( const NifModel * nif, const QModelIndex & iShape, ObjWriter & obj, ObjWriter & mtl, int ofs[], Transform t )
 {
 	QString name = nif->get<QString>( iShape, "Name" );
 	QString matn = name, map_Kd, map_Kn, map_Ks, map_Ns, map_d, disp, decal, bump;
@@ -382,7 +458,7 @@ static void writeShape( const NifModel * nif, const QModelIndex & iShape, QTextS
 		writeData( nif, iShape, obj, ofs, t );
 }
 
-static void writeParent( const NifModel * nif, const QModelIndex & iNode, QTextStream & obj, QTextStream & mtl, int ofs[], Transform t )
+static void writeParent( const NifModel * nif, const QModelIndex & iNode, ObjWriter & obj, ObjWriter & mtl, int ofs[], Transform t )
 {
 	// export culling
 	if ( objCulling && !objCullRegExp.pattern().isEmpty() && nif->get<QString>( iNode, "Name" ).contains( objCullRegExp ) )
@@ -539,8 +615,8 @@ void exportObj( const NifModel * nif, const Scene* scene, const QModelIndex & in
 	if ( i >= 0 )
 		fname = fname.remove( 0, i + 1 );
 
-	QTextStream sobj( &fobj );
-	QTextStream smtl( &fmtl );
+	ObjWriter sobj( &fobj );
+	ObjWriter smtl( &fmtl );
 
 	sobj << "# exported with NifSkope\r\n\r\n" << "mtllib " << fname << "\r\n";
 
@@ -599,6 +675,11 @@ struct ObjPoint
 	}
 };
 
+static inline size_t qHash( const ObjPoint & p, size_t seed = 0 )
+{
+	return qHashMulti( seed, p.v, p.t, p.n );
+}
+
 struct ObjFace
 {
 	ObjPoint p[3];
@@ -620,6 +701,123 @@ struct ObjMaterial
 	}
 };
 
+//! Tokenizer for OBJ and MTL files
+/*!
+ * The file is memory mapped if possible, or read in one call otherwise. Tokens are separated
+ * by spaces or tabs, numbers are parsed in the C locale.
+ */
+class ObjReader final
+{
+public:
+	ObjReader( QFile & file )
+	{
+		qint64	size = file.size();
+		const char *	p = nullptr;
+		if ( size > 0 )
+			p = reinterpret_cast< const char * >( file.map( 0, size ) );
+		if ( !p ) {
+			data = file.readAll();
+			p = data.constData();
+			size = data.size();
+		}
+		filePos = p;
+		fileEnd = p + size;
+		if ( size >= 3 && std::memcmp( p, "\xEF\xBB\xBF", 3 ) == 0 )
+			filePos += 3;
+	}
+
+	//! Advances to the next line, returns false at the end of the file
+	bool nextLine()
+	{
+		if ( filePos >= fileEnd )
+			return false;
+		pos = filePos;
+		lineEnd = static_cast< const char * >( std::memchr( pos, '\n', size_t( fileEnd - pos ) ) );
+		filePos = ( lineEnd ? lineEnd + 1 : fileEnd );
+		if ( !lineEnd )
+			lineEnd = fileEnd;
+		if ( lineEnd > pos && lineEnd[-1] == '\r' )
+			lineEnd--;
+		return true;
+	}
+
+	//! Returns the next token of the current line, or an empty string at the end of the line
+	std::string_view token()
+	{
+		while ( pos < lineEnd && ( *pos == ' ' || *pos == '\t' ) )
+			pos++;
+		const char *	s = pos;
+		while ( pos < lineEnd && !( *pos == ' ' || *pos == '\t' ) )
+			pos++;
+		return std::string_view( s, size_t( pos - s ) );
+	}
+
+	//! Number of tokens remaining on the current line
+	int tokenCount() const
+	{
+		int	n = 0;
+		for ( const char * p = pos; p < lineEnd; ) {
+			while ( p < lineEnd && ( *p == ' ' || *p == '\t' ) )
+				p++;
+			if ( p >= lineEnd )
+				break;
+			n++;
+			while ( p < lineEnd && !( *p == ' ' || *p == '\t' ) )
+				p++;
+		}
+		return n;
+	}
+
+	//! Returns the remainder of the current line without leading and trailing white space
+	QString remainder()
+	{
+		while ( pos < lineEnd && ( *pos == ' ' || *pos == '\t' ) )
+			pos++;
+		const char *	e = lineEnd;
+		while ( e > pos && ( e[-1] == ' ' || e[-1] == '\t' ) )
+			e--;
+		QString	s = QString::fromUtf8( pos, qsizetype( e - pos ) );
+		pos = lineEnd;
+		return s;
+	}
+
+	//! Parses the next token as a number, returns 0.0 if it is missing or invalid
+	double number() { return toDouble( token() ); }
+
+	static double toDouble( std::string_view s )
+	{
+		if ( !s.empty() && s.front() == '+' )
+			s.remove_prefix( 1 );
+		double	x = 0.0;
+#if OBJ_FLOAT_CHARCONV
+		auto	r = std::from_chars( s.data(), s.data() + s.size(), x );
+		if ( r.ec != std::errc() || r.ptr != s.data() + s.size() )
+			x = 0.0;
+#else
+		x = QByteArray::fromRawData( s.data(), qsizetype( s.size() ) ).toDouble();
+#endif
+		return x;
+	}
+
+	static int toInt( std::string_view s )
+	{
+		if ( !s.empty() && s.front() == '+' )
+			s.remove_prefix( 1 );
+		int	n = 0;
+		auto	r = std::from_chars( s.data(), s.data() + s.size(), n );
+		if ( r.ec != std::errc() || r.ptr != s.data() + s.size() )
+			n = 0;
+		return n;
+	}
+
+private:
+	QByteArray	data;
+	const char *	filePos = nullptr;
+	const char *	fileEnd = nullptr;
+	const char *	pos = nullptr;
+	const char *	lineEnd = nullptr;
+};
+
 static void readMtlLib( const QString & fname, QMap<QString, ObjMaterial> & omaterials )
 {
 	QFile file( fname );
@@ -629,44 +827,43 @@ static void readMtlLib( const QString & fname, QMap<QString, ObjMaterial> & omat
 		return;
 	}
 
-	QTextStream smtl( &file );
+	ObjReader smtl( file );
 
 	QString mtlid;
 	ObjMaterial mtl;
 
-	while ( !smtl.atEnd() ) {
-		QString line = smtl.readLine();
-
-		QStringList t = line.split( " ", Qt::SkipEmptyParts );
+	while ( smtl.nextLine() ) {
+		std::string_view	t = smtl.token();
 
-		if ( t.value( 0 ) == "newmtl" ) {
+		if ( t == "newmtl" ) {
 			if ( !mtlid.isEmpty() )
 				omaterials.insert( mtlid, mtl );
 
-			mtlid = t.value( 1 );
+			std::string_view	name = smtl.token();
+			mtlid = QString::fromUtf8( name.data(), qsizetype( name.size() ) );
 			mtl = ObjMaterial();
-		} else if ( t.value( 0 ) == "Ka" ) {
-			mtl.Ka = Color3( t.value( 1 ).toDouble(), t.value( 2 ).toDouble(), t.value( 3 ).toDouble() );
-		} else if ( t.value( 0 ) == "Kd" ) {
-			mtl.Kd = Color3( t.value( 1 ).toDouble(), t.value( 2 ).toDouble(), t.value( 3 ).toDouble() );
-		} else if ( t.value( 0 ) == "Ks" ) {
-			mtl.Ks = Color3( t.value( 1 ).toDouble(), t.value( 2 ).toDouble(), t.value( 3 ).toDouble() );
-		} else if ( t.value( 0 ) == "d" ) {
-			mtl.d = t.value( 1 ).toDouble();
-		} else if ( t.value( 0 ) == "Ns" ) {
-			mtl.Ns = t.value( 1 ).toDouble();
-		} else if ( t.value( 0 ) == "map_Kd" ) {
+		} else if ( t == "Ka" ) {
+			double	r = smtl.number();
+			double	g = smtl.number();
+			mtl.Ka = Color3( r, g, smtl.number() );
+		} else if ( t == "Kd" ) {
+			double	r = smtl.number();
+			double	g = smtl.number();
+			mtl.Kd = Color3( r, g, smtl.number() );
+		} else if ( t == "Ks" ) {
+			double	r = smtl.number();
+			double	g = smtl.number();
+			mtl.Ks = Color3( r, g, smtl.number() );
+		} else if ( t == "d" ) {
+			mtl.d = smtl.number();
+		} else if ( t == "Ns" ) {
+			mtl.Ns = smtl.number();
+		} else if ( t == "map_Kd" ) {
 			// handle spaces in filenames
-			mtl.map_Kd = t.value( 1 );
-
-			for ( int i = 2; i < t.size(); i++ )
-				mtl.map_Kd += " " + t.value( i );
-		} else if ( t.value( 0 ) == "map_Kn" ) {
+			mtl.map_Kd = smtl.remainder();
+		} else if ( t == "map_Kn" ) {
 			// handle spaces in filenames
-			mtl.map_Kn = t.value( 1 );
-
-			for ( int i = 2; i < t.size(); i++ )
-				mtl.map_Kn += " " + t.value( i );
+			mtl.map_Kn = smtl.remainder();
 		}
 	}
 
@@ -789,7 +986,7 @@ void importObjMain( NifModel * nif, const QModelIndex & index, bool collision )
 		return;
 	}
 
-	QTextStream sobj( &fobj );
+	ObjReader sobj( fobj );
 
 	QVector<Vector3> overts;
 	QVector<Vector3> onorms;
@@ -803,16 +1000,16 @@ void importObjMain( NifModel * nif, const QModelIndex & index, bool collision )
 	QString usemtl = "None";
 	ofaces.insert( usemtl, mfaces );
 
-	while ( !sobj.atEnd() ) {
+	while ( sobj.nextLine() ) {
 		// parse each line of the file
-		QString line = sobj.readLine();
-
-		QStringList t = line.split( " ", Qt::SkipEmptyParts );
-
-		if ( t.value( 0 ) == "mtllib" ) {
-			readMtlLib( fname.left( qMax( fname.lastIndexOf( "/" ), fname.lastIndexOf( "\\" ) ) + 1 ) + t.value( 1 ), omaterials );
-		} else if ( t.value( 0 ) == "usemtl" ) {
-			usemtl = t.value( 1 );
+		std::string_view	t = sobj.token();
+
+		if ( t == "mtllib" ) {
+			std::string_view	name = sobj.token();
+			readMtlLib( fname.left( qMax( fname.lastIndexOf( "/" ), fname.lastIndexOf( "\\" ) ) + 1 ) + QString::fromUtf8( name.data(), qsizetype( name.size() ) ), omaterials );
+		} else if ( t == "usemtl" ) {
+			std::string_view	name = sobj.token();
+			usemtl = QString::fromUtf8( name.data(), qsizetype( name.size() ) );
 			//if ( usemtl.contains( "_" ) )
 			//	usemtl = usemtl.left( usemtl.indexOf( "_" ) );
 
@@ -822,45 +1019,64 @@ void importObjMain( NifModel * nif, const QModelIndex & index, bool collision )
 				mfaces = new QVector<ObjFace>();
 				ofaces.insert( usemtl, mfaces );
 			}
-		} else if ( t.value( 0 ) == "v" ) {
-			overts.append( Vector3( t.value( 1 ).toDouble(), t.value( 2 ).toDouble(), t.value( 3 ).toDouble() ) );
+		} else if ( t == "v" ) {
+			bool	haveColor = ( sobj.tokenCount() == 6 );
+			double	x = sobj.number();
+			double	y = sobj.number();
+			overts.append( Vector3( x, y, sobj.number() ) );
 			ByteColor4 c;
-			if ( t.size() == 7 ) {
+			if ( haveColor ) {
 				// X, Y, Z, R, G, B format
-				c[0] = t.value( 4 ).toFloat();
-				c[1] = t.value( 5 ).toFloat();
-				c[2] = t.value( 6 ).toFloat();
+				c[0] = float( sobj.number() );
+				c[1] = float( sobj.number() );
+				c[2] = float( sobj.number() );
 			}
 			ocolors.append( c );
-		} else if ( t.value( 0 ) == "vt" ) {
-			otexco.append( Vector2( t.value( 1 ).toDouble(), 1.0 - t.value( 2 ).toDouble() ) );
-		} else if ( t.value( 0 ) == "vn" ) {
-			onorms.append( Vector3( t.value( 1 ).toDouble(), t.value( 2 ).toDouble(), t.value( 3 ).toDouble() ) );
-		} else if ( t.value( 0 ) == "f" ) {
-			if ( t.count() > 5 ) {
+		} else if ( t == "vt" ) {
+			double	u = sobj.number();
+			otexco.append( Vector2( u, 1.0 - sobj.number() ) );
+		} else if ( t == "vn" ) {
+			double	x = sobj.number();
+			double	y = sobj.number();
+			onorms.append( Vector3( x, y, sobj.number() ) );
+		} else if ( t == "f" ) {
+			std::string_view	points[4];
+			int	pointCnt = sobj.tokenCount();
+			if ( pointCnt > 4 ) {
 				qCCritical( nsNif ) << tr( "Please triangulate your mesh before import." );
+				qDeleteAll( ofaces );
 				return;
 			}
 
-			for ( int j = 1; j < t.count() - 2; j++ ) {
+			for ( int i = 0; i < pointCnt; i++ )
+				points[i] = sobj.token();
+
+			for ( int j = 1; j < pointCnt - 1; j++ ) {
 				ObjFace face;
 
 				for ( int i = 0; i < 3; i++ ) {
-					QStringList lst = t.value( i == 0 ? 1 : j + i ).split( "/" );
+					// v/t/n, t and n are optional
+					std::string_view	lst[3];
+					std::string_view	s = points[ i == 0 ? 0 : j + i - 1 ];
+					for ( int k = 0; k < 3 && !s.empty(); k++ ) {
+						size_t	n = s.find( '/' );
+						lst[k] = s.substr( 0, n );
+						s = ( n == std::string_view::npos ? std::string_view() : s.substr( n + 1 ) );
+					}
 
-					int v = lst.value( 0 ).toInt();
+					int v = ObjReader::toInt( lst[0] );
 					if ( v < 0 )
 						v += overts.count();
 					else
 						v--;
 
-					int t = lst.value( 1 ).toInt();
+					int t = ObjReader::toInt( lst[1] );
 					if ( t < 0 )
-						v += otexco.count();
+						t += otexco.count();
 					else
 						t--;
 
-					int n = lst.value( 2 ).toInt();
+					int n = ObjReader::toInt( lst[2] );
 					if ( n < 0 )
 						n += onorms.count();
 					else
@@ -902,23 +1118,20 @@ void importObjMain( NifModel * nif, const QModelIndex & index, bool collision )
 		QVector<ByteColor4> colors;
 		QVector<Triangle> triangles;
 
-		QVector<ObjPoint> points;
+		QHash<ObjPoint, int> points;
+		points.reserve( it.value()->count() * 3 );
 		bool	haveVertexColors = false;
 
-		foreach ( ObjFace oface, *( it.value() ) ) {
+		for ( const ObjFace & oface : *( it.value() ) ) {
 			Triangle tri;
 
 			for ( int t = 0; t < 3; t++ ) {
 				ObjPoint p = oface.p[t];
-				int ix;
+				int ix = points.value( p, -1 );
 
-				for ( ix = 0; ix < points.count(); ix++ ) {
-					if ( points[ix] == p )
-						break;
-				}
-
-				if ( ix == points.count() ) {
-					points.append( p );
+				if ( ix < 0 ) {
+					ix = int( verts.count() );
+					points.insert( p, ix );
 					verts.append( overts.value( p.v ) );
 					norms.append( onorms.value( p.n ) );
 					texco.append( otexco.value( p.t ) );
@@ -1175,7 +1388,8 @@ void importObjMain( NifModel * nif, const QModelIndex & index, bool collision )
 			QVector<Vector3> norms;
 			QVector<Triangle> triangles;
 
-			QVector<ObjPoint> points;
+			QHash<ObjPoint, int> points;
+			points.reserve( it.value()->count() * 3 );
 
 			shapecount++;
 
@@ -1184,15 +1398,11 @@ void importObjMain( NifModel * nif, const QModelIndex & index, bool collision )
 
 				for ( int t = 0; t < 3; t++ ) {
 					ObjPoint p = oface.p[t];
-					int ix;
-
-					for ( ix = 0; ix < points.count(); ix++ ) {
-						if ( points[ix] == p )
-							break;
-					}
+					int ix = points.value( p, -1 );
 
-					if ( ix == points.count() ) {
-						points.append( p );
+					if ( ix < 0 ) {
+						ix = int( verts.count() );
+						points.insert( p, ix );
 						verts.append( overts.value( p.v ) );
 						norms.append( onorms.value( p.n ) );
 					}
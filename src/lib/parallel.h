@@ -0,0 +1,54 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+//! \file parallel.h Running independent jobs on multiple threads
+
+//! Calls f( i ) for each i in the range 0 to n - 1, distributed dynamically over up to maxThreads threads
+/*!
+ * The calling thread also runs jobs, and the function returns when all jobs are finished.
+ * f must be thread safe and must not throw exceptions. If threads cannot be created,
+ * the jobs are run on the remaining threads.
+ *
+ * @param maxThreads	Maximum number of threads including the calling one, 0 to use
+ *						std::thread::hardware_concurrency()
+ */
+template< typename F >
+void parallelFor( size_t n, F && f, size_t maxThreads = 0 )
+{
+	if ( !maxThreads )
+		maxThreads = std::thread::hardware_concurrency();
+	size_t	threadCnt = std::min( std::min< size_t >( maxThreads, 64 ), n );
+	if ( threadCnt <= 1 ) {
+		for ( size_t i = 0; i < n; i++ )
+			f( i );
+		return;
+	}
+
+	std::atomic< size_t >	nextJob( 0 );
+	auto	runJobs = [&]() {
+		for ( size_t i; ( i = nextJob.fetch_add( 1, std::memory_order_relaxed ) ) < n; )
+			f( i );
+	};
+
+	std::vector< std::thread >	threads;
+	threads.reserve( threadCnt - 1 );
+	for ( size_t i = 1; i < threadCnt; i++ ) {
+		try {
+			threads.emplace_back( runJobs );
+		} catch ( ... ) {
+			break;
+		}
+	}
+	runJobs();
+	for ( auto & t : threads )
+		t.join();
+}
+
+#endif
@@ -35,6 +35,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "data/nifvalue.h"
 #include "model/nifmodel.h"
 #include "model/kfmmodel.h"
+#include "ui/widgets/xmlcheck.h"
 
 #include <QApplication>
 #include <QColorSpace>
@@ -166,7 +167,17 @@ int main( int argc, char * argv[] )
 			return 0;
 		}
 	} else {
-		// Future command line batch tools here
+		app->setOrganizationName( "NifTools" );
+		app->setOrganizationDomain( "niftools.org" );
+		app->setApplicationName( "NifSkope " + NifSkopeVersion::rawToMajMin( NIFSKOPE_VERSION ) );
+		app->setApplicationVersion( NIFSKOPE_VERSION );
+
+		// Load XML files
+		if ( !NifModel::loadXML() || !KfmModel::loadXML() )
+			return 1;
+
+		// Command line batch tools
+		return TestShredder::runHeadless( *app );
 	}
 
 	return 0;
@@ -4,6 +4,7 @@
 #include <QAbstractButton>
 #include <QMap>
 #include <QCloseEvent>
+#include <QDebug>
 #include <QScreen>
 
 
@@ -14,6 +15,12 @@ Q_LOGGING_CATEGORY( nsNif, "nifskope.nif" )
 Q_LOGGING_CATEGORY( nsSpell, "nifskope.spell" )
 
 
+//! Returns false when running without GUI (-no-gui), message boxes are then logged instead
+static bool hasGui()
+{
+	return qobject_cast<QApplication *>( QCoreApplication::instance() ) != nullptr;
+}
+
 Message::Message() : QObject( nullptr )
 {
 
@@ -27,6 +34,11 @@ Message::~Message()
 //! Static helper for message box without detail text
 QMessageBox* Message::message( QWidget * parent, const QString & str, QMessageBox::Icon icon )
 {
+	if ( !hasGui() ) {
+		qWarning().noquote() << str;
+		return nullptr;
+	}
+
 	auto msgBox = new QMessageBox( parent );
 	msgBox->setWindowFlags( msgBox->windowFlags() | Qt::Tool );
 	msgBox->setAttribute( Qt::WA_DeleteOnClose );
@@ -45,6 +57,11 @@ QMessageBox* Message::message( QWidget * parent, const QString & str, QMessageBo
 //! Static helper for message box with detail text
 QMessageBox* Message::message( QWidget * parent, const QString & str, const QString & err, QMessageBox::Icon icon )
 {
+	if ( !hasGui() ) {
+		qWarning().noquote() << str << err;
+		return nullptr;
+	}
+
 	if ( !parent )
 		parent = qApp->activeWindow();
 
@@ -166,6 +183,11 @@ void unregisterMessageBox( DetailsMessageBox * msgBox )
 
 void Message::append( QWidget * parent, const QString & str, const QString & err, QMessageBox::Icon icon )
 {
+	if ( !hasGui() ) {
+		qWarning().noquote() << str << err;
+		return;
+	}
+
 	if ( !parent )
 		parent = qApp->activeWindow();
 
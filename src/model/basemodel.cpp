@@ -81,8 +81,16 @@ void BaseModel::logWarning( const QString & details ) const
 	logMessage(tr("Warnings were generated while reading the file."), details);
 }
 
+thread_local QList<TestMessage> * BaseModel::threadMessages = nullptr;
+
 void BaseModel::testMsg( const QString & m ) const
 {
+	if ( threadMessages ) {
+		threadMessages->append( TestMessage() << m );
+		return;
+	}
+
+	QMutexLocker lock( &messagesLock );
 	messages.append( TestMessage() << m );
 }
 
@@ -93,24 +101,32 @@ inline NifItem * indexToItem( const QModelIndex & index )
 
 void BaseModel::beginInsertRows( const QModelIndex & parent, int first, int last )
 {
+	if ( concurrentLoading )
+		return;
 	setState( Inserting );
 	QAbstractItemModel::beginInsertRows( parent, first, last );
 }
 
 void BaseModel::endInsertRows()
 {
+	if ( concurrentLoading )
+		return;
 	QAbstractItemModel::endInsertRows();
 	restoreState();
 }
 
 void BaseModel::beginRemoveRows( const QModelIndex & parent, int first, int last )
 {
+	if ( concurrentLoading )
+		return;
 	setState( Removing );
 	QAbstractItemModel::beginRemoveRows( parent, first, last );
 }
 
 void BaseModel::endRemoveRows()
 {
+	if ( concurrentLoading )
+		return;
 	QAbstractItemModel::endRemoveRows();
 	restoreState();
 }
@@ -126,6 +142,7 @@ bool BaseModel::getProcessingResult()
 
 QList<TestMessage> BaseModel::getMessages() const
 {
+	QMutexLocker lock( &messagesLock );
 	QList<TestMessage> lst = messages;
 	messages.clear();
 	return lst;
@@ -552,7 +569,7 @@ Qt::ItemFlags BaseModel::flags( const QModelIndex & index ) const
  *  load and save
  */
 
-bool BaseModel::loadFromFile( const QString & file )
+bool BaseModel::loadFromFile( const QString & file, bool memoryMapped )
 {
 	QFile f( file );
 	QFileInfo finfo( f );
@@ -562,7 +579,26 @@ bool BaseModel::loadFromFile( const QString & file )
 	std::string	fileName;
 	if ( finfo.isFile() )
 		fileName = file.toStdString();
-	if ( f.exists() && finfo.isFile() && f.open( QIODevice::ReadOnly ) && load( f, fileName.c_str() ) ) {
+
+	bool loaded = false;
+	if ( f.exists() && finfo.isFile() && f.open( QIODevice::ReadOnly ) ) {
+		const uchar * p = nullptr;
+		if ( memoryMapped && f.size() > 0 )
+			p = f.map( 0, f.size() );
+
+		if ( p ) {
+			// Read through a buffer on the mapped file, the data is not copied
+			QByteArray data( QByteArray::fromRawData( reinterpret_cast< const char * >( p ), qsizetype( f.size() ) ) );
+			QBuffer buf( &data );
+			loaded = buf.open( QIODevice::ReadOnly ) && load( buf, fileName.c_str() );
+			buf.close();
+			f.unmap( const_cast< uchar * >( p ) );
+		} else {
+			loaded = load( f, fileName.c_str() );
+		}
+	}
+
+	if ( loaded ) {
 		fileinfo = finfo;
 		filename = finfo.baseName();
 		folder = finfo.absolutePath();
@@ -609,6 +645,22 @@ const NifItem * BaseModel::getItemInternal( const NifItem * parent, const QStrin
 }
 
 const NifItem * BaseModel::getItemInternal( const NifItem * parent, const QLatin1StringView & name, bool reportErrors ) const
+{
+	// A name that has no atom is not the name of any item
+	NifNameAtom atom = NifNameAtom::find( std::string_view( name.data(), size_t( name.size() ) ) );
+	if ( atom.isValid() ) {
+		for ( auto item : parent->children() ) {
+			if ( item->hasName(atom) && evalCondition(item) )
+				return item;
+		}
+	}
+
+	if ( reportErrors )
+		reportError( parent, tr( "Could not find \"%1\" subitem." ).arg( QString(name) ) );
+	return nullptr;
+}
+
+const NifItem * BaseModel::getItemInternal( const NifItem * parent, NifNameAtom name, bool reportErrors ) const
 {
 	for ( auto item : parent->children() ) {
 		if ( item->hasName(name) && evalCondition(item) )
@@ -616,7 +668,7 @@ const NifItem * BaseModel::getItemInternal( const NifItem * parent, const QLatin
 	}
 
 	if ( reportErrors )
-		reportError( parent, tr( "Could not find \"%1\" subitem." ).arg( QString(name) ) );
+		reportError( parent, tr( "Could not find \"%1\" subitem." ).arg( name.name() ) );
 	return nullptr;
 }
 
@@ -871,6 +923,9 @@ void BaseModel::reportError( const QModelIndex & index, const QString & funcName
 
 void BaseModel::onItemValueChange( NifItem * item )
 {
+	if ( concurrentLoading )
+		return;
+
 	if ( state != Processing ) {
 		QModelIndex idx = itemToIndex( item, ValueCol );
 		emit dataChanged( idx, idx );
@@ -39,6 +39,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QAbstractItemModel> // Inherited
 #include <QFileInfo>
 #include <QIODevice>
+#include <QMutex>
 #include <QStack>
 #include <QString>
 #include <QVariant>
@@ -94,8 +95,8 @@ public:
 	//! Get version as a number
 	virtual quint32 getVersionNumber() const = 0;
 
-	//! Load from file.
-	bool loadFromFile( const QString & filename );
+	//! Load from file, optionally reading it through a memory mapping.
+	bool loadFromFile( const QString & filename, bool memoryMapped = false );
 	//! Save to file.
 	bool saveToFile( const QString & str ) const;
 
@@ -188,9 +189,9 @@ public:
 	//! Get the model's state
 	ModelState getState() const { return state; }
 	//! Set the model's state
-	void setState( ModelState s ) const { states.push( state ); state = s; }
+	void setState( ModelState s ) const { if ( !concurrentLoading ) { states.push( state ); state = s; } }
 	//! Restore the model's state to the previous
-	void restoreState() const { state = states.pop(); }
+	void restoreState() const { if ( !concurrentLoading ) state = states.pop(); }
 	//! Reset the model's state
 	void resetState() const { state = Default; states.clear(); }
 	//! Were there updates while batch processing (also clears the result)
@@ -330,6 +331,7 @@ protected:
 protected:
 	const NifItem * getItemInternal( const NifItem * parent, const QString & name, bool reportErrors ) const;
 	const NifItem * getItemInternal( const NifItem * parent, const QLatin1StringView & name, bool reportErrors ) const;
+	const NifItem * getItemInternal( const NifItem * parent, NifNameAtom name, bool reportErrors ) const;
 
 public:
 	//! Get a child NifItem from its parent and name.
@@ -344,6 +346,10 @@ public:
 	const NifItem * getItem( const NifItem * parent, const char * name, bool reportErrors = false ) const;
 	//! Get a child NifItem from its parent and name.
 	NifItem * getItem( const NifItem * parent, const char * name, bool reportErrors = false );
+	//! Get a child NifItem from its parent and name atom.
+	const NifItem * getItem( const NifItem * parent, NifNameAtom name, bool reportErrors = false ) const;
+	//! Get a child NifItem from its parent and name atom.
+	NifItem * getItem( const NifItem * parent, NifNameAtom name, bool reportErrors = false );
 	//! Get a child NifItem from its parent and numerical index.
 	const NifItem * getItem( const NifItem * parent, int childIndex, bool reportErrors = true ) const;
 	//! Get a child NifItem from its parent and numerical index.
@@ -544,6 +550,8 @@ signals:
 	void sigMessage( const TestMessage & msg ) const;
 	//! Progress signal
 	void sigProgress( int c, int m ) const;
+	//! Emitted before dataChanged() for a single value, rows are the items whose cached conditions the change invalidated
+	void conditionsInvalidated( const QModelIndex & index, const QModelIndexList & rows );
 
 protected:
 	//! Set an item value
@@ -581,6 +589,10 @@ protected:
 
 	//! A list of test messages
 	mutable QList<TestMessage> messages;
+	//! Lock for messages, test messages can be added from multiple threads while saving
+	mutable QMutex messagesLock;
+	//! If not null, test messages from the current thread are added to this list instead of messages
+	static thread_local QList<TestMessage> * threadMessages;
 	//! Handle a test message
 	void testMsg( const QString & m ) const;
 
@@ -589,6 +601,8 @@ protected:
 	//! The model's state
 	mutable ModelState state = Default;
 	mutable QStack<ModelState> states;
+	//! Blocks are being loaded on multiple threads; the state is not changed and no row signals are emitted
+	bool concurrentLoading = false;
 
 	//! Has any data changed while processing
 	bool changedWhileProcessing = false;
@@ -680,11 +694,23 @@ inline NifItem * BaseModel::getItem( const NifItem * parent, const QLatin1String
 }
 inline const NifItem * BaseModel::getItem( const NifItem * parent, const char * name, bool reportErrors ) const
 {
+	// Names are usually string literals, which are resolved to an atom only once
+	NifNameAtom atom = NifNameAtom::fromLiteral( name );
+	if ( atom.isValid() )
+		return getItem( parent, atom, reportErrors );
 	return getItem( parent, QLatin1StringView(name), reportErrors );
 }
 inline NifItem * BaseModel::getItem( const NifItem * parent, const char * name, bool reportErrors )
 {
-	return _BASEMODEL_NONCONST_GETITEM_3( parent, QLatin1StringView(name), reportErrors );
+	return _BASEMODEL_NONCONST_GETITEM_3( parent, name, reportErrors );
+}
+inline const NifItem * BaseModel::getItem( const NifItem * parent, NifNameAtom name, bool reportErrors ) const
+{
+	return ( parent ? getItemInternal( parent, name, reportErrors ) : nullptr );
+}
+inline NifItem * BaseModel::getItem( const NifItem * parent, NifNameAtom name, bool reportErrors )
+{
+	return _BASEMODEL_NONCONST_GETITEM_3( parent, name, reportErrors );
 }
 inline NifItem * BaseModel::getItem( const NifItem * parent, int childIndex, bool reportErrors )
 {
@@ -712,11 +738,11 @@ inline NifItem * BaseModel::getItem( const QModelIndex & parent, const QLatin1St
 }
 inline const NifItem * BaseModel::getItem( const QModelIndex & parent, const char * name, bool reportErrors ) const
 {
-	return getItem( getItem(parent), QLatin1StringView(name), reportErrors );
+	return getItem( getItem(parent), name, reportErrors );
 }
 inline NifItem * BaseModel::getItem( const QModelIndex & parent, const char * name, bool reportErrors )
 {
-	return _BASEMODEL_NONCONST_GETITEM_3( getItem(parent), QLatin1StringView(name), reportErrors );
+	return _BASEMODEL_NONCONST_GETITEM_3( getItem(parent), name, reportErrors );
 }
 inline const NifItem * BaseModel::getItem( const QModelIndex & parent, int childIndex, bool reportErrors ) const
 {
@@ -750,7 +776,7 @@ inline QModelIndex BaseModel::getIndex( const NifItem * itemParent, const QLatin
 }
 inline QModelIndex BaseModel::getIndex( const NifItem * itemParent, const char * itemName, int column ) const
 {
-	return itemToIndex( getItem(itemParent, QLatin1StringView(itemName)), column );
+	return itemToIndex( getItem(itemParent, itemName), column );
 }
 inline QModelIndex BaseModel::getIndex( const QModelIndex & itemParent, const QString & itemName, int column ) const
 {
@@ -762,7 +788,7 @@ inline QModelIndex BaseModel::getIndex( const QModelIndex & itemParent, const QL
 }
 inline QModelIndex BaseModel::getIndex( const QModelIndex & itemParent, const char * itemName, int column ) const
 {
-	return itemToIndex( getItem(itemParent, QLatin1StringView(itemName)), column );
+	return itemToIndex( getItem(itemParent, itemName), column );
 }
 
 
@@ -786,7 +812,7 @@ template <typename T> inline T BaseModel::get( const NifItem * itemParent, const
 }
 template <typename T> inline T BaseModel::get( const NifItem * itemParent, const char * itemName ) const
 {
-	return NifItem::get<T>( getItem(itemParent, QLatin1StringView(itemName)) );
+	return NifItem::get<T>( getItem(itemParent, itemName) );
 }
 template <typename T> inline T BaseModel::get( const QModelIndex & index ) const
 {
@@ -806,7 +832,7 @@ template <typename T> inline T BaseModel::get( const QModelIndex & itemParent, c
 }
 template <typename T> inline T BaseModel::get( const QModelIndex & itemParent, const char * itemName ) const
 {
-	return NifItem::get<T>( getItem(itemParent, QLatin1StringView(itemName)) );
+	return NifItem::get<T>( getItem(itemParent, itemName) );
 }
 
 
@@ -835,7 +861,7 @@ template <typename T> inline bool BaseModel::set( const NifItem * itemParent, co
 }
 template <typename T> inline bool BaseModel::set( const NifItem * itemParent, const char * itemName, const T & val )
 {
-	return set( getItem(itemParent, QLatin1StringView(itemName), true), val );
+	return set( getItem(itemParent, itemName, true), val );
 }
 template <typename T> inline bool BaseModel::set( const QModelIndex & index, const T & val )
 {
@@ -855,7 +881,7 @@ template <typename T> inline bool BaseModel::set( const QModelIndex & itemParent
 }
 template <typename T> inline bool BaseModel::set( const QModelIndex & itemParent, const char * itemName, const T & val )
 {
-	return set( getItem(itemParent, QLatin1StringView(itemName), true), val );
+	return set( getItem(itemParent, itemName, true), val );
 }
 
 
@@ -879,7 +905,7 @@ inline bool BaseModel::updateArraySize( const NifItem * arrayParent, const QLati
 }
 inline bool BaseModel::updateArraySize( const NifItem * arrayParent, const char * arrayName )
 {
-	return updateArraySizeImpl( getItem(arrayParent, QLatin1StringView(arrayName), true) );
+	return updateArraySizeImpl( getItem(arrayParent, arrayName, true) );
 }
 inline bool BaseModel::updateArraySize( const QModelIndex & iArray )
 {
@@ -899,7 +925,7 @@ inline bool BaseModel::updateArraySize( const QModelIndex & arrayParent, const Q
 }
 inline bool BaseModel::updateArraySize( const QModelIndex & arrayParent, const char * arrayName )
 {
-	return updateArraySizeImpl( getItem(arrayParent, QLatin1StringView(arrayName), true) );
+	return updateArraySizeImpl( getItem(arrayParent, arrayName, true) );
 }
 
 
@@ -923,7 +949,7 @@ template <typename T> inline QVector<T> BaseModel::getArray( const NifItem * arr
 }
 template <typename T> inline QVector<T> BaseModel::getArray( const NifItem * arrayParent, const char * arrayName ) const
 {
-	return NifItem::getArray<T>( getItem(arrayParent, QLatin1StringView(arrayName)) );
+	return NifItem::getArray<T>( getItem(arrayParent, arrayName) );
 }
 template <typename T> inline QVector<T> BaseModel::getArray( const QModelIndex & iArray ) const
 {
@@ -943,7 +969,7 @@ template <typename T> inline QVector<T> BaseModel::getArray( const QModelIndex &
 }
 template <typename T> inline QVector<T> BaseModel::getArray( const QModelIndex & arrayParent, const char * arrayName ) const
 {
-	return NifItem::getArray<T>( getItem(arrayParent, QLatin1StringView(arrayName)) );
+	return NifItem::getArray<T>( getItem(arrayParent, arrayName) );
 }
 
 
@@ -970,7 +996,7 @@ template <typename T> inline void BaseModel::setArray( const NifItem * arrayPare
 }
 template <typename T> inline void BaseModel::setArray( const NifItem * arrayParent, const char * arrayName, const QVector<T> & array )
 {
-	setArray( getItem(arrayParent, QLatin1StringView(arrayName), true), array );
+	setArray( getItem(arrayParent, arrayName, true), array );
 }
 template <typename T> inline void BaseModel::setArray( const QModelIndex & iArray, const QVector<T> & array )
 {
@@ -990,7 +1016,7 @@ template <typename T> inline void BaseModel::setArray( const QModelIndex & array
 }
 template <typename T> inline void BaseModel::setArray( const QModelIndex & arrayParent, const char * arrayName, const QVector<T> & array )
 {
-	setArray( getItem(arrayParent, QLatin1StringView(arrayName), true), array );
+	setArray( getItem(arrayParent, arrayName, true), array );
 }
 
 
@@ -1017,7 +1043,7 @@ template <typename T> inline void BaseModel::fillArray( const NifItem * arrayPar
 }
 template <typename T> inline void BaseModel::fillArray( const NifItem * arrayParent, const char * arrayName, const T & val )
 {
-	fillArray( getItem(arrayParent, QLatin1StringView(arrayName), true), val );
+	fillArray( getItem(arrayParent, arrayName, true), val );
 }
 template <typename T> inline void BaseModel::fillArray( const QModelIndex & iArray, const T & val )
 {
@@ -1037,7 +1063,7 @@ template <typename T> inline void BaseModel::fillArray( const QModelIndex & arra
 }
 template <typename T> inline void BaseModel::fillArray( const QModelIndex & arrayParent, const char * arrayName, const T & val )
 {
-	fillArray( getItem(arrayParent, QLatin1StringView(arrayName), true), val );
+	fillArray( getItem(arrayParent, arrayName, true), val );
 }
 
 #endif
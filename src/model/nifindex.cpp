@@ -0,0 +1,461 @@
+#include "nifindex.h"
+
+#include "model/nifmodel.h"
+#include "lib/parallel.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QReadLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <algorithm>
+#include <vector>
+
+
+//! Identifies a NIF index file
+static constexpr quint32 indexFileMagic = 0x58494E4E;	// "NNIX"
+//! Version of the index file format, must be incremented when the format or the indexed data changes
+static constexpr quint32 indexFileVersion = 2;
+
+//! Data read from one file by the loading threads, before the strings are added to the pool
+struct NifIndex::ParsedFile
+{
+	//! Value of an indexed field, and the type of its block
+	struct Value
+	{
+		QString	name;
+		qint64	value;
+		QString	block;
+
+		bool operator==( const Value & ) const = default;
+	};
+
+	bool	done = false;
+	bool	loaded = false;
+	quint32	version = 0;
+	quint32	userVersion = 0;
+	quint32	bsVersion = 0;
+	QStringList	blockTypes;
+	//! Block type (empty for the header) and string
+	QList<QPair<QString, QString>>	strings;
+	QList<QPair<QString, QString>>	resources;
+	QList<Value>	values;
+};
+
+NifIndex::NifIndex( const QString & folder )
+	: root( QDir( folder ).absolutePath() )
+{
+}
+
+const QStringList & NifIndex::indexedValues()
+{
+	static const QStringList names = {
+		"Flags", "Shader Flags", "Shader Flags 1", "Shader Flags 2", "Shader Type", "Skyrim Shader Type",
+		"Texture Clamp Mode", "Alpha", "Num Vertices", "Num Triangles", "Vertex Desc", "Data Size"
+	};
+	return names;
+}
+
+QString NifIndex::normalizePath( const QString & path )
+{
+	QString p = path.trimmed().toLower();
+	p.replace( '\\', '/' );
+	while ( p.startsWith( '/' ) )
+		p.remove( 0, 1 );
+	return p;
+}
+
+QString NifIndex::defaultIndexFile( const QString & folder )
+{
+	QString path = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+	if ( path.isEmpty() )
+		path = QDir::tempPath() + "/NifSkope";
+
+	QByteArray key = QCryptographicHash::hash( QDir( folder ).absolutePath().toUtf8(), QCryptographicHash::Sha1 );
+	return path + "/nif_index/" + QString::fromLatin1( key.toHex() ) + ".index";
+}
+
+quint32 NifIndex::addString( const QString & s )
+{
+	auto i = poolIds.constFind( s );
+	if ( i != poolIds.constEnd() )
+		return quint32( i.value() );
+
+	quint32 id = quint32( pool.size() );
+	pool.append( s );
+	poolIds.insert( s, id );
+	return id;
+}
+
+QList<quint32> NifIndex::addStrings( const QStringList & strings )
+{
+	QList<quint32> ids;
+	ids.reserve( strings.size() );
+	for ( const QString & s : strings )
+		ids.append( addString( s ) );
+
+	std::sort( ids.begin(), ids.end() );
+	ids.erase( std::unique( ids.begin(), ids.end() ), ids.end() );
+	return ids;
+}
+
+void NifIndex::addStrings( const QList<QPair<QString, QString>> & strings, QList<quint32> & ids, QList<quint32> & blocks )
+{
+	ids.clear();
+	blocks.clear();
+	ids.reserve( strings.size() );
+	blocks.reserve( strings.size() );
+	for ( const auto & s : strings ) {
+		ids.append( addString( s.second ) );
+		blocks.append( s.first.isEmpty() ? headerBlock : addString( s.first ) );
+	}
+
+	sortStrings( ids, blocks );
+}
+
+void NifIndex::sortStrings( QList<quint32> & ids, QList<quint32> & blocks )
+{
+	std::vector<std::pair<quint32, quint32>>	pairs;
+	pairs.reserve( size_t( ids.size() ) );
+	for ( qsizetype i = 0; i < ids.size(); i++ )
+		pairs.emplace_back( ids.at( i ), blocks.at( i ) );
+
+	std::sort( pairs.begin(), pairs.end() );
+	pairs.erase( std::unique( pairs.begin(), pairs.end() ), pairs.end() );
+
+	ids.resize( qsizetype( pairs.size() ) );
+	blocks.resize( qsizetype( pairs.size() ) );
+	for ( size_t i = 0; i < pairs.size(); i++ ) {
+		ids[qsizetype( i )] = pairs[i].first;
+		blocks[qsizetype( i )] = pairs[i].second;
+	}
+}
+
+bool NifIndex::load( const QString & fileName )
+{
+	QFile f( fileName );
+	if ( !f.open( QIODevice::ReadOnly ) )
+		return false;
+
+	QDataStream in( &f );
+	in.setVersion( QDataStream::Qt_6_0 );
+
+	quint32	magic = 0, version = 0;
+	QString	folder;
+	QStringList	valueNames;
+	QByteArray	data;
+	in >> magic >> version;
+	if ( in.status() != QDataStream::Ok || magic != indexFileMagic || version != indexFileVersion )
+		return false;
+	in >> folder >> valueNames >> data;
+	if ( in.status() != QDataStream::Ok || folder != root || valueNames != indexedValues() )
+		return false;
+
+	data = qUncompress( data );
+	if ( data.isEmpty() )
+		return false;
+
+	QDataStream d( data );
+	d.setVersion( QDataStream::Qt_6_0 );
+
+	QStringList	strings;
+	quint32	fileCnt = 0;
+	d >> strings >> fileCnt;
+	if ( d.status() != QDataStream::Ok )
+		return false;
+
+	QList<FileEntry>	files;
+	files.reserve( fileCnt );
+	auto validIds = [&strings]( const QList<quint32> & ids ) {
+		return std::all_of( ids.cbegin(), ids.cend(), [&strings]( quint32 id ) { return id < quint32( strings.size() ); } );
+	};
+	auto validBlocks = [&strings]( const QList<quint32> & ids ) {
+		return std::all_of( ids.cbegin(), ids.cend(), [&strings]( quint32 id ) { return id < quint32( strings.size() ) || id == headerBlock; } );
+	};
+	for ( ; fileCnt; fileCnt-- ) {
+		FileEntry	e;
+		d >> e.path >> e.modified >> e.size >> e.loaded >> e.version >> e.userVersion >> e.bsVersion;
+		d >> e.blockTypes >> e.strings >> e.stringBlocks >> e.resources >> e.resourceBlocks >> e.valueNames >> e.values >> e.valueBlocks;
+		if ( d.status() != QDataStream::Ok || e.strings.size() != e.stringBlocks.size() || e.resources.size() != e.resourceBlocks.size()
+			 || e.valueNames.size() != e.values.size() || e.valueNames.size() != e.valueBlocks.size()
+			 || !validIds( e.blockTypes ) || !validIds( e.strings ) || !validIds( e.resources ) || !validIds( e.valueNames )
+			 || !validBlocks( e.stringBlocks ) || !validBlocks( e.resourceBlocks ) || !validBlocks( e.valueBlocks ) ) {
+			return false;
+		}
+		files.append( e );
+	}
+
+	entries.swap( files );
+	pool.swap( strings );
+	poolIds.clear();
+	poolIds.reserve( pool.size() );
+	for ( qsizetype i = 0; i < pool.size(); i++ )
+		poolIds.insert( pool.at( i ), i );
+
+	return true;
+}
+
+bool NifIndex::save( const QString & fileName ) const
+{
+	// Renumber the strings that are still used, in the order of their first use
+	std::vector<qint64>	remap( size_t( pool.size() ), -1 );
+	QStringList	strings;
+	auto mapIds = [&remap, &strings, this]( const QList<quint32> & ids ) {
+		QList<quint32> r;
+		r.reserve( ids.size() );
+		for ( quint32 id : ids ) {
+			if ( id == headerBlock ) {
+				r.append( id );
+				continue;
+			}
+			if ( remap[id] < 0 ) {
+				remap[id] = strings.size();
+				strings.append( pool.at( id ) );
+			}
+			r.append( quint32( remap[id] ) );
+		}
+		return r;
+	};
+
+	QByteArray	data;
+	{
+		QDataStream d( &data, QIODevice::WriteOnly );
+		d.setVersion( QDataStream::Qt_6_0 );
+
+		QList<FileEntry>	files;
+		files.reserve( entries.size() );
+		for ( const FileEntry & e : entries ) {
+			FileEntry	m = e;
+			m.blockTypes = mapIds( e.blockTypes );
+			m.strings = mapIds( e.strings );
+			m.stringBlocks = mapIds( e.stringBlocks );
+			m.resources = mapIds( e.resources );
+			m.resourceBlocks = mapIds( e.resourceBlocks );
+			m.valueNames = mapIds( e.valueNames );
+			m.valueBlocks = mapIds( e.valueBlocks );
+			// Keep the id lists sorted after renumbering
+			std::sort( m.blockTypes.begin(), m.blockTypes.end() );
+			sortStrings( m.strings, m.stringBlocks );
+			sortStrings( m.resources, m.resourceBlocks );
+			files.append( m );
+		}
+
+		d << strings << quint32( files.size() );
+		for ( const FileEntry & e : files ) {
+			d << e.path << e.modified << e.size << e.loaded << e.version << e.userVersion << e.bsVersion;
+			d << e.blockTypes << e.strings << e.stringBlocks << e.resources << e.resourceBlocks << e.valueNames << e.values << e.valueBlocks;
+		}
+	}
+
+	QDir().mkpath( QFileInfo( fileName ).absolutePath() );
+
+	// QSaveFile only replaces the index after it has been written completely
+	QSaveFile f( fileName );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return false;
+
+	QDataStream out( &f );
+	out.setVersion( QDataStream::Qt_6_0 );
+	out << indexFileMagic << indexFileVersion << root << indexedValues() << qCompress( data );
+
+	return out.status() == QDataStream::Ok && f.commit();
+}
+
+static bool isStringValue( const NifItem * item )
+{
+	return item->isString() || item->valueType() == NifValue::tStringIndex;
+}
+
+//! Returns true if a string item is the path of a texture, material, mesh or other resource file
+static bool isResourcePath( const NifModel & nif, const NifItem * item, const QString & value )
+{
+	// "String" and "Index" are the children of the string and file path compounds, the parent has the field name
+	const NifItem * named = item;
+	if ( ( item->hasName( "String" ) || item->hasName( "Index" ) ) && item->parent() )
+		named = item->parent();
+
+	const NifItem * parent = named->parent();
+	if ( parent && parent->hasName( "Textures" ) )
+		return true;
+	if ( named->hasName( "Path" ) || named->hasName( "Mesh Path" ) || named->hasName( "File Name" )
+		 || named->name().startsWith( QLatin1StringView( "Texture " ) ) ) {
+		return true;
+	}
+	if ( parent && nif.getBSVersion() >= 130 && named->hasName( "Name" )
+		 && ( parent->hasName( "BSLightingShaderProperty" ) || parent->hasName( "BSEffectShaderProperty" ) ) ) {
+		return true;	// Fallout 4, 76 or Starfield material
+	}
+
+	static const QStringList extensions = {
+		".dds", ".tga", ".png", ".bgsm", ".bgem", ".mat", ".mesh", ".nif", ".kf", ".hkx", ".btr", ".bto"
+	};
+	for ( const QString & ext : extensions ) {
+		if ( value.endsWith( ext, Qt::CaseInsensitive ) )
+			return true;
+	}
+	return false;
+}
+
+//! Adds the string values under parent to strings, and the resource paths to resources, with the block type
+static void scanStrings( const NifModel & nif, const NifItem * parent, const QString & blockType,
+						 QList<QPair<QString, QString>> & strings, QList<QPair<QString, QString>> & resources )
+{
+	for ( int r = 0; r < parent->childCount(); r++ ) {
+		const NifItem * item = parent->child( r );
+		if ( !item || !nif.evalCondition( item ) )
+			continue;
+
+		if ( item->childCount() > 0 ) {
+			// The elements of an array have the same type, skip large arrays of numbers without reading them
+			const NifItem * first = ( item->isArray() ? item->child( 0 ) : nullptr );
+			if ( first && first->childCount() == 0 && !isStringValue( first ) )
+				continue;
+			scanStrings( nif, item, blockType, strings, resources );
+		} else if ( isStringValue( item ) ) {
+			QString s = nif.resolveString( item );
+			if ( s.isEmpty() )
+				continue;
+			if ( isResourcePath( nif, item, s ) )
+				resources.append( { blockType, NifIndex::normalizePath( s ) } );
+			strings.append( { blockType, s } );
+		}
+	}
+}
+
+void NifIndex::parseFile( NifModel & nif, const QString & filePath, ParsedFile & p )
+{
+	// Hold the XML lock while the file is loaded and read, like the XML checker threads
+	QReadLocker lck( &NifModel::XMLlock );
+
+	p.done = true;
+	p.loaded = nif.loadFromFile( filePath );
+	if ( p.loaded ) {
+		p.version = nif.getVersionNumber();
+		p.userVersion = nif.getUserVersion();
+		p.bsVersion = nif.getBSVersion();
+
+		const QStringList & valueNames = indexedValues();
+
+		scanStrings( nif, nif.getHeaderItem(), QString(), p.strings, p.resources );
+		for ( int b = 0; b < nif.getBlockCount(); b++ ) {
+			const NifItem * block = nif.getBlockItem( b );
+			if ( !block )
+				continue;
+
+			p.blockTypes.append( block->name() );
+			for ( int r = 0; r < block->childCount(); r++ ) {
+				const NifItem * item = block->child( r );
+				if ( item && item->childCount() == 0 && valueNames.contains( item->name() )
+					 && item->value().isCount() && !item->value().isFloat() && nif.evalCondition( item ) ) {
+					ParsedFile::Value v{ item->name(), qint64( item->value().toCount( &nif, item ) ), block->name() };
+					if ( !p.values.contains( v ) )
+						p.values.append( v );
+				}
+			}
+			scanStrings( nif, block, block->name(), p.strings, p.resources );
+		}
+	}
+
+	// Discard the load messages, errors are not indexed
+	(void) nif.getMessages();
+}
+
+qsizetype NifIndex::update( const QStringList & extensions, bool recursive, int maxThreads,
+							const std::function<void( qsizetype, qsizetype )> & progress, const std::atomic<bool> * abort )
+{
+	QDir dir( root );
+	QList<FileEntry>	files;
+	QDirIterator it( root, extensions, QDir::Files, ( recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags ) );
+	while ( it.hasNext() ) {
+		QFileInfo finfo( it.next() );
+		FileEntry	e;
+		e.path = dir.relativeFilePath( finfo.absoluteFilePath() );
+		e.modified = finfo.lastModified().toMSecsSinceEpoch();
+		e.size = finfo.size();
+		files.append( e );
+	}
+	std::sort( files.begin(), files.end(), []( const FileEntry & a, const FileEntry & b ) { return a.path < b.path; } );
+
+	// Keep the entries of the files that have not changed
+	QHash<QString, qsizetype>	oldEntries;
+	oldEntries.reserve( entries.size() );
+	for ( qsizetype i = 0; i < entries.size(); i++ )
+		oldEntries.insert( entries.at( i ).path, i );
+
+	std::vector<qsizetype>	changed;
+	for ( qsizetype i = 0; i < files.size(); i++ ) {
+		FileEntry & e = files[i];
+		auto old = oldEntries.constFind( e.path );
+		if ( old != oldEntries.constEnd() ) {
+			const FileEntry & o = entries.at( old.value() );
+			if ( o.modified == e.modified && o.size == e.size ) {
+				e = o;
+				continue;
+			}
+		}
+		changed.push_back( i );
+	}
+
+	// Load the new and changed files, each thread with its own model
+	std::vector<ParsedFile>	parsed( changed.size() );
+	std::atomic<size_t>	nextFile( 0 );
+	std::atomic<qsizetype>	filesDone( 0 );
+	size_t	threadCnt = ( maxThreads > 0 ? size_t( maxThreads ) : size_t( 0 ) );
+	if ( !threadCnt )
+		threadCnt = std::max( 1, QThread::idealThreadCount() );
+
+	parallelFor( std::min( threadCnt, parsed.size() ), [&]( [[maybe_unused]] size_t t ) {
+		NifModel nif;
+		for ( size_t i; ( i = nextFile.fetch_add( 1, std::memory_order_relaxed ) ) < parsed.size(); ) {
+			if ( abort && abort->load( std::memory_order_relaxed ) )
+				break;
+
+			parseFile( nif, root + '/' + files.at( changed[i] ).path, parsed[i] );
+			if ( progress )
+				progress( filesDone.fetch_add( 1, std::memory_order_relaxed ) + 1, qsizetype( parsed.size() ) );
+		}
+	}, threadCnt );
+
+	// Add the strings to the pool on this thread, in file order so that the pool does not depend on the threads
+	qsizetype	indexed = 0;
+	std::vector<bool>	skipped( size_t( files.size() ), false );
+	for ( size_t i = 0; i < parsed.size(); i++ ) {
+		ParsedFile & p = parsed[i];
+		FileEntry & e = files[changed[i]];
+		if ( !p.done ) {
+			// Aborted, the file is indexed on the next update
+			skipped[size_t( changed[i] )] = true;
+			continue;
+		}
+
+		e.loaded = p.loaded;
+		e.version = p.version;
+		e.userVersion = p.userVersion;
+		e.bsVersion = p.bsVersion;
+		e.blockTypes = addStrings( p.blockTypes );
+		addStrings( p.strings, e.strings, e.stringBlocks );
+		addStrings( p.resources, e.resources, e.resourceBlocks );
+		for ( const auto & v : p.values ) {
+			e.valueNames.append( addString( v.name ) );
+			e.values.append( v.value );
+			e.valueBlocks.append( addString( v.block ) );
+		}
+		indexed++;
+	}
+
+	entries.clear();
+	entries.reserve( files.size() );
+	for ( qsizetype i = 0; i < files.size(); i++ ) {
+		if ( !skipped[size_t( i )] )
+			entries.append( files.at( i ) );
+	}
+
+	return indexed;
+}
@@ -0,0 +1,111 @@
+#ifndef NIFINDEX_H
+#define NIFINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <functional>
+
+
+//! @file nifindex.h NifIndex
+
+//! Persistent search index of the NIF files in a folder
+/*!
+ * For each file, the index stores the block types, the strings (header string table, names and other
+ * string values), the resource paths and the values of the fields listed by indexedValues().
+ * The strings, resource paths and values are stored with the type of the block they were found in,
+ * so that a query can require a value and a block type to match in the same block.
+ * All strings are stored once in a shared pool and referenced by their position in it, files refer to
+ * the pool by sorted lists of ids. update() only parses the files that are new or whose modification
+ * time or size has changed since they were indexed.
+ */
+class NifIndex final
+{
+public:
+	//! Block type id of the strings found in the header
+	static constexpr quint32 headerBlock = 0xFFFFFFFF;
+
+	//! Indexed data of one file
+	struct FileEntry
+	{
+		//! Path relative to the folder, with '/' separators
+		QString	path;
+		//! Modification time in milliseconds since the epoch
+		qint64	modified = 0;
+		qint64	size = 0;
+		//! False if the file could not be loaded, the other fields are then empty
+		bool	loaded = false;
+		quint32	version = 0;
+		quint32	userVersion = 0;
+		quint32	bsVersion = 0;
+		//! Sorted string pool ids of the block types
+		QList<quint32>	blockTypes;
+		//! String pool ids of all strings, sorted, and the block type ids they were found in (distinct pairs)
+		QList<quint32>	strings;
+		QList<quint32>	stringBlocks;
+		//! String pool ids of the resource paths, in lower case with '/' separators, sorted, and their block type ids
+		QList<quint32>	resources;
+		QList<quint32>	resourceBlocks;
+		//! String pool ids of the field names, the values of the fields, and their block type ids (distinct triples)
+		QList<quint32>	valueNames;
+		QList<qint64>	values;
+		QList<quint32>	valueBlocks;
+	};
+
+	NifIndex( const QString & folder );
+
+	//! The folder indexed
+	const QString & folder() const { return root; }
+	//! The indexed files, sorted by path
+	const QList<FileEntry> & files() const { return entries; }
+
+	//! Number of strings in the pool
+	qsizetype stringCount() const { return pool.size(); }
+	//! Returns a string from the pool
+	const QString & string( quint32 id ) const { return pool.at( id ); }
+	//! Returns the id of a string, or -1 if it is not in the pool
+	qint64 stringId( const QString & s ) const { return poolIds.value( s, -1 ); }
+
+	//! Names of the integer fields (direct children of the blocks) of which the values are indexed
+	static const QStringList & indexedValues();
+	//! Converts a resource path to the form stored in the index
+	static QString normalizePath( const QString & path );
+
+	//! Default index file of a folder, in the user cache directory
+	static QString defaultIndexFile( const QString & folder );
+
+	//! Loads the index from a file, fails if the file is missing, invalid or was written for a different folder
+	bool load( const QString & fileName );
+	//! Writes the index to a file, strings that are no longer used are not written
+	bool save( const QString & fileName ) const;
+
+	//! Adds new and changed files to the index and removes the files that no longer exist
+	/*!
+	 * @param extensions	Name filters of the files to index, e.g. "*.nif"
+	 * @param maxThreads	Maximum number of threads loading the files, 0 to use all cores
+	 * @param progress		Called from the loading threads with the number of files done and the total
+	 * @param abort			Stops loading the remaining files when set, the files already loaded are kept
+	 * @return				The number of files (re)indexed
+	 */
+	qsizetype update( const QStringList & extensions, bool recursive, int maxThreads = 0,
+					  const std::function<void( qsizetype, qsizetype )> & progress = {}, const std::atomic<bool> * abort = nullptr );
+
+private:
+	struct ParsedFile;
+
+	quint32 addString( const QString & s );
+	QList<quint32> addStrings( const QStringList & strings );
+	void addStrings( const QList<QPair<QString, QString>> & strings, QList<quint32> & ids, QList<quint32> & blocks );
+	static void sortStrings( QList<quint32> & ids, QList<quint32> & blocks );
+	static void parseFile( class NifModel & nif, const QString & filePath, ParsedFile & p );
+
+	QString	root;
+	QList<FileEntry>	entries;
+	QStringList	pool;
+	QHash<QString, qint64>	poolIds;
+};
+
+#endif
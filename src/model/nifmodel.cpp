@@ -38,7 +38,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "data/niftypes.h"
 #include "io/nifstream.h"
 #include "libfo76utils/src/filebuf.hpp"
+#include "lib/parallel.h"
 
+#include <QBuffer>
 #include <QByteArray>
 #include <QColor>
 #include <QDebug>
@@ -47,6 +49,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QSettings>
 #include <QStringBuilder>
 #include <cctype>
+#include <thread>
 
 //! @file nifmodel.cpp The NIF data model.
 
@@ -469,7 +472,7 @@ const NifItem * NifModel::getHeaderItem() const
 	return root->child( 0 );
 }
 
-void NifModel::updateHeader()
+void NifModel::updateHeader( bool updateBlockSizes )
 {
 	emit beginUpdateHeader();
 
@@ -508,7 +511,7 @@ void NifModel::updateHeader()
 			}
 			blockTypeIndices.append( iBlockType );
 
-			if ( itemBlockSizes ) {
+			if ( itemBlockSizes && updateBlockSizes ) {
 				updateChildArraySizes( itemBlock );
 				blockSizes.append( blockSize( itemBlock ) );
 			}
@@ -525,7 +528,8 @@ void NifModel::updateHeader()
 		}
 		if ( itemBlockSizes ) {
 			updateArraySize(itemBlockSizes);
-			itemBlockSizes->setArray<int>( blockSizes );
+			if ( updateBlockSizes )
+				itemBlockSizes->setArray<int>( blockSizes );
 		}
 		// 20.3.1.2 Custom Version
 		if ( itemBlockTypeHashes ) {
@@ -657,7 +661,7 @@ bool NifModel::updateArraySizeImpl( NifItem * array )
 		&& ( bOldHasChildLinks || array->hasChildLinks() ) // had or has any links inside
 		&& !array->isDescendantOf( getFooterItem() )
 	) {
-		updateLinks();
+		updateLinks( getBlockNumber( array ) );
 		updateFooter();
 		emit linksChanged();
 	}
@@ -1857,6 +1861,165 @@ bool NifModel::checkInternalGeometry( const QModelIndex & blockIndex )
 	return bool( get<quint32>( blockIndex, "Flags" ) & 0x0200 );
 }
 
+//! Evaluates and caches the conditions of an item and its children, so that they can be read from multiple threads
+static void cacheItemConditions( const BaseModel * model, const NifItem * item )
+{
+	model->evalCondition( item );
+	(void) item->row();
+	for ( auto child : item->children() )
+		cacheItemConditions( model, child );
+}
+
+bool NifModel::loadBlocksParallel( QIODevice & device, int numBlocks, bool ignoreSize )
+{
+	if ( version < 0x14020007 || numBlocks < 2 || numBlocks >= 65000 || device.isSequential() || std::thread::hardware_concurrency() < 2 )
+		return false;
+
+	NifItem * header = getHeaderItem();
+	const NifItem * typeIndices = getItem( header, "Block Type Index" );
+	const NifItem * types = getItem( header, "Block Types" );
+	const NifItem * hashes = ( version == 0x14030102 ? getItem( header, "Block Type Hashes" ) : nullptr );
+	const NifItem * sizes = getItem( header, "Block Size" );
+	if ( !( typeIndices && types && sizes ) || ( version == 0x14030102 && !hashes )
+		|| typeIndices->childCount() < numBlocks || sizes->childCount() < numBlocks ) {
+		return false;
+	}
+
+	// Read the types and the sizes of the blocks first, anything unexpected is left to the sequential loader,
+	// so that the error is reported the same way as before
+	QStringList	blockTypes;
+	std::vector<NiMesh::DataStreamMetadata>	blockMetadata( numBlocks );
+	std::vector<qint64>	blockOffsets( numBlocks + 1 );
+	blockTypes.reserve( numBlocks );
+	qint64	blocksSize = 0;
+	for ( int c = 0; c < numBlocks; c++ ) {
+		int blktypidx = get<int>( typeIndices->child( c ) ) & 0x7FFF;
+		QString blktyp;
+		if ( hashes ) {
+			const NifItem * hashItem = hashes->child( blktypidx );
+			NifBlockPtr blockHash = ( hashItem ? blockHashes.value( get<quint32>( hashItem ) ) : NifBlockPtr() );
+			if ( !blockHash )
+				return false;
+			blktyp = blockHash->id;
+		} else {
+			const NifItem * typeItem = types->child( blktypidx );
+			if ( !typeItem )
+				return false;
+			blktyp = get<QString>( typeItem );
+		}
+
+		if ( blktyp.startsWith( "NiDataStream\x01" ) )
+			blktyp = extractRTTIArgs( blktyp, blockMetadata[c] );
+		if ( !isNiBlock( blktyp ) )
+			return false;
+
+		blockTypes.append( blktyp );
+		blockOffsets[c] = blocksSize;
+		blocksSize += get<quint32>( sizes->child( c ) );
+	}
+	blockOffsets[numBlocks] = blocksSize;
+
+	qint64 startPos = device.pos();
+	if ( startPos + blocksSize > device.size() )
+		return false;
+
+	// The blocks are read directly from the data of a buffer or from the mapped file, so that they are not copied
+	const char * blockData = nullptr;
+	QFile * file = nullptr;
+	uchar * mappedData = nullptr;
+	if ( auto buffer = qobject_cast<QBuffer *>( &device ); buffer ) {
+		blockData = buffer->data().constData() + startPos;
+	} else if ( ( file = qobject_cast<QFile *>( &device ) ) != nullptr ) {
+		mappedData = file->map( startPos, blocksSize );
+		blockData = reinterpret_cast<const char *>( mappedData );
+	}
+	if ( !blockData )
+		return false;
+
+	for ( int c = 0; c < numBlocks; c++ )
+		insertNiBlock( blockTypes.at( c ), -1 );
+
+	// Everything outside of the blocks that the threads can read is cached first, and the link cache of the root
+	// is filled so that it is not modified when the blocks are loaded. Messages are collected per block,
+	// and reported in block order afterwards.
+	cacheItemConditions( this, header );
+	evalCondition( root );
+	for ( int c = 0; c < root->childCount(); c++ ) {
+		evalCondition( root->child( c ) );
+		(void) root->child( c )->row();
+	}
+	root->registerAllChildLinkRows();
+
+	MsgMode	savedMsgMode = msgMode;
+	setMessageMode( MSG_TEST );
+	concurrentLoading = true;
+
+	std::vector<QList<TestMessage>>	blockMessages( numBlocks );
+	std::vector<qint64>	blockBytesRead( numBlocks, 0 );
+	std::vector<char>	blockLoaded( numBlocks, 0 );
+	parallelFor( size_t( numBlocks ), [&]( size_t i ) {
+		QByteArray	data = QByteArray::fromRawData( blockData + blockOffsets[i], blockOffsets[i + 1] - blockOffsets[i] );
+		QBuffer	buf( &data );
+		buf.open( QIODevice::ReadOnly );
+		NifIStream	stream( this, &buf );
+		threadMessages = &( blockMessages[i] );
+		try {
+			blockLoaded[i] = char( loadItem( root->child( int( i ) + 1 ), stream ) );
+		} catch ( ... ) {
+		}
+		blockBytesRead[i] = buf.pos();
+		threadMessages = nullptr;
+	} );
+
+	concurrentLoading = false;
+	setMessageMode( savedMsgMode );
+	root->updateChildLinkRows();
+
+	if ( mappedData )
+		file->unmap( mappedData );
+	device.seek( startPos + blocksSize );
+
+	for ( int c = 0; c < numBlocks; c++ ) {
+		emit sigProgress( c + 1, numBlocks );
+
+		for ( const auto & m : blockMessages[c] )
+			reportError( m );
+
+		const QString & blktyp = blockTypes.at( c );
+		qint64 size = blockOffsets[c + 1] - blockOffsets[c];
+		// Without "Ignore Block Size", the sequential loader also continues at the next block after a failure
+		if ( !blockLoaded[c] && ignoreSize ) {
+			// Leave the model as the sequential loader would have
+			if ( c + 1 < numBlocks ) {
+				beginRemoveRows( QModelIndex(), c + 2, numBlocks );
+				root->removeChildren( c + 2, numBlocks - ( c + 1 ) );
+				endRemoveRows();
+			}
+			device.seek( startPos + blockOffsets[c + 1] );
+			throw tr( "failed to load block number %1 (%2) previous block was %3" ).arg( c ).arg( blktyp ).arg( c > 0 ? blockTypes.at( c - 1 ) : QString() );
+		}
+
+		// NiMesh hack
+		if ( blktyp == "NiDataStream" ) {
+			NifItem * block = root->child( c + 1 );
+			set<quint32>( block, "Usage", blockMetadata[c].usage );
+			set<quint32>( block, "Access", blockMetadata[c].access );
+		}
+
+		if ( blockBytesRead[c] != size ) {
+			logWarning( tr( "device position incorrect after block number %1 (%2) at 0x%3 ended at 0x%4 (expected 0x%5)" )
+				.arg( c )
+				.arg( blktyp )
+				.arg( QString::number( startPos + blockOffsets[c], 16 ) )
+				.arg( QString::number( startPos + blockOffsets[c] + blockBytesRead[c], 16 ) )
+				.arg( QString::number( startPos + blockOffsets[c + 1], 16 ) )
+			);
+		}
+	}
+
+	return true;
+}
+
 bool NifModel::load( QIODevice & device, const char* fileName )
 {
 	QSettings settings;
@@ -1896,10 +2059,11 @@ bool NifModel::load( QIODevice & device, const char* fileName )
 		curpos = device.pos();
 
 		if ( version >= 0x0303000d ) {
-			// read in the NiBlocks
+			// read in the NiBlocks, on multiple threads if the header has the block sizes
 			QString prevblktyp;
+			bool loadedInParallel = loadBlocksParallel( device, numblocks, ignoreSize );
 
-			for ( int c = 0; c < numblocks; c++ ) {
+			for ( int c = 0; c < numblocks && !loadedInParallel; c++ ) {
 				emit sigProgress( c + 1, numblocks );
 
 				if ( device.atEnd() )
@@ -2098,22 +2262,276 @@ bool NifModel::load( QIODevice & device, const char* fileName )
 	return true;
 }
 
+int NifModel::saveRows( QList<QByteArray> & rowData, int firstRow, int numRows ) const
+{
+	// The conditions of the items outside of the rows are cached first,
+	// so that the threads only modify the cached conditions of the row they are writing
+	cacheItemConditions( this, getHeaderItem() );
+	evalCondition( root );
+	for ( int c = 0; c < root->childCount(); c++ ) {
+		evalCondition( root->child( c ) );
+		(void) root->child( c )->row();
+	}
+
+	// Messages cannot be shown from the worker threads, they are collected and reported afterwards
+	NifModel * mdl = const_cast<NifModel *>(this);
+	MsgMode	savedMsgMode = msgMode;
+	mdl->setMessageMode( MSG_TEST );
+	qsizetype	nMessages;
+	{
+		QMutexLocker lock( &messagesLock );
+		nMessages = messages.size();
+	}
+
+	rowData.clear();
+	rowData.resize( numRows );
+	std::atomic<int>	failedRow( INT_MAX );
+	parallelFor( size_t( numRows ), [&]( size_t i ) {
+		int	r = firstRow + int( i );
+		QBuffer	buf( &( rowData[i] ) );
+		buf.open( QIODevice::WriteOnly );
+		NifOStream	stream( this, &buf );
+		if ( !saveItem( root->child( r ), stream ) ) {
+			for ( int f = failedRow.load(); r < f && !failedRow.compare_exchange_weak( f, r ); )
+				;
+		}
+	} );
+
+	mdl->setMessageMode( savedMsgMode );
+	if ( savedMsgMode == MSG_USER ) {
+		QList<TestMessage>	rowMessages;
+		{
+			QMutexLocker lock( &messagesLock );
+			rowMessages = messages.mid( nMessages );
+			messages.resize( nMessages );
+		}
+		for ( const auto & m : rowMessages )
+			logWarning( m );
+	}
+
+	return ( failedRow.load() != INT_MAX ? failedRow.load() : -1 );
+}
+
+//! Counts the blocks with the same types at the start and the end of two lists of row types (header, blocks and footer)
+static void matchBlockTypes( const QStringList & types1, const QStringList & types2, int firstRow, int & keepFirst, int & keepLast )
+{
+	int	blocks1 = int( types1.size() ) - 2;
+	int	blocks2 = int( types2.size() ) - 2;
+	int	minBlocks = std::min( blocks1, blocks2 );
+	keepFirst = 0;
+	while ( keepFirst < minBlocks && types1.at( keepFirst + firstRow ) == types2.at( keepFirst + firstRow ) )
+		keepFirst++;
+	keepLast = 0;
+	while ( ( keepFirst + keepLast ) < minBlocks
+			&& types1.at( blocks1 - 1 - keepLast + firstRow ) == types2.at( blocks2 - 1 - keepLast + firstRow ) ) {
+		keepLast++;
+	}
+}
+
+NifModel::Snapshot NifModel::saveSnapshot() const
+{
+	Snapshot	snapshot;
+	int	nRows = root->childCount();
+
+	setState( Saving );
+	snapshot.types.reserve( nRows );
+	for ( int c = 0; c < nRows; c++ ) {
+		const NifItem * item = root->child( c );
+		snapshot.types.append( isBlockRow( c ) ? createRTTIName( item ) : item->name() );
+	}
+	// Like save(), make the arrays match their sizes first, otherwise the rows cannot be read back
+	NifModel * mdl = const_cast<NifModel *>(this);
+	for ( int c = 0; c < nRows; c++ )
+		mdl->updateChildArraySizes( root->child( c ) );
+	if ( saveRows( snapshot.data, 0, nRows ) >= 0 ) {
+		snapshot = Snapshot();
+	} else {
+		// Null data marks rows that are not restored
+		for ( auto & d : snapshot.data ) {
+			if ( d.isNull() )
+				d = QByteArray( "" );
+		}
+	}
+	restoreState();
+
+	return snapshot;
+}
+
+bool NifModel::diffSnapshots( Snapshot & before, Snapshot & after ) const
+{
+	int	nRows1 = int( before.types.size() );
+	int	nRows2 = int( after.types.size() );
+	if ( nRows1 < 2 || nRows2 < 2 || before.data.size() != nRows1 || after.data.size() != nRows2 )
+		return true;
+
+	// Only the header, the footer and the blocks at the start and the end with the same types are reloaded
+	// in place by loadSnapshot(), the blocks between them are recreated and their data is always kept
+	int	keepFirst, keepLast;
+	matchBlockTypes( before.types, after.types, firstBlockRow(), keepFirst, keepLast );
+
+	bool	changed = ( before.types != after.types );
+	auto	dropRow = [&before, &after, &changed]( int r1, int r2 ) {
+		if ( before.data.at( r1 ) == after.data.at( r2 ) ) {
+			before.data[r1] = QByteArray();
+			after.data[r2] = QByteArray();
+		} else {
+			changed = true;
+		}
+	};
+	dropRow( 0, 0 );
+	for ( int b = 0; b < keepFirst; b++ )
+		dropRow( b + firstBlockRow(), b + firstBlockRow() );
+	for ( int b = 1; b <= keepLast; b++ )
+		dropRow( nRows1 - 1 - b, nRows2 - 1 - b );
+	dropRow( nRows1 - 1, nRows2 - 1 );
+
+	return changed;
+}
+
+bool NifModel::loadSnapshot( const Snapshot & snapshot )
+{
+	int	nRows = root->childCount();
+	if ( snapshot.types.size() != snapshot.data.size() || snapshot.types.size() < 2 )
+		return false;
+
+	QStringList	rowTypes;
+	rowTypes.reserve( nRows );
+	for ( int c = 0; c < nRows; c++ ) {
+		const NifItem * item = root->child( c );
+		rowTypes.append( isBlockRow( c ) ? createRTTIName( item ) : item->name() );
+	}
+	bool	sameBlocks = ( rowTypes == snapshot.types );
+
+	bool	ok = true;
+	auto	loadRow = [this, &snapshot, &ok]( int c ) {
+		const QByteArray &	d = snapshot.data.at( c );
+		if ( d.isNull() )
+			return;
+		QBuffer	buf;
+		buf.setData( d );
+		buf.open( QIODevice::ReadOnly );
+		NifIStream	stream( this, &buf );
+		ok = loadItem( root->child( c ), stream ) && ok;
+	};
+
+	if ( sameBlocks ) {
+		setState( Processing );
+		for ( int c = 0; c < nRows; c++ )
+			loadRow( c );
+		restoreState();
+
+		for ( int c = 0; c < nRows; c++ ) {
+			if ( !snapshot.data.at( c ).isNull() )
+				emit dataChanged( createIndex( c, 0, root->child( c ) ), createIndex( c, NumColumns - 1, root->child( c ) ) );
+		}
+	} else {
+		// The blocks have been inserted, removed or reordered, recreate the blocks between the unchanged
+		// blocks at the start and the end, so that the other rows and their persistent indexes are kept.
+		// diffSnapshots() only drops the data of the rows that are reloaded in place.
+		int	oldBlocks = getBlockCount();
+		int	newBlocks = int( snapshot.types.size() ) - 2;
+		int	keepFirst, keepLast;
+		matchBlockTypes( rowTypes, snapshot.types, firstBlockRow(), keepFirst, keepLast );
+		for ( int b = keepFirst; b < ( newBlocks - keepLast ); b++ ) {
+			if ( snapshot.data.at( b + firstBlockRow() ).isNull() )
+				return false;
+		}
+
+		setState( Loading );
+
+		// Load the header first, the version affects the structure of the blocks
+		loadRow( 0 );
+		cacheBSVersion( getHeaderItem() );
+
+		int	removeCnt = oldBlocks - keepFirst - keepLast;
+		if ( removeCnt > 0 ) {
+			int	r = keepFirst + firstBlockRow();
+			beginRemoveRows( QModelIndex(), r, r + removeCnt - 1 );
+			root->removeChildren( r, removeCnt );
+			endRemoveRows();
+		}
+
+		for ( int b = keepFirst; b < ( newBlocks - keepLast ) && ok; b++ ) {
+			QString	blktyp = snapshot.types.at( b + firstBlockRow() );
+
+			// Hack for NiMesh data streams
+			NiMesh::DataStreamMetadata metadata = {};
+			if ( blktyp.startsWith( "NiDataStream\x01" ) )
+				blktyp = extractRTTIArgs( blktyp, metadata );
+
+			QModelIndex	newBlock = insertNiBlock( blktyp, b );
+			if ( !newBlock.isValid() ) {
+				ok = false;
+				break;
+			}
+			loadRow( b + firstBlockRow() );
+
+			if ( blktyp == "NiDataStream" ) {
+				set<quint32>( newBlock, "Usage", metadata.usage );
+				set<quint32>( newBlock, "Access", metadata.access );
+			}
+		}
+
+		// Reload the unchanged blocks in place, their links and other values may differ
+		if ( ok ) {
+			for ( int b = 0; b < keepFirst; b++ )
+				loadRow( b + firstBlockRow() );
+			for ( int b = newBlocks - keepLast; b < newBlocks; b++ )
+				loadRow( b + firstBlockRow() );
+			loadRow( root->childCount() - 1 );
+		}
+		restoreState();
+
+		for ( int c = 0; c < root->childCount(); c++ ) {
+			int	b = c - firstBlockRow();
+			if ( b >= keepFirst && b < ( newBlocks - keepLast ) )
+				continue;
+			emit dataChanged( createIndex( c, 0, root->child( c ) ), createIndex( c, NumColumns - 1, root->child( c ) ) );
+		}
+	}
+
+	updateLinks();
+	emit linksChanged();
+
+	return ok;
+}
+
 bool NifModel::save( QIODevice & device ) const
 {
 	NifOStream stream( this, &device );
 
 	setState( Saving );
 
-	// Force update header and footer prior to save
-	if ( NifModel * mdl = const_cast<NifModel *>(this) ) {
-		mdl->updateHeader();
-		mdl->updateFooter();
+	NifModel * mdl = const_cast<NifModel *>(this);
+	// Force update header and footer prior to save, the block sizes are set after serialising the blocks
+	mdl->updateHeader( false );
+	mdl->updateFooter();
+
+	int nRows = rowCount( QModelIndex() );
+	NifItem * header = mdl->getHeaderItem();
+	NifItem * itemBlockSizes = ( version >= 0x14020000 ) ? mdl->getItem( header, "Block Size" ) : nullptr;
+
+	// Serialise each block to a separate buffer, on multiple threads
+	int nBlocks = getBlockCount();
+	if ( itemBlockSizes ) {
+		for ( int b = 0; b < nBlocks; b++ )
+			mdl->updateChildArraySizes( mdl->getBlockItem( b ) );
 	}
+	QList<QByteArray> blockData;
+	int failedRow = saveRows( blockData, firstBlockRow(), nBlocks );
 
-	emit sigProgress( 0, rowCount( QModelIndex() ) );
+	if ( itemBlockSizes ) {
+		QVector<int> blockSizes;
+		blockSizes.reserve( nBlocks );
+		for ( const auto & d : blockData )
+			blockSizes.append( int( d.size() ) );
+		itemBlockSizes->setArray<int>( blockSizes );
+	}
 
-	for ( int c = 0; c < rowCount( QModelIndex() ); c++ ) {
-		emit sigProgress( c + 1, rowCount( QModelIndex() ) );
+	emit sigProgress( 0, nRows );
+
+	for ( int c = 0; c < nRows; c++ ) {
+		emit sigProgress( c + 1, nRows );
 
 		//qDebug() << "saving block " << c << ": " << itemName( index( c, 0 ) );
 
@@ -2144,7 +2562,15 @@ bool NifModel::save( QIODevice & device ) const
 			}
 		}
 
-		if ( !saveItem( root->child( c ), stream ) ) {
+		bool saved;
+		if ( isBlockRow( c ) ) {
+			const QByteArray & d = blockData.at( c - firstBlockRow() );
+			saved = ( c != failedRow && device.write( d ) == d.size() );
+		} else {
+			saved = saveItem( root->child( c ), stream );
+		}
+
+		if ( !saved ) {
 			Message::critical( nullptr, tr( "Failed to write block %1 (%2)." ).arg( itemName( index( c, 0 ) ) ).arg( c - 1 ) );
 			resetState();
 			return false;
@@ -2536,7 +2962,7 @@ bool NifModel::evalConditionImpl( const NifItem * item ) const
 	return BaseModel::evalConditionImpl( item );
 }
 
-void NifModel::invalidateDependentConditions( NifItem * item )
+void NifModel::invalidateDependentConditions( NifItem * item, QList<NifItem *> * invalidatedItems )
 {
 	if ( !item )
 		return;
@@ -2558,6 +2984,8 @@ void NifModel::invalidateDependentConditions( NifItem * item )
 			|| ( c->childCount() > 0 && !c->isArray() ) // If it has children but is not an array, let's reset conditions just to be safe.
 		) {
 			c->invalidateCondition();
+			if ( invalidatedItems )
+				invalidatedItems->append( c );
 		}
 	}
 }
@@ -2607,48 +3035,24 @@ void NifModel::updateLinks( int block )
 		return;
 	}
 
-	if ( block >= 0 ) {
-		childLinks[ block ].clear();
-		parentLinks[ block ].clear();
+	int n = getBlockCount();
+
+	if ( block >= 0 && block < n && blockLinks.size() == n && parentLinks.size() == n ) {
+		// Only the links of one block have changed
+		blockLinks[block].clear();
+		parentLinks[block].clear();
 		updateLinks( block, getBlockItem( block ) );
 	} else {
-		rootLinks.clear();
-		childLinks.clear();
+		blockLinks.clear();
 		parentLinks.clear();
+		blockLinks.resize( n );
+		parentLinks.resize( n );
 
-		// Run updateLinks() for each block
-		for ( int c = 0; c < getBlockCount(); c++ )
-			updateLinks( c );
-
-		// Run checkLinks() for each block
-		for ( int c = 0; c < getBlockCount(); c++ ) {
-			QStack<int> stack;
-			checkLinks( c, stack );
-		}
-
-
-		int n = getBlockCount();
-		QByteArray hasrefs( n, 0 );
-
-		for ( int c = 0; c < n; c++ ) {
-			for ( const auto d : childLinks.value( c ) ) {
-				if ( d >= 0 && d < n )
-					hasrefs[d] = 1;
-			}
-		}
-
-		for ( int c = 0; c < n; c++ ) {
-			if ( !hasrefs[c] ) {
-				const NifItem *	b;
-				if ( bsVersion >= 151 && ( b = getBlockItem( qint32(c) ) ) != nullptr && b->name() == "BSShaderTextureSet" ) {
-					if ( c > 0 && ( b = getBlockItem( qint32(c - 1) ) ) != nullptr && b->name() == "BSLightingShaderProperty" )
-						insertLink( childLinks[c - 1], c );
-				} else {
-					rootLinks.append( c );
-				}
-			}
-		}
+		for ( int c = 0; c < n; c++ )
+			updateLinks( c, getBlockItem( c ) );
 	}
+
+	checkLinks();
 }
 
 void NifModel::updateLinks( int block, NifItem * parent )
@@ -2671,24 +3075,72 @@ void NifModel::updateLinks( int block, NifItem * parent )
 			if ( c->valueType() == NifValue::tUpLink )
 				insertLink( parentLinks[block], i );
 			else
-				insertLink( childLinks[block], i );
+				insertLink( blockLinks[block], i );
 		}
 	}
 }
 
-void NifModel::checkLinks( int block, QStack<int> & parents )
+void NifModel::checkLinks()
 {
-	parents.push( block );
-	foreach ( const auto child, childLinks.value( block ) ) {
-		if ( parents.contains( child ) ) {
-			logWarning(tr("Infinite recursive link detected (%1 -> %2 -> %1)").arg(block).arg(child));
+	int n = int( blockLinks.size() );
+	childLinks = blockLinks;
+	rootLinks.clear();
 
-			childLinks[block].removeAll( child );
-		} else {
-			checkLinks( child, parents );
+	// Iterative depth first search, removing the links to blocks that are on the current path
+	enum : char { notVisited = 0, onPath, visited };
+	QByteArray state( n, notVisited );
+	QList<QPair<int, qsizetype>> path;
+
+	for ( int r = 0; r < n; r++ ) {
+		if ( state.at( r ) != notVisited )
+			continue;
+
+		state[r] = onPath;
+		path.append( { r, 0 } );
+		while ( !path.isEmpty() ) {
+			auto & [block, i] = path.last();
+			QList<int> & links = childLinks[block];
+			if ( i >= links.size() ) {
+				state[block] = visited;
+				path.removeLast();
+				continue;
+			}
+
+			int child = links.at( i );
+			if ( child < 0 || child >= n || state.at( child ) == visited ) {
+				i++;
+			} else if ( state.at( child ) == onPath ) {
+				logWarning( tr( "Infinite recursive link detected (%1 -> %2 -> %1)" ).arg( block ).arg( child ) );
+
+				links.removeAt( i );
+			} else {
+				i++;
+				state[child] = onPath;
+				path.append( { child, 0 } );
+			}
+		}
+	}
+
+	QByteArray hasrefs( n, 0 );
+
+	for ( int c = 0; c < n; c++ ) {
+		for ( const auto d : childLinks.at( c ) ) {
+			if ( d >= 0 && d < n )
+				hasrefs[d] = 1;
+		}
+	}
+
+	for ( int c = 0; c < n; c++ ) {
+		if ( !hasrefs[c] ) {
+			const NifItem *	b;
+			if ( bsVersion >= 151 && ( b = getBlockItem( qint32(c) ) ) != nullptr && b->name() == "BSShaderTextureSet" ) {
+				if ( c > 0 && ( b = getBlockItem( qint32(c - 1) ) ) != nullptr && b->name() == "BSLightingShaderProperty" )
+					insertLink( childLinks[c - 1], c );
+			} else {
+				rootLinks.append( c );
+			}
 		}
 	}
-	parents.pop();
 }
 
 void NifModel::adjustLinks( NifItem * parent, int block, int delta )
@@ -2787,7 +3239,7 @@ bool NifModel::setLinkArray( NifItem * arrayRootItem, const QVector<qint32> & li
 	onArrayValuesChange( arrayRootItem );
 
 	if ( !arrayRootItem->isDescendantOf( getFooterItem() ) ) {
-		updateLinks();
+		updateLinks( getBlockNumber( arrayRootItem ) );
 		updateFooter();
 		emit linksChanged();
 	}
@@ -3080,11 +3532,20 @@ QString NifModel::topItemRepr( const NifItem * item ) const
 
 void NifModel::onItemValueChange( NifItem * item )
 {
-	invalidateDependentConditions( item );
+	QList<NifItem *> invalidated;
+	invalidateDependentConditions( item, &invalidated );
+	// Same conditions as for emitting dataChanged in BaseModel::onItemValueChange()
+	if ( !concurrentLoading && state != Processing ) {
+		QModelIndexList rows;
+		rows.reserve( invalidated.size() );
+		for ( auto c : invalidated )
+			rows.append( createIndex( c->row(), 0, c ) );
+		emit conditionsInvalidated( createIndex( item->row(), 0, item ), rows );
+	}
 	BaseModel::onItemValueChange( item );
 
 	if ( item->isLink() && !item->isDescendantOf( getFooterItem() ) ) {
-		updateLinks();
+		updateLinks( getBlockNumber( item ) );
 		updateFooter();
 		emit linksChanged();
 	}
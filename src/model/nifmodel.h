@@ -43,6 +43,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <memory>
 
+class NifXmlHandler;
 class SpellBook;
 class QUndoStack;
 
@@ -111,11 +112,30 @@ public:
 	bool loadIndex( QIODevice & device, const QModelIndex & );
 	//! Save to QIODevice and index
 	bool saveIndex( QIODevice & device, const QModelIndex & ) const;
+
+	//! Serialised copy of the top level items (header, blocks and footer), used for undoing spells
+	struct Snapshot
+	{
+		//! Name of each row, the RTTI name for blocks
+		QStringList types;
+		//! Serialised data of each row, rows with null data are not restored
+		QList<QByteArray> data;
+	};
+	//! Serialises all top level items after updating the array sizes, returns an empty snapshot on failure
+	Snapshot saveSnapshot() const;
+	//! Drops the data of the rows that are the same before and after a change, returns false if nothing has changed
+	/*!
+	 * Rows are compared if loadSnapshot() would reload them in place: the header, the footer and the
+	 * blocks with the same types at the start and the end. The rows of the other blocks are always kept.
+	 */
+	bool diffSnapshots( Snapshot & before, Snapshot & after ) const;
+	//! Restores the rows of a snapshot, if the block types do not match the snapshot, the blocks between the matching ones are recreated
+	bool loadSnapshot( const Snapshot & snapshot );
 	//! Resets the model to its original state in any attached views.
 	void reset();
 
-	//! Invalidate only the conditions of the items dependent on this item
-	void invalidateDependentConditions( NifItem * item );
+	//! Invalidate only the conditions of the items dependent on this item, optionally returning the invalidated items
+	void invalidateDependentConditions( NifItem * item, QList<NifItem *> * invalidatedItems = nullptr );
 	//! Reset all cached conditions of the header
 	void invalidateHeaderConditions();
 
@@ -148,8 +168,12 @@ public:
 	// TODO(Gavrant): try replace it with getHeaderItem
 	QModelIndex getHeaderIndex() const;
 
-	//! Updates the header infos ( num blocks etc. )
-	void updateHeader();
+	/*! Updates the header infos ( num blocks etc. )
+	 *
+	 * @param updateBlockSizes	If false, the values of the Block Size array are not calculated, save() takes them
+	 *							from the serialised blocks instead
+	 */
+	void updateHeader( bool updateBlockSizes = true );
 	//! Extracts the 0x01 separated args from NiDataStream. NiDataStream is the only known block to use RTTI args.
 	QString extractRTTIArgs( const QString & RTTIName, NiMesh::DataStreamMetadata & metadata ) const;
 	//! Creates the 0x01 separated args for NiDataStream. NiDataStream is the only known block to use RTTI args.
@@ -706,7 +730,14 @@ protected:
 
 	bool loadItem( NifItem * parent, NifIStream & stream );
 	bool loadHeader( NifItem * parent, NifIStream & stream );
+	//! Loads the blocks on multiple threads using the block sizes in the header, returns false without loading anything if that is not possible
+	/*!
+	 * The device must be a QBuffer or a QFile that can be memory mapped, the blocks are parsed from its data without copying it.
+	 */
+	bool loadBlocksParallel( QIODevice & device, int numBlocks, bool ignoreSize );
 	bool saveItem( const NifItem * parent, NifOStream & stream ) const;
+	//! Serialises numRows top level items starting at firstRow to separate buffers on multiple threads, returns the first row that failed or -1
+	int saveRows( QList<QByteArray> & rowData, int firstRow, int numRows ) const;
 	bool fileOffset( const NifItem * parent, const NifItem * target, NifSStream & stream, int & ofs ) const;
 
 protected:
@@ -714,9 +745,11 @@ protected:
 	void insertType( NifItem * parent, const NifData & data, int row = -1 );
 	NifItem * insertBranch( NifItem * parent, const NifData & data, int row = -1 );
 
+	//! Updates the link graph, only rescanning the links of block if it is not -1
 	void updateLinks( int block = -1 );
 	void updateLinks( int block, NifItem * parent );
-	void checkLinks( int block, QStack<int> & parents );
+	//! Rebuilds childLinks and rootLinks from blockLinks, removing links that would create cycles
+	void checkLinks();
 	void adjustLinks( NifItem * parent, int block, int delta );
 	void mapLinks( NifItem * parent, const QMap<qint32, qint32> & map );
 
@@ -726,8 +759,11 @@ protected:
 	quint32 version;
 	quint32 bsVersion;
 
-	QHash<int, QList<int> > childLinks;
-	QHash<int, QList<int> > parentLinks;
+	//! Child links of each block as read from the block, may contain cycles
+	QList<QList<int>> blockLinks;
+	//! Child links of each block without cycles
+	QList<QList<int>> childLinks;
+	QList<QList<int>> parentLinks;
 	QList<int> rootLinks;
 	static bool insertLink( QList<int> & l, int n );
 
@@ -797,6 +833,10 @@ public:
 protected:
 	//! Parse the XML file using a NifXmlHandler
 	static QString parseXmlDescription( const QString & filename );
+	//! Load the XML structures from a binary schema cache, fails if the cache key does not match
+	static bool loadSchemaCache( const QString & cacheName, const QByteArray & key );
+	//! Write the XML structures parsed by handler to a binary schema cache
+	static void saveSchemaCache( const QString & cacheName, const QByteArray & key, const NifXmlHandler & handler );
 
 	// XML structures
 	static QList<quint32> supportedVersions;
@@ -35,44 +35,43 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "message.h"
 #include "model/nifmodel.h"
 
-#include <QVector>
 #include <QDebug>
+#include <QHash>
+#include <QMultiHash>
 
 
 //! @file nifproxymodel.cpp NifProxyItem
 
+//! Maps block numbers to all proxy items that show the block
+using NifProxyItemIndex = QMultiHash<int, NifProxyItem *>;
+
 class NifProxyItem
 {
 public:
-	NifProxyItem( int number, NifProxyItem * parent )
+	NifProxyItem( int number, NifProxyItem * parent, NifProxyItemIndex * index )
 	{
 		blockNumber = number;
 		parentItem  = parent;
+		itemIndex   = index;
+		if ( itemIndex && blockNumber >= 0 )
+			itemIndex->insert( blockNumber, this );
 	}
 	~NifProxyItem()
 	{
+		if ( itemIndex && blockNumber >= 0 )
+			itemIndex->remove( blockNumber, this );
 		qDeleteAll( childItems );
 	}
 
-	NifProxyItem * getLink( int link )
+	NifProxyItem * getLink( int link ) const
 	{
-		for ( NifProxyItem * item : childItems ) {
-			if ( item->block() == link )
-				return item;
-		}
-		return nullptr;
+		return linkItems.value( link );
 	}
 
-	int rowLink( int link )
+	int rowLink( int link ) const
 	{
-		int row = 0;
-		for ( NifProxyItem * item : childItems ) {
-			if ( item->block() == link )
-				return row;
-
-			row++;
-		}
-		return -1;
+		NifProxyItem * item = getLink( link );
+		return ( item ? item->rowNumber : -1 );
 	}
 
 	NifProxyItem * addLink( int link )
@@ -82,8 +81,10 @@ public:
 		if ( child ) {
 			return child;
 		} else {
-			child = new NifProxyItem( link, this );
+			child = new NifProxyItem( link, this, itemIndex );
+			child->rowNumber = int( childItems.count() );
 			childItems.append( child );
+			linkItems.insert( link, child );
 			return child;
 		}
 	}
@@ -93,11 +94,23 @@ public:
 		NifProxyItem * child = getLink( link );
 
 		if ( child ) {
-			childItems.removeAll( child );
+			removeChild( child );
 			delete child;
 		}
 	}
 
+	//! Removes a child item without deleting it
+	void removeChild( NifProxyItem * child )
+	{
+		int at = child->rowNumber;
+		childItems.removeAt( at );
+		if ( linkItems.value( child->blockNumber ) == child )
+			linkItems.remove( child->blockNumber );
+
+		for ( int i = at; i < childItems.count(); i++ )
+			childItems.at( i )->rowNumber = i;
+	}
+
 	NifProxyItem * parent() const
 	{
 		return parentItem;
@@ -117,12 +130,13 @@ public:
 	{
 		qDeleteAll( childItems );
 		childItems.clear();
+		linkItems.clear();
 	}
 
 	int row() const
 	{
 		if ( parentItem )
-			return parentItem->childItems.indexOf( const_cast<NifProxyItem *>(this) );
+			return rowNumber;
 
 		return 0;
 	}
@@ -132,6 +146,25 @@ public:
 		return blockNumber;
 	}
 
+	int depth() const
+	{
+		int d = 0;
+		for ( NifProxyItem * parent = parentItem; parent; parent = parent->parentItem )
+			d++;
+
+		return d;
+	}
+
+	bool isDescendantOf( const NifProxyItem * item ) const
+	{
+		for ( NifProxyItem * parent = parentItem; parent; parent = parent->parentItem ) {
+			if ( parent == item )
+				return true;
+		}
+
+		return false;
+	}
+
 	QList<int> parentBlocks() const
 	{
 		QList<int> parents;
@@ -154,52 +187,59 @@ public:
 		return blocks;
 	}
 
-	NifProxyItem * findItem( int b, bool scanParents = true )
+	//! Finds an item for block b, preferring this item, then its closest descendant, then the item closest to the root
+	NifProxyItem * findItem( int b )
 	{
 		if ( blockNumber == b )
 			return this;
 
-		for ( NifProxyItem * child : childItems ) {
-			if ( child->blockNumber == b )
-				return child;
-		}
-
-		for ( NifProxyItem * child : childItems ) {
-			if ( NifProxyItem * x = child->findItem( b, false ) )
-				return x;
-		}
-
-		if ( parentItem && scanParents ) {
-			NifProxyItem * root = parentItem;
-
-			while ( root && root->parentItem )
-				root = root->parentItem;
+		if ( NifProxyItem * child = getLink( b ) )
+			return child;
 
-			if ( NifProxyItem * x = root->findItem( b, false ) )
-				return x;
+		if ( !itemIndex )
+			return nullptr;
+
+		NifProxyItem * found = nullptr;
+		int foundDepth = 0;
+		bool foundDescendant = false;
+		for ( auto it = itemIndex->constFind( b ); it != itemIndex->cend() && it.key() == b; ++it ) {
+			NifProxyItem * item = it.value();
+			bool isDescendant = item->isDescendantOf( this );
+			if ( foundDescendant && !isDescendant )
+				continue;
+
+			int d = item->depth();
+			if ( !found || ( isDescendant && !foundDescendant ) || d < foundDepth ) {
+				found = item;
+				foundDepth = d;
+				foundDescendant = isDescendant;
+			}
 		}
 
-		return nullptr;
+		return found;
 	}
 
-	void findAllItems( int b, QList<NifProxyItem *> & list )
+	QList<NifProxyItem *> findAllItems( int b ) const
 	{
-		for ( NifProxyItem * item : childItems ) {
-			item->findAllItems( b, list );
-		}
+		if ( !itemIndex )
+			return {};
 
-		if ( blockNumber == b )
-			list.append( this );
+		return itemIndex->values( b );
 	}
 
 	int blockNumber;
+	//! Row in the parent item
+	int rowNumber = 0;
 	NifProxyItem * parentItem;
+	NifProxyItemIndex * itemIndex;
 	QList<NifProxyItem *> childItems;
+	//! Child items by block number
+	QHash<int, NifProxyItem *> linkItems;
 };
 
 NifProxyModel::NifProxyModel( QObject * parent ) : QAbstractItemModel( parent )
 {
-	root = new NifProxyItem( -1, 0 );
+	root = new NifProxyItem( -1, nullptr, &itemIndex );
 	nif = nullptr;
 }
 
@@ -473,8 +513,7 @@ QList<QModelIndex> NifProxyModel::mapFrom( const QModelIndex & idx ) const
 	if ( blockNumber < 0 )
 		return indices;
 
-	QList<NifProxyItem *> items;
-	root->findAllItems( blockNumber, items );
+	const QList<NifProxyItem *> items = root->findAllItems( blockNumber );
 	for ( NifProxyItem * item : items ) {
 		indices.append( createIndex( item->row(), idx.column() != NifModel::NameCol ? 1 : 0, item ) );
 	}
@@ -573,12 +612,11 @@ void NifProxyModel::xRowsAboutToBeRemoved( const QModelIndex & parent, int first
 	if ( !parent.isValid() ) {
 		// block removed
 		for ( int c = first; c <= last; c++ ) {
-			QList<NifProxyItem *> list;
-			root->findAllItems( c - 1, list );
-			for ( NifProxyItem * item : list ) {
+			// Deleting an item also removes its descendants from the index, so it is looked up again after each deletion
+			while ( NifProxyItem * item = itemIndex.value( c - 1 ) ) {
 				QModelIndex idx = createIndex( item->row(), 0, item );
 				beginRemoveRows( idx.parent(), idx.row(), idx.row() );
-				item->parentItem->childItems.removeAll( item );
+				item->parentItem->removeChild( item );
 				delete item;
 				endRemoveRows();
 			}
@@ -36,6 +36,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QAbstractItemModel> // Inherited
 #include <QList>
 #include <QModelIndex>
+#include <QMultiHash>
 #include <QVariant>
 
 
@@ -93,6 +94,8 @@ protected:
 	NifModel * nif;
 
 	NifProxyItem * root;
+	//! Block number to proxy items, maintained by the items when they are created or deleted
+	QMultiHash<int, NifProxyItem *> itemIndex;
 };
 
 #endif
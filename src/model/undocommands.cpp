@@ -38,10 +38,46 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QCoreApplication>
 
 
-//! @file undocommands.cpp ChangeValueCommand, ToggleCheckBoxListCommand
+//! @file undocommands.cpp ItemRef, ChangeValueCommand, ToggleCheckBoxListCommand, SpellCommand
 
 size_t ChangeValueCommand::lastID = 0;
 
+/*
+ *  ItemRef
+ */
+
+ItemRef::ItemRef( const QModelIndex & index, const NifModel * model )
+	: idx( index ), column( index.column() )
+{
+	const NifItem * item = model->getItem( index, false );
+	if ( item )
+		name = item->name();
+
+	for ( QModelIndex i = index; i.isValid(); i = i.parent() )
+		rows.prepend( i.row() );
+}
+
+QModelIndex ItemRef::index( const NifModel * model ) const
+{
+	if ( idx.isValid() )
+		return idx;
+	if ( rows.isEmpty() )
+		return QModelIndex();
+
+	QModelIndex i;
+	for ( qsizetype n = 0; n < rows.size(); n++ ) {
+		i = model->index( rows.at( n ), ( n + 1 < rows.size() ? 0 : column ), i );
+		if ( !i.isValid() )
+			return QModelIndex();
+	}
+
+	const NifItem * item = model->getItem( i, false );
+	if ( !( item && item->name() == name ) )
+		return QModelIndex();
+
+	return i;
+}
+
 /*
  *  ChangeValueCommand
  */
@@ -50,7 +86,7 @@ ChangeValueCommand::ChangeValueCommand( const QModelIndex & index,
 	const QVariant & value, const QString & valueString, const QString & valueType, NifModel * model )
 	: QUndoCommand(), nif( model )
 {
-	idxs << index;
+	idxs << ItemRef( index, model );
 	oldValues << index.data( Qt::EditRole );
 	newValues << value;
 
@@ -69,7 +105,7 @@ ChangeValueCommand::ChangeValueCommand( const QModelIndex & index, const NifValu
 										const NifValue & newVal, const QString & valueType, NifModel * model )
 	: QUndoCommand(), nif( model )
 {
-	idxs << index;
+	idxs << ItemRef( index, model );
 	oldValues << oldVal.toVariant();
 	newValues << newVal.toVariant();
 
@@ -92,15 +128,15 @@ void ChangeValueCommand::redo()
 	if ( idxs.size() > 1 )
 		nif->setState( BaseModel::Processing );
 
-	int i = 0;
-	for ( auto idx : idxs ) {
+	for ( qsizetype i = 0; i < idxs.size(); i++ ) {
+		QModelIndex idx = idxs.at( i ).index( nif );
 		if ( idx.isValid() )
-			nif->setData( idx, newValues.at( i++ ), Qt::EditRole );
+			nif->setData( idx, newValues.at( i ), Qt::EditRole );
 	}
 
 	if ( idxs.size() > 1 ) {
 		nif->restoreState();
-		nif->dataChanged( idxs.first(), idxs.last() );
+		nif->dataChanged( idxs.first().index( nif ), idxs.last().index( nif ) );
 	}
 
 	//qDebug() << nif->data( idx ).toString();
@@ -113,15 +149,15 @@ void ChangeValueCommand::undo()
 	if ( idxs.size() > 1 )
 		nif->setState( BaseModel::Processing );
 
-	int i = 0;
-	for ( auto idx : idxs ) {
+	for ( qsizetype i = 0; i < idxs.size(); i++ ) {
+		QModelIndex idx = idxs.at( i ).index( nif );
 		if ( idx.isValid() )
-			nif->setData( idx, oldValues.at( i++ ), Qt::EditRole );
+			nif->setData( idx, oldValues.at( i ), Qt::EditRole );
 	}
 
 	if ( idxs.size() > 1 ) {
 		nif->restoreState();
-		nif->dataChanged( idxs.first(), idxs.last() );
+		nif->dataChanged( idxs.first().index( nif ), idxs.last().index( nif ) );
 	}
 
 	//qDebug() << nif->data( idx ).toString();
@@ -158,7 +194,7 @@ void ChangeValueCommand::createTransaction()
 
 ToggleCheckBoxListCommand::ToggleCheckBoxListCommand( const QModelIndex & index,
 	const QVariant & value, const QString & valueType, NifModel * model )
-	: QUndoCommand(), nif( model ), idx( index )
+	: QUndoCommand(), nif( model ), idx( index, model )
 {
 	oldValue = index.data( Qt::EditRole );
 	newValue = value;
@@ -171,8 +207,9 @@ ToggleCheckBoxListCommand::ToggleCheckBoxListCommand( const QModelIndex & index,
 void ToggleCheckBoxListCommand::redo()
 {
 	//qDebug() << "Redoing";
-	if ( idx.isValid() )
-		nif->setData( idx, newValue, Qt::EditRole );
+	QModelIndex index = idx.index( nif );
+	if ( index.isValid() )
+		nif->setData( index, newValue, Qt::EditRole );
 
 	//qDebug() << nif->data( idx ).toString();
 }
@@ -180,31 +217,87 @@ void ToggleCheckBoxListCommand::redo()
 void ToggleCheckBoxListCommand::undo()
 {
 	//qDebug() << "Undoing";
-	if ( idx.isValid() )
-		nif->setData( idx, oldValue, Qt::EditRole );
+	QModelIndex index = idx.index( nif );
+	if ( index.isValid() )
+		nif->setData( index, oldValue, Qt::EditRole );
 
 	//qDebug() << nif->data( idx ).toString();
 }
 
 ArrayUpdateCommand::ArrayUpdateCommand( const QModelIndex & index, NifModel * model )
-	: QUndoCommand(), nif( model ), idx( index )
+	: QUndoCommand(), nif( model ), idx( index, model )
 {
 	setText( QCoreApplication::translate( "ArrayUpdateCommand", "Update Array" ) );
 }
 
 void ArrayUpdateCommand::redo()
 {
-	if ( idx.isValid() ) {
-		oldSize = nif->rowCount( idx );
-		nif->updateArraySize( idx );
-		newSize = nif->rowCount( idx );
+	QModelIndex index = idx.index( nif );
+	if ( index.isValid() ) {
+		oldSize = nif->rowCount( index );
+		nif->updateArraySize( index );
+		newSize = nif->rowCount( index );
 	}
 }
 
 void ArrayUpdateCommand::undo()
 {
-	if ( idx.isValid() ) {
+	QModelIndex index = idx.index( nif );
+	if ( index.isValid() ) {
 		// TODO: Actually attempt to set the array size back
-		nif->updateArraySize( idx );
+		nif->updateArraySize( index );
 	}
 }
+
+
+/*
+ *  SpellCommand
+ */
+
+SpellCommand::SpellCommand( const QString & spellName, NifModel * model )
+	: QUndoCommand(), nif( model ), spell( spellName ), oldRows( model->saveSnapshot() )
+{
+	setText( QCoreApplication::translate( "SpellCommand", "Cast %1" ).arg( spellName ) );
+}
+
+bool SpellCommand::finish()
+{
+	if ( oldRows.data.isEmpty() )
+		return false;
+
+	newRows = nif->saveSnapshot();
+	if ( newRows.data.isEmpty() ) {
+		nif->logMessage( QCoreApplication::translate( "SpellCommand", "%1 cannot be undone." ).arg( spell ),
+						 QCoreApplication::translate( "SpellCommand", "The file could not be serialized after the spell was cast." ) );
+		return false;
+	}
+
+	// Only the changed rows are kept, if blocks have been inserted, removed or reordered,
+	// the unchanged blocks before and after them are dropped as well
+	return nif->diffSnapshots( oldRows, newRows );
+}
+
+void SpellCommand::restore( const NifModel::Snapshot & snapshot )
+{
+	if ( nif->loadSnapshot( snapshot ) )
+		return;
+
+	nif->logMessage( QCoreApplication::translate( "SpellCommand", "Could not undo or redo %1." ).arg( spell ),
+					 QCoreApplication::translate( "SpellCommand", "The file may have been restored only partially." ) );
+	setObsolete( true );
+}
+
+void SpellCommand::redo()
+{
+	if ( isCast ) {
+		isCast = false;
+		return;
+	}
+
+	restore( newRows );
+}
+
+void SpellCommand::undo()
+{
+	restore( oldRows );
+}
@@ -33,16 +33,38 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef UNDOCOMMANDS_H
 #define UNDOCOMMANDS_H
 
+#include "model/nifmodel.h"
+
 #include <QUndoCommand>
 #include <QModelIndex>
 #include <QVariant>
 
 
-//! @file undocommands.h ChangeValueCommand, ToggleCheckBoxListCommand
+//! @file undocommands.h ItemRef, ChangeValueCommand, ToggleCheckBoxListCommand, SpellCommand
 
-class NifModel;
 class NifValue;
 
+//! Reference to the item changed by an undo command
+/*!
+ * The persistent index becomes invalid when the block is recreated by SpellCommand, the item is then
+ * looked up again by its row numbers, which are the same as when the command was created.
+ */
+class ItemRef
+{
+public:
+	ItemRef() {}
+	ItemRef( const QModelIndex & index, const NifModel * model );
+
+	//! Returns the index of the item, or an invalid index if it no longer exists
+	QModelIndex index( const NifModel * model ) const;
+
+private:
+	QPersistentModelIndex idx;
+	QVector<int> rows;
+	int column = 0;
+	QString name;
+};
+
 class ChangeValueCommand : public QUndoCommand
 {
 public:
@@ -65,7 +87,7 @@ public:
 private:
 	NifModel * nif;
 	QVector<QVariant> newValues, oldValues;
-	QVector<QPersistentModelIndex> idxs;
+	QVector<ItemRef> idxs;
 
 	//! The command ID for this undo command
 	size_t localID;
@@ -84,7 +106,7 @@ public:
 private:
 	NifModel * nif;
 	QVariant newValue, oldValue;
-	QPersistentModelIndex idx;
+	ItemRef idx;
 };
 
 
@@ -97,7 +119,31 @@ public:
 private:
 	NifModel * nif;
 	uint newSize, oldSize;
-	QPersistentModelIndex idx;
+	ItemRef idx;
+};
+
+
+//! Undoes and redoes a spell by restoring the blocks it has changed
+class SpellCommand : public QUndoCommand
+{
+public:
+	//! Takes a snapshot of the model before the spell is cast
+	SpellCommand( const QString & spellName, NifModel * model );
+	//! Returns false if the snapshot before the spell could not be taken
+	bool isValid() const { return !oldRows.data.isEmpty(); }
+	//! Takes a snapshot after the spell and keeps only the rows that have changed. Returns false if nothing has changed or the snapshot failed.
+	bool finish();
+	void redo() override;
+	void undo() override;
+private:
+	//! Restores a snapshot, reports a failure and marks the command obsolete
+	void restore( const NifModel::Snapshot & snapshot );
+
+	NifModel * nif;
+	QString spell;
+	NifModel::Snapshot oldRows, newRows;
+	//! The spell has already been cast when the command is pushed to the undo stack
+	bool isCast = true;
 };
 
 #endif // UNDOCOMMANDS_H
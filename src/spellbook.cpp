@@ -32,11 +32,12 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "spellbook.h"
 
-#include "ui/checkablemessagebox.h"
+#include "model/undocommands.h"
 
 #include <QCache>
 #include <QDir>
-#include <QSettings>
+
+#include <memory>
 
 
 
@@ -109,13 +110,6 @@ SpellBook::~SpellBook()
 
 void SpellBook::cast( NifModel * nif, const QModelIndex & index, SpellPtr spell )
 {
-	QSettings cfg;
-
-	bool suppressConfirm = cfg.value( "Settings/Suppress Undoable Confirmation", false ).toBool();
-	bool accepted = false;
-
-	QDialogButtonBox::StandardButton response = QDialogButtonBox::Yes;
-
 	// Cast non-modifying spells
 	if ( spell && spell->isApplicable( nif, index ) && spell->constant() ) {
 		auto idx = spell->cast( nif, index );
@@ -123,14 +117,17 @@ void SpellBook::cast( NifModel * nif, const QModelIndex & index, SpellPtr spell
 		return;
 	}
 
-	if ( !suppressConfirm && spell->page() != "Array" ) {
-		response = CheckableMessageBox::question( this, "Confirmation", "This action cannot currently be undone. Do you want to continue?", "Do not ask me again", &accepted );
-
-		if ( accepted )
-			cfg.setValue( "Settings/Suppress Undoable Confirmation", true );
-	}
+	if ( spell && spell->isApplicable( nif, index ) ) {
+		// Unless the spell adds its own undo commands, it is undone by restoring the blocks it has changed
+		std::unique_ptr<SpellCommand> undoCmd;
+		if ( nif->undoStack && !spell->hasUndoCommand() ) {
+			undoCmd = std::make_unique<SpellCommand>( spell->name(), nif );
+			if ( !undoCmd->isValid() ) {
+				nif->logMessage( tr( "%1 cannot be undone." ).arg( spell->name() ), tr( "The file could not be serialized before the spell was cast." ) );
+				undoCmd.reset();
+			}
+		}
 
-	if ( (response == QDialogButtonBox::Yes) && spell && spell->isApplicable( nif, index ) ) {
 		bool noSignals = spell->batch();
 		if ( noSignals )
 			nif->setState( BaseModel::Processing );
@@ -143,6 +140,9 @@ void SpellBook::cast( NifModel * nif, const QModelIndex & index, SpellPtr spell
 		nif->invalidateHeaderConditions();
 		nif->updateHeader();
 
+		if ( undoCmd && undoCmd->finish() )
+			nif->undoStack->push( undoCmd.release() );
+
 		if ( nif->getProcessingResult() ) {
 			emit nif->dataChanged( idx, idx );
 		}
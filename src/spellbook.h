@@ -83,6 +83,8 @@ public:
 	virtual bool checker() const { return false; }
 	//! Whether the spell has a high processing cost
 	virtual bool batch() const { return (page() == "Batch") || (page() == "Block") || (page() == "Mesh"); }
+	//! Whether the spell adds its own commands to the undo stack, instead of being undone by restoring a snapshot
+	virtual bool hasUndoCommand() const { return false; }
 	//! Hotkey sequence
 	virtual QKeySequence hotkey() const { return QKeySequence(); }
 
@@ -2,6 +2,7 @@
 
 #include <QDialog>
 #include <QCheckBox>
+#include <QFile>
 #include <QFileDialog>
 #include <QGridLayout>
 #include <QLabel>
@@ -13,12 +14,17 @@
 #include <QCryptographicHash>
 
 #include "libfo76utils/src/common.hpp"
+#include "libfo76utils/src/ba2file.hpp"
 #include "libfo76utils/src/filebuf.hpp"
 #include "libfo76utils/src/material.hpp"
 #include "model/nifmodel.h"
 #include "io/nifstream.h"
+#include "lib/parallel.h"
 #include "nifskope.h"
 
+#include <deque>
+#include <unordered_map>
+
 #ifdef Q_OS_WIN32
 #  include <direct.h>
 #else
@@ -63,6 +69,8 @@ public:
 	static std::string getNifItemFilePath( NifModel * nif, const NifItem * item );
 	static std::string getOutputDirectory( const NifModel * nif = nullptr );
 	static void writeFileWithPath( const std::string & fileName, const char * buf, qsizetype bufSize );
+	//! Writes the file unless it already exists with the same size and hash. Returns false if the file was skipped.
+	static bool writeFileIfChanged( const std::string & fileName, const char * buf, qsizetype bufSize );
 
 	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
 	{
@@ -165,6 +173,23 @@ void spResourceFileExtract::writeFileWithPath( const std::string & fileName, con
 	delete f;
 }
 
+bool spResourceFileExtract::writeFileIfChanged( const std::string & fileName, const char * buf, qsizetype bufSize )
+{
+	if ( bufSize < 0 )
+		return false;
+	QFile	f( QString::fromStdString( fileName ) );
+	if ( f.size() == bufSize && f.open( QIODevice::ReadOnly ) ) {
+		QCryptographicHash	oldHash( QCryptographicHash::Sha1 );
+		if ( oldHash.addData( &f )
+			&& oldHash.result() == QCryptographicHash::hash( QByteArrayView( buf, bufSize ), QCryptographicHash::Sha1 ) ) {
+			return false;
+		}
+		f.close();
+	}
+	writeFileWithPath( fileName, buf, bufSize );
+	return true;
+}
+
 QModelIndex spResourceFileExtract::cast( NifModel * nif, const QModelIndex & index )
 {
 	if ( !nif )
@@ -228,7 +253,30 @@ public:
 	}
 
 	static void findPaths( std::set< std::string > & fileSet, NifModel * nif, const NifItem * item );
+	static void findAllPaths( std::set< std::string > & fileSet, NifModel * nif );
+	//! Extracts the resource files in fileSet to dstPath, skipping those in extractedFiles
+	/*!
+	 * The files are looked up and Starfield materials are converted to JSON on the calling thread, then
+	 * decompressed and written by worker threads, each holding one file in memory at a time. Existing files
+	 * with the same size and hash are not overwritten. Loose files that changed size since the archives were
+	 * opened are loaded again on the calling thread. The files extracted successfully are added to extractedFiles.
+	 */
+	static void extractFiles( NifModel * nif, const std::string & dstPath, const std::set< std::string > & fileSet,
+								std::set< std::string > * extractedFiles = nullptr );
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final;
+
+protected:
+	struct ExtractJob {
+		const std::string *	filePath;
+		std::string	matFileData;
+		const BA2File *	ba2File = nullptr;
+		const BA2File::FileInfo *	fileInfo = nullptr;
+		std::string	errorMessage;
+		// the loose file has changed, it needs to be loaded again after reopening the archives
+		bool	reloadArchives = false;
+		bool	extracted = false;
+	};
+	static bool findArchivedFile( ExtractJob & job, NifModel * nif );
 };
 
 void spExtractAllResources::findPaths( std::set< std::string > & fileSet, NifModel * nif, const NifItem * item )
@@ -245,54 +293,134 @@ void spExtractAllResources::findPaths( std::set< std::string > & fileSet, NifMod
 	}
 }
 
-QModelIndex spExtractAllResources::cast( NifModel * nif, const QModelIndex & index )
+void spExtractAllResources::findAllPaths( std::set< std::string > & fileSet, NifModel * nif )
 {
-	if ( !nif )
-		return index;
-
-	std::set< std::string >	fileSet;
 	for ( int b = 0; b < nif->getBlockCount(); b++ ) {
 		const NifItem * item = nif->getBlockItem( qint32(b) );
 		if ( item )
 			findPaths( fileSet, nif, item );
 	}
-	if ( fileSet.begin() == fileSet.end() )
-		return index;
+}
 
-	std::string	dstPath( spResourceFileExtract::getOutputDirectory( nif ) );
-	if ( dstPath.empty() )
-		return index;
+bool spExtractAllResources::findArchivedFile( ExtractJob & job, NifModel * nif )
+{
+	// opens the archives if necessary
+	if ( nif->findResourceFile( QString::fromStdString( *(job.filePath) ), nullptr, nullptr ).isEmpty() )
+		return false;
 
-	std::string	matFileData;
-	std::string	fullPath;
-	QByteArray	fileData;
-	try {
-		for ( std::set< std::string >::const_iterator i = fileSet.begin(); i != fileSet.end(); i++ ) {
-			matFileData.clear();
-			if ( nif->getBSVersion() >= 170 && i->ends_with( ".mat" ) && i->starts_with( "materials/" ) ) {
+	for ( const Game::GameManager::GameResources * r = &( nif->getGameResources() ); r; r = r->parent ) {
+		if ( r->ba2File && ( job.fileInfo = r->ba2File->findFile( *(job.filePath) ) ) != nullptr ) {
+			job.ba2File = r->ba2File;
+			return true;
+		}
+	}
+	return false;
+}
+
+void spExtractAllResources::extractFiles(
+	NifModel * nif, const std::string & dstPath, const std::set< std::string > & fileSet,
+	std::set< std::string > * extractedFiles )
+{
+	std::vector< ExtractJob >	jobs;
+	for ( const std::string & filePath : fileSet ) {
+		if ( extractedFiles && extractedFiles->find( filePath ) != extractedFiles->end() )
+			continue;
+
+		ExtractJob	job;
+		job.filePath = &filePath;
+		try {
+			if ( nif->getBSVersion() >= 170 && filePath.ends_with( ".mat" ) && filePath.starts_with( "materials/" ) ) {
 				CE2MaterialDB *	materials = nif->getCE2Materials();
 				if ( materials ) {
-					(void) materials->loadMaterial( *i );
-					materials->getJSONMaterial( matFileData, *i );
+					(void) materials->loadMaterial( filePath );
+					materials->getJSONMaterial( job.matFileData, filePath );
 				}
-				if ( matFileData.empty() )
+				if ( job.matFileData.empty() )
 					continue;
-			} else if ( nif->findResourceFile( QString::fromStdString( *i ), nullptr, nullptr ).isEmpty() ) {
+				job.matFileData += '\n';
+			} else if ( !findArchivedFile( job, nif ) ) {
 				continue;
 			}
+		} catch ( std::exception & e ) {
+			job.errorMessage = e.what();
+		}
+		jobs.push_back( std::move( job ) );
+	}
 
-			fullPath = dstPath;
-			fullPath += *i;
-			if ( !matFileData.empty() ) {
-				matFileData += '\n';
-				spResourceFileExtract::writeFileWithPath( fullPath, matFileData.c_str(), qsizetype(matFileData.length()) );
-			} else if ( nif->getResourceFile( fileData, *i ) ) {
-				spResourceFileExtract::writeFileWithPath( fullPath, fileData.data(), fileData.size() );
+	parallelFor( jobs.size(), [&]( size_t i ) {
+		ExtractJob &	job = jobs[i];
+		if ( !job.errorMessage.empty() )
+			return;
+		try {
+			std::string	fullPath( dstPath );
+			fullPath += *(job.filePath);
+			if ( !job.matFileData.empty() ) {
+				(void) spResourceFileExtract::writeFileIfChanged(
+					fullPath, job.matFileData.c_str(), qsizetype(job.matFileData.length()) );
+			} else {
+				BA2File::UCharArray	buf;
+				job.ba2File->extractFile( &buf, &BA2File::UCharArray::allocFunc, *(job.fileInfo) );
+				(void) spResourceFileExtract::writeFileIfChanged(
+					fullPath, reinterpret_cast< const char * >( buf.data ), qsizetype(buf.size) );
+			}
+			job.extracted = true;
+		} catch ( std::exception & e ) {
+			if ( std::string_view( e.what() ).starts_with( "BA2File: unexpected change to size of loose file" ) )
+				job.reloadArchives = true;
+			else
+				job.errorMessage = e.what();
+		}
+	} );
+
+	// getResourceFile() reopens the archives if a loose file has changed, and reports other errors
+	QByteArray	fileData;
+	for ( ExtractJob & job : jobs ) {
+		if ( !job.reloadArchives )
+			continue;
+		try {
+			if ( nif->getResourceFile( fileData, *(job.filePath) ) ) {
+				std::string	fullPath( dstPath );
+				fullPath += *(job.filePath);
+				(void) spResourceFileExtract::writeFileIfChanged( fullPath, fileData.data(), fileData.size() );
+				job.extracted = true;
 			}
+		} catch ( std::exception & e ) {
+			job.errorMessage = e.what();
 		}
-	} catch ( std::exception & e ) {
-		QMessageBox::critical( nullptr, "NifSkope error", QString("Error extracting file: %1" ).arg( e.what() ) );
 	}
+
+	QStringList	errors;
+	for ( const ExtractJob & job : jobs ) {
+		if ( !job.errorMessage.empty() )
+			errors.append( QString( "%1: %2" ).arg( QString::fromStdString( *(job.filePath) ), QString::fromStdString( job.errorMessage ) ) );
+		else if ( job.extracted && extractedFiles )
+			extractedFiles->insert( *(job.filePath) );
+	}
+	if ( !errors.isEmpty() ) {
+		if ( errors.size() > 10 ) {
+			qsizetype	n = errors.size() - 10;
+			errors.resize( 10 );
+			errors.append( QString( "(%1 more errors)" ).arg( n ) );
+		}
+		QMessageBox::critical( nullptr, "NifSkope error", QString( "Error extracting files:\n%1" ).arg( errors.join( '\n' ) ) );
+	}
+}
+
+QModelIndex spExtractAllResources::cast( NifModel * nif, const QModelIndex & index )
+{
+	if ( !nif )
+		return index;
+
+	std::set< std::string >	fileSet;
+	findAllPaths( fileSet, nif );
+	if ( fileSet.begin() == fileSet.end() )
+		return index;
+
+	std::string	dstPath( spResourceFileExtract::getOutputDirectory( nif ) );
+	if ( dstPath.empty() )
+		return index;
+
+	extractFiles( nif, dstPath, fileSet );
 	return index;
 }
 
@@ -401,16 +529,73 @@ public:
 		return ( item->hasName( "BSGeometry" ) && ( nif->get<quint32>(item, "Flags") & 0x0200 ) != 0 );
 	}
 
+	//! Index of the .mesh files written, the file names are the SHA-1 hashes of the mesh data
+	struct MeshStore {
+		// full path -> size of the files known to exist with the same contents
+		std::unordered_map< std::string, qsizetype >	blobs;
+		// reused serialization buffers
+		std::deque< QByteArray >	bufferPool;
+		// maximum total capacity of the buffers kept in bufferPool between files
+		static constexpr qsizetype	bufferPoolBudget = 0x04000000;
+		size_t	meshCnt = 0;
+		size_t	writeCnt = 0;
+		qint64	totalBytes = 0;
+		qint64	bytesWritten = 0;
+
+		QString results() const;
+		//! Releases the unused buffers and those over the budget, keeps at most maxBuffers
+		void trimBufferPool( size_t maxBuffers );
+	};
+
 	static void saveMeshData( QByteArray & meshBuf, NifModel * nif, const NifItem * meshDataItem );
-	static bool processItem( NifModel * nif, NifItem * item, const std::string & outputDirectory, const QString & meshDir );
+	//! Converts item, or all BSGeometry blocks if it is nullptr. Returns true if any meshes were converted.
+	static bool processItems( NifModel * nif, NifItem * item, MeshStore & store );
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final;
+
+protected:
+	struct MeshJob {
+		NifItem *	item;
+		int	lod;
+		QByteArray *	meshBuf;
+		QString	meshPath;
+		std::string	fullPath;
+		bool	writeFile = false;
+		std::string	errorMessage;
+	};
+	static bool isExportable( const NifModel * nif, const NifItem * item );
+	static void exportMeshes( NifModel * nif, const std::vector< NifItem * > & items,
+								const std::string & outputDirectory, const QString & meshDir, MeshStore & store );
 };
 
+QString spMeshFileExport::MeshStore::results() const
+{
+	double	writeRatio = ( meshCnt ? double( writeCnt ) / double( meshCnt ) : 1.0 );
+	double	byteRatio = ( totalBytes ? double( bytesWritten ) / double( totalBytes ) : 1.0 );
+	return QString( "%1 meshes exported, %2 files written (%3%), %4 of %5 bytes written (%6%)" )
+			.arg( meshCnt ).arg( writeCnt ).arg( writeRatio * 100.0, 0, 'f', 1 )
+			.arg( bytesWritten ).arg( totalBytes ).arg( byteRatio * 100.0, 0, 'f', 1 );
+}
+
+void spMeshFileExport::MeshStore::trimBufferPool( size_t maxBuffers )
+{
+	if ( bufferPool.size() > maxBuffers )
+		bufferPool.resize( maxBuffers );
+	qsizetype	totalCapacity = 0;
+	for ( QByteArray & b : bufferPool ) {
+		totalCapacity += b.capacity();
+		if ( totalCapacity > bufferPoolBudget ) {
+			totalCapacity -= b.capacity();
+			b = QByteArray();
+		}
+	}
+}
+
 void spMeshFileExport::saveMeshData( QByteArray & meshBuf, NifModel * nif, const NifItem * meshDataItem )
 {
 	{
+		// the capacity of meshBuf is kept when it is truncated
 		QBuffer	tmpBuf( &meshBuf );
-		tmpBuf.open( QIODevice::WriteOnly );
+		tmpBuf.open( QIODevice::WriteOnly | QIODevice::Truncate );
 		NifOStream	nifStream( nif, &tmpBuf );
 		nif->saveItem( meshDataItem, nifStream );
 	}
@@ -418,18 +603,21 @@ void spMeshFileExport::saveMeshData( QByteArray & meshBuf, NifModel * nif, const
 		meshBuf.chop( 8 );	// end of file after LODs if there are no meshlets
 }
 
-bool spMeshFileExport::processItem(
-	NifModel * nif, NifItem * item, const std::string & outputDirectory, const QString & meshDir )
+bool spMeshFileExport::isExportable( const NifModel * nif, const NifItem * item )
 {
-	quint32	flags;
-	if ( !( item && item->hasName( "BSGeometry" ) && ( (flags = nif->get<quint32>(item, "Flags")) & 0x0200 ) != 0 ) )
-		return false;
-
-	QString	meshPaths[4];
-	bool	haveMeshes = false;
+	return ( item && item->hasName( "BSGeometry" ) && ( nif->get<quint32>(item, "Flags") & 0x0200 ) != 0 );
+}
 
-	auto	meshesIndex = nif->getIndex( item, "Meshes" );
-	if ( meshesIndex.isValid() ) {
+void spMeshFileExport::exportMeshes(
+	NifModel * nif, const std::vector< NifItem * > & items,
+	const std::string & outputDirectory, const QString & meshDir, MeshStore & store )
+{
+	// serialize the LOD meshes of all blocks into pooled buffers
+	std::vector< MeshJob >	jobs;
+	for ( NifItem * item : items ) {
+		auto	meshesIndex = nif->getIndex( item, "Meshes" );
+		if ( !meshesIndex.isValid() )
+			continue;
 		for ( int l = 0; l < 4; l++ ) {
 			auto	meshIndex = nif->getIndex( meshesIndex, l );
 			if ( !( meshIndex.isValid() && nif->get<bool>(meshIndex, "Has Mesh") ) )
@@ -437,56 +625,100 @@ bool spMeshFileExport::processItem(
 			auto	meshData = nif->getIndex( nif->getIndex( meshIndex, "Mesh" ), "Mesh Data" );
 			if ( !meshData.isValid() )
 				continue;
-			haveMeshes = true;
-
-			QByteArray	meshBuf;
-			saveMeshData( meshBuf, nif, nif->getItem( meshData, false ) );
-
-			QCryptographicHash	h( QCryptographicHash::Sha1 );
-			h.addData( meshBuf );
-			meshPaths[l] = h.result().toHex();
-			if ( meshDir.isEmpty() )
-				meshPaths[l].insert( 20, QChar('\\') );
-			else
-				meshPaths[l].insert( 0, meshDir );
-
-			std::string	fullPath( outputDirectory );
-			fullPath += Game::GameManager::get_full_path( meshPaths[l], "geometries/", ".mesh" );
-			try {
-				spResourceFileExtract::writeFileWithPath( fullPath, meshBuf.data(), meshBuf.size() );
-			} catch ( std::exception & e ) {
-				QMessageBox::critical( nullptr, "NifSkope error", QString("Error extracting file: %1" ).arg( e.what() ) );
-			}
+			if ( store.bufferPool.size() <= jobs.size() )
+				store.bufferPool.emplace_back();
+			MeshJob	job;
+			job.item = item;
+			job.lod = l;
+			job.meshBuf = &( store.bufferPool[jobs.size()] );
+			saveMeshData( *(job.meshBuf), nif, nif->getItem( meshData, false ) );
+			jobs.push_back( std::move( job ) );
 		}
 	}
 
-	item->invalidateVersionCondition();
-	item->invalidateCondition();
-	nif->set<quint32>( item, "Flags", flags & ~0x0200U );
-
-	meshesIndex = nif->getIndex( item, "Meshes" );
-	for ( int l = 0; l < 4; l++ ) {
-		auto	meshIndex = nif->getIndex( meshesIndex, l );
-		if ( !( meshIndex.isValid() && nif->get<bool>(meshIndex, "Has Mesh") ) )
+	parallelFor( jobs.size(), [&]( size_t i ) {
+		MeshJob &	job = jobs[i];
+		job.meshPath = QString::fromLatin1(
+			QCryptographicHash::hash( *(job.meshBuf), QCryptographicHash::Sha1 ).toHex() );
+		if ( meshDir.isEmpty() )
+			job.meshPath.insert( 20, QChar('\\') );
+		else
+			job.meshPath.insert( 0, meshDir );
+		job.fullPath = outputDirectory;
+		job.fullPath += Game::GameManager::get_full_path( job.meshPath, "geometries/", ".mesh" );
+	} );
+
+	// only write data that is not already in the store or in the output directory
+	for ( MeshJob & job : jobs ) {
+		qsizetype	n = job.meshBuf->size();
+		store.meshCnt++;
+		store.totalBytes += n;
+		auto	i = store.blobs.find( job.fullPath );
+		if ( i != store.blobs.end() && i->second == n )
+			continue;
+		store.blobs.insert_or_assign( job.fullPath, n );
+		if ( QFile( QString::fromStdString( job.fullPath ) ).size() == n )
 			continue;
-		nif->set<QString>( nif->getIndex( meshIndex, "Mesh" ), "Mesh Path", meshPaths[l] );
+		job.writeFile = true;
 	}
 
-	return haveMeshes;
+	parallelFor( jobs.size(), [&]( size_t i ) {
+		MeshJob &	job = jobs[i];
+		if ( !job.writeFile )
+			return;
+		try {
+			spResourceFileExtract::writeFileWithPath( job.fullPath, job.meshBuf->data(), job.meshBuf->size() );
+		} catch ( std::exception & e ) {
+			job.errorMessage = e.what();
+		}
+	} );
+
+	for ( const MeshJob & job : jobs ) {
+		if ( !job.errorMessage.empty() ) {
+			store.blobs.erase( job.fullPath );
+			QMessageBox::critical( nullptr, "NifSkope error", QString("Error extracting file: %1" ).arg( job.errorMessage.c_str() ) );
+		} else if ( job.writeFile ) {
+			store.writeCnt++;
+			store.bytesWritten += job.meshBuf->size();
+		}
+	}
+	store.trimBufferPool( jobs.size() );
+
+	// switch the blocks to external geometry and store the mesh paths
+	size_t	j = 0;
+	for ( NifItem * item : items ) {
+		quint32	flags = nif->get<quint32>( item, "Flags" );
+		item->invalidateVersionCondition();
+		item->invalidateCondition();
+		nif->set<quint32>( item, "Flags", flags & ~0x0200U );
+
+		auto	meshesIndex = nif->getIndex( item, "Meshes" );
+		for ( ; j < jobs.size() && jobs[j].item == item; j++ ) {
+			auto	meshIndex = nif->getIndex( meshesIndex, jobs[j].lod );
+			nif->set<QString>( nif->getIndex( meshIndex, "Mesh" ), "Mesh Path", jobs[j].meshPath );
+		}
+	}
 }
 
-QModelIndex spMeshFileExport::cast( NifModel * nif, const QModelIndex & index )
+bool spMeshFileExport::processItems( NifModel * nif, NifItem * item, MeshStore & store )
 {
-	if ( !( nif && nif->getBSVersion() >= 170 ) )
-		return index;
-
-	NifItem *	item = nif->getItem( index, false );
-	if ( item && !( item->hasName( "BSGeometry" ) && (nif->get<quint32>(item, "Flags") & 0x0200) != 0 ) )
-		return index;
+	std::vector< NifItem * >	items;
+	if ( item ) {
+		if ( isExportable( nif, item ) )
+			items.push_back( item );
+	} else {
+		for ( int b = 0; b < nif->getBlockCount(); b++ ) {
+			NifItem *	i = nif->getBlockItem( qint32(b) );
+			if ( isExportable( nif, i ) )
+				items.push_back( i );
+		}
+	}
+	if ( items.empty() )
+		return false;
 
 	std::string	outputDirectory( spResourceFileExtract::getOutputDirectory( nif ) );
 	if ( outputDirectory.empty() )
-		return index;
+		return false;
 
 	QString	meshDir;
 	{
@@ -501,14 +733,22 @@ QModelIndex spMeshFileExport::cast( NifModel * nif, const QModelIndex & index )
 	if ( !meshDir.isEmpty() )
 		meshDir.append( QChar('\\') );
 
-	bool	meshesConverted = false;
-	if ( item ) {
-		meshesConverted = processItem( nif, item, outputDirectory, meshDir );
-	} else {
-		for ( int b = 0; b < nif->getBlockCount(); b++ )
-			meshesConverted |= processItem( nif, nif->getBlockItem( qint32(b) ), outputDirectory, meshDir );
-	}
-	if ( meshesConverted && !nif->getBatchProcessingMode() )
+	size_t	meshCnt = store.meshCnt;
+	exportMeshes( nif, items, outputDirectory, meshDir, store );
+	return ( store.meshCnt > meshCnt );
+}
+
+QModelIndex spMeshFileExport::cast( NifModel * nif, const QModelIndex & index )
+{
+	if ( !( nif && nif->getBSVersion() >= 170 ) )
+		return index;
+
+	NifItem *	item = nif->getItem( index, false );
+	if ( item && !isExportable( nif, item ) )
+		return index;
+
+	MeshStore	store;
+	if ( processItems( nif, item, store ) && !nif->getBatchProcessingMode() )
 		Game::GameManager::close_resources();
 
 	return index;
@@ -699,7 +939,15 @@ public:
 		spellFlagTangentSpace = 8,
 		spellFlagMeshlets = 16,
 		spellFlagUpdateBounds = 32,
-		spellFlagExternalGeom = 64
+		spellFlagExternalGeom = 64,
+		spellFlagExtractResources = 128
+	};
+	struct BatchProcessData {
+		int	spellMask = 0;
+		std::string	extractPath;
+		// resource files already extracted from previous models
+		std::set< std::string >	extractedFiles;
+		spMeshFileExport::MeshStore	meshStore;
 	};
 	static bool processFile( NifModel * nif, void * p );
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final;
@@ -737,7 +985,8 @@ public:
 
 bool spBatchProcessFiles::processFile( NifModel * nif, void * p )
 {
-	int	spellMask = *( reinterpret_cast< int * >( p ) );
+	BatchProcessData &	d = *( reinterpret_cast< BatchProcessData * >( p ) );
+	int	spellMask = d.spellMask;
 	bool	fileChanged = false;
 
 	if ( ( spellMask & spellFlagInternalGeom ) && nif->getBSVersion() >= 170 ) {
@@ -771,11 +1020,16 @@ bool spBatchProcessFiles::processFile( NifModel * nif, void * p )
 	}
 
 	if ( ( spellMask & spellFlagExternalGeom ) && nif->getBSVersion() >= 170 ) {
-		spMeshFileExport	sp;
-		sp.cast( nif, QModelIndex() );
+		(void) spMeshFileExport::processItems( nif, nullptr, d.meshStore );
 		fileChanged = true;
 	}
 
+	if ( spellMask & spellFlagExtractResources ) {
+		std::set< std::string >	fileSet;
+		spExtractAllResources::findAllPaths( fileSet, nif );
+		spExtractAllResources::extractFiles( nif, d.extractPath, fileSet, &d.extractedFiles );
+	}
+
 	return fileChanged;
 }
 
@@ -784,7 +1038,8 @@ QModelIndex spBatchProcessFiles::cast( [[maybe_unused]] NifModel * nif, const QM
 	if ( index.isValid() )
 		return index;
 
-	int	spellMask = 0;
+	BatchProcessData	d;
+	int &	spellMask = d.spellMask;
 	{
 		QDialog	dlg;
 		QLabel *	lb = new QLabel( &dlg );
@@ -797,6 +1052,7 @@ QModelIndex spBatchProcessFiles::cast( [[maybe_unused]] NifModel * nif, const QM
 		QCheckBox *	checkMeshlets = new QCheckBox( "Generate Meshlets and Update Bounds", &dlg );
 		QCheckBox *	checkUpdateBounds = new QCheckBox( "Update Bounds", &dlg );
 		QCheckBox *	checkExternalGeom = new QCheckBox( "Convert to External Geometry", &dlg );
+		QCheckBox *	checkExtractResources = new QCheckBox( "Extract Resource Files", &dlg );
 		QPushButton *	okButton = new QPushButton( "OK", &dlg );
 		QPushButton *	cancelButton = new QPushButton( "Cancel", &dlg );
 
@@ -812,9 +1068,10 @@ QModelIndex spBatchProcessFiles::cast( [[maybe_unused]] NifModel * nif, const QM
 		grid->addWidget( checkMeshlets, 7, 0, 1, 5 );
 		grid->addWidget( checkUpdateBounds, 8, 0, 1, 5 );
 		grid->addWidget( checkExternalGeom, 9, 0, 1, 5 );
-		grid->addWidget( new QLabel( "", &dlg ), 10, 0, 1, 5 );
-		grid->addWidget( okButton, 11, 1, 1, 1 );
-		grid->addWidget( cancelButton, 11, 3, 1, 1 );
+		grid->addWidget( checkExtractResources, 10, 0, 1, 5 );
+		grid->addWidget( new QLabel( "", &dlg ), 11, 0, 1, 5 );
+		grid->addWidget( okButton, 12, 1, 1, 1 );
+		grid->addWidget( cancelButton, 12, 3, 1, 1 );
 
 		QObject::connect( okButton, &QPushButton::clicked, &dlg, &QDialog::accept );
 		QObject::connect( cancelButton, &QPushButton::clicked, &dlg, &QDialog::reject );
@@ -836,6 +1093,8 @@ QModelIndex spBatchProcessFiles::cast( [[maybe_unused]] NifModel * nif, const QM
 			spellMask = spellMask | spellFlagUpdateBounds;
 		if ( checkExternalGeom->isChecked() )
 			spellMask = spellMask | spellFlagExternalGeom;
+		if ( checkExtractResources->isChecked() )
+			spellMask = spellMask | spellFlagExtractResources;
 		if ( !spellMask )
 			return index;
 	}
@@ -850,14 +1109,19 @@ QModelIndex spBatchProcessFiles::cast( [[maybe_unused]] NifModel * nif, const QM
 	}
 	if ( fileList.isEmpty() )
 		return index;
-	if ( spellMask & spellFlagExternalGeom )
-		(void) spResourceFileExtract::getOutputDirectory();
+	if ( spellMask & ( spellFlagExternalGeom | spellFlagExtractResources ) ) {
+		d.extractPath = spResourceFileExtract::getOutputDirectory();
+		if ( d.extractPath.empty() )
+			spellMask = spellMask & ~spellFlagExtractResources;
+	}
 
 	NifSkope *	w = dynamic_cast< NifSkope * >( nif->getWindow() );
 	if ( w ) {
-		w->batchProcessFiles( fileList, &processFile, &spellMask );
-		if ( spellMask & spellFlagExternalGeom )
+		w->batchProcessFiles( fileList, &processFile, &d );
+		if ( spellMask & ( spellFlagExternalGeom | spellFlagExtractResources ) )
 			Game::GameManager::close_resources();
+		if ( d.meshStore.meshCnt )
+			QMessageBox::information( nullptr, "Convert to External Geometry results", d.meshStore.results() );
 	}
 
 	return index;
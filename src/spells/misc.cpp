@@ -18,6 +18,7 @@ public:
 	QString page() const override final { return Spell::tr( "Array" ); }
 	QIcon icon() const override final { return QIcon( ":/img/update" ); }
 	bool instant() const override final { return true; }
+	bool hasUndoCommand() const override final { return true; }
 
 	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
 	{
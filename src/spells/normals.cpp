@@ -1,6 +1,7 @@
 #include "spellbook.h"
 
 #include "lib/nvtristripwrapper.h"
+#include "lib/parallel.h"
 
 #include <QDialog>
 #include <QDoubleSpinBox>
@@ -9,6 +10,8 @@
 #include <QPushButton>
 #include <QMessageBox>
 
+#include <vector>
+
 // Brief description is deliberately not autolinked to class Spell
 /*! \file normals.cpp
  * \brief Vertex normal spells
@@ -27,6 +30,53 @@ static inline void normalizeUDecVector4( UDecVector4 & n )
 	xyzw.convertToVector3( &(n[0]) );
 }
 
+//! Vertex data of a shape or Starfield mesh, read and written by the normals spells
+/*!
+ * The normals are calculated from the arrays only, so that multiple shapes can be
+ * processed in parallel between load() and store(), see calculateNormals().
+ */
+struct NormalsData
+{
+	enum DataType
+	{
+		NiGeometryData,	// NiTriShapeData or NiTriStripsData
+		BSVertexData,	// "Vertex Data" of BSTriShape or NiSkinPartition
+		SFMeshData		// "Normals" of BSMeshData
+	};
+
+	DataType	type = NiGeometryData;
+	QPersistentModelIndex	iData;
+	QVector<Vector3>	verts;
+	QVector<Triangle>	triangles;
+	QVector<Vector3>	norms;
+	QVector<UDecVector4>	sfNorms;
+
+	// appends the data of a shape to meshes, reads the triangles if loadTriangles is true, and the normals otherwise
+	static void load( std::vector< NormalsData > & meshes, const NifModel * nif, const QModelIndex & index,
+						bool loadTriangles );
+	void store( NifModel * nif ) const;
+};
+
+//! Reads the data of all blocks, calls calculate() on each mesh in parallel, then writes the results
+template< typename F >
+static void calculateNormals( NifModel * nif, const QList<QPersistentModelIndex> & blocks, bool loadTriangles,
+								F && calculate )
+{
+	std::vector< NormalsData >	meshes;
+	for ( const auto & index : blocks ) {
+		if ( nif->getBSVersion() >= 170 && nif->isNiBlock( index, "BSGeometry" ) && !nif->checkInternalGeometry( index ) )
+			continue;
+		NormalsData::load( meshes, nif, index, loadTriangles );
+	}
+
+	parallelFor( meshes.size(), [&meshes, &calculate]( size_t i ) {
+		calculate( meshes[i] );
+	} );
+
+	for ( const auto & m : meshes )
+		m.store( nif );
+}
+
 //! Recalculates and faces the normals of a mesh
 class spFaceNormals final : public Spell
 {
@@ -68,145 +118,166 @@ public:
 		return getShapeData( nif, index ).isValid();
 	}
 
-	static void faceNormalsSFMesh( NifModel * nif, const QModelIndex & index );
+	// does not access the model, can be called from any thread
+	static void calculate( NormalsData & m );
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
-		if ( nif->getBSVersion() >= 170 && nif->isNiBlock( index, "BSGeometry" ) ) {
-			if ( nif->checkInternalGeometry( index ) )
-				faceNormalsSFMesh( nif, index );
-			return index;
-		}
-
-		QModelIndex iData = getShapeData( nif, index );
+		calculateNormals( nif, { QPersistentModelIndex( index ) }, true, calculate );
 
-		auto faceNormals = []( const QVector<Vector3> & verts, const QVector<Triangle> & triangles, QVector<Vector3> & norms ) {
-			for ( const Triangle & tri : triangles ) {
-				Vector3 a = verts[tri[0]];
-				Vector3 b = verts[tri[1]];
-				Vector3 c = verts[tri[2]];
+		return index;
+	}
+};
 
-				Vector3 fn = Vector3::crossproduct( b - a, c - a );
-				norms[tri[0]] += fn;
-				norms[tri[1]] += fn;
-				norms[tri[2]] += fn;
-			}
+void NormalsData::load( std::vector< NormalsData > & meshes, const NifModel * nif, const QModelIndex & index,
+						bool loadTriangles )
+{
+	if ( nif->getBSVersion() >= 170 && nif->isNiBlock( index, "BSGeometry" ) ) {
+		if ( ( nif->get<quint32>(index, "Flags") & 0x0200 ) == 0 )
+			return;
+
+		auto	iMeshes = nif->getIndex( index, "Meshes" );
+		if ( !iMeshes.isValid() )
+			return;
+		for ( int i = 0; i <= 3; i++ ) {
+			if ( !nif->get<bool>( nif->getIndex( iMeshes, i ), "Has Mesh" ) )
+				continue;
+			QModelIndex	iMesh = nif->getIndex( nif->getIndex( iMeshes, i ), "Mesh" );
+			if ( !iMesh.isValid() )
+				continue;
+			QModelIndex	iMeshData = nif->getIndex( iMesh, "Mesh Data" );
+			if ( !iMeshData.isValid() )
+				continue;
 
-			for ( int n = 0; n < norms.count(); n++ ) {
-				norms[n].normalize();
+			QModelIndex	iTriangles = nif->getIndex( iMeshData, "Triangles" );
+			QModelIndex	iVertices = nif->getIndex( iMeshData, "Vertices" );
+			QModelIndex	iNormals = nif->getIndex( iMeshData, "Normals" );
+			int	numVerts;
+			if ( !( ( iTriangles.isValid() || !loadTriangles ) && iVertices.isValid() && iNormals.isValid()
+					&& ( numVerts = nif->rowCount( iVertices ) ) > 0 && nif->rowCount( iNormals ) == numVerts ) ) {
+				QMessageBox::critical( nullptr, "NifSkope error", QString("Error calculating normals for mesh %1").arg(i) );
+				continue;
 			}
-		};
-
-		if ( nif->getBSVersion() < 100 ) {
-			QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
-			QVector<Triangle> triangles;
-			QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
-			if ( iPoints.isValid() ) {
-				QVector<QVector<quint16> > strips;
+			NormalsData &	m = meshes.emplace_back();
+			m.type = SFMeshData;
+			m.iData = iNormals;
+			m.verts = nif->getArray<Vector3>( iVertices );
+			if ( loadTriangles )
+				m.triangles = nif->getArray<Triangle>( iTriangles );
+			else
+				m.sfNorms = nif->getArray<UDecVector4>( iNormals );
+		}
+		return;
+	}
 
-				for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
-					strips.append( nif->getArray<quint16>( nif->getIndex( iPoints, r ) ) );
+	QModelIndex	iData = spFaceNormals::getShapeData( nif, index );
+	if ( !iData.isValid() )
+		return;
 
-				triangles = triangulate( strips );
-			} else {
-				triangles = nif->getArray<Triangle>( iData, "Triangles" );
-			}
+	NormalsData	m;
+	m.iData = iData;
 
+	if ( nif->getBSVersion() < 100 ) {
+		m.verts = nif->getArray<Vector3>( iData, "Vertices" );
+		if ( !loadTriangles ) {
+			m.norms = nif->getArray<Vector3>( iData, "Normals" );
+		} else if ( QModelIndex iPoints = nif->getIndex( iData, "Points" ); iPoints.isValid() ) {
+			QVector<QVector<quint16> > strips;
 
-			QVector<Vector3> norms( verts.count() );
+			for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
+				strips.append( nif->getArray<quint16>( nif->getIndex( iPoints, r ) ) );
 
-			faceNormals( verts, triangles, norms );
+			m.triangles = triangulate( strips );
+		} else {
+			m.triangles = nif->getArray<Triangle>( iData, "Triangles" );
+		}
+	} else {
+		m.type = BSVertexData;
 
-			nif->set<int>( iData, "Has Normals", 1 );
-			nif->updateArraySize( iData, "Normals" );
-			nif->setArray<Vector3>( iData, "Normals", norms );
+		int numVerts;
+		auto vf = nif->get<BSVertexDesc>( index, "Vertex Desc" );
+		if ( !((vf & VertexFlags::VF_SKINNED) && nif->getBSVersion() == 100) ) {
+			numVerts = nif->get<int>( index, "Num Vertices" );
+			if ( loadTriangles )
+				m.triangles = nif->getArray<Triangle>( index, "Triangles" );
 		} else {
-			QVector<Triangle> triangles;
-			int numVerts;
-			auto vf = nif->get<BSVertexDesc>( index, "Vertex Desc" );
-			if ( !((vf & VertexFlags::VF_SKINNED) && nif->getBSVersion() == 100) ) {
-				numVerts = nif->get<int>( index, "Num Vertices" );
-				triangles = nif->getArray<Triangle>( index, "Triangles" );
-			} else {
-				// Skinned SSE
-				auto iPart = iData.parent();
-				numVerts = nif->get<uint>( iPart, "Data Size" ) / nif->get<uint>( iPart, "Vertex Size" );
+			// Skinned SSE
+			// "Num Vertices" does not exist in the partition
+			auto iPart = iData.parent();
+			numVerts = nif->get<uint>( iPart, "Data Size" ) / nif->get<uint>( iPart, "Vertex Size" );
 
-				// Get triangles from all partitions
+			// Get triangles from all partitions
+			if ( loadTriangles ) {
 				auto numParts = nif->get<int>( iPart, "Num Partitions" );
 				auto iParts = nif->getIndex( iPart, "Partitions" );
 				for ( int i = 0; i < numParts; i++ )
-					triangles << nif->getArray<Triangle>( nif->getIndex( iParts, i ), "Triangles" );
-			}
-
-			QVector<Vector3> verts;
-			verts.reserve( numVerts );
-			QVector<Vector3> norms( numVerts );
-
-			if ( nif->isNiBlock(index, "BSDynamicTriShape") ) {
-				auto dynVerts = nif->getArray<Vector4>(index, "Vertices");
-				verts.clear();
-				verts.reserve(numVerts);
-				for ( const auto & v : dynVerts )
-					verts << Vector3(v);
-			} else {
-				for ( int i = 0; i < numVerts; i++ ) {
-					auto idx = nif->getIndex( iData, i );
-
-					verts += nif->get<Vector3>(idx, "Vertex");
-				}
+					m.triangles << nif->getArray<Triangle>( nif->getIndex( iParts, i ), "Triangles" );
 			}
+		}
 
-			faceNormals( verts, triangles, norms );
+		bool	isDynamic = nif->isNiBlock( index, "BSDynamicTriShape" );
+		if ( isDynamic ) {
+			auto dynVerts = nif->getArray<Vector4>( index, "Vertices" );
+			m.verts.reserve( dynVerts.size() );
+			for ( const auto & v : dynVerts )
+				m.verts << Vector3( v );
+		}
 
-			// Pause updates between model/view
-			nif->setState( BaseModel::Processing );
+		if ( !isDynamic || !loadTriangles ) {
+			if ( !isDynamic )
+				m.verts.reserve( numVerts );
+			if ( !loadTriangles )
+				m.norms.reserve( numVerts );
 			for ( int i = 0; i < numVerts; i++ ) {
-				nif->set<ByteVector3>( nif->getIndex( iData, i ), "Normal", norms[i] );
+				auto idx = nif->getIndex( iData, i );
+
+				if ( !isDynamic )
+					m.verts += nif->get<Vector3>( idx, "Vertex" );
+				if ( !loadTriangles )
+					m.norms += nif->get<ByteVector3>( idx, "Normal" );
 			}
-			nif->resetState();
 		}
-
-		return index;
 	}
-};
 
-void spFaceNormals::faceNormalsSFMesh( NifModel * nif, const QModelIndex & index )
-{
-	if ( ( nif->get<quint32>(index, "Flags") & 0x0200 ) == 0 )
+	if ( m.verts.isEmpty() || ( !loadTriangles && m.norms.size() != m.verts.size() ) )
 		return;
+	meshes.push_back( std::move( m ) );
+}
 
-	auto	iMeshes = nif->getIndex( index, "Meshes" );
-	if ( !iMeshes.isValid() )
+void NormalsData::store( NifModel * nif ) const
+{
+	if ( !iData.isValid() )
 		return;
-	for ( int i = 0; i <= 3; i++ ) {
-		if ( !nif->get<bool>( nif->getIndex( iMeshes, i ), "Has Mesh" ) )
-			continue;
-		QModelIndex	iMesh = nif->getIndex( nif->getIndex( iMeshes, i ), "Mesh" );
-		if ( !iMesh.isValid() )
-			continue;
-		QModelIndex	iMeshData = nif->getIndex( iMesh, "Mesh Data" );
-		if ( !iMeshData.isValid() )
-			continue;
 
-		QModelIndex	iTriangles = nif->getIndex( iMeshData, "Triangles" );
-		QModelIndex	iVertices = nif->getIndex( iMeshData, "Vertices" );
-		QModelIndex	iNormals = nif->getIndex( iMeshData, "Normals" );
-		int	numVerts;
-		if ( !( iTriangles.isValid() && iVertices.isValid() && iNormals.isValid()
-				&& ( numVerts = nif->rowCount( iVertices ) ) > 0 && nif->rowCount( iNormals ) == numVerts ) ) {
-			QMessageBox::critical( nullptr, "NifSkope error", QString("Error calculating normals for mesh %1").arg(i) );
-			continue;
-		}
+	if ( type == NiGeometryData ) {
+		nif->set<int>( iData, "Has Normals", 1 );
+		nif->updateArraySize( iData, "Normals" );
+		nif->setArray<Vector3>( iData, "Normals", norms );
+	} else if ( type == BSVertexData ) {
+		int	numVerts = std::min< int >( int( norms.size() ), nif->rowCount( iData ) );
 
-		QVector< Triangle >	triangles( nif->getArray<Triangle>( iTriangles ) );
-		QVector< Vector3 >	vertices( nif->getArray<Vector3>( iVertices ) );
-		QVector< UDecVector4 >	normals;
+		// Pause updates between model/view
+		nif->setState( BaseModel::Processing );
+		for ( int i = 0; i < numVerts; i++ )
+			nif->set<ByteVector3>( nif->getIndex( iData, i ), "Normal", norms[i] );
+		nif->resetState();
+	} else {
+		nif->setArray<UDecVector4>( iData, sfNorms );
+	}
+}
+
+void spFaceNormals::calculate( NormalsData & m )
+{
+	qsizetype	numVerts = m.verts.size();
+
+	if ( m.type == NormalsData::SFMeshData ) {
+		const QVector< Vector3 > &	vertices = m.verts;
+		QVector< UDecVector4 > &	normals = m.sfNorms;
 		normals.resize( numVerts );
 		for ( auto & n : normals )
 			FloatVector4( 0.0f ).convertToFloats( &(n[0]) );
-		for ( const auto & t : triangles ) {
+		for ( const auto & t : m.triangles ) {
 			if ( qsizetype(t[0]) >= numVerts || qsizetype(t[1]) >= numVerts || qsizetype(t[2]) >= numVerts )
 				continue;
 			FloatVector4	v0( vertices.at( t[0] ) );
@@ -224,7 +295,28 @@ void spFaceNormals::faceNormalsSFMesh( NifModel * nif, const QModelIndex & index
 			normalizeUDecVector4( n );
 			n[3] = -1.0f / 3.0f;
 		}
-		nif->setArray<UDecVector4>( iNormals, normals );
+		return;
+	}
+
+	const QVector<Vector3> &	verts = m.verts;
+	QVector<Vector3> &	norms = m.norms;
+	norms.fill( Vector3(), numVerts );
+
+	for ( const Triangle & tri : m.triangles ) {
+		if ( qsizetype(tri[0]) >= numVerts || qsizetype(tri[1]) >= numVerts || qsizetype(tri[2]) >= numVerts )
+			continue;
+		Vector3 a = verts[tri[0]];
+		Vector3 b = verts[tri[1]];
+		Vector3 c = verts[tri[2]];
+
+		Vector3 fn = Vector3::crossproduct( b - a, c - a );
+		norms[tri[0]] += fn;
+		norms[tri[1]] += fn;
+		norms[tri[2]] += fn;
+	}
+
+	for ( int n = 0; n < norms.count(); n++ ) {
+		norms[n].normalize();
 	}
 }
 
@@ -244,14 +336,17 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
+		QList<QPersistentModelIndex>	blocks;
 		spFaceNormals	sp;
 		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
 			QModelIndex idx = nif->getBlockIndex( n );
 
 			if ( sp.isApplicable( nif, idx ) )
-				sp.cast( nif, idx );
+				blocks << idx;
 		}
 
+		calculateNormals( nif, blocks, true, spFaceNormals::calculate );
+
 		return index;
 	}
 };
@@ -346,10 +441,8 @@ public:
 	static bool getOptions( float & maxa, float & maxd, bool isSFMesh );
 	static void calculateSmoothNormals( float * snorms, size_t snormSize,
 										float * norms, const float * verts, size_t numVerts, float maxa, float maxd );
-	// for nif->getBSVersion() < 170
-	static void smoothNormals( NifModel * nif, const QModelIndex & index, float maxa, float maxd );
-	// for nif->getBSVersion() >= 170
-	static void smoothNormalsSFMesh( NifModel * nif, const QModelIndex & index, float maxa, float maxd );
+	// does not access the model, can be called from any thread
+	static void calculate( NormalsData & m, float maxa, float maxd );
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
@@ -359,10 +452,9 @@ public:
 		if ( !getOptions( maxa, maxd, isSFMesh ) )
 			return index;
 
-		if ( !isSFMesh )
-			smoothNormals( nif, index, maxa, maxd );
-		else if ( nif->checkInternalGeometry( index ) )
-			smoothNormalsSFMesh( nif, index, maxa, maxd );
+		calculateNormals( nif, { QPersistentModelIndex( index ) }, false, [maxa, maxd]( NormalsData & m ) {
+			calculate( m, maxa, maxd );
+		} );
 
 		return index;
 	}
@@ -478,97 +570,15 @@ void spSmoothNormals::calculateSmoothNormals( float * snorms, size_t snormSize,
 	}
 }
 
-void spSmoothNormals::smoothNormals( NifModel * nif, const QModelIndex & index, float maxa, float maxd )
+void spSmoothNormals::calculate( NormalsData & m, float maxa, float maxd )
 {
-	QModelIndex	iData = spFaceNormals::getShapeData( nif, index );
+	qsizetype	numVerts = m.verts.size();
 
-	QVector<Vector3> verts;
-	QVector<Vector3> norms;
+	// an extra vertex is needed because FloatVector4 reads 4 floats from the Vector3 arrays
+	m.verts += Vector3();
 
-	int numVerts = 0;
-
-	if ( nif->getBSVersion() < 100 ) {
-		verts = nif->getArray<Vector3>( iData, "Vertices" );
-		norms = nif->getArray<Vector3>( iData, "Normals" );
-	} else {
-		auto vf = nif->get<BSVertexDesc>( index, "Vertex Desc" );
-		if ( !((vf & VertexFlags::VF_SKINNED) && nif->getBSVersion() == 100) ) {
-			numVerts = nif->get<int>( index, "Num Vertices" );
-		} else {
-			// Skinned SSE
-			// "Num Vertices" does not exist in the partition
-			auto iPart = iData.parent();
-			numVerts = nif->get<uint>( iPart, "Data Size" ) / nif->get<uint>( iPart, "Vertex Size" );
-		}
-
-		verts.reserve( numVerts + 1 );
-		norms.reserve( numVerts + 1 );
-
-		for ( int i = 0; i < numVerts; i++ ) {
-			auto idx = nif->getIndex( iData, i );
-
-			verts += nif->get<Vector3>( idx, "Vertex" );
-			norms += nif->get<ByteVector3>( idx, "Normal" );
-		}
-	}
-
-	if ( nif->isNiBlock(index, "BSDynamicTriShape") ) {
-		auto dynVerts = nif->getArray<Vector4>(index, "Vertices");
-		verts.clear();
-		verts.reserve( numVerts + 1 );
-		for ( const auto & v : dynVerts )
-			verts << Vector3(v);
-	}
-
-	numVerts = verts.count();
-	if ( numVerts < 1 || norms.count() != numVerts )
-		return;
-	verts += Vector3();
-	norms += Vector3();
-
-	QVector<Vector3> snorms( norms );
-
-	calculateSmoothNormals( &( snorms[0][0] ), sizeof( Vector3 ),
-							&( norms[0][0] ), &( verts.constFirst()[0] ), size_t( numVerts ), maxa, maxd );
-	snorms.removeLast();
-
-	if ( nif->getBSVersion() < 100 ) {
-		nif->setArray<Vector3>( iData, "Normals", snorms );
-	} else {
-		// Pause updates between model/view
-		nif->setState( BaseModel::Processing );
-		for ( int i = 0; i < numVerts; i++ )
-			nif->set<ByteVector3>( nif->getIndex( iData, i ), "Normal", snorms[i] );
-		nif->resetState();
-	}
-}
-
-void spSmoothNormals::smoothNormalsSFMesh( NifModel * nif, const QModelIndex & index, float maxa, float maxd )
-{
-	auto	iMeshes = nif->getIndex( index, "Meshes" );
-	if ( !iMeshes.isValid() )
-		return;
-	for ( int i = 0; i <= 3; i++ ) {
-		if ( !nif->get<bool>( nif->getIndex( iMeshes, i ), "Has Mesh" ) )
-			continue;
-		QModelIndex	iMesh = nif->getIndex( nif->getIndex( iMeshes, i ), "Mesh" );
-		if ( !iMesh.isValid() )
-			continue;
-		QModelIndex	iMeshData = nif->getIndex( iMesh, "Mesh Data" );
-		if ( !iMeshData.isValid() )
-			continue;
-
-		QModelIndex	iVertices = nif->getIndex( iMeshData, "Vertices" );
-		QModelIndex	iNormals = nif->getIndex( iMeshData, "Normals" );
-		int	numVerts;
-		if ( !( iVertices.isValid() && iNormals.isValid()
-				&& ( numVerts = nif->rowCount( iVertices ) ) > 0 && nif->rowCount( iNormals ) == numVerts ) ) {
-			QMessageBox::critical( nullptr, "NifSkope error", QString("Error calculating normals for mesh %1").arg(i) );
-			continue;
-		}
-
-		QVector< Vector3 >	vertices( nif->getArray<Vector3>( iVertices ) );
-		QVector< UDecVector4 >	snorms( nif->getArray<UDecVector4>( iNormals ) );
+	if ( m.type == NormalsData::SFMeshData ) {
+		QVector< UDecVector4 > &	snorms = m.sfNorms;
 
 		QVector< Vector3 >	norms;
 		norms.reserve( snorms.count() + 1 );
@@ -576,15 +586,23 @@ void spSmoothNormals::smoothNormalsSFMesh( NifModel * nif, const QModelIndex & i
 			n[3] = float( -1.0 / 3.0 );
 			norms += Vector3( n );
 		}
-
-		vertices += Vector3();
 		norms += Vector3();
 
 		calculateSmoothNormals( &( snorms[0][0] ), sizeof( UDecVector4 ),
-								&( norms[0][0] ), &( vertices.constFirst()[0] ), size_t( numVerts ), maxa, maxd );
+								&( norms[0][0] ), &( m.verts.constFirst()[0] ), size_t( numVerts ), maxa, maxd );
+	} else {
+		QVector<Vector3> &	norms = m.norms;
+		norms += Vector3();
+
+		QVector<Vector3> snorms( norms );
 
-		nif->setArray<UDecVector4>( iNormals, snorms );
+		calculateSmoothNormals( &( snorms[0][0] ), sizeof( Vector3 ),
+								&( norms[0][0] ), &( m.verts.constFirst()[0] ), size_t( numVerts ), maxa, maxd );
+		snorms.removeLast();
+		norms = snorms;
 	}
+
+	m.verts.removeLast();
 }
 
 REGISTER_SPELL( spSmoothNormals )
@@ -609,18 +627,19 @@ public:
 		if ( !spSmoothNormals::getOptions( maxa, maxd, isSFMesh ) )
 			return index;
 
+		QList<QPersistentModelIndex>	blocks;
 		spSmoothNormals	sp;
 		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
 			QModelIndex idx = nif->getBlockIndex( n );
 
-			if ( sp.isApplicable( nif, idx ) ) {
-				if ( !isSFMesh )
-					sp.smoothNormals( nif, idx, maxa, maxd );
-				else
-					sp.smoothNormalsSFMesh( nif, idx, maxa, maxd );
-			}
+			if ( sp.isApplicable( nif, idx ) )
+				blocks << idx;
 		}
 
+		calculateNormals( nif, blocks, false, [maxa, maxd]( NormalsData & m ) {
+			spSmoothNormals::calculate( m, maxa, maxd );
+		} );
+
 		return index;
 	}
 };
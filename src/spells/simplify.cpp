@@ -1,8 +1,10 @@
 #include "mesh.h"
 #include "gl/gltools.h"
+#include "lib/parallel.h"
 
 #include <QSettings>
 #include <cfloat>
+#include <chrono>
 #include <unordered_set>
 
 #include "fp32vec4.hpp"
@@ -23,21 +25,26 @@ public:
 	QString page() const override final { return Spell::tr( "Mesh" ); }
 
 	struct Meshes {
-		size_t	totalIndices;
-		size_t	totalVertices;
-		std::vector< unsigned int >	indices;
-		std::vector< unsigned int >	newIndices[3];
-		std::vector< float >	positions;
-		std::vector< std::uint32_t >	blockNumbers;
-		std::vector< unsigned int >	blockVertexRanges;
-		Meshes()
-			: totalIndices( 0 ), totalVertices( 0 ), blockVertexRanges( 1, 0U )
-		{
-		}
+		struct Block {
+			std::uint32_t	blockNumber;
+			std::vector< unsigned int >	indices;
+			std::vector< float >	positions;
+			std::vector< unsigned int >	newIndices[3];
+			// simplification error relative to the size of all meshes
+			float	errors[3];
+			// time spent on simplifying each LOD, in seconds
+			double	times[3];
+			Block( std::uint32_t n )
+				: blockNumber( n ), errors{ 0.0f, 0.0f, 0.0f }, times{ 0.0, 0.0, 0.0 }
+			{
+			}
+			void simplify( int l, float targetCnt_f, float targetErr, size_t minTriCnt, size_t sloppyTriCnt,
+							float totalScale );
+		};
+		std::vector< Block >	blocks;
 		static void getTransform( Transform & t, const NifModel * nif, const QModelIndex & index );
 		void loadGeometryData( const NifModel * nif, const QModelIndex & index );
 		void simplifyMeshes( bool noMessages = false );
-		int vertexBlockNum( unsigned int v ) const;
 		void saveGeometryData( NifModel * nif ) const;
 	};
 
@@ -138,28 +145,62 @@ void spSimplifySFMesh::Meshes::loadGeometryData( const NifModel * nif, const QMo
 				QMessageBox::critical( nullptr, "NifSkope error", QString("Mesh has invalid indices, cannot generate LODs") );
 				return;
 			}
-			tmpIndices[j * 3] = (unsigned int) ( totalVertices + tmp[0] );
-			tmpIndices[j * 3 + 1] = (unsigned int) ( totalVertices + tmp[1] );
-			tmpIndices[j * 3 + 2] = (unsigned int) ( totalVertices + tmp[2] );
+			tmpIndices[j * 3] = tmp[0];
+			tmpIndices[j * 3 + 1] = tmp[1];
+			tmpIndices[j * 3 + 2] = tmp[2];
 		}
 	}
 
-	totalIndices = totalIndices + indicesCnt;
-	totalVertices = totalVertices + numVerts;
-	indices.insert( indices.end(), tmpIndices.begin(), tmpIndices.end() );
-	positions.insert( positions.end(), tmpPositions.begin(), tmpPositions.end() );
-	blockNumbers.push_back( std::uint32_t(blockNum) );
-	blockVertexRanges.push_back( (unsigned int) totalVertices );
+	Block &	b = blocks.emplace_back( std::uint32_t(blockNum) );
+	b.indices = std::move( tmpIndices );
+	b.positions = std::move( tmpPositions );
+}
+
+void spSimplifySFMesh::Meshes::Block::simplify(
+	int l, float targetCnt_f, float targetErr, size_t minTriCnt, size_t sloppyTriCnt, float totalScale )
+{
+	size_t	indicesCnt = indices.size();
+	size_t	numVerts = positions.size() / 3;
+	size_t	numTriangles = indicesCnt / 3;
+	size_t	targetCnt = std::max< size_t >( size_t( roundFloat( float( numTriangles ) * targetCnt_f ) ), minTriCnt );
+
+	std::vector< unsigned int > &	newIndicesL = newIndices[l];
+	newIndicesL.resize( indicesCnt );
+	size_t	newIndicesCnt = 0;
+	if ( targetCnt >= numTriangles ) {
+		newIndicesCnt = indicesCnt;
+		std::memcpy( newIndicesL.data(), indices.data(), newIndicesCnt * sizeof(unsigned int) );
+	} else {
+		// the target error is relative to the size of all meshes, convert it to the scale of this one
+		float	meshScale = meshopt_simplifyScale( positions.data(), numVerts, sizeof(float) * 3 );
+		float	errScale = ( meshScale > 0.0f ? totalScale / meshScale : 1.0f );
+		float	err = 0.0f;
+		if ( sloppyTriCnt && numTriangles >= sloppyTriCnt ) {
+			newIndicesCnt = meshopt_simplifySloppy(
+								newIndicesL.data(), indices.data(), indicesCnt,
+								positions.data(), numVerts, sizeof(float) * 3,
+								targetCnt * 3, targetErr * errScale, &err );
+		} else {
+			newIndicesCnt = meshopt_simplify(
+								newIndicesL.data(), indices.data(), indicesCnt,
+								positions.data(), numVerts, sizeof(float) * 3,
+								targetCnt * 3, targetErr * errScale, meshopt_SimplifyLockBorder, &err );
+		}
+		errors[l] = err / errScale;
+	}
+	newIndicesL.resize( newIndicesCnt );
 }
 
 void spSimplifySFMesh::Meshes::simplifyMeshes( bool noMessages )
 {
-	if ( blockNumbers.empty() || !( totalIndices >= 3 && totalVertices >= 1 ) )
+	if ( blocks.empty() )
 		return;
 
 	QSettings	settings;
-	Vector3	err;
-	int	numTriangles = int( totalIndices / 3 );
+	float	targetCnts[3];
+	float	targetErrs[3];
+	size_t	minTriCnts[3];
+	int	numLODs = 0;
 	for ( int l = 0; l < 3; l++ ) {
 		float	x = 0.2f / float( 1 << l );
 		x = settings.value( QString("Settings/Nif/Sf LOD Gen Target Cnt %1").arg(l + 1), x ).toFloat();
@@ -169,78 +210,85 @@ void spSimplifySFMesh::Meshes::simplifyMeshes( bool noMessages )
 		float	targetErr = std::min( std::max( x, 0.0f ), 1.0f );
 		int	n = 200 >> l;
 		n = settings.value( QString("Settings/Nif/Sf LOD Gen Min Tri Cnt %1").arg(l + 1), n ).toInt();
-		size_t	minTriCnt = size_t( std::min< int >( std::max< int >( n, 0 ), 1000000 ) ) * blockNumbers.size();
-		minTriCnt = std::min< size_t >( minTriCnt, 1000000000 );
 
 		if ( !( targetCnt_f >= 0.0005f && targetErr < 0.99995f ) )
 			break;
 
-		newIndices[l].resize( totalIndices );
-		size_t	newIndicesCnt = 0;
-		int	targetCnt = std::max< int >( roundFloat( float( numTriangles ) * targetCnt_f ), int( minTriCnt ) );
-		if ( targetCnt >= numTriangles ) {
-			newIndicesCnt = totalIndices;
-			std::memcpy( newIndices[l].data(), indices.data(), newIndicesCnt * sizeof(unsigned int) );
-		} else {
-			newIndicesCnt = meshopt_simplify(
-								newIndices[l].data(), indices.data(), totalIndices,
-								positions.data(), totalVertices, sizeof(float) * 3,
-								size_t(targetCnt) * 3, targetErr, meshopt_SimplifyLockBorder, &(err[l]) );
+		targetCnts[l] = targetCnt_f;
+		targetErrs[l] = targetErr;
+		minTriCnts[l] = size_t( std::min< int >( std::max< int >( n, 0 ), 1000000 ) );
+		numLODs = l + 1;
+	}
+	// meshes with at least this many triangles are simplified with meshopt_simplifySloppy(), 0 to disable
+	int	n = settings.value( "Settings/Nif/Sf LOD Gen Sloppy Min Tri Cnt", 0 ).toInt();
+	size_t	sloppyTriCnt = size_t( std::max< int >( n, 0 ) );
+
+	// the simplification error is relative to the extent of all meshes
+	FloatVector4	boundsMin( FLT_MAX );
+	FloatVector4	boundsMax( -FLT_MAX );
+	size_t	numTriangles = 0;
+	for ( const auto & b : blocks ) {
+		for ( size_t i = 0; ( i + 3 ) <= b.positions.size(); i = i + 3 ) {
+			FloatVector4	v( b.positions[i], b.positions[i + 1], b.positions[i + 2], 0.0f );
+			boundsMin.minValues( v );
+			boundsMax.maxValues( v );
 		}
-		newIndices[l].resize( newIndicesCnt );
+		numTriangles = numTriangles + ( b.indices.size() / 3 );
+	}
+	boundsMax -= boundsMin;
+	float	totalScale = std::max( std::max( boundsMax[0], boundsMax[1] ), boundsMax[2] );
+
+	// each LOD of each mesh is a separate job
+	auto	t0 = std::chrono::steady_clock::now();
+	if ( numLODs > 0 ) {
+		parallelFor( blocks.size() * size_t( numLODs ), [&]( size_t i ) {
+			Block &	b = blocks[i / size_t( numLODs )];
+			int	l = int( i % size_t( numLODs ) );
+			auto	t = std::chrono::steady_clock::now();
+			b.simplify( l, targetCnts[l], targetErrs[l], minTriCnts[l], sloppyTriCnt, totalScale );
+			b.times[l] = std::chrono::duration< double >( std::chrono::steady_clock::now() - t ).count();
+		} );
 	}
+	double	totalTime = std::chrono::duration< double >( std::chrono::steady_clock::now() - t0 ).count();
 
 	if ( noMessages )
 		return;
+	size_t	lodTriangles[3] = { 0, 0, 0 };
+	float	lodErrors[3] = { 0.0f, 0.0f, 0.0f };
+	QString	details;
+	for ( const auto & b : blocks ) {
+		details.append( QString( "Block %1: %2 triangles" ).arg( b.blockNumber ).arg( b.indices.size() / 3 ) );
+		for ( int l = 0; l < numLODs; l++ ) {
+			lodTriangles[l] += b.newIndices[l].size() / 3;
+			lodErrors[l] = std::max( lodErrors[l], b.errors[l] );
+			details.append( QString( ", LOD%1: %2 (error = %3)" )
+							.arg( l + 1 ).arg( b.newIndices[l].size() / 3 ).arg( b.errors[l] ) );
+		}
+		details.append( QString( ", %1 ms\n" ).arg( ( b.times[0] + b.times[1] + b.times[2] ) * 1000.0, 0, 'f', 1 ) );
+	}
+
 	QString	msg = QString( "LOD0: %1 triangles" ).arg( numTriangles );
 	for ( int l = 0; l < 3; l++ )
-		msg.append( QString("\nLOD%1: %2 triangles, error = %3").arg(l + 1).arg(newIndices[l].size() / 3).arg(err[l]) );
-	QMessageBox::information( nullptr, "LOD generation results", msg );
-}
-
-int spSimplifySFMesh::Meshes::vertexBlockNum( unsigned int v ) const
-{
-	if ( blockVertexRanges.empty() || v >= blockVertexRanges.back() )
-		return -1;
-	size_t	n0 = 0;
-	size_t	n2 = blockVertexRanges.size() - 1;
-	while ( ( n0 + 1 ) < n2 ) {
-		size_t	n1 = ( n0 + n2 ) >> 1;
-		( v < blockVertexRanges[n1] ? n2 : n0 ) = n1;
-	}
-	return int( n0 );
+		msg.append( QString("\nLOD%1: %2 triangles, error = %3").arg(l + 1).arg(lodTriangles[l]).arg(lodErrors[l]) );
+	msg.append( QString( "\n\n%1 meshes simplified in %2 seconds" ).arg( blocks.size() ).arg( totalTime, 0, 'f', 3 ) );
+	QMessageBox	msgBox( QMessageBox::Information, "LOD generation results", msg, QMessageBox::Ok );
+	msgBox.setDetailedText( details );
+	msgBox.exec();
 }
 
 void spSimplifySFMesh::Meshes::saveGeometryData( NifModel * nif ) const
 {
-	if ( blockNumbers.empty() || !( totalIndices >= 3 && totalVertices >= 1 ) )
-		return;
-
-	QVector< QVector< QVector< Triangle > > >	blockTriangles;
-	blockTriangles.resize( qsizetype(blockNumbers.size()) );
-	for ( auto & b : blockTriangles )
-		b.resize( 3 );
-	for ( int l = 0; l < 3; l++ ) {
-		for ( size_t i = 0; ( i + 3 ) <= newIndices[l].size(); i = i + 3 ) {
-			unsigned int	v0 = newIndices[l][i];
-			unsigned int	v1 = newIndices[l][i + 1];
-			unsigned int	v2 = newIndices[l][i + 2];
-			int	b0 = vertexBlockNum( v0 );
-			int	b1 = vertexBlockNum( v1 );
-			int	b2 = vertexBlockNum( v2 );
-			if ( ( b0 | b1 | b2 ) < 0 || b0 != b1 || b0 != b2 ) {
-				QMessageBox::critical( nullptr, "NifSkope error", QString("spSimplifySFMesh: internal error: invalid index in simplified mesh data") );
-				return;
+	for ( const auto & blk : blocks ) {
+		QVector< QVector< Triangle > >	blockTriangles( 3 );
+		for ( int l = 0; l < 3; l++ ) {
+			const std::vector< unsigned int > &	newIndices = blk.newIndices[l];
+			for ( size_t i = 0; ( i + 3 ) <= newIndices.size(); i = i + 3 ) {
+				blockTriangles[l].append( Triangle( quint16(newIndices[i]), quint16(newIndices[i + 1]),
+													quint16(newIndices[i + 2]) ) );
 			}
-			v0 -= blockVertexRanges[b0];
-			v1 -= blockVertexRanges[b0];
-			v2 -= blockVertexRanges[b0];
-			blockTriangles[b0][l].append( Triangle( quint16(v0), quint16(v1), quint16(v2) ) );
 		}
-	}
 
-	for ( int b = 0; b < int( blockNumbers.size() ); b++ ) {
-		QModelIndex	index = nif->getBlockIndex( qint32(blockNumbers[b]) );
+		QModelIndex	index = nif->getBlockIndex( qint32(blk.blockNumber) );
 		if ( !( index.isValid() && nif->blockInherits( index, "BSGeometry" ) ) ) {
 			QMessageBox::critical( nullptr, "NifSkope error", QString("spSimplifySFMesh: internal error: block not found") );
 			continue;
@@ -271,7 +319,7 @@ void spSimplifySFMesh::Meshes::saveGeometryData( NifModel * nif ) const
 		if ( auto i = nif->getIndex( iMeshData, "LODs" ); i.isValid() )
 			nif->updateArraySize( i );
 		for ( int l = 0; l < 3; l++ ) {
-			const QVector< Triangle > &	newTriangles = blockTriangles.at( b ).at( l );
+			const QVector< Triangle > &	newTriangles = blockTriangles.at( l );
 			size_t	newIndicesCnt = size_t( newTriangles.size() ) * 3;
 
 			QModelIndex	iMesh = nif->getIndex( index, "Meshes" );
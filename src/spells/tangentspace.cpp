@@ -1,6 +1,7 @@
 #include "tangentspace.h"
 
 #include "lib/nvtristripwrapper.h"
+#include "lib/parallel.h"
 
 #include <QMessageBox>
 
@@ -48,37 +49,89 @@ bool spTangentSpace::isApplicable( const NifModel * nif, const QModelIndex & ind
 	return false;
 }
 
+struct spTangentSpace::MeshData
+{
+	// shape, or BSMeshData for Starfield
+	QPersistentModelIndex	iShape;
+	QPersistentModelIndex	iData;
+	QPersistentModelIndex	iPartBlock;
+	bool	isSFMesh = false;
+	bool	isBSTriShape = false;
+
+	QVector<Vector3>	verts;
+	QVector<Vector2>	texco;
+	QVector<Triangle>	triangles;
+	QVector<Vector3>	norms;		// nif->getBSVersion() < 170
+	QVector<Vector4>	sfNormals;	// nif->getBSVersion() >= 170
+
+	// output
+	QVector<Vector3>	tan;
+	QVector<Vector3>	bin;
+	QVector<UDecVector4>	sfTangents;
+};
+
 QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 {
-	if ( nif->getBSVersion() >= 170 ) {
-		if ( nif->checkInternalGeometry( iBlock ) )
-			tangentSpaceSFMesh( nif, iBlock );
-		return iBlock;
+	QPersistentModelIndex iShape = iBlock;
+	castMultiple( nif, { iShape } );
+	return iShape;
+}
+
+void spTangentSpace::castMultiple( NifModel * nif, const QList<QPersistentModelIndex> & blocks,
+									bool checkInternalGeometry )
+{
+	std::vector< MeshData >	meshes;
+
+	for ( const auto & iBlock : blocks ) {
+		if ( !iBlock.isValid() )
+			continue;
+		if ( nif->getBSVersion() >= 170 ) {
+			if ( !checkInternalGeometry || nif->checkInternalGeometry( iBlock ) )
+				loadSFMeshData( meshes, nif, iBlock );
+		} else {
+			loadMeshData( meshes, nif, iBlock );
+		}
 	}
 
-	QPersistentModelIndex iShape = iBlock;
+	parallelFor( meshes.size(), [&meshes]( size_t i ) {
+		calculate( meshes[i] );
+	} );
+
+	for ( const auto & m : meshes )
+		storeMeshData( nif, m );
+}
+
+void spTangentSpace::tangentSpaceSFMesh( NifModel * nif, const QModelIndex & index )
+{
+	castMultiple( nif, { QPersistentModelIndex( index ) }, false );
+}
+
+bool spTangentSpace::loadMeshData( std::vector< MeshData > & meshes, const NifModel * nif, const QModelIndex & iBlock )
+{
+	MeshData	m;
+	m.iShape = iBlock;
 	QModelIndex iData;
 	QModelIndex iPartBlock;
 	bool	isBSTriShape = ( nif->getBSVersion() >= 100 && !nif->blockInherits( iBlock, "NiTriShape" ) );
 	if ( !isBSTriShape ) {
-		iData = nif->getBlockIndex( nif->getLink( iShape, "Data" ) );
+		iData = nif->getBlockIndex( nif->getLink( iBlock, "Data" ) );
 	} else {
-		auto vf = nif->get<BSVertexDesc>( iShape, "Vertex Desc" );
+		auto vf = nif->get<BSVertexDesc>( iBlock, "Vertex Desc" );
 		if ( (vf & VertexFlags::VF_SKINNED) && nif->getBSVersion() == 100 ) {
 			// Skinned SSE
-			auto skinID = nif->getLink( nif->getIndex( iShape, "Skin" ) );
+			auto skinID = nif->getLink( nif->getIndex( iBlock, "Skin" ) );
 			auto partID = nif->getLink( nif->getBlockIndex( skinID, "NiSkinInstance" ), "Skin Partition" );
 			iPartBlock = nif->getBlockIndex( partID, "NiSkinPartition" );
 			if ( iPartBlock.isValid() )
 				iData = nif->getIndex( iPartBlock, "Vertex Data" );
 		} else {
-			iData = nif->getIndex( iShape, "Vertex Data" );
+			iData = nif->getIndex( iBlock, "Vertex Data" );
 		}
 	}
 
-	QVector<Vector3> verts;
-	QVector<Vector3> norms;
-	QVector<Vector2> texco;
+	QVector<Vector3> & verts = m.verts;
+	QVector<Vector3> & norms = m.norms;
+	QVector<Vector2> & texco = m.texco;
 
 	if ( !isBSTriShape ) {
 		verts = nif->getArray<Vector3>( iData, "Vertices" );
@@ -89,7 +142,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		if ( iPartBlock.isValid() )
 			numVerts = nif->get<uint>( iPartBlock, "Data Size" ) / nif->get<uint>( iPartBlock, "Vertex Size" );
 		else
-			numVerts = nif->get<int>( iShape, "Num Vertices" );
+			numVerts = nif->get<int>( iBlock, "Num Vertices" );
 
 		verts.reserve( numVerts );
 		norms.reserve( numVerts );
@@ -103,8 +156,6 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		}
 	}
 
-	QVector<Color4> vxcol = nif->getArray<Color4>( iData, "Vertex Colors" );
-
 	if ( !isBSTriShape ) {
 		QModelIndex iTexCo = nif->getIndex( iData, "UV Sets" );
 		iTexCo = nif->getIndex( iTexCo, 0 );
@@ -112,7 +163,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 	}
 
 
-	QVector<Triangle> triangles;
+	QVector<Triangle> & triangles = m.triangles;
 	QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
 	if ( iPoints.isValid() ) {
@@ -132,7 +183,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 			for ( int i = 0; i < numParts; i++ )
 				triangles << nif->getArray<Triangle>( nif->getIndex( iParts, i ), "Triangles" );
 		} else {
-			triangles = nif->getArray<Triangle>( iShape, "Triangles" );
+			triangles = nif->getArray<Triangle>( iBlock, "Triangles" );
 		}
 	}
 
@@ -145,11 +196,152 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 			.arg( texco.count() )
 			.arg( triangles.count() )
 		);
-		return iBlock;
+		return false;
+	}
+
+	m.iData = iData;
+	m.iPartBlock = iPartBlock;
+	m.isBSTriShape = isBSTriShape;
+	meshes.push_back( std::move( m ) );
+	return true;
+}
+
+void spTangentSpace::loadSFMeshData( std::vector< MeshData > & meshes, const NifModel * nif, const QModelIndex & index )
+{
+	if ( !index.isValid() ) {
+		return;
+	} else {
+		const NifItem *	i = nif->getItem( index );
+		if ( !i )
+			return;
+		if ( !i->hasStrType( "BSMeshData" ) ) {
+			if ( i->hasStrType( "BSMesh" ) ) {
+				loadSFMeshData( meshes, nif, nif->getIndex( i, "Mesh Data" ) );
+			} else if ( i->hasStrType( "BSMeshArray" ) ) {
+				if ( nif->get<bool>( i, "Has Mesh" ) )
+					loadSFMeshData( meshes, nif, nif->getIndex( i, "Mesh" ) );
+			} else if ( nif->blockInherits( index, "BSGeometry" ) && ( nif->get<quint32>( i, "Flags" ) & 0x0200 ) ) {
+				auto	iMeshes = nif->getIndex( i, "Meshes" );
+				if ( iMeshes.isValid() && nif->isArray( iMeshes ) ) {
+					for ( int n = 0; n <= 3; n++ )
+						loadSFMeshData( meshes, nif, nif->getIndex( iMeshes, n ) );
+				}
+			}
+			return;
+		}
+	}
+
+	QModelIndex	iTriangles = nif->getIndex( index, "Triangles" );
+	QModelIndex	iVertices = nif->getIndex( index, "Vertices" );
+	QModelIndex	iUVs = nif->getIndex( index, "UVs" );
+	QModelIndex	iNormals = nif->getIndex( index, "Normals" );
+	int	numVerts;
+	if ( !( iTriangles.isValid() && iVertices.isValid() && iUVs.isValid() && iNormals.isValid()
+			&& ( numVerts = nif->rowCount( iVertices ) ) > 0
+			&& nif->rowCount( iUVs ) == numVerts && nif->rowCount( iNormals ) == numVerts ) ) {
+		QMessageBox::critical( nullptr, "NifSkope error", QString("Error calculating tangents for mesh") );
+		return;
+	}
+
+	MeshData &	m = meshes.emplace_back();
+	m.iShape = index;
+	m.isSFMesh = true;
+	m.triangles = nif->getArray<Triangle>( iTriangles );
+	m.verts = nif->getArray<Vector3>( iVertices );
+	m.texco = nif->getArray<Vector2>( iUVs );
+	m.sfNormals = nif->getArray<Vector4>( iNormals );
+}
+
+void spTangentSpace::calculate( MeshData & m )
+{
+	if ( m.isSFMesh ) {
+		const QVector< Triangle > &	triangles = m.triangles;
+		const QVector< Vector3 > &	vertices = m.verts;
+		const QVector< Vector2 > &	uvs = m.texco;
+		const QVector< Vector4 > &	normals = m.sfNormals;
+		int	numVerts = int( vertices.size() );
+
+		QVector< UDecVector4 > &	tangents = m.sfTangents;
+		tangents.resize( numVerts );
+		for ( auto & n : tangents )
+			FloatVector4( 0.0f ).convertToFloats( &(n[0]) );
+		QVector< FloatVector4 >	bitangents;
+		bitangents.resize( numVerts );
+		for ( auto & n : bitangents )
+			n = FloatVector4( 0.0f );
+
+		for ( const auto & t : triangles ) {
+			// for each triangle caculate the texture flow direction
+
+			int	i1 = t[0];
+			int	i2 = t[1];
+			int	i3 = t[2];
+			if ( i1 >= numVerts || i2 >= numVerts || i3 >= numVerts )
+				continue;
+
+			FloatVector4	v1( FloatVector4::convertVector3( &(vertices.at(i1)[0]) ) );
+			FloatVector4	v2( FloatVector4::convertVector3( &(vertices.at(i2)[0]) ) );
+			FloatVector4	v3( FloatVector4::convertVector3( &(vertices.at(i3)[0]) ) );
+
+			const Vector2 &	w1 = uvs.at( i1 );
+			const Vector2 &	w2 = uvs.at( i2 );
+			const Vector2 &	w3 = uvs.at( i3 );
+
+			FloatVector4	v2v1 = v2 - v1;
+			FloatVector4	v3v1 = v3 - v1;
+
+			Vector2	w2w1 = w2 - w1;
+			Vector2	w3w1 = w3 - w1;
+
+			FloatVector4	sdir( v2v1 * w3w1[1] - v3v1 * w2w1[1] );
+			FloatVector4	tdir( v3v1 * w2w1[0] - v2v1 * w3w1[0] );
+
+			// this seems to produce better results
+			bool	r = ( w2w1[0] * w3w1[1] < w3w1[0] * w2w1[1] );
+			sdir.normalize( r );
+			tdir.normalize( r );
+
+			for ( int j = 0; j < 3; j++ ) {
+				int i = t[j];
+
+				( FloatVector4( &(tangents[i][0]) ) + sdir ).convertToFloats( &(tangents[i][0]) );
+				bitangents[i] += tdir;
+			}
+		}
+
+		for ( const auto & n : normals ) {
+			// for each vertex calculate tangent and binormal
+			qsizetype	i = qsizetype( &n - normals.constData() );
+			FloatVector4	normal = FloatVector4::convertVector3( &(n[0]) );
+			FloatVector4	tangent = FloatVector4::convertVector3( &(tangents.at(i)[0]) );
+			FloatVector4	bitangent = FloatVector4::convertVector3( &(bitangents.at(i)[0]) );
+
+			normal.normalize();
+			tangent -= normal * normal.dotProduct3( tangent );
+			if ( !( tangent.dotProduct3( tangent ) > 0.0f ) ) [[unlikely]] {
+				tangent = normal.crossProduct3( ( normal[2] * normal[2] ) > 0.5f ?
+												FloatVector4( 0.0f, -1.0f, 0.0f, 0.0f )
+												: FloatVector4( 0.0f, 0.0f, -1.0f, 0.0f ) );
+			}
+			tangent.normalize();
+
+			tangent[3] = ( normal.crossProduct3( tangent ).dotProduct3( bitangent ) > 0.0f ? 1.0f : -1.0f );
+
+			tangent.convertToFloats( &(tangents[i][0]) );
+		}
+
+		return;
 	}
 
-	QVector<Vector3> tan( verts.count() );
-	QVector<Vector3> bin( verts.count() );
+	const QVector<Vector3> & verts = m.verts;
+	const QVector<Vector3> & norms = m.norms;
+	const QVector<Vector2> & texco = m.texco;
+	const QVector<Triangle> & triangles = m.triangles;
+
+	QVector<Vector3> & tan = m.tan;
+	QVector<Vector3> & bin = m.bin;
+	tan.resize( verts.count() );
+	bin.resize( verts.count() );
 
 	//int skptricnt = 0;
 
@@ -157,7 +349,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		// for each triangle caculate the texture flow direction
 		//qDebug() << "triangle" << t;
 
-		Triangle & tri = triangles[t];
+		const Triangle & tri = triangles[t];
 
 		int i1 = tri[0];
 		int i2 = tri[1];
@@ -253,6 +445,28 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 	}
 
 	//qDebug() << "unassigned vertices" << cnt;
+}
+
+void spTangentSpace::storeMeshData( NifModel * nif, const MeshData & m )
+{
+	if ( !( m.iShape.isValid() && ( m.isSFMesh || m.iData.isValid() ) ) )
+		return;
+
+	if ( m.isSFMesh ) {
+		nif->set<quint32>( m.iShape, "Num Tangents", quint32( m.sfTangents.size() ) );
+		QModelIndex	iTangents = nif->getIndex( m.iShape, "Tangents" );
+		if ( !iTangents.isValid() )
+			return;
+		nif->updateArraySize( iTangents );
+		nif->setArray<UDecVector4>( iTangents, m.sfTangents );
+		return;
+	}
+
+	QModelIndex iShape = m.iShape;
+	QModelIndex iData = m.iData;
+	QModelIndex iPartBlock = m.iPartBlock;
+	const QVector<Vector3> & tan = m.tan;
+	const QVector<Vector3> & bin = m.bin;
 
 	bool isOblivion = false;
 
@@ -285,7 +499,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		}
 
 		nif->set<QByteArray>( iTSpace, "Binary Data", QByteArray( (const char *)tan.data(), tan.count() * sizeof( Vector3 ) ) + QByteArray( (const char *)bin.data(), bin.count() * sizeof( Vector3 ) ) );
-	} else if ( !isBSTriShape ) {
+	} else if ( !m.isBSTriShape ) {
 		QModelIndex iBinorms  = nif->getIndex( iData, "Bitangents" );
 		QModelIndex iTangents = nif->getIndex( iData, "Tangents" );
 		nif->updateArraySize( iBinorms );
@@ -299,6 +513,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 			numVerts = nif->get<uint>( iPartBlock, "Data Size" ) / nif->get<uint>( iPartBlock, "Vertex Size" );
 		else
 			numVerts = nif->get<int>( iShape, "Num Vertices" );
+		numVerts = std::min< int >( numVerts, int( tan.count() ) );
 
 		nif->setState( BaseModel::Processing );
 		for ( int i = 0; i < numVerts; i++ ) {
@@ -311,128 +526,6 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		}
 		nif->restoreState();
 	}
-
-	return iShape;
-}
-
-void spTangentSpace::tangentSpaceSFMesh( NifModel * nif, const QModelIndex & index )
-{
-	if ( !index.isValid() ) {
-		return;
-	} else {
-		NifItem *	i = nif->getItem( index );
-		if ( !i )
-			return;
-		if ( !i->hasStrType( "BSMeshData" ) ) {
-			if ( i->hasStrType( "BSMesh" ) ) {
-				tangentSpaceSFMesh( nif, nif->getIndex( i, "Mesh Data" ) );
-			} else if ( i->hasStrType( "BSMeshArray" ) ) {
-				if ( nif->get<bool>( i, "Has Mesh" ) )
-					tangentSpaceSFMesh( nif, nif->getIndex( i, "Mesh" ) );
-			} else if ( nif->blockInherits( index, "BSGeometry" ) && ( nif->get<quint32>( i, "Flags" ) & 0x0200 ) ) {
-				auto	iMeshes = nif->getIndex( i, "Meshes" );
-				if ( iMeshes.isValid() && nif->isArray( iMeshes ) ) {
-					for ( int n = 0; n <= 3; n++ )
-						tangentSpaceSFMesh( nif, nif->getIndex( iMeshes, n ) );
-				}
-			}
-			return;
-		}
-	}
-
-	QModelIndex	iTriangles = nif->getIndex( index, "Triangles" );
-	QModelIndex	iVertices = nif->getIndex( index, "Vertices" );
-	QModelIndex	iUVs = nif->getIndex( index, "UVs" );
-	QModelIndex	iNormals = nif->getIndex( index, "Normals" );
-	int	numVerts;
-	if ( !( iTriangles.isValid() && iVertices.isValid() && iUVs.isValid() && iNormals.isValid()
-			&& ( numVerts = nif->rowCount( iVertices ) ) > 0
-			&& nif->rowCount( iUVs ) == numVerts && nif->rowCount( iNormals ) == numVerts ) ) {
-		QMessageBox::critical( nullptr, "NifSkope error", QString("Error calculating tangents for mesh") );
-		return;
-	}
-
-	QVector< Triangle >	triangles( nif->getArray<Triangle>( iTriangles ) );
-	QVector< Vector3 >	vertices( nif->getArray<Vector3>( iVertices ) );
-	QVector< Vector2 >	uvs( nif->getArray<Vector2>( iUVs ) );
-	QVector< Vector4 >	normals( nif->getArray<Vector4>( iNormals ) );
-
-	nif->set<quint32>( index, "Num Tangents", quint32(numVerts) );
-	QModelIndex	iTangents = nif->getIndex( index, "Tangents" );
-	if ( !iTangents.isValid() )
-		return;
-	nif->updateArraySize( iTangents );
-
-	QVector< UDecVector4 >	tangents;
-	tangents.resize( numVerts );
-	for ( auto & n : tangents )
-		FloatVector4( 0.0f ).convertToFloats( &(n[0]) );
-	QVector< FloatVector4 >	bitangents;
-	bitangents.resize( numVerts );
-	for ( auto & n : bitangents )
-		n = FloatVector4( 0.0f );
-
-	for ( const auto & t : triangles ) {
-		// for each triangle caculate the texture flow direction
-
-		int	i1 = t[0];
-		int	i2 = t[1];
-		int	i3 = t[2];
-		if ( i1 >= numVerts || i2 >= numVerts || i3 >= numVerts )
-			continue;
-
-		FloatVector4	v1( FloatVector4::convertVector3( &(vertices.at(i1)[0]) ) );
-		FloatVector4	v2( FloatVector4::convertVector3( &(vertices.at(i2)[0]) ) );
-		FloatVector4	v3( FloatVector4::convertVector3( &(vertices.at(i3)[0]) ) );
-
-		const Vector2 &	w1 = uvs.at( i1 );
-		const Vector2 &	w2 = uvs.at( i2 );
-		const Vector2 &	w3 = uvs.at( i3 );
-
-		FloatVector4	v2v1 = v2 - v1;
-		FloatVector4	v3v1 = v3 - v1;
-
-		Vector2	w2w1 = w2 - w1;
-		Vector2	w3w1 = w3 - w1;
-
-		FloatVector4	sdir( v2v1 * w3w1[1] - v3v1 * w2w1[1] );
-		FloatVector4	tdir( v3v1 * w2w1[0] - v2v1 * w3w1[0] );
-
-		// this seems to produce better results
-		bool	r = ( w2w1[0] * w3w1[1] < w3w1[0] * w2w1[1] );
-		sdir.normalize( r );
-		tdir.normalize( r );
-
-		for ( int j = 0; j < 3; j++ ) {
-			int i = t[j];
-
-			( FloatVector4( &(tangents[i][0]) ) + sdir ).convertToFloats( &(tangents[i][0]) );
-			bitangents[i] += tdir;
-		}
-	}
-
-	for ( const auto & n : normals ) {
-		// for each vertex calculate tangent and binormal
-		qsizetype	i = qsizetype( &n - normals.constData() );
-		FloatVector4	normal = FloatVector4::convertVector3( &(n[0]) );
-		FloatVector4	tangent = FloatVector4::convertVector3( &(tangents.at(i)[0]) );
-		FloatVector4	bitangent = FloatVector4::convertVector3( &(bitangents.at(i)[0]) );
-
-		normal.normalize();
-		tangent -= normal * normal.dotProduct3( tangent );
-		if ( !( tangent.dotProduct3( tangent ) > 0.0f ) ) [[unlikely]] {
-			tangent = normal.crossProduct3( ( normal[2] * normal[2] ) > 0.5f ?
-											FloatVector4( 0.0f, -1.0f, 0.0f, 0.0f )
-											: FloatVector4( 0.0f, 0.0f, -1.0f, 0.0f ) );
-		}
-		tangent.normalize();
-
-		tangent[3] = ( normal.crossProduct3( tangent ).dotProduct3( bitangent ) > 0.0f ? 1.0f : -1.0f );
-
-		tangent.convertToFloats( &(tangents[i][0]) );
-	}
-
-	nif->setArray<UDecVector4>( iTangents, tangents );
 }
 
 REGISTER_SPELL( spTangentSpace )
@@ -472,9 +565,7 @@ public:
 				indices << idx;
 		}
 
-		for ( const QPersistentModelIndex& idx : indices ) {
-			TSpacer.castIfApplicable( nif, idx );
-		}
+		spTangentSpace::castMultiple( nif, indices );
 
 		return QModelIndex();
 	}
@@ -496,12 +587,12 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
 	{
-		QVector<QModelIndex> blks;
+		QList<QPersistentModelIndex> blks;
 		for ( int l = 0; l < nif->getBlockCount(); l++ ) {
 			if ( nif->getBSVersion() >= 170 ) {
 				QModelIndex	idx = nif->getBlockIndex( l, "BSGeometry" );
 				if ( idx.isValid() )
-					spTangentSpace::tangentSpaceSFMesh( nif, idx );
+					blks << idx;
 				continue;
 			}
 			QModelIndex idx = nif->getBlockIndex( l, "NiTriShape" );
@@ -527,9 +618,7 @@ public:
 			blks << idx;
 		}
 
-		spTangentSpace update;
-		for ( auto& b : blks )
-			update.cast( nif, b );
+		spTangentSpace::castMultiple( nif, blks, false );
 
 		return QModelIndex();
 	}
@@ -3,6 +3,8 @@
 
 #include "spellbook.h"
 
+#include <vector>
+
 
 //! Calculates tangents and bitangents
 /*!
@@ -18,6 +20,26 @@ public:
 	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final;
 	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final;
 	static void tangentSpaceSFMesh( NifModel * nif, const QModelIndex & index );
+
+	//! Updates the tangent spaces of multiple shapes, calculating them in parallel
+	/*!
+	 * The mesh data of all shapes is read first, then the tangents are calculated on multiple threads,
+	 * and finally the results are written back to the model.
+	 * If checkInternalGeometry is true, Starfield shapes are converted to internal geometry as needed.
+	 */
+	static void castMultiple( NifModel * nif, const QList<QPersistentModelIndex> & blocks,
+								bool checkInternalGeometry = true );
+
+protected:
+	struct MeshData;
+
+	// appends the input data of a shape to meshes, returns false if the shape has insufficient data
+	static bool loadMeshData( std::vector< MeshData > & meshes, const NifModel * nif, const QModelIndex & iBlock );
+	// appends the input data of all Starfield meshes in index to meshes
+	static void loadSFMeshData( std::vector< MeshData > & meshes, const NifModel * nif, const QModelIndex & index );
+	// does not access the model, can be called from any thread
+	static void calculate( MeshData & m );
+	static void storeMeshData( NifModel * nif, const MeshData & m );
 };
 
 
@@ -41,6 +41,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QMimeData>
 #include <QClipboard>
 #include <QKeyEvent>
+#include <QSet>
 
 #include <vector>
 
@@ -60,15 +61,21 @@ NifTreeView::~NifTreeView()
 
 void NifTreeView::setModel( QAbstractItemModel * model )
 {
-	if ( nif )
+	if ( nif ) {
 		disconnect( nif, &BaseModel::dataChanged, this, &NifTreeView::updateConditions );
+		disconnect( nif, &BaseModel::conditionsInvalidated, this, &NifTreeView::onConditionsInvalidated );
+	}
 
 	nif = qobject_cast<BaseModel *>( model );
+	pendingConditionRows.clear();
+	conditionsReportedItem = nullptr;
 
 	QTreeView::setModel( model );
 
-	if ( nif )
+	if ( nif ) {
 		connect( nif, &BaseModel::dataChanged, this, &NifTreeView::updateConditions );
+		connect( nif, &BaseModel::conditionsInvalidated, this, &NifTreeView::onConditionsInvalidated );
+	}
 }
 
 void NifTreeView::setRootIndex( const QModelIndex & index )
@@ -94,7 +101,7 @@ void NifTreeView::setRowHiding( bool show )
 	doRowHiding = !show;
 
 	if ( nif )
-		connect( nif, &BaseModel::dataChanged, this, &NifTreeView::updateConditions );
+		connect( nif, &BaseModel::dataChanged, this, &NifTreeView::updateConditions, Qt::UniqueConnection );
 
 	// refresh
 	updateConditionRecurse( rootIndex() );
@@ -284,9 +291,56 @@ void NifTreeView::updateConditions( const QModelIndex & topLeft, const QModelInd
 	if ( nif->getState() != BaseModel::Default )
 		return;
 
-	Q_UNUSED( bottomRight );
-	updateConditionRecurse( topLeft.parent() );
-	doItemsLayout();
+	// A single value change with the affected rows already queued by onConditionsInvalidated()
+	const void *	reportedItem = conditionsReportedItem;
+	conditionsReportedItem = nullptr;
+	if ( topLeft == bottomRight && reportedItem && topLeft.internalPointer() == reportedItem )
+		return;
+
+	queueConditionUpdate( topLeft.parent() );
+}
+
+void NifTreeView::onConditionsInvalidated( const QModelIndex & index, const QModelIndexList & rows )
+{
+	if ( nif->getState() != BaseModel::Default )
+		return;
+
+	conditionsReportedItem = index.internalPointer();
+	for ( const auto & i : rows )
+		queueConditionUpdate( i );
+}
+
+void NifTreeView::queueConditionUpdate( const QModelIndex & index )
+{
+	if ( !index.isValid() )
+		return;
+
+	// Duplicates are removed by updatePendingConditions()
+	if ( pendingConditionRows.isEmpty() )
+		QMetaObject::invokeMethod( this, &NifTreeView::updatePendingConditions, Qt::QueuedConnection );
+	pendingConditionRows.append( index );
+}
+
+void NifTreeView::updatePendingConditions()
+{
+	QList<QPersistentModelIndex> rows;
+	rows.swap( pendingConditionRows );
+	if ( !nif || nif->getState() != BaseModel::Default )
+		return;
+
+	rowsHiddenChanged = false;
+	QSet<const void *> done;
+	done.reserve( rows.size() );
+	for ( const auto & i : rows ) {
+		// Rows removed since they were queued are no longer valid
+		if ( !i.isValid() || done.contains( i.internalPointer() ) )
+			continue;
+		done.insert( i.internalPointer() );
+		updateConditionRecurse( i );
+	}
+
+	if ( rowsHiddenChanged )
+		doItemsLayout();
 }
 
 void NifTreeView::updateConditionRecurse( const QModelIndex & index )
@@ -307,7 +361,11 @@ void NifTreeView::updateConditionRecurse( const QModelIndex & index )
 		updateConditionRecurse( child );
 	}
 
-	setRowHidden( index.row(), index.parent(), isRowHidden(item) );
+	bool hidden = isRowHidden( item );
+	if ( hidden != QTreeView::isRowHidden( index.row(), index.parent() ) ) {
+		setRowHidden( index.row(), index.parent(), hidden );
+		rowsHiddenChanged = true;
+	}
 }
 
 auto splitMime = []( QString format ) {
@@ -34,6 +34,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define NIFTREEVIEW_H
 
 #include <QTreeView> // Inherited
+#include <QPersistentModelIndex>
 #include <data/nifvalue.h>
 
 #include <memory>
@@ -84,9 +85,13 @@ public slots:
 
 	//! Updates version conditions (connect to dataChanged)
 	void updateConditions( const QModelIndex & topLeft, const QModelIndex & bottomRight );
+	//! Queues the rows invalidated by a value change for updating (connect to conditionsInvalidated)
+	void onConditionsInvalidated( const QModelIndex & index, const QModelIndexList & rows );
 protected slots:
 	//! Recursively updates version conditions
 	void updateConditionRecurse( const QModelIndex & index );
+	//! Updates the queued rows and the layout, called once per event loop iteration
+	void updatePendingConditions();
 	//! Called when the current index changes
 	void currentChanged( const QModelIndex & current, const QModelIndex & previous ) override final;
 
@@ -121,6 +126,16 @@ protected:
 
 	class BaseModel * nif = nullptr;
 
+	//! Rows (and their children) to be updated by updatePendingConditions(), may contain duplicates
+	QList<QPersistentModelIndex> pendingConditionRows;
+	//! The item of the last conditionsInvalidated() signal, its dataChanged() needs no full update
+	const void * conditionsReportedItem = nullptr;
+	//! Set by updateConditionRecurse() if a row was hidden or shown
+	bool rowsHiddenChanged = false;
+
+	//! Queues a row for updatePendingConditions()
+	void queueConditionUpdate( const QModelIndex & index );
+
 	//! Row Copy
 	void copy();
 	//! Row Paste
@@ -64,6 +64,10 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QFileDialog>
 #include <QSurfaceFormat>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #define BASESIZE 1024.0
 #define GRIDSIZE 16.0
 #define GRIDSEGS 4
@@ -72,6 +76,40 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MAXSCALE 10.0
 #define MAXTRANS 10.0
 
+//! Returns a bit set of the texcoords in the selection, out of range indices are ignored
+static std::vector<bool> selectionMask( const QList<int> & selection, qsizetype numVerts )
+{
+	std::vector<bool>	mask( size_t( numVerts ), false );
+	for ( const auto i : selection ) {
+		if ( i >= 0 && i < numVerts )
+			mask[i] = true;
+	}
+	return mask;
+}
+
+//! Transforms the selected texcoords around their centre by the 2x2 matrix m (m[0] m[1] = first row)
+static void transformSelection( QVector<Vector2> & texcoords, const QList<int> & selection, const float * m )
+{
+	if ( selection.isEmpty() )
+		return;
+
+	Vector2 *	tc = texcoords.data();
+	double	centreU = 0.0;
+	double	centreV = 0.0;
+	for ( const auto i : selection ) {
+		centreU += tc[i][0];
+		centreV += tc[i][1];
+	}
+	float	cU = float( centreU / double( selection.size() ) );
+	float	cV = float( centreV / double( selection.size() ) );
+
+	for ( const auto i : selection ) {
+		float	u = tc[i][0] - cU;
+		float	v = tc[i][1] - cV;
+		tc[i] = Vector2( m[0] * u + m[1] * v + cU, m[2] * u + m[3] * v + cV );
+	}
+}
+
 
 UVWidget * UVWidget::createEditor( NifModel * nif, const QModelIndex & idx )
 {
@@ -403,11 +441,13 @@ void UVWidget::drawTexCoords()
 	FloatVector4	nlColor = FloatVector4( Color4(cfg.wireframe) ).blendValues( FloatVector4( 0.5f ), 0x08 );
 	FloatVector4	hlColor = FloatVector4( Color4(cfg.highlight) ).blendValues( FloatVector4( 0.5f ), 0x08 );
 
+	std::vector<bool>	selected = selectionMask( selection, numVerts );
+
 	// load geometry data
 	for ( qsizetype i = 0; i < numVerts; i++ ) {
 		Vector2	v( texcoords.at( i ) );
 		float	z = 0.0f;
-		if ( selection.contains( int( i ) ) ) {
+		if ( selected[i] ) {
 			vertexColorData[i] = hlColor;
 			z = 1.0f;
 		} else {
@@ -517,16 +557,98 @@ QVector<int> UVWidget::indices( const QPoint & p ) const
 	return indices( QRect( p - QPoint( d2, d2 ), QSize( d, d ) ) );
 }
 
-QVector<int> UVWidget::indices( const QRegion & region ) const
+void UVWidget::TexCoordGrid::build( const QVector<Vector2> & texcoords )
+{
+	qsizetype	n = texcoords.size();
+	// about 2 texcoords per cell on average
+	gridSize = std::clamp< int >( int( std::sqrt( double( n ) * 0.5 ) ), 1, 1024 );
+
+	float	maxU = 0.0f;
+	float	maxV = 0.0f;
+	minU = 0.0f;
+	minV = 0.0f;
+	bool	first = true;
+	for ( qsizetype i = 0; i < n; i++ ) {
+		const Vector2 &	v = texcoords.at( i );
+		if ( !( std::isfinite( v[0] ) && std::isfinite( v[1] ) ) )
+			continue;
+		if ( first ) {
+			minU = maxU = v[0];
+			minV = maxV = v[1];
+			first = false;
+			continue;
+		}
+		minU = std::min( minU, v[0] );
+		maxU = std::max( maxU, v[0] );
+		minV = std::min( minV, v[1] );
+		maxV = std::max( maxV, v[1] );
+	}
+	scaleU = float( gridSize ) / std::max( maxU - minU, 1.0e-6f );
+	scaleV = float( gridSize ) / std::max( maxV - minV, 1.0e-6f );
+
+	// counting sort of the texcoord indices by cell
+	qsizetype	numCells = qsizetype( gridSize ) * gridSize;
+	cellOffsets.fill( 0, numCells + 1 );
+	QVector<int>	cells( n );
+	for ( qsizetype i = 0; i < n; i++ ) {
+		const Vector2 &	v = texcoords.at( i );
+		cells[i] = cellY( v[1] ) * gridSize + cellX( v[0] );
+		cellOffsets[cells[i] + 1]++;
+	}
+	for ( qsizetype i = 0; i < numCells; i++ )
+		cellOffsets[i + 1] += cellOffsets[i];
+	items.resize( n );
+	QVector<int>	pos( cellOffsets );
+	for ( qsizetype i = 0; i < n; i++ )
+		items[pos[cells[i]]++] = int( i );
+}
+
+int UVWidget::TexCoordGrid::cellX( float u ) const
+{
+	float	x = ( u - minU ) * scaleU;
+	return ( x > 0.0f ? int( std::min( x, float( gridSize - 1 ) ) ) : 0 );
+}
+
+int UVWidget::TexCoordGrid::cellY( float v ) const
 {
-	QList<int> hits;
+	float	y = ( v - minV ) * scaleV;
+	return ( y > 0.0f ? int( std::min( y, float( gridSize - 1 ) ) ) : 0 );
+}
 
-	for ( int i = 0; i < texcoords.count(); i++ ) {
-		if ( region.contains( mapFromContents( texcoords[ i ] ) ) )
-			hits << i;
+QVector<int> UVWidget::indices( const QRegion & region ) const
+{
+	QVector<int> hits;
+	if ( texcoords.isEmpty() || region.isEmpty() )
+		return hits;
+
+	if ( !texcoordGrid.gridSize )
+		texcoordGrid.build( texcoords );
+
+	// texcoords within half a pixel of the bounding rectangle can round into the region
+	QRect	r = region.boundingRect();
+	Vector2	a = mapToContents( r.topLeft() - QPoint( 1, 1 ) );
+	Vector2	b = mapToContents( r.bottomRight() + QPoint( 1, 1 ) );
+	const TexCoordGrid &	g = texcoordGrid;
+	int	x0 = g.cellX( std::min( a[0], b[0] ) );
+	int	x1 = g.cellX( std::max( a[0], b[0] ) );
+	int	y0 = g.cellY( std::min( a[1], b[1] ) );
+	int	y1 = g.cellY( std::max( a[1], b[1] ) );
+
+	for ( int y = y0; y <= y1; y++ ) {
+		for ( int x = x0; x <= x1; x++ ) {
+			int	c = y * g.gridSize + x;
+			for ( int j = g.cellOffsets.at( c ); j < g.cellOffsets.at( c + 1 ); j++ ) {
+				int	i = g.items.at( j );
+				if ( region.contains( mapFromContents( texcoords.at( i ) ) ) )
+					hits.append( i );
+			}
+		}
 	}
 
-	return hits.toVector();
+	// the mouse click selection cycles through the hits in index order
+	std::sort( hits.begin(), hits.end() );
+
+	return hits;
 }
 
 bool UVWidget::bindTexture( const TextureInfo & t )
@@ -1207,7 +1329,9 @@ bool UVWidget::setNifData( NifModel * nifModel, const QModelIndex & nifIndex )
 bool UVWidget::setTexCoords( const QVector<Triangle> * triangles )
 {
 	faces.clear();
-	texcoords2faces.clear();
+	texcoordFaceOffsets.clear();
+	texcoordFaces.clear();
+	texcoordGrid.gridSize = 0;
 
 	if ( iTexCoords.isValid() && nif->isArray( iTexCoords ) )
 		texcoords = nif->getArray<Vector2>( iTexCoords );
@@ -1244,24 +1368,44 @@ bool UVWidget::setTexCoords( const QVector<Triangle> * triangles )
 	QVectorIterator<Triangle> itri( tris );
 
 	unsigned int	numVerts = (unsigned int) texcoords.size();
+	faces.reserve( tris.size() );
 	while ( itri.hasNext() ) {
 		Triangle	t = itri.next();
 		unsigned int	d = std::min( t[0], std::min( t[1], t[2] ) );
 		if ( d >= numVerts )
 			d = 0;
-		int	fIdx = int( faces.size() );
 		for ( int i = 0; i < 3; i++ ) {
 			if ( t[i] >= numVerts )
 				t[i] = d;		// remove invalid indices
-			else
-				texcoords2faces.insert( int( t[i] ), fIdx );
 		}
 		faces.append( t );
 	}
 
+	// build the texcoord to face table with a counting sort
+	texcoordFaceOffsets.fill( 0, qsizetype( numVerts ) + 1 );
+	for ( const Triangle & t : faces ) {
+		for ( int i = 0; i < 3; i++ )
+			texcoordFaceOffsets[t[i] + 1]++;
+	}
+	for ( unsigned int i = 0; i < numVerts; i++ )
+		texcoordFaceOffsets[i + 1] += texcoordFaceOffsets[i];
+	texcoordFaces.resize( texcoordFaceOffsets.last() );
+	QVector<int>	pos( texcoordFaceOffsets );
+	for ( qsizetype f = 0; f < faces.size(); f++ ) {
+		for ( int i = 0; i < 3; i++ )
+			texcoordFaces[pos[faces.at( f )[i]]++] = int( f );
+	}
+
 	return true;
 }
 
+void UVWidget::texCoordsChanged()
+{
+	texcoordGrid.gridSize = 0;
+	updateNif();
+	update();
+}
+
 void UVWidget::updateNif()
 {
 	if ( nif && iTexCoords.isValid() ) {
@@ -1381,9 +1525,12 @@ void UVWidget::select( int index, bool yes )
 void UVWidget::select( const QRegion & r, bool add )
 {
 	QList<int> sel( add ? this->selection : QList<int>() );
+	std::vector<bool>	selected = selectionMask( sel, texcoords.size() );
 	for ( const auto s : indices( r ) ) {
-		if ( !sel.contains( s ) )
+		if ( !selected[s] ) {
+			selected[s] = true;
 			sel.append( s );
+		}
 	}
 	undoStack->push( new UVWSelectCommand( this, sel ) );
 }
@@ -1406,11 +1553,17 @@ void UVWidget::selectAll()
 void UVWidget::selectFaces()
 {
 	QList<int> sel = this->selection;
-	for ( const auto s : QList<int>( sel ) ) {
-		for ( const auto f : texcoords2faces.values( s ) ) {
+	std::vector<bool>	selected = selectionMask( sel, std::max< qsizetype >( texcoordFaceOffsets.size() - 1, 0 ) );
+	for ( const auto s : this->selection ) {
+		if ( !( s >= 0 && s < qsizetype( selected.size() ) ) )
+			continue;
+		for ( int j = texcoordFaceOffsets.at( s ); j < texcoordFaceOffsets.at( s + 1 ); j++ ) {
+			const Triangle &	t = faces.at( texcoordFaces.at( j ) );
 			for ( int i = 0; i < 3; i++ ) {
-				if ( !sel.contains( faces.at(f)[i] ) )
-					sel.append( faces.at(f)[i] );
+				if ( !selected[t[i]] ) {
+					selected[t[i]] = true;
+					sel.append( t[i] );
+				}
 			}
 		}
 	}
@@ -1420,17 +1573,19 @@ void UVWidget::selectFaces()
 void UVWidget::selectConnected()
 {
 	QList<int> sel = this->selection;
-	bool more = true;
-
-	while ( more ) {
-		more = false;
-		for ( const auto s : QList<int>( sel ) ) {
-			for ( const auto f :texcoords2faces.values( s ) ) {
-				for ( int i = 0; i < 3; i++ ) {
-					if ( !sel.contains( faces.at(f)[i] ) ) {
-						sel.append( faces.at(f)[i] );
-						more = true;
-					}
+	std::vector<bool>	selected = selectionMask( sel, std::max< qsizetype >( texcoordFaceOffsets.size() - 1, 0 ) );
+
+	// breadth-first search, the selection list is also the queue
+	for ( qsizetype k = 0; k < sel.size(); k++ ) {
+		int	s = sel.at( k );
+		if ( !( s >= 0 && s < qsizetype( selected.size() ) ) )
+			continue;
+		for ( int j = texcoordFaceOffsets.at( s ); j < texcoordFaceOffsets.at( s + 1 ); j++ ) {
+			const Triangle &	t = faces.at( texcoordFaces.at( j ) );
+			for ( int i = 0; i < 3; i++ ) {
+				if ( !selected[t[i]] ) {
+					selected[t[i]] = true;
+					sel.append( t[i] );
 				}
 			}
 		}
@@ -1464,20 +1619,18 @@ public:
 
 	void redo() override final
 	{
-		for ( const auto tc : uvw->selection ) {
-			uvw->texcoords[tc] += move;
-		}
-		uvw->updateNif();
-		uvw->update();
+		Vector2 *	tc = uvw->texcoords.data();
+		for ( const auto i : uvw->selection )
+			tc[i] += move;
+		uvw->texCoordsChanged();
 	}
 
 	void undo() override final
 	{
-		for ( const auto tc : uvw->selection ) {
-			uvw->texcoords[tc] -= move;
-		}
-		uvw->updateNif();
-		uvw->update();
+		Vector2 *	tc = uvw->texcoords.data();
+		for ( const auto i : uvw->selection )
+			tc[i] -= move;
+		uvw->texCoordsChanged();
 	}
 
 protected:
@@ -1520,52 +1673,16 @@ public:
 
 	void redo() override final
 	{
-		Vector2 centre;
-		for ( const auto i : uvw->selection ) {
-			centre += uvw->texcoords[i];
-		}
-		centre /= uvw->selection.size();
-
-		for ( const auto i : uvw->selection ) {
-			uvw->texcoords[i] -= centre;
-		}
-
-		for ( const auto i : uvw->selection ) {
-			Vector2 temp( uvw->texcoords[i] );
-			uvw->texcoords[i] = Vector2( temp[0] * scaleX, temp[1] * scaleY );
-		}
-
-		for ( const auto i : uvw->selection ) {
-			uvw->texcoords[i] += centre;
-		}
-
-		uvw->updateNif();
-		uvw->update();
+		const float	m[4] = { scaleX, 0.0f, 0.0f, scaleY };
+		transformSelection( uvw->texcoords, uvw->selection, m );
+		uvw->texCoordsChanged();
 	}
 
 	void undo() override final
 	{
-		Vector2 centre;
-		for ( const auto i : uvw->selection ) {
-			centre += uvw->texcoords[i];
-		}
-		centre /= uvw->selection.size();
-
-		for ( const auto i : uvw->selection ) {
-			uvw->texcoords[i] -= centre;
-		}
-
-		for ( const auto i : uvw->selection ) {
-			Vector2 temp( uvw->texcoords[i] );
-			uvw->texcoords[i] = Vector2( temp[0] / scaleX, temp[1] / scaleY );
-		}
-
-		for ( const auto i : uvw->selection ) {
-			uvw->texcoords[i] += centre;
-		}
-
-		uvw->updateNif();
-		uvw->update();
+		const float	m[4] = { 1.0f / scaleX, 0.0f, 0.0f, 1.0f / scaleY };
+		transformSelection( uvw->texcoords, uvw->selection, m );
+		uvw->texCoordsChanged();
 	}
 
 protected:
@@ -1707,65 +1824,27 @@ public:
 
 	void redo() override final
 	{
-		Vector2 centre;
-		for ( const auto i : uvw->selection ) {
-			centre += uvw->texcoords[i];
-		}
-		centre /= uvw->selection.size();
-
-		for ( const auto i : uvw->selection ) {
-			uvw->texcoords[i] -= centre;
-		}
-
-		Matrix rotMatrix;
-		rotMatrix.fromEuler( 0, 0, deg2rad(rotation) );
-
-		for ( const auto i : uvw->selection ) {
-			Vector3 temp( uvw->texcoords[i], 0 );
-			temp = rotMatrix * temp;
-			uvw->texcoords[i] = Vector2( temp[0], temp[1] );
-		}
-
-		for ( const auto i : uvw->selection ) {
-			uvw->texcoords[i] += centre;
-		}
-
-		uvw->updateNif();
-		uvw->update();
+		rotate( deg2rad( rotation ) );
 	}
 
 	void undo() override final
 	{
-		Vector2 centre;
-		for ( const auto i : uvw->selection ) {
-			centre += uvw->texcoords[i];
-		}
-		centre /= uvw->selection.size();
-
-		for ( const auto i : uvw->selection ) {
-			uvw->texcoords[i] -= centre;
-		}
-
-		Matrix rotMatrix;
-		rotMatrix.fromEuler( 0, 0, -deg2rad(rotation) );
-
-		for ( const auto i : uvw->selection ) {
-			Vector3 temp( uvw->texcoords[i], 0 );
-			temp = rotMatrix * temp;
-			uvw->texcoords[i] = Vector2( temp[0], temp[1] );
-		}
-
-		for ( const auto i : uvw->selection ) {
-			uvw->texcoords[i] += centre;
-		}
-
-		uvw->updateNif();
-		uvw->update();
+		rotate( -deg2rad( rotation ) );
 	}
 
 protected:
 	UVWidget * uvw;
 	float rotation;
+
+	void rotate( float a )
+	{
+		// same as a rotation around the Z axis with Matrix::fromEuler()
+		float	c = std::cos( a );
+		float	s = std::sin( a );
+		const float	m[4] = { c, -s, s, c };
+		transformSelection( uvw->texcoords, uvw->selection, m );
+		uvw->texCoordsChanged();
+	}
 };
 
 void UVWidget::rotateSelection()
@@ -170,7 +170,9 @@ private:
 
 	QVector<Vector2> texcoords;
 	QVector<Triangle> faces;
-	QMultiMap<int, int> texcoords2faces;
+	//! Faces using texcoord i are texcoordFaces[texcoordFaceOffsets[i]] to texcoordFaces[texcoordFaceOffsets[i + 1] - 1]
+	QVector<int> texcoordFaceOffsets;
+	QVector<int> texcoordFaces;
 	QVector<Vector3> vertexPosBuf;
 	QVector<FloatVector4> vertexColorBuf;
 
@@ -202,9 +204,32 @@ private:
 	bool bindTexture( const TextureInfo & t );
 	bool bindTexture( const QModelIndex & iSource );
 
+	//! Uniform grid of texcoord indices for hit testing
+	struct TexCoordGrid
+	{
+		//! Number of cells in each direction, 0 if the grid needs to be rebuilt
+		int	gridSize = 0;
+		float	minU = 0.0f;
+		float	minV = 0.0f;
+		float	scaleU = 0.0f;
+		float	scaleV = 0.0f;
+		//! Texcoords in cell i are items[cellOffsets[i]] to items[cellOffsets[i + 1] - 1]
+		QVector<int>	cellOffsets;
+		QVector<int>	items;
+
+		void build( const QVector<Vector2> & texcoords );
+		int cellX( float u ) const;
+		int cellY( float v ) const;
+	};
+	//! Built on demand by indices() after the texcoords change
+	mutable TexCoordGrid	texcoordGrid;
+
 	QVector<int> indices( const QPoint & p ) const;
 	QVector<int> indices( const QRegion & r ) const;
 
+	//! Rebuilds the hit testing grid on the next query, writes the texcoords to the nif and redraws
+	void texCoordsChanged();
+
 	QPoint mapFromContents( const Vector2 & v ) const;
 	Vector2 mapToContents( const QPoint & p ) const;
 
@@ -2,6 +2,7 @@
 
 #include "message.h"
 #include "model/kfmmodel.h"
+#include "model/nifindex.h"
 #include "model/nifmodel.h"
 #include "ui/widgets/fileselect.h"
 
@@ -10,7 +11,11 @@
 #include <QAction>
 #include <QCheckBox>
 #include <QCloseEvent>
+#include <QCommandLineParser>
+#include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QGroupBox>
 #include <QLabel>
 #include <QLayout>
@@ -19,14 +24,39 @@
 #include <QMouseEvent>
 #include <QProgressBar>
 #include <QPushButton>
+#include <QSet>
 #include <QSettings>
 #include <QSpinBox>
 #include <QTextBrowser>
 #include <QToolButton>
 #include <QComboBox>
-#include <QQueue>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 
-#define NUM_THREADS 4
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+//! Maximum number of results in a batch sent by a TestThread
+#define RESULT_BATCH_SIZE 64
+//! Maximum time in milliseconds before a TestThread sends the results it has
+#define RESULT_BATCH_TIME 250
+
+
+static QStringList fileExtensions( bool nif, bool kf, bool kfm )
+{
+	QStringList extensions;
+
+	if ( nif )
+		extensions << "*.nif" << "*.nifcache" << "*.texcache" << "*.pcpatch" << "*.bto" << "*.btr" << "*.item" << "*.nif_wii" << "*.cat";
+	if ( kf )
+		extensions << "*.kf" << "*.kfa";
+	if ( kfm )
+		extensions << "*.kfm";
+
+	return extensions;
+}
 
 
 TestShredder * TestShredder::create()
@@ -90,9 +120,21 @@ TestShredder::TestShredder()
 	repErr = new QCheckBox( tr( "Show only Matches/Errors" ), this );
 	repErr->setChecked( settings.value( "List Matches Only", true ).toBool() );
 
+	mapFiles = new QCheckBox( tr( "Memory Mapped" ), this );
+	mapFiles->setChecked( settings.value( "Memory Mapped", false ).toBool() );
+	mapFiles->setToolTip( tr( "Read the files through memory mapping instead of file I/O" ) );
+
+	useIndex = new QCheckBox( tr( "Use Index" ), this );
+	useIndex->setChecked( settings.value( "Use Index", false ).toBool() );
+	useIndex->setToolTip( tr( "Answer the block, version and value matches from a search index of the folder instead of checking every file."
+		" Only the new and changed files are loaded to update the index.\n"
+		"Error checking, Header Only, Memory Mapped and *.kfm files are not supported with the index.\n"
+		"An empty value name matches all strings, \"Resource Path\" matches texture, material and mesh paths,"
+		" other values must be one of: %1" ).arg( NifIndex::indexedValues().join( ", " ) ) );
+
 	count = new QSpinBox();
-	count->setRange( 1, 16 );
-	count->setValue( settings.value( "Threads", NUM_THREADS ).toInt() );
+	count->setRange( 1, std::max( 16, QThread::idealThreadCount() ) );
+	count->setValue( settings.value( "Threads", QThread::idealThreadCount() ).toInt() );
 	connect( count, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, &TestShredder::renumberThreads );
 
 	//Version Check
@@ -145,6 +187,8 @@ TestShredder::TestShredder()
 	hbox->addWidget( chkCheckErrors );
 	hbox->addWidget( repErr );
 	hbox->addWidget( hdrOnly );
+	hbox->addWidget( mapFiles );
+	hbox->addWidget( useIndex );
 
 	lay->addLayout( hbox = new QHBoxLayout() );
 	hbox->addWidget( new QLabel( tr( "Version Match:" ) ) );
@@ -161,6 +205,12 @@ TestShredder::TestShredder()
 	hbox->addWidget( btXML );
 	hbox->addWidget( btClose );
 
+	indexThread = new IndexThread( this );
+	connect( indexThread, &IndexThread::sigProgress, this, &TestShredder::onIndexProgress );
+	connect( indexThread, &IndexThread::sigResults, this, &TestShredder::onResults );
+	connect( indexThread, &IndexThread::sigError, text, &QTextBrowser::append );
+	connect( indexThread, &IndexThread::finished, this, &TestShredder::threadFinished );
+
 	renumberThreads( count->value() );
 
 	settings.endGroup();
@@ -179,6 +229,8 @@ TestShredder::~TestShredder()
 	settings.setValue( "List Matches Only", repErr->isChecked() );
 	settings.setValue( "Header Only", hdrOnly->isChecked() );
 	settings.setValue( "Error Checking", chkCheckErrors->isChecked() );
+	settings.setValue( "Memory Mapped", mapFiles->isChecked() );
+	settings.setValue( "Use Index", useIndex->isChecked() );
 	settings.setValue( "Threads", count->value() );
 
 	settings.endGroup();
@@ -196,25 +248,30 @@ void TestShredder::xml()
 	KfmModel::loadXML();
 }
 
+TestOptions TestShredder::currentOptions() const
+{
+	TestOptions options;
+	options.blockMatch = blockMatch->text();
+	options.valueName = valueName->text();
+	options.valueMatch = valueMatch->text();
+	options.op = OpType( valueOps->currentIndex() );
+	options.verMatch = NifModel::version2number( verMatch->text() );
+	options.reportAll = !repErr->isChecked();
+	options.headerOnly = hdrOnly->isChecked();
+	options.checkFile = chkCheckErrors->isChecked();
+	options.memoryMapped = mapFiles->isChecked();
+	return options;
+}
+
 void TestShredder::renumberThreads( int num )
 {
 	while ( threads.count() < num ) {
 		TestThread * thread = new TestThread( this, &queue );
-		connect( thread, &TestThread::sigStart, this, &TestShredder::threadStarted );
-		connect( thread, &TestThread::sigReady, text, &QTextBrowser::append );
+		connect( thread, &TestThread::sigResults, this, &TestShredder::onResults );
 		connect( thread, &TestThread::finished, this, &TestShredder::threadFinished );
-		connect( thread, &TestThread::incrementError, this, &TestShredder::onIncrementError );
 		threads.append( thread );
 
-		thread->blockMatch = blockMatch->text();
-		thread->verMatch  = NifModel::version2number( verMatch->text() );
-		thread->reportAll = !repErr->isChecked();
-		thread->headerOnly = hdrOnly->isChecked();
-		thread->checkFile = chkCheckErrors->isChecked();
-
-		thread->valueName = valueName->text();
-		thread->valueMatch = valueMatch->text();
-		thread->op = OpType(valueOps->currentIndex());
+		thread->options = currentOptions();
 
 		if ( btRun->isChecked() ) {
 			thread->start();
@@ -230,8 +287,9 @@ void TestShredder::renumberThreads( int num )
 void TestShredder::run()
 {
 	errorCount = 0;
-	progress->setMaximum( progress->maximum() - queue.count() );
+	progress->setMaximum( progress->maximum() - int( queue.count() ) );
 	queue.clear();
+	indexThread->abort = true;
 
 	if ( !btRun->isChecked() )
 		return;
@@ -239,45 +297,53 @@ void TestShredder::run()
 	for ( TestThread * thread : threads ) {
 		thread->wait();
 	}
+	indexThread->wait();
+	indexThread->abort = false;
 
 	text->clear();
 	label->setHidden( true );
 
-	QStringList extensions;
-
-	if ( chkNif->isChecked() )
-		extensions << "*.nif" << "*.nifcache" << "*.texcache" << "*.pcpatch" << "*.bto" << "*.btr" << "*.item" << "*.nif_wii" << "*.cat";
-	if ( chkKf->isChecked() )
-		extensions << "*.kf" << "*.kfa";
-	if ( chkKfm->isChecked() )
-		extensions << "*.kfm";
+	if ( useIndex->isChecked() ) {
+		QStringList ignored;
+		if ( chkCheckErrors->isChecked() )
+			ignored << chkCheckErrors->text();
+		if ( hdrOnly->isChecked() )
+			ignored << hdrOnly->text();
+		if ( mapFiles->isChecked() )
+			ignored << mapFiles->text();
+		if ( chkKfm->isChecked() )
+			ignored << chkKfm->text();
+		if ( !ignored.isEmpty() )
+			text->append( tr( "<p>Not supported with the index, ignored: %1</p>" ).arg( ignored.join( ", " ).toHtmlEscaped() ) );
+
+		time = QDateTime::currentDateTime();
+
+		// Busy indicator until the files to index are known
+		progress->setRange( 0, 0 );
+
+		indexThread->folder = directory->text();
+		indexThread->extensions = fileExtensions( chkNif->isChecked(), chkKf->isChecked(), false );
+		indexThread->recursive = recursive->isChecked();
+		indexThread->threadCount = count->value();
+		indexThread->options = currentOptions();
+		indexThread->start();
+		return;
+	}
 
-	queue.init( directory->text(), extensions, recursive->isChecked() );
+	queue.init( directory->text(), fileExtensions( chkNif->isChecked(), chkKf->isChecked(), chkKfm->isChecked() ), recursive->isChecked() );
 
 	time = QDateTime::currentDateTime();
 
-	progress->setRange( 0, queue.count() );
+	progress->setRange( 0, int( queue.count() ) );
 	progress->setValue( 0 );
 
+	TestOptions options = currentOptions();
 	for ( TestThread * thread : threads ) {
-		thread->verMatch = NifModel::version2number( verMatch->text() );
-		thread->blockMatch = blockMatch->text();
-		thread->reportAll  = !repErr->isChecked();
-		thread->headerOnly = hdrOnly->isChecked();
-		thread->checkFile = chkCheckErrors->isChecked();
-		thread->valueName = valueName->text();
-		thread->valueMatch = valueMatch->text();
-		thread->op = OpType(valueOps->currentIndex());
-
+		thread->options = options;
 		thread->start();
 	}
 }
 
-void TestShredder::threadStarted()
-{
-	progress->setValue( progress->maximum() - queue.count() );
-}
-
 void TestShredder::threadFinished()
 {
 	std::uint32_t finishedThreads = 0;
@@ -286,8 +352,11 @@ void TestShredder::threadFinished()
 			if ( thread->isRunning() )
 				return;
 		}
+		if ( indexThread->isRunning() )
+			return;
 
 		btRun->setChecked( false );
+		progress->setValue( progress->maximum() );
 
 		label->setText( tr( "%1 files in %2 seconds" ).arg( progress->maximum() ).arg( time.secsTo( QDateTime::currentDateTime() ) ) );
 		label->setVisible( true );
@@ -301,10 +370,229 @@ void TestShredder::threadFinished()
 	}
 }
 
-void TestShredder::onIncrementError()
+void TestShredder::onIndexProgress( int value, int maximum )
 {
-	QMutexLocker lock(&mutex);
-	errorCount += 1;
+	progress->setRange( 0, maximum );
+	progress->setValue( value );
+}
+
+void TestShredder::onResults( const QList<TestResult> & results )
+{
+	if ( !indexThread->isRunning() )
+		progress->setValue( progress->maximum() - int( queue.count() ) );
+
+	if ( results.isEmpty() )
+		return;
+
+	// Format the whole batch as one append to the text browser
+	QString html;
+	for ( const TestResult & r : results ) {
+		if ( !r.recognized ) {
+			html += QString( "<p>Did not recognize file as a NIF: %1</p>" ).arg( r.file );
+			continue;
+		}
+
+		html += QString( "<p><a href=\"nif:%1\">%1</a> (%2, %3, %4)" )
+			.arg( r.file, r.version ).arg( r.userVersion ).arg( r.bsVersion );
+		for ( const QString & m : r.messages )
+			html += "<br>" + m.toHtmlEscaped();
+		html += "</p>";
+
+		errorCount += uint32_t( r.messages.size() );
+	}
+
+	text->append( html );
+}
+
+//! Quotes a CSV field if required
+static QString csvField( const QString & s )
+{
+	if ( !s.contains( ',' ) && !s.contains( '"' ) && !s.contains( '\n' ) && !s.contains( '\r' ) )
+		return s;
+
+	QString t = s;
+	t.replace( "\"", "\"\"" );
+	return "\"" + t + "\"";
+}
+
+int TestShredder::runHeadless( QCoreApplication & app )
+{
+	// Names of the value operators on the command line, in OpType order
+	static const QStringList opNames = {
+		"eq", "neq", "and", "and_s", "nand", "starts", "ends", "not_starts", "not_ends", "contains"
+	};
+
+	QCommandLineParser parser;
+	parser.setSingleDashWordOptionMode( QCommandLineParser::ParseAsLongOptions );
+	parser.setApplicationDescription( "Checks the NIF, KF and KFM files in a folder and writes a CSV or JSON report." );
+	parser.addHelpOption();
+	parser.addPositionalArgument( "folder", "Folder to check" );
+
+	QCommandLineOption noGuiOption( "no-gui", "Run without GUI" );
+	QCommandLineOption reportOption( { "o", "report" }, "Report file, JSON if it ends with .json, CSV otherwise (default: CSV to stdout)", "file" );
+	QCommandLineOption typesOption( "types", "Comma separated list of the file types to check (default: nif,kf,kfm)", "types", "nif,kf,kfm" );
+	QCommandLineOption noRecursiveOption( "no-recursive", "Do not recurse into sub directories" );
+	QCommandLineOption blockOption( "block", "Only report files containing a block of this type", "type" );
+	QCommandLineOption valueOption( "value", "Name of the value to match", "name" );
+	QCommandLineOption matchOption( "match", "Value to compare with", "value" );
+	QCommandLineOption opOption( "op", "Value operator: " + opNames.join( ", " ) + " (default: eq)", "op", "eq" );
+	QCommandLineOption versionOption( "version", "Only check files of this version", "version" );
+	QCommandLineOption headerOption( "header-only", "Only load the file headers" );
+	QCommandLineOption noChecksOption( "no-checks", "Disable error checking" );
+	QCommandLineOption allOption( "all", "Report all files, not only matches and errors" );
+	QCommandLineOption mmapOption( "mmap", "Read the files through memory mapping" );
+	QCommandLineOption threadsOption( "threads", "Number of threads (default: all cores)", "count", QString::number( QThread::idealThreadCount() ) );
+	QCommandLineOption indexOption( "index", "Update the search index of the folder and answer the block, version and value matches from it."
+										" No error checking is done, and --header-only, --mmap and kfm files are not supported."
+										" An empty value name matches all strings, \"Resource Path\" the resource paths,"
+										" other values must be one of: " + NifIndex::indexedValues().join( ", " ) );
+	QCommandLineOption indexFileOption( "index-file", "Index file (default: in the user cache directory)", "file" );
+	QCommandLineOption rebuildIndexOption( "rebuild-index", "Index all files again instead of only the new and changed ones" );
+
+	parser.addOptions( { noGuiOption, reportOption, typesOption, noRecursiveOption, blockOption, valueOption, matchOption,
+						 opOption, versionOption, headerOption, noChecksOption, allOption, mmapOption, threadsOption,
+						 indexOption, indexFileOption, rebuildIndexOption } );
+	parser.process( app );
+
+	if ( parser.positionalArguments().isEmpty() || !QDir( parser.positionalArguments().first() ).exists() ) {
+		qCritical().noquote() << "A folder to check is required, see --help";
+		return 1;
+	}
+
+	TestOptions options;
+	options.blockMatch = parser.value( blockOption );
+	options.valueName = parser.value( valueOption );
+	options.valueMatch = parser.value( matchOption );
+	options.op = OpType( std::max( int( opNames.indexOf( parser.value( opOption ).toLower() ) ), 0 ) );
+	options.verMatch = NifModel::version2number( parser.value( versionOption ) );
+	options.reportAll = parser.isSet( allOption );
+	options.headerOnly = parser.isSet( headerOption );
+	options.checkFile = !parser.isSet( noChecksOption );
+	options.memoryMapped = parser.isSet( mmapOption );
+
+	QStringList types = parser.value( typesOption ).toLower().split( ',', Qt::SkipEmptyParts );
+
+	QString folder = parser.positionalArguments().first();
+	bool recursive = !parser.isSet( noRecursiveOption );
+	int threadCount = std::max( parser.value( threadsOption ).toInt(), 1 );
+
+	qsizetype fileCount = 0;
+	QDateTime start = QDateTime::currentDateTime();
+	QList<TestResult> results;
+
+	if ( parser.isSet( indexOption ) ) {
+		QStringList ignored;
+		if ( parser.isSet( headerOption ) )
+			ignored << "--header-only";
+		if ( parser.isSet( mmapOption ) )
+			ignored << "--mmap";
+		if ( parser.isSet( typesOption ) && types.contains( "kfm" ) )
+			ignored << "kfm files";
+		if ( !ignored.isEmpty() )
+			qWarning().noquote() << "Not supported with --index, ignored:" << ignored.join( ", " );
+		if ( options.checkFile )
+			qInfo().noquote() << "No error checking is done with --index";
+
+		NifIndex index( folder );
+		QString indexFile = parser.isSet( indexFileOption ) ? parser.value( indexFileOption ) : NifIndex::defaultIndexFile( folder );
+		if ( !parser.isSet( rebuildIndexOption ) )
+			index.load( indexFile );
+
+		qsizetype indexed = index.update( fileExtensions( types.contains( "nif" ), types.contains( "kf" ), false ), recursive, threadCount );
+		if ( !index.save( indexFile ) )
+			qWarning().noquote() << "Could not write index" << indexFile;
+		qInfo().noquote() << QString( "%1 of %2 files indexed" ).arg( indexed ).arg( index.files().size() );
+
+		QString error;
+		results = IndexThread::query( index, options, &error );
+		if ( !error.isEmpty() ) {
+			qCritical().noquote() << error;
+			return 1;
+		}
+
+		fileCount = index.files().size();
+	} else {
+		FileQueue queue;
+		queue.init( folder, fileExtensions( types.contains( "nif" ), types.contains( "kf" ), types.contains( "kfm" ) ), recursive );
+		fileCount = queue.count();
+
+		// The results are collected directly from the threads, there is no event loop running
+		QMutex resultsMutex;
+
+		std::vector<std::unique_ptr<TestThread>> threads;
+		for ( int i = 0; i < threadCount; i++ ) {
+			auto thread = std::make_unique<TestThread>( nullptr, &queue );
+			thread->options = options;
+			connect( thread.get(), &TestThread::sigResults, thread.get(), [&results, &resultsMutex]( const QList<TestResult> & r ) {
+				QMutexLocker lock( &resultsMutex );
+				results += r;
+			}, Qt::DirectConnection );
+			thread->start();
+			threads.push_back( std::move( thread ) );
+		}
+
+		for ( auto & thread : threads )
+			thread->wait();
+	}
+
+	std::sort( results.begin(), results.end(), []( const TestResult & a, const TestResult & b ) {
+		return a.file < b.file;
+	} );
+
+	QByteArray report;
+	QString reportName = parser.value( reportOption );
+	qsizetype messageCount = 0;
+
+	if ( reportName.endsWith( ".json", Qt::CaseInsensitive ) ) {
+		QJsonArray files;
+		for ( const TestResult & r : results ) {
+			QJsonObject file;
+			file["file"] = r.file;
+			file["version"] = r.version;
+			file["userVersion"] = qint64( r.userVersion );
+			file["bsVersion"] = qint64( r.bsVersion );
+			file["recognized"] = r.recognized;
+			file["messages"] = QJsonArray::fromStringList( r.messages );
+			files.append( file );
+
+			messageCount += r.messages.size();
+		}
+
+		report = QJsonDocument( files ).toJson();
+	} else {
+		QString csv = "File,Version,User Version,BS Version,Message\n";
+		for ( const TestResult & r : results ) {
+			QString row = QString( "%1,%2,%3,%4," ).arg( csvField( r.file ), csvField( r.version ) ).arg( r.userVersion ).arg( r.bsVersion );
+			if ( !r.recognized )
+				csv += row + "Did not recognize file as a NIF\n";
+			else if ( r.messages.isEmpty() )
+				csv += row + "\n";
+
+			for ( const QString & m : r.messages )
+				csv += row + csvField( m ) + "\n";
+
+			messageCount += r.messages.size();
+		}
+
+		report = csv.toUtf8();
+	}
+
+	if ( reportName.isEmpty() ) {
+		QFile out;
+		if ( !out.open( stdout, QIODevice::WriteOnly ) || out.write( report ) != report.size() )
+			return 1;
+	} else {
+		QFile out( reportName );
+		if ( !out.open( QIODevice::WriteOnly ) || out.write( report ) != report.size() ) {
+			qCritical().noquote() << "Could not write report" << reportName;
+			return 1;
+		}
+	}
+
+	qInfo().noquote() << QString( "%1 files in %2 seconds, %3 reported with %4 messages" )
+		.arg( fileCount ).arg( start.secsTo( QDateTime::currentDateTime() ) ).arg( results.size() ).arg( messageCount );
+
+	return 0;
 }
 
 void TestShredder::chooseBlock()
@@ -349,64 +637,62 @@ void TestShredder::closeEvent( QCloseEvent * e )
 			queue.clear();
 		}
 	}
+
+	if ( indexThread->isRunning() ) {
+		e->ignore();
+		indexThread->abort = true;
+	}
 }
 
 /*
  *  File Queue
  */
 
-QQueue<QString> FileQueue::make( const QString & dname, const QStringList & extensions, bool recursive )
+void FileQueue::make( QStringList & paths, const QString & dname, const QStringList & extensions, bool recursive )
 {
-	QQueue<QString> paths;
-
 	QDir dir( dname );
 
 	if ( recursive ) {
 		dir.setFilter( QDir::Dirs );
 		for ( const QString& d : dir.entryList() ) {
 			if ( d != "." && d != ".." )
-				paths += make( dir.filePath( d ), extensions, true );
+				make( paths, dir.filePath( d ), extensions, true );
 		}
 	}
 
 	dir.setFilter( QDir::Files );
 	dir.setNameFilters( extensions );
 	for ( const QString& f : dir.entryList() ) {
-		paths.enqueue( dir.filePath( f ) );
+		paths.append( dir.filePath( f ) );
 	}
-
-	return paths;
 }
 
 void FileQueue::init( const QString & dname, const QStringList & extensions, bool recursive )
 {
-	QQueue<QString> paths = make( dname, extensions, recursive );
+	QStringList paths;
+	make( paths, dname, extensions, recursive );
 
-	mutex.lock();
-	this->queue = paths;
-	mutex.unlock();
+	files.swap( paths );
+	next.store( 0 );
 }
 
 QString FileQueue::dequeue()
 {
-	QMutexLocker lock( &mutex );
-
-	if ( queue.isEmpty() )
+	qsizetype i = next.fetch_add( 1, std::memory_order_relaxed );
+	if ( i >= files.size() )
 		return QString();
 
-	return queue.dequeue();
+	return files.at( i );
 }
 
-int FileQueue::count()
+qsizetype FileQueue::count() const
 {
-	QMutexLocker lock( &mutex );
-	return queue.count();
+	return std::max< qsizetype >( files.size() - next.load( std::memory_order_relaxed ), 0 );
 }
 
 void FileQueue::clear()
 {
-	QMutexLocker lock( &mutex );
-	queue.clear();
+	next.store( files.size() );
 }
 
 /*
@@ -432,159 +718,179 @@ void TestThread::run()
 	NifModel nif;
 	KfmModel kfm;
 
-	QString filepath = queue->dequeue();
-
-	while ( !filepath.isEmpty() ) {
-		emit sigStart( filepath );
+	QList<TestResult> results;
+	QElapsedTimer timer;
+	timer.start();
 
-		BaseModel * model = &nif;
-		QReadWriteLock * lock = &nif.XMLlock;
+	for ( QString filepath = queue->dequeue(); !filepath.isEmpty(); filepath = queue->dequeue() ) {
+		TestResult result;
+		if ( testFile( nif, kfm, filepath, options, result ) )
+			results.append( result );
 
-		if ( filepath.endsWith( ".KFM", Qt::CaseInsensitive ) ) {
-			model = &kfm;
-			lock  = &kfm.XMLlock;
+		// Send the results in batches to limit the number of signals and text browser updates
+		if ( results.size() >= RESULT_BATCH_SIZE || timer.elapsed() >= RESULT_BATCH_TIME ) {
+			emit sigResults( results );
+			results.clear();
+			timer.restart();
 		}
 
-		bool kf = ( filepath.endsWith( ".KF", Qt::CaseInsensitive ) || filepath.endsWith( ".KFA", Qt::CaseInsensitive ) );
-
-		{
-			// lock the XML lock
-			QReadLocker lck( lock );
-
-			QString result;
-			if ( model == &nif && nif.earlyRejection( filepath, blockMatch, verMatch ) ) {
-				bool loaded = (headerOnly) ? nif.loadHeaderOnly(filepath) : model->loadFromFile(filepath);
-
-				result = QString( "<a href=\"nif:%1\">%1</a> (%2, %3, %4)" )
-					.arg( filepath, model->getVersion() ).arg( nif.getUserVersion() ).arg( nif.getBSVersion() );
-				QList<TestMessage> messages = model->getMessages();
-
-				bool blk_match = false;
-				bool val_match = false;
-
-				if ( !headerOnly && loaded && model == &nif ) {
-					for ( int b = 0; b < nif.getBlockCount(); b++ ) {
-						auto blk = nif.getBlockIndex( b );
-						bool current_match = !blockMatch.isEmpty() && nif.inherits(nif.itemName(blk), blockMatch);
-						blk_match |= current_match;
-
-						NifValue value;
-						if ( (blockMatch.isEmpty() || current_match) && !valueName.isEmpty() && !valueMatch.isEmpty() ) {
-							auto nameIdx = nif.getIndex(blk, valueName);
-							bool hasName = nameIdx.isValid();
-							if ( hasName ) {
-								value = nif.getValue(nameIdx);
-
-								bool isInt = value.isCount() && !value.isFloat();
-								bool isStr = value.isString() || value.type() == NifValue::tStringIndex || value.isFloat();
-
-								qint64 asInt = qint64( value.toCount( nullptr, nullptr) );
-								auto asStr = ( value.type() == NifValue::tStringIndex ) ? nif.resolveString(nameIdx) : value.toString();
-
-								bool current_match = false;
-
-								switch ( op ) {
-								case OP_EQ:
-									if ( isInt )
-										current_match = (asInt == valueMatch.toInt(nullptr, 0));
-									else if ( isStr )
-										current_match = (asStr == valueMatch);
-									break;
-								case OP_NEQ:
-									if ( isInt )
-										current_match = (asInt != valueMatch.toInt(nullptr, 0));
-									else if ( isStr )
-										current_match = (asStr != valueMatch);
-									break;
-								case OP_AND:
-									if ( !isInt )
-										break;
-									current_match = (asInt & valueMatch.toInt(nullptr, 0));
-									break;
-								case OP_AND_S:
-									if ( !isInt )
-										break;
-									current_match = (asInt & (1 << valueMatch.toInt(nullptr, 0)));
-									break;
-								case OP_NAND:
-									if ( !isInt )
-										break;
-									current_match = !(asInt & valueMatch.toInt(nullptr, 0));
-									break;
-								case OP_STR_S:
-									current_match = asStr.startsWith(valueMatch, Qt::CaseInsensitive);
-									break;
-								case OP_STR_E:
-									current_match = asStr.endsWith(valueMatch, Qt::CaseInsensitive);
-									break;
-								case OP_STR_NS:
-									current_match = !asStr.startsWith(valueMatch, Qt::CaseInsensitive);
-									break;
-								case OP_STR_NE:
-									current_match = !asStr.endsWith(valueMatch, Qt::CaseInsensitive);
-									break;
-								case OP_CONT:
-									current_match = asStr.contains(valueMatch, Qt::CaseInsensitive);
-									break;
-								default:
-									current_match = false;
-									break;
-								}
-
-								if ( current_match )
-									messages += TestMessage( QtInfoMsg ) <<
-												QString( "[%1] Found Match: %2 %3 %4 | Value: %5" ).arg(b)
-												.arg(valueName).arg(ops_ord[int(op)].toHtmlEscaped())
-												.arg(valueMatch).arg(asStr);
-							} else {
-								current_match = false;
-							}
-
-							val_match |= current_match;
-						}
+		if ( quit.tryLock() )
+			quit.unlock();
+		else
+			break;
+	}
+
+	emit sigResults( results );
+}
 
-						if ( checkFile ) {
-							messages += checkLinks(&nif, blk, kf);
+bool TestThread::testFile( NifModel & nif, KfmModel & kfm, const QString & filepath, const TestOptions & options, TestResult & result )
+{
+	const QString & blockMatch = options.blockMatch;
+	const QString & valueName = options.valueName;
+	const QString & valueMatch = options.valueMatch;
+	OpType op = options.op;
+	quint32 verMatch = options.verMatch;
+
+	BaseModel * model = &nif;
+	QReadWriteLock * lock = &nif.XMLlock;
+
+	if ( filepath.endsWith( ".KFM", Qt::CaseInsensitive ) ) {
+		model = &kfm;
+		lock  = &kfm.XMLlock;
+	}
+
+	bool kf = ( filepath.endsWith( ".KF", Qt::CaseInsensitive ) || filepath.endsWith( ".KFA", Qt::CaseInsensitive ) );
+
+	// lock the XML lock
+	QReadLocker lck( lock );
+
+	result.file = filepath;
+
+	if ( model == &nif && nif.earlyRejection( filepath, blockMatch, verMatch ) ) {
+		bool loaded = (options.headerOnly) ? nif.loadHeaderOnly(filepath) : model->loadFromFile(filepath, options.memoryMapped);
+
+		result.version = model->getVersion();
+		result.userVersion = nif.getUserVersion();
+		result.bsVersion = nif.getBSVersion();
+		QList<TestMessage> messages = model->getMessages();
+
+		bool blk_match = false;
+		bool val_match = false;
+
+		if ( !options.headerOnly && loaded && model == &nif ) {
+			for ( int b = 0; b < nif.getBlockCount(); b++ ) {
+				auto blk = nif.getBlockIndex( b );
+				bool current_match = !blockMatch.isEmpty() && nif.inherits(nif.itemName(blk), blockMatch);
+				blk_match |= current_match;
+
+				NifValue value;
+				if ( (blockMatch.isEmpty() || current_match) && !valueName.isEmpty() && !valueMatch.isEmpty() ) {
+					auto nameIdx = nif.getIndex(blk, valueName);
+					bool hasName = nameIdx.isValid();
+					if ( hasName ) {
+						value = nif.getValue(nameIdx);
+
+						bool isInt = value.isCount() && !value.isFloat();
+						bool isStr = value.isString() || value.type() == NifValue::tStringIndex || value.isFloat();
+
+						qint64 asInt = qint64( value.toCount( nullptr, nullptr) );
+						auto asStr = ( value.type() == NifValue::tStringIndex ) ? nif.resolveString(nameIdx) : value.toString();
+
+						bool current_match = false;
+
+						switch ( op ) {
+						case OP_EQ:
+							if ( isInt )
+								current_match = (asInt == valueMatch.toInt(nullptr, 0));
+							else if ( isStr )
+								current_match = (asStr == valueMatch);
+							break;
+						case OP_NEQ:
+							if ( isInt )
+								current_match = (asInt != valueMatch.toInt(nullptr, 0));
+							else if ( isStr )
+								current_match = (asStr != valueMatch);
+							break;
+						case OP_AND:
+							if ( !isInt )
+								break;
+							current_match = (asInt & valueMatch.toInt(nullptr, 0));
+							break;
+						case OP_AND_S:
+							if ( !isInt )
+								break;
+							current_match = (asInt & (1 << valueMatch.toInt(nullptr, 0)));
+							break;
+						case OP_NAND:
+							if ( !isInt )
+								break;
+							current_match = !(asInt & valueMatch.toInt(nullptr, 0));
+							break;
+						case OP_STR_S:
+							current_match = asStr.startsWith(valueMatch, Qt::CaseInsensitive);
+							break;
+						case OP_STR_E:
+							current_match = asStr.endsWith(valueMatch, Qt::CaseInsensitive);
+							break;
+						case OP_STR_NS:
+							current_match = !asStr.startsWith(valueMatch, Qt::CaseInsensitive);
+							break;
+						case OP_STR_NE:
+							current_match = !asStr.endsWith(valueMatch, Qt::CaseInsensitive);
+							break;
+						case OP_CONT:
+							current_match = asStr.contains(valueMatch, Qt::CaseInsensitive);
+							break;
+						default:
+							current_match = false;
+							break;
 						}
-					}
 
-					if ( checkFile ) {
-						for ( auto checker : SpellBook::checkers() )
-							checker->castIfApplicable(&nif, {});
-						messages += nif.getMessages();
+						if ( current_match )
+							messages += TestMessage( QtInfoMsg ) <<
+										QString( "[%1] Found Match: %2 %3 %4 | Value: %5" ).arg(b)
+										.arg(valueName).arg(ops_ord[int(op)])
+										.arg(valueMatch).arg(asStr);
+					} else {
+						current_match = false;
 					}
 
+					val_match |= current_match;
 				}
 
-				bool rep = reportAll || (blk_match && valueMatch.isEmpty());
-
-				// Don't show anything if block match is on but the requested type wasn't found & we're in block match mode
-				if ( blockMatch.isEmpty() == true || blk_match == true || val_match == true ) {
-					for ( const TestMessage& msg : messages ) {
-						if ( msg.type() != QtDebugMsg ) {
-							result += "<br>" + msg;
-							rep |= true;
-							emit incrementError();
-						}
-					}
-
-					if ( rep )
-						emit sigReady( result );
+				if ( options.checkFile ) {
+					messages += checkLinks(&nif, blk, kf);
 				}
-			} else if ( !blockMatch.isEmpty() && !verMatch ) {
-				// Do not silently fail on unrecognized NIFs
-				result += QString("Did not recognize file as a NIF: %1").arg(filepath);
-				emit sigReady(result);
 			}
+
+			if ( options.checkFile ) {
+				for ( auto checker : SpellBook::checkers() )
+					checker->castIfApplicable(&nif, {});
+				messages += nif.getMessages();
+			}
+
 		}
 
-		if ( quit.tryLock() )
-			quit.unlock();
-		else
-			break;
+		bool rep = options.reportAll || (blk_match && valueMatch.isEmpty());
+
+		// Don't show anything if block match is on but the requested type wasn't found & we're in block match mode
+		if ( blockMatch.isEmpty() == true || blk_match == true || val_match == true ) {
+			for ( const TestMessage& msg : messages ) {
+				if ( msg.type() != QtDebugMsg ) {
+					result.messages.append( msg );
+					rep |= true;
+				}
+			}
 
-		filepath = queue->dequeue();
+			return rep;
+		}
+	} else if ( !blockMatch.isEmpty() && !verMatch ) {
+		// Do not silently fail on unrecognized NIFs
+		result.recognized = false;
+		return true;
 	}
+
+	return false;
 }
 
 static QString linkId( const NifModel * nif, QModelIndex idx )
@@ -633,3 +939,202 @@ QList<TestMessage> TestThread::checkLinks( const NifModel * nif, const QModelInd
 
 	return messages;
 }
+
+/*
+ *  Index Thread
+ */
+
+IndexThread::IndexThread( QObject * o )
+	: QThread( o )
+{
+}
+
+IndexThread::~IndexThread()
+{
+	if ( isRunning() ) {
+		abort = true;
+		wait();
+	}
+}
+
+void IndexThread::run()
+{
+	NifIndex index( folder );
+	QString indexFile = NifIndex::defaultIndexFile( folder );
+	index.load( indexFile );
+
+	index.update( extensions, recursive, threadCount, [this]( qsizetype done, qsizetype total ) {
+		emit sigProgress( int( done ), int( total ) );
+	}, &abort );
+
+	if ( !index.save( indexFile ) )
+		emit sigError( tr( "Could not write the index file %1" ).arg( indexFile ) );
+
+	if ( abort )
+		return;
+
+	emit sigProgress( int( index.files().size() ), int( index.files().size() ) );
+
+	QString error;
+	QList<TestResult> results = query( index, options, &error );
+	if ( !error.isEmpty() )
+		emit sigError( error );
+
+	emit sigResults( results );
+}
+
+//! Compares a string with the value of a match, as TestThread does for string values
+static bool matchString( const QString & s, const QString & m, OpType op )
+{
+	switch ( op ) {
+	case OP_EQ:
+		return s == m;
+	case OP_NEQ:
+		return s != m;
+	case OP_STR_S:
+		return s.startsWith( m, Qt::CaseInsensitive );
+	case OP_STR_E:
+		return s.endsWith( m, Qt::CaseInsensitive );
+	case OP_STR_NS:
+		return !s.startsWith( m, Qt::CaseInsensitive );
+	case OP_STR_NE:
+		return !s.endsWith( m, Qt::CaseInsensitive );
+	case OP_CONT:
+		return s.contains( m, Qt::CaseInsensitive );
+	default:
+		return false;
+	}
+}
+
+QList<TestResult> IndexThread::query( const NifIndex & index, const TestOptions & options, QString * error )
+{
+	QList<TestResult> results;
+
+	enum { MatchNone, MatchStrings, MatchResources, MatchValues } mode = MatchNone;
+	QString match = options.valueMatch;
+	QString name = options.valueName;
+	qint64 nameId = -1;
+
+	if ( !match.isEmpty() ) {
+		if ( name.isEmpty() ) {
+			mode = MatchStrings;
+			name = "String";
+		} else if ( name == "Resource Path" ) {
+			mode = MatchResources;
+			match = NifIndex::normalizePath( match );
+		} else if ( NifIndex::indexedValues().contains( name ) ) {
+			mode = MatchValues;
+			nameId = index.stringId( name );
+		} else {
+			if ( error )
+				*error = tr( "%1 is not indexed, the indexed values are: %2" ).arg( name, NifIndex::indexedValues().join( ", " ) );
+			return results;
+		}
+	}
+
+	qint64 matchInt = match.toLongLong( nullptr, 0 );
+	auto matchValue = [&]( qint64 v ) {
+		switch ( options.op ) {
+		case OP_EQ:
+			return v == matchInt;
+		case OP_NEQ:
+			return v != matchInt;
+		case OP_AND:
+			return ( v & matchInt ) != 0;
+		case OP_AND_S:
+			return ( matchInt >= 0 && matchInt < 64 && ( v & ( qint64( 1 ) << matchInt ) ) != 0 );
+		case OP_NAND:
+			return ( v & matchInt ) == 0;
+		default:
+			return matchString( QString::number( v ), match, options.op );
+		}
+	};
+
+	// The block type and string matches are evaluated once per string in the pool, not once per file
+	std::vector<signed char> typeMatches( size_t( index.stringCount() ), -1 );
+	std::vector<signed char> stringMatches( size_t( index.stringCount() ), -1 );
+
+	NifModel nif;
+	QReadLocker lck( &NifModel::XMLlock );
+
+	bool hasCriteria = ( !options.blockMatch.isEmpty() || options.verMatch || mode != MatchNone );
+
+	auto blockTypeMatches = [&]( quint32 id ) {
+		if ( id == NifIndex::headerBlock )
+			return false;
+		signed char & m = typeMatches[id];
+		if ( m < 0 )
+			m = nif.inherits( index.string( id ), options.blockMatch );
+		return m > 0;
+	};
+	// Like TestThread, a value only matches if it is in a block of the matching type
+	auto inMatchingBlock = [&]( quint32 id ) {
+		return options.blockMatch.isEmpty() || blockTypeMatches( id );
+	};
+
+	for ( const NifIndex::FileEntry & e : index.files() ) {
+		TestResult r;
+		r.file = QDir( index.folder() ).filePath( e.path );
+
+		if ( !e.loaded ) {
+			r.recognized = false;
+			if ( options.reportAll || ( !options.blockMatch.isEmpty() && !options.verMatch ) )
+				results.append( r );
+			continue;
+		}
+
+		if ( options.verMatch && e.version != options.verMatch )
+			continue;
+
+		r.version = NifModel::version2string( e.version );
+		r.userVersion = e.userVersion;
+		r.bsVersion = e.bsVersion;
+
+		if ( !options.blockMatch.isEmpty() ) {
+			bool blk_match = std::any_of( e.blockTypes.cbegin(), e.blockTypes.cend(), blockTypeMatches );
+			if ( !blk_match )
+				continue;
+		}
+
+		bool val_match = ( mode == MatchNone );
+		auto foundMatch = [&]( const QString & value ) {
+			val_match = true;
+			r.messages.append( QString( "Found Match: %1 %2 %3 | Value: %4" )
+							   .arg( name, ops_ord[int( options.op )], options.valueMatch, value ) );
+		};
+
+		if ( mode == MatchStrings || mode == MatchResources ) {
+			const QList<quint32> & ids = ( mode == MatchStrings ? e.strings : e.resources );
+			const QList<quint32> & blocks = ( mode == MatchStrings ? e.stringBlocks : e.resourceBlocks );
+			qint64 lastMatch = -1;
+			for ( qsizetype i = 0; i < ids.size(); i++ ) {
+				// The pairs are sorted by string, report each string once
+				quint32 id = ids.at( i );
+				if ( qint64( id ) == lastMatch || !inMatchingBlock( blocks.at( i ) ) )
+					continue;
+				signed char & m = stringMatches[id];
+				if ( m < 0 )
+					m = matchString( index.string( id ), match, options.op );
+				if ( m ) {
+					lastMatch = id;
+					foundMatch( index.string( id ) );
+				}
+			}
+		} else if ( mode == MatchValues ) {
+			QSet<qint64> found;
+			for ( qsizetype i = 0; i < e.values.size(); i++ ) {
+				qint64 v = e.values.at( i );
+				if ( qint64( e.valueNames.at( i ) ) == nameId && !found.contains( v )
+					 && inMatchingBlock( e.valueBlocks.at( i ) ) && matchValue( v ) ) {
+					found.insert( v );
+					foundMatch( QString( "0x%1 (%2)" ).arg( quint64( v ), 0, 16 ).arg( v ) );
+				}
+			}
+		}
+
+		if ( val_match && ( hasCriteria || options.reportAll ) )
+			results.append( r );
+	}
+
+	return results;
+}
@@ -5,12 +5,12 @@
 #include <QThread> // Inherited
 #include <QWidget> // Inherited
 #include <QMutex>
-#include <QQueue>
 #include <QDateTime>
-#include <QWaitCondition>
+#include <QStringList>
 
 #include <map>
 #include <array>
+#include <atomic>
 
 
 class QCheckBox;
@@ -20,7 +20,9 @@ class QProgressBar;
 class QPushButton;
 class QSpinBox;
 class QComboBox;
+class QCoreApplication;
 class QTextBrowser;
+class NifIndex;
 
 class TestMessage;
 class FileSelector;
@@ -59,6 +61,11 @@ static std::map<QString, QPair<OpType, QString>> ops = {
 	{ ops_ord[OP_CONT], {OP_CONT, "Contains"} }
 };
 
+//! List of files shared by the test threads
+/*!
+ * The list is not modified while the threads are running, files are taken from it
+ * by incrementing an atomic index, so that the threads never wait for each other.
+ */
 class FileQueue final
 {
 public:
@@ -66,51 +73,114 @@ public:
 
 	QString dequeue();
 
-	bool isEmpty() { return count() == 0; }
-	int count();
+	bool isEmpty() const { return count() == 0; }
+	qsizetype count() const;
 
+	//! Must not be called while threads are using the queue
 	void init( const QString & directory, const QStringList & extensions, bool recursive );
+	//! Removes the remaining files, can be called while threads are running
 	void clear();
 
 protected:
-	QQueue<QString> make( const QString & directory, const QStringList & extensions, bool recursive );
+	void make( QStringList & paths, const QString & directory, const QStringList & extensions, bool recursive );
 
-	QMutex mutex;
-	QQueue<QString> queue;
+	QStringList files;
+	std::atomic< qsizetype > next = 0;
 };
 
-class TestThread final : public QThread
+//! Search and checking parameters of TestShredder
+struct TestOptions
 {
-	Q_OBJECT
-
-public:
-	TestThread( QObject * o, FileQueue * q );
-	~TestThread();
-
 	QString blockMatch;
 	QString valueName;
 	QString valueMatch;
-	OpType op;
+	OpType op = OP_EQ;
 	quint32 verMatch = 0;
 	bool reportAll = true;
 	bool headerOnly = false;
 	bool checkFile = true;
+	bool memoryMapped = false;
+};
+
+//! Result of testing one file
+struct TestResult
+{
+	QString file;
+	QString version;
+	quint32 userVersion = 0;
+	quint32 bsVersion = 0;
+	//! False if the file was not recognized as a NIF
+	bool recognized = true;
+	//! Errors and value matches found in the file
+	QStringList messages;
+};
+
+class TestThread final : public QThread
+{
+	Q_OBJECT
+
+public:
+	TestThread( QObject * o, FileQueue * q );
+	~TestThread();
+
+	TestOptions options;
+
+	//! Tests a single file, returns false if there is nothing to report
+	static bool testFile( class NifModel & nif, class KfmModel & kfm, const QString & filepath,
+							const TestOptions & options, TestResult & result );
 
 signals:
-	void sigStart( const QString & file );
-	void sigReady( const QString & result );
-	void incrementError();
+	//! Results of a batch of files, also emitted periodically without results to allow updating the progress
+	void sigResults( const QList<TestResult> & results );
 
 protected:
 	void run() override final;
 
-	QList<TestMessage> checkLinks( const class NifModel * nif, const class QModelIndex & iParent, bool kf );
+	static QList<TestMessage> checkLinks( const class NifModel * nif, const class QModelIndex & iParent, bool kf );
 
 	FileQueue * queue;
 
 	QMutex quit;
 };
 
+//! Updates the search index of a folder and answers a query from it
+class IndexThread final : public QThread
+{
+	Q_OBJECT
+
+public:
+	IndexThread( QObject * o );
+	~IndexThread();
+
+	QString folder;
+	QStringList extensions;
+	bool recursive = true;
+	int threadCount = 0;
+	TestOptions options;
+
+	//! Stops updating the index, the files indexed so far are kept
+	std::atomic<bool> abort = false;
+
+	//! Returns the indexed files matching the block, version and value options
+	/*!
+	 * An empty value name matches the value against all strings of the files, "Resource Path" against
+	 * the resource paths, other names must be one of NifIndex::indexedValues(). As in TestThread, if a block
+	 * type is also given, the value must be found in a block of that type. Unlike TestThread, the messages
+	 * only contain the value matches without block numbers, the files are not checked for errors.
+	 *
+	 * @param error	Set if the query cannot be answered from the index
+	 */
+	static QList<TestResult> query( const NifIndex & index, const TestOptions & options, QString * error = nullptr );
+
+signals:
+	void sigProgress( int value, int maximum );
+	void sigResults( const QList<TestResult> & results );
+	void sigError( const QString & error );
+
+protected:
+	void run() override final;
+};
+
 //! The XML checker widget.
 class TestShredder final : public QWidget
 {
@@ -122,15 +192,18 @@ public:
 
 	static TestShredder * create();
 
+	//! Runs the checks without GUI as configured by the command line, and writes a CSV or JSON report
+	static int runHeadless( QCoreApplication & app );
+
 protected slots:
 	void chooseBlock();
 	void run();
 	void xml();
 
-	void threadStarted();
 	void threadFinished();
 
-	void onIncrementError();
+	void onResults( const QList<TestResult> & results );
+	void onIndexProgress( int value, int maximum );
 
 	void renumberThreads( int );
 
@@ -144,7 +217,7 @@ protected:
 	QComboBox * valueOps;
 	QCheckBox * recursive;
 	QCheckBox * chkNif, * chkKf, * chkKfm, *chkCheckErrors;
-	QCheckBox * repErr, * hdrOnly;
+	QCheckBox * repErr, * hdrOnly, * mapFiles, * useIndex;
 	QSpinBox * count;
 	QLineEdit * verMatch;
 	QTextBrowser * text;
@@ -155,11 +228,13 @@ protected:
 	FileQueue queue;
 
 	QList<TestThread *> threads;
+	IndexThread * indexThread;
 
 	QDateTime time;
 
-	QMutex mutex;
 	uint32_t errorCount = 0;
+
+	TestOptions currentOptions() const;
 };
 
 #endif
@@ -32,6 +32,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "nifexpr.h"
 
+#include <QDataStream>
+
 
 //! @file nifexpr.cpp Expression parsing for conditions defined in nif.xml.
 
@@ -325,3 +327,100 @@ void NifExpr::NormalizeVariants( QVariant & l, QVariant & r ) const
 		}
 	}
 }
+
+// Operand tags used by NifExpr::save() and NifExpr::load()
+enum NifExprOperand : quint8
+{
+	opInvalid, opString, opInt, opUInt, opExpr, opVariant
+};
+
+static void saveOperand( QDataStream & out, const QVariant & v )
+{
+	switch ( v.typeId() ) {
+	case QMetaType::UnknownType:
+		out << quint8( opInvalid );
+		break;
+	case QMetaType::QString:
+		out << quint8( opString ) << v.toString();
+		break;
+	case QMetaType::Int:
+		out << quint8( opInt ) << qint32( v.toInt() );
+		break;
+	case QMetaType::UInt:
+		out << quint8( opUInt ) << quint32( v.toUInt() );
+		break;
+	default:
+		if ( v.typeId() >= QMetaType::User && v.canConvert<NifExpr>() ) {
+			out << quint8( opExpr );
+			v.value<NifExpr>().save( out );
+		} else {
+			out << quint8( opVariant ) << v;
+		}
+		break;
+	}
+}
+
+static bool loadOperand( QDataStream & in, QVariant & v )
+{
+	quint8	tag;
+	in >> tag;
+	switch ( tag ) {
+	case opInvalid:
+		v = QVariant();
+		break;
+	case opString:
+		{
+			QString	s;
+			in >> s;
+			v.setValue( s );
+		}
+		break;
+	case opInt:
+		{
+			qint32	i;
+			in >> i;
+			v.setValue( int( i ) );
+		}
+		break;
+	case opUInt:
+		{
+			quint32	u;
+			in >> u;
+			v.setValue( uint( u ) );
+		}
+		break;
+	case opExpr:
+		{
+			NifExpr	e;
+			if ( !e.load( in ) )
+				return false;
+			v = QVariant::fromValue( e );
+		}
+		break;
+	case opVariant:
+		in >> v;
+		break;
+	default:
+		return false;
+	}
+
+	return ( in.status() == QDataStream::Ok );
+}
+
+void NifExpr::save( QDataStream & out ) const
+{
+	out << quint8( opcode );
+	saveOperand( out, lhs );
+	saveOperand( out, rhs );
+}
+
+bool NifExpr::load( QDataStream & in )
+{
+	quint8	op;
+	in >> op;
+	if ( in.status() != QDataStream::Ok || op > quint8( NifExpr::e_rsh ) )
+		return false;
+
+	opcode = Operator( op );
+	return ( loadOperand( in, lhs ) && loadOperand( in, rhs ) );
+}
@@ -38,6 +38,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QString>
 #include <QVariant>
 
+class QDataStream;
 
 //! @file nifexpr.h NifExpr
 
@@ -77,6 +78,11 @@ public:
 		return opcode == NifExpr::e_nop;
 	}
 
+	//! Write the parsed expression tree to a binary schema cache
+	void save( QDataStream & out ) const;
+	//! Read an expression tree written by save(), returns false on invalid data
+	bool load( QDataStream & in );
+
 public:
 	template <class F>
 	QVariant evaluateValue( const F & convert ) const
@@ -36,8 +36,13 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "model/nifmodel.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDir>
+#include <QFileInfo>
 #include <QMessageBox>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QXmlStreamReader>
 
 
@@ -145,6 +150,18 @@ public:
 	//! Data
 	NifData data;
 
+	//! Default value of a field as parsed from the "default" attribute
+	struct DefaultValue
+	{
+		QString str;
+		quint32 enumVal = 0;
+		bool isEnum = false;
+	};
+	//! Current field default value
+	DefaultValue dataDefault;
+	//! Default values of the fields of all blocks by block and field index, for the schema cache
+	QHash<QPair<const NifBlock *, int>, DefaultValue> defaults;
+
 	//! The current tag
 	Tag current() const
 	{
@@ -430,6 +447,7 @@ public:
 					if ( data.isBinary() && isMultiArray )
 						err( tr("Binary multi-arrays not supported") );
 
+					dataDefault = DefaultValue();
 					if ( !defval.isEmpty() ) {
 						bool ok;
 						quint32 enumVal = NifValue::enumOptionValue( type, defval, &ok );
@@ -439,6 +457,7 @@ public:
 						} else {
 							data.setFromString( defval, nullptr, nullptr );
 						}
+						dataDefault = { defval, enumVal, ok };
 					}
 
 					if ( !vercond.isEmpty() ) {
@@ -580,8 +599,11 @@ public:
 
 			break;
 		case tagAdd:
-			if ( blk )
+			if ( blk ) {
 				blk->types.append( data );
+				if ( !dataDefault.str.isEmpty() )
+					defaults.insert( { blk.get(), int( blk->types.size() - 1 ) }, dataDefault );
+			}
 
 			break;
 		case tagOption:
@@ -726,13 +748,173 @@ bool NifModel::loadXML()
 	return true;
 }
 
+//! Identifies a binary schema cache file
+static constexpr quint32 schemaCacheMagic = 0x4358534E;	// "NSXC"
+//! Version of the schema cache format, must be incremented when the cache or the XML parsing changes
+static constexpr quint32 schemaCacheVersion = 1;
+
+//! Path of the binary schema cache written after parsing nif.xml
+static QString schemaCacheFileName()
+{
+	QString path = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+	if ( path.isEmpty() )
+		path = QDir::tempPath() + "/NifSkope";
+
+	return path + "/nif.xml.cache";
+}
+
+static void saveSchemaBlock( QDataStream & out, const NifBlock & blk )
+{
+	out << blk.id << blk.ancestor << blk.text << blk.abstract << quint32( blk.types.size() );
+	for ( const NifData & d : blk.types ) {
+		d.saveSchema( out );
+		out << quint32( d.valueType() );
+	}
+}
+
+// documented in nifmodel.h
+void NifModel::saveSchemaCache( const QString & cacheName, const QByteArray & key, const NifXmlHandler & handler )
+{
+	QDir().mkpath( QFileInfo( cacheName ).absolutePath() );
+
+	// QSaveFile only replaces the cache after it has been written completely
+	QSaveFile f( cacheName );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return;
+
+	QDataStream out( &f );
+	out.setVersion( QDataStream::Qt_6_0 );
+	out << schemaCacheMagic << schemaCacheVersion << key;
+
+	out << supportedVersions;
+	NifValue::saveTypeRegistry( out );
+
+	auto saveBlocks = [&out, &handler]( const QHash<QString, NifBlockPtr> & blockMap ) {
+		out << quint32( blockMap.size() );
+		for ( const NifBlockPtr & blk : blockMap ) {
+			saveSchemaBlock( out, *blk );
+			out << fixedCompounds.contains( blk->id );
+
+			for ( int i = 0; i < blk->types.size(); i++ ) {
+				auto d = handler.defaults.constFind( { blk.get(), i } );
+				if ( d == handler.defaults.cend() )
+					continue;
+				out << qint32( i ) << d->str << d->enumVal << d->isEnum;
+			}
+			out << qint32( -1 );
+		}
+	};
+	saveBlocks( compounds );
+	saveBlocks( blocks );
+	out << schemaCacheMagic;
+
+	if ( out.status() == QDataStream::Ok )
+		f.commit();
+	else
+		f.cancelWriting();
+}
+
+// documented in nifmodel.h
+bool NifModel::loadSchemaCache( const QString & cacheName, const QByteArray & key )
+{
+	QFile f( cacheName );
+	if ( !f.open( QIODevice::ReadOnly ) )
+		return false;
+
+	qint64	size = f.size();
+	const uchar *	p = f.map( 0, size );
+	if ( !p )
+		return false;
+
+	// QDataStream copies all strings, the mapping is only needed until the end of this function
+	QDataStream in( QByteArray::fromRawData( reinterpret_cast< const char * >( p ), size ) );
+	in.setVersion( QDataStream::Qt_6_0 );
+
+	quint32	magic = 0, version = 0;
+	QByteArray	cacheKey;
+	in >> magic >> version >> cacheKey;
+	if ( in.status() != QDataStream::Ok || magic != schemaCacheMagic || version != schemaCacheVersion || cacheKey != key )
+		return false;
+
+	in >> supportedVersions;
+	if ( !NifValue::loadTypeRegistry( in ) )
+		return false;
+
+	auto loadBlocks = [&in]( QHash<QString, NifBlockPtr> & blockMap ) {
+		quint32	n = 0;
+		in >> n;
+		for ( ; n; n-- ) {
+			NifBlockPtr	blk( new NifBlock );
+			quint32	fieldCnt = 0;
+			in >> blk->id >> blk->ancestor >> blk->text >> blk->abstract >> fieldCnt;
+			if ( in.status() != QDataStream::Ok )
+				return false;
+
+			blk->types.reserve( fieldCnt );
+			for ( ; fieldCnt; fieldCnt-- ) {
+				NifData	d;
+				quint32	valueType = 0;
+				if ( !d.loadSchema( in ) )
+					return false;
+				in >> valueType;
+				d.changeType( NifValue::Type( valueType ) );
+				blk->types.append( d );
+			}
+
+			bool	isFixed = false;
+			in >> isFixed;
+			if ( isFixed )
+				fixedCompounds.insert( blk->id, blk );
+
+			// Default values are applied the same way as when parsing the XML
+			while ( true ) {
+				qint32	i = -1;
+				in >> i;
+				if ( in.status() != QDataStream::Ok )
+					return false;
+				if ( i < 0 )
+					break;
+
+				QString	str;
+				quint32	enumVal = 0;
+				bool	isEnum = false;
+				in >> str >> enumVal >> isEnum;
+				if ( in.status() != QDataStream::Ok || i >= blk->types.size() )
+					return false;
+
+				NifData &	d = blk->types[i];
+				if ( isEnum )
+					d.setCount( enumVal, nullptr, nullptr );
+				else
+					d.setFromString( str, nullptr, nullptr );
+			}
+
+			blockMap.insert( blk->id, blk );
+		}
+		return true;
+	};
+	if ( !loadBlocks( compounds ) || !loadBlocks( blocks ) )
+		return false;
+
+	in >> magic;
+	if ( in.status() != QDataStream::Ok || magic != schemaCacheMagic )
+		return false;
+
+	for ( const NifBlockPtr & blk : std::as_const( blocks ) )
+		blockHashes.insert( DJB1Hash( blk->id.toStdString().c_str() ), blk );
+
+	return true;
+}
+
 // documented in nifmodel.h
 QString NifModel::parseXmlDescription( const QString & filename )
 {
 	QWriteLocker lck( &XMLlock );
 
 	compounds.clear();
+	fixedCompounds.clear();
 	blocks.clear();
+	blockHashes.clear();
 
 	supportedVersions.clear();
 
@@ -746,8 +928,29 @@ QString NifModel::parseXmlDescription( const QString & filename )
 	if ( !f.open( QIODevice::ReadOnly | QIODevice::Text ) )
 		return tr( "Couldn't open NIF XML description file: %1" ).arg( filename );
 
+	QByteArray	xmlData = f.readAll();
+	f.close();
+
+	// The cache is keyed by the XML content, the application version and the layout of the built-in types
+	QCryptographicHash	hash( QCryptographicHash::Md5 );
+	hash.addData( xmlData );
+	hash.addData( QByteArrayView( NIFSKOPE_VERSION ) );
+	hash.addData( NifValue::typeLayoutHash() );
+	QByteArray	cacheKey = hash.result();
+	QString	cacheName = schemaCacheFileName();
+
+	if ( loadSchemaCache( cacheName, cacheKey ) )
+		return QString();
+
+	compounds.clear();
+	fixedCompounds.clear();
+	blocks.clear();
+	blockHashes.clear();
+	supportedVersions.clear();
+	NifValue::initialize();
+
 	NifXmlHandler handler;
-	QXmlStreamReader reader( &f );
+	QXmlStreamReader reader( xmlData );
 	while ( !reader.atEnd() && handler.errorStr.isEmpty() ) {
 		reader.readNext();
 		if ( reader.isStartElement() )
@@ -773,10 +976,13 @@ QString NifModel::parseXmlDescription( const QString & filename )
 		errorStr.prepend( tr( "%1 XML parse error (line %2): " ).arg( "NIF" ).arg( reader.lineNumber() ) );
 
 		compounds.clear();
+		fixedCompounds.clear();
 		blocks.clear();
+		blockHashes.clear();
 		supportedVersions.clear();
+	} else {
+		saveSchemaCache( cacheName, cacheKey, handler );
 	}
 
 	return errorStr;
 }
-